@@ -90,7 +90,7 @@ no_write_init:
 	ldx		#0
 	bit		wmode
 	smi:ldx	#1
-	jsr		CassetteWait
+	jsr		PIOCassetteWait
 	
 	;all done
 	ldy		#1
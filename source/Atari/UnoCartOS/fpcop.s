@@ -0,0 +1,108 @@
+;	Altirra - Atari 800/800XL/5200 emulator
+;	Modular Kernel ROM
+;	Copyright (C) 2008-2016 Avery Lee
+;
+;	UnoCart floating point coprocessor module
+;
+;	Copying and distribution of this file, with or without modification,
+;	are permitted in any medium without royalty provided the copyright
+;	notice and this notice are preserved.  This file is offered as-is,
+;	without any warranty.
+
+;The cart can do FMUL and FDIV for us. It runs a port of the code in
+;mathpack.s on a copy of FR0-FR2, and hands back everything the 6502 code
+;would have left behind (page zero, FLPTR and the registers), as LOG and
+;EXP depend on some of it. If the offload is switched on in the menu,
+;FPCopInit puts a JMP over the start of both routines (the OS is in RAM).
+;FADD/FSUB stay on the 6502, as they are quicker than the trip to the cart
+;and back.
+
+.proc FPCopInit
+	mva		#CART_FP_QUERY CART_FP_MODE
+	ldy		#CART_CMD_FP_MODE
+	jsr		IssueCartCommand
+	bmi		off
+	lda		CART_FP_STATE
+	beq		off
+	lda		#$4c
+	sta		fmul
+	sta		fdiv
+	mwa		#FPCopMul fmul+1
+	mwa		#FPCopDiv fdiv+1
+off:
+	rts
+.endp
+
+;==============================================================================
+
+.proc FPCopMul
+	;zero operands as the 6502 code does, since X and Y are left alone
+	lda		fr0
+	beq		zero
+
+	ldy		#CART_CMD_FP_MUL
+	jsr		FPCopIssue
+	lsr
+	bne		slow
+	lda		CART_FP_A
+	rts
+slow:
+	jmp		fmul+4
+zero:
+	clc
+	rts
+.endp
+
+;==============================================================================
+
+.proc FPCopDiv
+	lda		fr0
+	beq		zero
+	lda		fr1
+	beq		err
+
+	ldy		#CART_CMD_FP_DIV
+	jsr		FPCopIssue
+	lsr
+	bne		slow
+	lda		CART_FP_A
+	rts
+slow:
+	jmp		fdiv+4
+zero:
+	clc
+	rts
+err:
+	sec
+	rts
+.endp
+
+;==============================================================================
+
+.proc FPCopIssue
+	;issue command in Y, returns status in A with X/Y loaded
+	ldx		#CART_FP_ZP_SIZE-1
+copyin:
+	mva		fr0,x CART_FP_ZP,x
+	dex
+	bpl		copyin
+	mwa		flptr CART_FP_FLPTR
+	sty		CART_CMD
+	jsr		PIOWaitReady
+	lda		#CART_FP_STATUS_6502
+	bcs		xit
+	lda		CART_STATUS
+	cmp		#CART_FP_STATUS_6502
+	bcs		xit
+	ldx		#CART_FP_ZP_SIZE-1
+copyout:
+	mva		CART_FP_RESULT,x fr0,x
+	dex
+	bpl		copyout
+	mwa		CART_FP_RESULT+CART_FP_ZP_SIZE flptr
+	ldx		CART_FP_X
+	ldy		CART_FP_Y
+	lda		CART_STATUS
+xit:
+	rts
+.endp
@@ -0,0 +1,266 @@
+;	Altirra - Atari 800/800XL/5200 emulator
+;	Modular Kernel ROM
+;	Copyright (C) 2008-2016 Avery Lee
+;
+;	UnoCart H: device handler
+;
+;	Copying and distribution of this file, with or without modification,
+;	are permitted in any medium without royalty provided the copyright
+;	notice and this notice are preserved.  This file is offered as-is,
+;	without any warranty.
+
+;H: reaches files on the SD card, by name from the directory the ATR was
+;booted from. The firmware does the work and keeps one file open per IOCB.
+;GET CHARS and PUT CHARS move up to 128 bytes per trip through the cart, in
+;the same way as DOS 2's burst mode: the byte routine fills or empties the
+;caller's buffer directly and steps ICBALZ/ICBLLZ over all but the last
+;byte, which CIO then deals with as usual.
+;
+;XIO 48 doesn't touch a file: it works on the ATR overlay while the ATR is
+;still mounted, with AUX1 = 0 to ask, 1 to copy the changes into the ATR
+;and 2 to throw them away. The pages changed come back in ICAX3-4 and
+;ICAX5 is non-zero while the overlay is in use.
+
+HDevXIOPoint	= $25
+HDevXIONote		= $26
+HDevXIOOverlay	= $30
+
+hdevv	dta		a(HDevOpen-1)
+		dta		a(HDevClose-1)
+		dta		a(HDevGetByte-1)
+		dta		a(HDevPutByte-1)
+		dta		a(HDevGetStatus-1)
+		dta		a(HDevSpecial-1)
+		jmp		HDevGetStatus
+		dta		$00
+
+;==============================================================================
+
+.proc HDevInit
+	ldx		#'H'
+	lda		#>hdevv
+	ldy		#<hdevv
+	jmp		PHAddHandler
+.endp
+
+;==============================================================================
+
+.proc HDevOpen
+	mva		icax1z CART_H_AUX1
+	jsr		HDevCopyName
+	ldy		#CART_CMD_H_OPEN
+	jmp		HDevIssue
+.endp
+
+;==============================================================================
+
+.proc HDevClose
+	ldy		#CART_CMD_H_CLOSE
+	jmp		HDevIssue
+.endp
+
+;==============================================================================
+
+.proc HDevGetStatus
+	ldy		#1
+	rts
+.endp
+
+;==============================================================================
+
+.proc HDevGetByte
+	;GET CHARS asks for as much of the buffer as will fit through the cart
+	lda		iccomz
+	and		#$fe
+	cmp		#CIOCmdGetChars&$fe
+	bne		single
+	jsr		HDevBlockLen
+	dta		{bit $0100}
+single:
+	lda		#1
+	sta		CART_H_COUNT
+	ldy		#CART_CMD_H_READ
+	jsr		HDevIssue
+	bmi		xit
+
+	;copy all but the last byte into the buffer, CIO stores the last one
+	ldy		CART_H_LEN
+	dey
+	beq		last
+copy:
+	dey
+	lda		CART_H_DATA,y
+	sta		(icbalz),y
+	tya
+	bne		copy
+	ldx		CART_H_LEN
+	dex
+	jsr		HDevAdvance
+last:
+	ldy		CART_H_LEN
+	lda		CART_H_DATA-1,y
+	ldy		#1
+xit:
+	rts
+.endp
+
+;==============================================================================
+
+.proc HDevPutByte
+	;PUT CHARS sends as much of the buffer as will fit through the cart,
+	;starting with the byte in A
+	sta		CART_H_DATA
+	lda		iccomz
+	and		#$fe
+	cmp		#CIOCmdPutChars&$fe
+	bne		single
+	jsr		HDevBlockLen
+	dta		{bit $0100}
+single:
+	lda		#1
+	sta		CART_H_COUNT
+	tay
+	dey
+	beq		send
+copy:
+	lda		(icbalz),y
+	sta		CART_H_DATA,y
+	dey
+	bne		copy
+send:
+	ldy		#CART_CMD_H_WRITE
+	jsr		HDevIssue
+	bmi		xit
+
+	ldx		CART_H_LEN
+	dex
+	beq		xit
+	jsr		HDevAdvance
+
+	;leave the last byte written in CIOCHR, as CIO would
+	ldy		#0
+	lda		(icbalz),y
+	sta		ciochr
+	iny
+xit:
+	rts
+.endp
+
+;==============================================================================
+
+.proc HDevSpecial
+	lda		iccomz
+	cmp		#HDevXIOOverlay
+	beq		HDevOverlay
+	;POINT and NOTE use the position in ICAX3-5, the rest a filespec
+	mva		icax3,x CART_H_POS
+	mva		icax4,x CART_H_POS+1
+	mva		icax5,x CART_H_POS+2
+	ldy		iccomz
+	sty		CART_H_XIO
+	cpy		#HDevXIOPoint
+	bcc		name
+	cpy		#HDevXIONote+1
+	bcc		issue
+name:
+	jsr		HDevCopyName
+issue:
+	ldy		#CART_CMD_H_SPECIAL
+	jsr		HDevIssue
+	bmi		xit
+	ldx		icidno
+	mva		CART_H_POS icax3,x
+	mva		CART_H_POS+1 icax4,x
+	mva		CART_H_POS+2 icax5,x
+xit:
+	rts
+.endp
+
+;==============================================================================
+
+.proc HDevOverlay
+	mva		icax1z CART_ATR_DELTA_OP
+	ldy		#CART_CMD_ATR_DELTA
+	jsr		IssueCartCommand
+	bmi		xit
+	ldx		icidno
+	mva		CART_ATR_DELTA_PAGES icax3,x
+	mva		CART_ATR_DELTA_PAGES+1 icax4,x
+	mva		CART_ATR_DELTA_ON icax5,x
+	ldy		#1
+xit:
+	rts
+.endp
+
+;==============================================================================
+
+.proc HDevIssue
+	;issue command in Y for the IOCB in X, returns the CIO status in Y
+	txa
+	lsr
+	lsr
+	lsr
+	lsr
+	sta		CART_H_IOCB
+	sty		CART_CMD
+	jsr		PIOWaitReady
+	ldy		#CIOStatTimeout
+	bcs		xit
+	ldy		CART_STATUS
+	sne:iny
+xit:
+	rts
+.endp
+
+;==============================================================================
+
+.proc HDevBlockLen
+	;bytes left in the caller's buffer, up to a block (none means one byte)
+	lda		icblhz
+	bne		full
+	lda		icbllz
+	beq		one
+	bpl		xit
+full:
+	lda		#CART_H_BLOCK
+	rts
+one:
+	lda		#1
+xit:
+	rts
+.endp
+
+;==============================================================================
+
+.proc HDevAdvance
+	;step the caller's buffer over X bytes
+	stx		icax6z
+	txa
+	clc
+	adc		icbalz
+	sta		icbalz
+	scc:inc	icbalz+1
+	lda		icbllz
+	sec
+	sbc		icax6z
+	sta		icbllz
+	scs:dec	icblhz
+	rts
+.endp
+
+;==============================================================================
+
+.proc HDevCopyName
+	;filespec up to the EOL
+	ldy		#0
+loop:
+	lda		(icbalz),y
+	sta		CART_H_NAME,y
+	cmp		#$9b
+	beq		xit
+	iny
+	cpy		#CART_H_NAME_LEN
+	bne		loop
+xit:
+	rts
+.endp
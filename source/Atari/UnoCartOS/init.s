@@ -418,11 +418,18 @@ end:
 	jsr		cioinv
 	jsr		SIOInit
 	jsr		IntInitInterrupts
+.if _KERNEL_XLXE
+	jsr		FPCopInit
+	jsr		HDevInit
+.endif
 	
 	; check for START key, and if so, set cassette boot flag
 	lda		consol
 	and		#1
 	sta		ckey
+.if _KERNEL_XLXE
+	jsr		PIOCassetteBoot
+.endif
 	
 .if _KERNEL_PBI_SUPPORT
 	jsr		PBIScan
@@ -67,6 +67,12 @@
 	_KERNEL_REPORT_MODULE_SIZE	'PBI routines', 0
 	icl		'phandler.s'
 	_KERNEL_REPORT_MODULE_SIZE	'Peripheral Handler routines', 0
+	icl		'fpcop.s'
+	_KERNEL_REPORT_MODULE_SIZE	'FP coprocessor routines', 0
+	icl		'hdevice.s'
+	_KERNEL_REPORT_MODULE_SIZE	'H: device handler', 0
+	icl		'pio.s'
+	_KERNEL_REPORT_MODULE_SIZE	'Cart PIO routines', 0
 	
 	org		$cc00
 	icl		'atariifont.inc'
@@ -237,7 +243,6 @@ gpdvv	PBI_VECTOR_TABLE			;$E48F	XL/XE: Generic device vector
 	_KERNEL_REPORT_MODULE_SIZE 'Monitor routines', $F3E4-$F0E3
 	
 	icl		'screentab.s'
-	icl		'pio.s'
 	icl		'screen.s'
 	icl		'editor.s'
 	icl		'screenext.s'
@@ -18,12 +18,23 @@
 	and 	#$70
 	;check for disk IO
 	cmp		#$30
+	beq		Disk
+	;and cassette reads, for a CAS image
+	cmp		#$60
 	bne		Ignore_Request
+	lda		dcomnd
+	cmp		#'R'
+	beq		CassetteRead
+	bne		Ignore_Request
+Disk:
 	;pass back to OS if not for us
 	lda		dunit
 	cmp		#1
 	bne		Ignore_Request
-	;only handling drive 1 at the moment
+	;only handling drive 1 at the moment, and only with an ATR (a CAS image
+	;may be mounted instead)
+	jsr		GetATRHeader
+	bmi		Ignore_Request
 	lda		dcomnd
 	cmp		#'R'
 	beq		ReadSector
@@ -33,8 +44,10 @@
 	beq		WriteSector
 	cmp 	#'S'
 	beq		GetStatus
-;	cmp		#'N'
-;	beq		GetPERCOM
+	cmp		#'N'
+	beq		GetPERCOM
+	cmp		#'O'
+	beq		WriteSector
 	bne		Error
 	
 Ignore_Request:
@@ -53,6 +66,12 @@ ReadSector:
 	bmi		Error
 	
 GetBufferSize:
+	;number of 128 byte pages, 128/256/512 byte sectors
+	lda		dbytlo
+	asl
+	lda		dbythi
+	rol
+	sta		bfenlo
 	ldx		#0
 	
 TransferLoop:
@@ -63,41 +82,58 @@ TransferLoop:
 	bne		Transfer
 
 GetStatus:
-	jsr		GetATRHeader
-	bmi		Error
+	;the firmware works out the drive status from the ATR header
 	ldy 	#3
 @	
 	lda		StatusTable,y
 	sta		(bufrlo),y
 	dey
 	bne		@-
-	;get sector size MSB
-	lda		#$10
-	ldx		CART_ATR_HEADER+5
-	seq
-	lda		#$30
+	lda		CART_ATR_STATUS
 	sta		(bufrlo),y
 	;return Y=1
 	iny
 	sec
 	rts
 
-;GetPERCOM:
-;	jsr		GetATRHeader
-;	bmi		Error
-;	ldy		#11
-;@
-;	lda		perctbl,y
-;	sta		(bufrlo),y
-;	dey
-;	bpl		@-
-;	bmi		ReturnOK
+GetPERCOM:
+	ldy		#PERCOM_SIZE-1
+@
+	lda		CART_ATR_PERCOM,y
+	sta		(bufrlo),y
+	dey
+	bpl		@-
+	bmi		ReturnOK
 	
 	
 Error:
 	sec
 	rts	
 
+CassetteRead:
+	;the next record, sync bytes and all, or the real recorder if no CAS
+	;image is mounted. Running off the end of the tape is a timeout
+	ldy		#CART_CMD_CAS_READ_RECORD
+	sty		CART_CMD
+	jsr		PIOWaitReady
+	ldy		#$8A
+	bcs		Error
+	lda		CART_STATUS
+	beq		CassetteCopy
+	cmp		#CART_CAS_NO_TAPE
+	beq		Ignore_Request
+	bne		Error
+CassetteCopy:
+	ldy		dbytlo
+	beq		ReturnOK
+@
+	dey
+	lda		CART_CAS_DATA,y
+	sta		(bufrlo),y
+	tya
+	bne		@-
+	beq		ReturnOK
+
 Write:
 	ldy		#0
 	;write 128 bytes
@@ -107,6 +143,10 @@ Write:
 	iny
 	bpl		@-
 	ldy		#CART_CMD_WRITE_ATR_SECTOR
+	lda		dcomnd
+	cmp		#'O'
+	bne		Transfer
+	ldy		#CART_CMD_ATR_SET_PERCOM
 
 Transfer:
 	mva		daux1	CART_DCB_SECTOR_LO
@@ -128,7 +168,8 @@ Transfer:
 	bpl		@-
 	
 CheckNextPage
-	cpx 	dbythi
+	inx
+	cpx 	bfenlo
 	bcs		ReturnOK
 	lda		bufrlo
 	clc
@@ -136,8 +177,7 @@ CheckNextPage
 	sta		bufrlo
 	scc
 	inc		bufrhi
-	inx
-	bne		TransferLoop
+	jmp		TransferLoop
 	
 ReturnOK:
 	mwa		dbuflo bufrlo
@@ -149,18 +189,6 @@ ReturnOK:
 
 StatusTable
 	.byte	$30,$FF,$E0,$00
-
-;PERCTbl
-;	.byte 40		; Tracks	
-;	.byte 9		 	; Step rate
-;	.byte > 720		; Sectors (M) - get partition size from table
-;	.byte < 720		; Sectors (L)
-;	.byte 0			; Sectors (H)
-;	.byte 4			; Type (4=MFM, 6=1.2M, 8=percom+4 is sectors H)
-;	.byte > 256		; Bytes / Sec (Hi)
-;	.byte < 256		; Bytes / Sec (Lo)
-;	.byte $FF		; serial rate control
-;	.byte 0,0,0		; misc bytes
 .endp
 
 ;==============================================================================
@@ -203,7 +231,12 @@ Timeout
 	ldy		#$8A
 	rts
 BadStatus
-	;return NAK on bad status for now
+	;a full ATR overlay is disk full, anything else NAK for now
+	cpy		#CART_STATUS_DELTA_FULL
+	bne		nak
+	ldy		#CIOStatDiskFull
+	rts
+nak:
 	ldy		#$8B
 	rts
 .endp
@@ -224,3 +257,36 @@ Chain
 OK
 	rts
 .endp
+
+;==============================================================================
+
+.proc PIOCassetteWait
+	;no need to wait for the leader when reading a CAS image
+	cpx		#1
+	bne		Wait
+	ldy		#CART_CMD_CAS_STATUS
+	mva		#0 CART_CAS_REWIND
+	jsr		IssueCartCommand
+	bne		Wait
+	rts
+Wait:
+	jmp		CassetteWait
+.endp
+
+;==============================================================================
+
+.proc PIOCassetteBoot
+	;on a cold start, rewind the CAS image and boot it as if START was held
+	;down if it's a boot tape
+	lda		warmst
+	bne		Done
+	ldy		#CART_CMD_CAS_STATUS
+	mva		#1 CART_CAS_REWIND
+	jsr		IssueCartCommand
+	bne		Done
+	lda		CART_CAS_BOOT
+	beq		Done
+	sty		ckey
+Done:
+	rts
+.endp
@@ -23,14 +23,42 @@ CART_CMD_GET_DIR_ENTRY = $2
 CART_CMD_UP_DIR = $3
 CART_CMD_ROOT_DIR = $4
 CART_CMD_SEARCH = $5
+CART_CMD_BOOT_TIMES = $6
+CART_CMD_META_SCAN = $7
+CART_CMD_SEARCH_KEY = $8
+CART_CMD_CURSOR_HINT = $9
 CART_CMD_LOAD_SOFT_OS = $10
 CART_CMD_SOFT_OS_CHUNK = $11
+CART_CMD_OVERLAY_MODE = $26
+CART_CMD_FP_MODE = $30
+CART_CMD_TRACE = $50
+CART_CMD_STATS = $51
+CART_CMD_SD_TEST = $52
+CART_CMD_PROFILE = $53
 CART_CMD_NO_CART = $FE
 CART_CMD_ACTIVATE_CART = $FF
 
+SEARCH_KEY_START = $0
+SEARCH_KEY_DELETE = $7E
+SEARCH_KEY_REFRESH = $9B
+SEARCH_MAX_CHARS = 12
+
+CART_FP_QUERY = $FF
+CART_OVERLAY_QUERY = $FF
+CART_TRACE_QUERY = $FF
+CART_TRACE_FILL = $1
+CART_TRACE_HOTSPOTS = $4
+CART_STATS_RESET = $3
+CART_STATS_LOG = $4
+CART_STATS_QUERY = $FF
+CART_TEXT_LINE = $0
+CART_SD_TEST_RUN = $1
+CART_PROFILE_QUERY = $FF
+
 DIR_START_ROW = 7
 DIR_END_ROW = 21
 ITEMS_PER_PAGE = DIR_END_ROW-DIR_START_ROW+1
+HINT_FRAMES = 15	; the cursor rests this long on an item before it's read ahead
 
 ;@com.wudsn.ide.asm.outputfileextension=.rom
 
@@ -110,6 +138,11 @@ text_out_y	= $94	// word
 text_out_ptr	= $96	// word
 text_out_len	= $98
 cur_chunk	= $99
+scan_done	= $9A
+scan_tick	= $9B
+lines_cmd	= $9C
+hint_item	= $9D
+hint_time	= $9E
 
 ; XEX loader stuff from Jon Halliday/FJC
 LoaderAddress	equ $700
@@ -220,7 +253,27 @@ read_dir_ok
 	lda $D502
 	sta num_dir_entries
 	mva #0 top_item
-	mva #0 cur_item
+	lda $D503	; the item we were on when we left this directory
+	cmp num_dir_entries
+	bcc cursor_ok
+	lda #0
+cursor_ok
+	sta cur_item
+find_page
+	lda cur_item
+	sec
+	sbc top_item
+	cmp #ITEMS_PER_PAGE
+	bcc page_found
+	lda top_item
+	clc
+	adc #ITEMS_PER_PAGE
+	sta top_item
+	jmp find_page
+page_found
+	mva #0 scan_done
+	mva #$FF hint_item
+	mva 20 hint_time
 	
 ; display_directory
 display_directory
@@ -239,7 +292,10 @@ dir_ok	jsr output_directory
 	
 main_loop
 	jsr GetKey
-	beq main_loop
+	bne key_pressed
+	jsr idle_scan
+	jmp main_loop
+key_pressed
 	cmp #$1C ; cur up
 	beq up_pressed
 	cmp #'-'
@@ -269,9 +325,30 @@ _4	cmp #$1B ; esc
 	bne _5
 	jmp search_pressed
 
-_5	jmp main_loop
+_5	cmp #'f'
+	bne _6
+	jmp fp_pressed
+
+_6	cmp #'o'
+	bne _7
+	jmp overlay_pressed
+
+_7	cmp #'t'
+	bne _8
+	jmp trace_pressed
+
+_8	cmp #'?'
+	bne _9
+	jmp stats_pressed
+
+_9	cmp #'s'
+	bne _10
+	jmp sd_test_pressed
+
+_10	jmp main_loop
 
 down_pressed
+	mva 20 hint_time
 	lda cur_item
 	clc
 	adc #1
@@ -296,9 +373,12 @@ page_down
 	jmp display_directory
 
 up_pressed
+	mva 20 hint_time
 	lda cur_item
 	cmp #0
-	beq main_loop
+	bne up_ok
+	jmp main_loop
+up_ok
 ; single row up
 	dec cur_item
 ; do we need to page up
@@ -359,6 +439,113 @@ disable_pressed
 	jsr wait_for_cart
 	jmp reboot_to_selected_cart
 
+; toggle the soft OS handing FMUL/FDIV to the cart (for ATRs)
+fp_pressed
+	mva #CART_FP_QUERY $D500
+	lda #CART_CMD_FP_MODE
+	jsr wait_for_cart
+	lda $D502
+	eor #1
+	sta $D500
+	lda #CART_CMD_FP_MODE
+	jsr wait_for_cart
+	jsr output_fp_mode
+	jmp main_loop
+
+; toggle ATR writes going to a delta file rather than the image
+overlay_pressed
+	mva #CART_OVERLAY_QUERY $D500
+	lda #CART_CMD_OVERLAY_MODE
+	jsr wait_for_cart
+	lda $D502
+	eor #1
+	sta $D500
+	lda #CART_CMD_OVERLAY_MODE
+	jsr wait_for_cart
+	jsr output_overlay_mode
+	jmp main_loop
+
+; arm a bus trace of the next cart started, then hot spots, then neither
+; (debug firmware only)
+trace_pressed
+	mva #CART_TRACE_QUERY $D500
+	lda #CART_CMD_TRACE
+	jsr wait_for_cart
+	ldx #CART_TRACE_FILL
+	lda $D502
+	beq trace_set
+	ldx #CART_TRACE_HOTSPOTS
+	cmp #CART_TRACE_FILL
+	beq trace_set
+	ldx #0
+trace_set
+	stx $D500
+	lda #CART_CMD_TRACE
+	jsr wait_for_cart
+	jsr output_trace_mode
+	jmp main_loop
+
+; hidden screen of how long the cart takes over each command. R resets the
+; figures, L turns the log on the SD card on and off, P starts the profiler
+; or stops it and writes out what it found, other keys go back
+stats_pressed
+	jsr hide_pmg_cursor
+	jsr output_stats
+stats_key
+	jsr GetKey
+	beq stats_key
+	cmp #'r'
+	bne stats_not_r
+	mva #CART_STATS_RESET $D500
+	lda #CART_CMD_STATS
+	jsr wait_for_cart
+	jmp stats_pressed
+stats_not_r
+	cmp #'p'
+	bne stats_not_p
+	mva #CART_PROFILE_QUERY $D500
+	lda #CART_CMD_PROFILE
+	jsr wait_for_cart
+	lda $D502
+	eor #1
+	sta $D500
+	lda #CART_CMD_PROFILE
+	jsr wait_for_cart
+	jmp stats_pressed
+stats_not_p
+	cmp #'l'
+	bne stats_done
+	mva #CART_STATS_LOG $D500
+	mva #CART_STATS_QUERY $D501
+	lda #CART_CMD_STATS
+	jsr wait_for_cart
+	lda $D502
+	eor #1
+	sta $D501
+	mva #CART_STATS_LOG $D500
+	lda #CART_CMD_STATS
+	jsr wait_for_cart
+	jmp stats_pressed
+stats_done
+	jmp display_directory
+
+; SD card speed test, the results stay up until a key is pressed
+sd_test_pressed
+	jsr hide_pmg_cursor
+	jsr clear_screen
+	mva #9 text_out_x
+	mva #DIR_START_ROW-2 text_out_y
+	mwa #sd_test_text text_out_ptr
+	mva #(.len sd_test_text) text_out_len
+	jsr output_text_inverted
+	mva #CART_SD_TEST_RUN $D500
+	lda #CART_CMD_SD_TEST
+	jsr wait_for_cart
+	lda #CART_CMD_SD_TEST
+	jsr output_cart_lines
+	jsr wait_key
+	jmp display_directory
+
 launch_xex
 	jsr disable_pmg
 	jsr copy_XEX_loader
@@ -373,32 +560,71 @@ launch_atr
 reboot_atr
 	jmp reboot_to_selected_cart
 		
+; incremental search - each key goes to the cart, which sends back the
+; best page of matches so far
 search_pressed
-	jsr output_search_box
-	jsr get_search_string
-	lda search_text_len
-	cmp #0
-	bne search
-	jmp display_directory
-search
-	; copy search_text_len bytes from search_text to $D5xx
-	ldy #0
-@	lda search_string,y
-	sta $D500,y
-	iny
-	tya
-	cmp search_text_len
-	bcc @-
-	; null terminate
-	lda #0
-	sta $D500,y
-		
+	mva #1 search_results_mode
+	mva #0 search_text_len
+	jsr hide_pmg_cursor
+	lda #SEARCH_KEY_START
+search_send_key
+	sta $D500
+	mva #ITEMS_PER_PAGE $D501
+	lda #CART_CMD_SEARCH_KEY
+	jsr wait_for_cart
+	lda $D501
+	beq search_update
+	jsr display_error_msg_from_cart
+	jmp read_current_directory
+search_update
+	mva $D502 num_dir_entries
+	mva #0 top_item
+	mva #0 cur_item
 	jsr clear_screen
-	jsr output_searching_msg
-		
-	lda #CART_CMD_SEARCH
+	jsr output_directory
+	jsr output_search_line
+	lda num_dir_entries
+	bne search_loop
+	lda search_text_len
+	beq search_loop
+	jsr output_empty_dir_msg
+search_loop
+	jsr GetKey
+	beq search_loop
+	cmp #$1B ; esc
+	bne search_not_esc
+	jmp read_current_directory
+search_not_esc
+	cmp #$9B ; ret
+	beq search_done
+	cmp #$7E ; del
+	bne search_char
+	lda search_text_len
+	beq search_loop
+	dec search_text_len
+	lda #SEARCH_KEY_DELETE
+	jmp search_send_key
+search_char
+	cmp #$20 ; only the keys the cart takes ($20-$7C)
+	bcc search_loop
+	cmp #$7D
+	bcs search_loop
+	ldy search_text_len
+	cpy #SEARCH_MAX_CHARS
+	beq search_loop
+	sta search_string,y
+	inc search_text_len
+	jmp search_send_key
+search_done
+	lda search_text_len
+	bne search_all
+	jmp read_current_directory
+search_all
+	; fetch the full list to browse
+	mva #SEARCH_KEY_REFRESH $D500
+	mva #255 $D501
+	lda #CART_CMD_SEARCH_KEY
 	jsr wait_for_cart
-	mva #1 search_results_mode
 	jmp check_read_dir
         .endp ; proc start
 
@@ -482,58 +708,6 @@ enable	pla
 	rts
 	.endp
 	
-.proc   get_search_string
-	mva #0 search_text_len
-	jmp output
-loop
-	jsr GetKey
-	beq loop
-	cmp #$1B ; esc
-	beq cancel
-	cmp #$7E; del
-	beq delete
-	cmp #$9B ; ret
-	beq done
-	ldy search_text_len
-	cpy #14
-	beq loop
-	jmp newchar
-delete	
-	lda search_text_len
-	beq loop
-	; erase character
-	clc
-	adc #16
-	sta text_out_x
-	mwa #cursor_text text_out_ptr
-	mva #1 text_out_len
-	jsr output_text
-	
-	dec search_text_len
-	jmp output
-newchar		
-	ldy search_text_len
-	sta search_string,y
-	inc search_text_len
-output	
-	mva #16 text_out_x
-	mva #9 text_out_y
-	mwa #search_string text_out_ptr
-	mva search_text_len text_out_len
-	jsr output_text
-	; draw cursor
-	lda text_out_x
-	clc
-	adc text_out_len
-	sta text_out_x
-	mwa #cursor_text text_out_ptr
-	mva #1 text_out_len
-	jsr output_text_inverted
-	
-	jmp loop
-cancel	mva #0 search_text_len
-done	rts
-	.endp
 .proc	reset_routine
 	mva #3 BOOT
 	lda #CART_CMD_ROOT_DIR ; tell the mcu we've done a reset
@@ -541,6 +715,47 @@ done	rts
 	rts
 	.endp
 
+; while no key is pressed, have the cart identify more files (once per frame)
+; and redraw the page if it found any. After that, once the cursor has rested
+; on a folder or file, have the cart read it ahead so opening it is quicker
+.proc	idle_scan
+	lda num_dir_entries
+	beq done
+	lda 20
+	cmp scan_tick
+	beq done
+	sta scan_tick
+	lda scan_done
+	bne hint
+	lda top_item
+	sta $D500
+	lda #CART_CMD_META_SCAN
+	jsr wait_for_cart
+	lda $D502
+	sta scan_done
+	lda $D501
+	beq done
+	jsr output_directory
+done	rts
+hint	lda search_results_mode
+	bne done
+	lda cur_item
+	cmp hint_item
+	beq done
+	lda 20
+	sec
+	sbc hint_time
+	cmp #HINT_FRAMES
+	bcc done
+	mva cur_item $D500
+	lda #CART_CMD_CURSOR_HINT
+	jsr wait_for_cart
+	lda $D501
+	beq done
+	mva cur_item hint_item
+	rts
+	.endp
+
 .proc	display_error_msg_from_cart
 	jsr hide_pmg_cursor
 	mva #1 text_out_x
@@ -592,6 +807,11 @@ next_entry
 	cpx #1
 	beq folder
 file	jsr output_text
+	; type tag from the metadata cache
+	mva #36 text_out_x
+	mwa #$D522 text_out_ptr
+	mva #4 text_out_len
+	jsr output_text
 	jmp next
 folder	jsr output_text
 	mva #0 text_out_x
@@ -782,30 +1002,119 @@ out	jsr output_text_inverted
 	rts
 	.endp
 
-.proc	output_searching_msg
-	mva #12 text_out_x
-	mva #9 text_out_y
-	mwa #searching_text text_out_ptr
-	mva #(.len searching_text) text_out_len
-	jsr output_text
+; FP offload state, in place of the header until the next redraw
+.proc	output_fp_mode
+	mva #9 text_out_x
+	mva #DIR_START_ROW-2 text_out_y
+	mwa #fp_off_text text_out_ptr
+	lda $D502
+	beq off
+	mwa #fp_on_text text_out_ptr
+off	mva #(.len fp_on_text) text_out_len
+	jsr output_text_inverted
 	rts
 	.endp
 
-.proc	output_search_box
-	jsr hide_pmg_cursor
-	mva #8 text_out_x
-	mva #8 text_out_y
-	mwa #search_text1 text_out_ptr
-	mva #(.len search_text1) text_out_len
-	jsr output_text_internal
-	inc text_out_y
-	mwa #search_text2 text_out_ptr
-	mva #(.len search_text2) text_out_len
-	jsr output_text_internal
-	inc text_out_y
-	mwa #search_text3 text_out_ptr
-	mva #(.len search_text3) text_out_len
-	jsr output_text_internal
+; ATR overlay state, in place of the header until the next redraw
+.proc	output_overlay_mode
+	mva #9 text_out_x
+	mva #DIR_START_ROW-2 text_out_y
+	mwa #overlay_off_text text_out_ptr
+	lda $D502
+	beq off
+	mwa #overlay_on_text text_out_ptr
+off	mva #(.len overlay_on_text) text_out_len
+	jsr output_text_inverted
+	rts
+	.endp
+
+; bus trace state, in place of the header until the next redraw
+.proc	output_trace_mode
+	mva #9 text_out_x
+	mva #DIR_START_ROW-2 text_out_y
+	mwa #trace_none_text text_out_ptr
+	lda $D501
+	bne out
+	mwa #trace_off_text text_out_ptr
+	lda $D502
+	beq out
+	mwa #trace_on_text text_out_ptr
+	lda $D502
+	cmp #CART_TRACE_FILL
+	beq out
+	mwa #trace_hot_text text_out_ptr
+out	mva #(.len trace_on_text) text_out_len
+	jsr output_text_inverted
+	rts
+	.endp
+
+; the cart's stats screen, a line at a time in place of the directory
+.proc	output_stats
+	jsr clear_screen
+	mva #CART_STATS_LOG $D500
+	mva #CART_STATS_QUERY $D501
+	lda #CART_CMD_STATS
+	jsr wait_for_cart
+	mva #9 text_out_x
+	mva #DIR_START_ROW-2 text_out_y
+	mwa #stats_log_off_text text_out_ptr
+	lda $D502
+	beq log_off
+	mwa #stats_log_on_text text_out_ptr
+log_off	mva #(.len stats_log_on_text) text_out_len
+	jsr output_text_inverted
+	lda #CART_CMD_STATS
+	jsr output_cart_lines
+	rts
+	.endp
+
+; text lines from the cart in place of the directory, until it runs out.
+; A = the command, which gets $D500 = 0 and the line number in $D501
+.proc	output_cart_lines
+	sta lines_cmd
+	mva #DIR_START_ROW ypos
+	mva #0 dir_entry
+next_line
+	lda ypos
+	cmp #DIR_END_ROW+1
+	beq done
+	mva dir_entry $D501
+	mva #CART_TEXT_LINE $D500
+	lda lines_cmd
+	jsr wait_for_cart
+	lda $D501
+	bne done
+	mva ypos text_out_y
+	mva #1 text_out_x
+	mwa #$D502 text_out_ptr
+	mva #38 text_out_len
+	jsr output_text
+	inc ypos
+	inc dir_entry
+	jmp next_line
+done	rts
+	.endp
+
+; the search text being typed, in place of the header
+.proc	output_search_line
+	mva #9 text_out_x
+	mva #DIR_START_ROW-2 text_out_y
+	mwa #find_text text_out_ptr
+	mva #(.len find_text) text_out_len
+	jsr output_text_inverted
+	mva #15 text_out_x
+	lda search_text_len
+	beq cursor
+	mwa #search_string text_out_ptr
+	mva search_text_len text_out_len
+	jsr output_text_inverted
+	lda text_out_x
+	clc
+	adc search_text_len
+	sta text_out_x
+cursor	mwa #cursor_text text_out_ptr
+	mva #1 text_out_len
+	jsr output_text
 	rts
 	.endp
 
@@ -989,7 +1298,7 @@ Loop
 	.byte 90,82,82,82,82,82,82,82,82,82,82,82,88,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,67
 	.endl
 	.local menu_text_bottom
-	.byte 'CurUp/Dn/Retn=Sel B=Back X=Boot Esc=Find'
+	.byte ' B=Back X=Boot Esc=Find F=FP O=Overlay  '
 	.endl
 	.local directory_text
 	.byte '[Directory contents]'
@@ -1008,14 +1317,42 @@ Loop
 	.byte 90,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,"P"+$80,"r"+$80,"e"+$80,"s"+$80,"s"+$80," "+$80,"a"+$80," "+$80,"k"+$80,"e"+$80,"y"+$80,67
 	.endl
 	
-	.local search_text1
-	.byte 81,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,82,69
+	.local fp_on_text
+	.byte '[  Fast FP:   on   ]'
+	.endl
+	.local fp_off_text
+	.byte '[  Fast FP:   off  ]'
+	.endl
+	.local overlay_on_text
+	.byte '[ ATR overlay:  on ]'
+	.endl
+	.local overlay_off_text
+	.byte '[ ATR overlay:  off]'
+	.endl
+	.local trace_on_text
+	.byte '[  Bus trace:  on  ]'
+	.endl
+	.local trace_off_text
+	.byte '[  Bus trace:  off ]'
+	.endl
+	.local trace_hot_text
+	.byte '[  Bus trace:  hot ]'
 	.endl
-	.local search_text2
-	.byte 124,"Search:",0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,124
+	.local stats_log_on_text
+	.byte '[ Stats - log:  on ]'
 	.endl
-	.local search_text3
-	.byte 90,82,82,82,82,82,82,82,82,82,82,82,82,"E"+$80,"S"+$80,"C"+$80," "+$80,"C"+$80,"a"+$80,"n"+$80,"c"+$80,"e"+$80,"l"+$80,67
+	.local stats_log_off_text
+	.byte '[ Stats - log:  off]'
+	.endl
+	.local sd_test_text
+	.byte '[SD card speed test]'
+	.endl
+	.local trace_none_text
+	.byte '[ Bus trace: n/a   ]'
+	.endl
+
+	.local find_text
+	.byte '[Find:             ]'
 	.endl
 	
 	.local folder_text
@@ -1026,10 +1363,6 @@ Loop
 	.byte 'No valid files to display'
 	.endl
 	
-	.local searching_text
-	.byte 'Searching....'
-	.endl
-	
 	.local cursor_text
 	.byte ' '
 	.endl
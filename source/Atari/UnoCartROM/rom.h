@@ -1,141 +1,196 @@
 unsigned char UnoCart_rom[] = {
   0x60, 0xa9, 0x8f, 0x8d, 0xc5, 0x02, 0xa9, 0x82, 0x8d, 0xc6, 0x02, 0xa9,
-  0x03, 0x85, 0x09, 0xa9, 0x7d, 0x85, 0x02, 0xa9, 0xa2, 0x85, 0x03, 0x20,
-  0x53, 0xa4, 0x20, 0x21, 0xa6, 0x20, 0x38, 0xa6, 0x20, 0x90, 0xa3, 0xa9,
+  0x03, 0x85, 0x09, 0xa9, 0xb5, 0x85, 0x02, 0xa9, 0xa3, 0x85, 0x03, 0x20,
+  0xed, 0xa5, 0x20, 0xb5, 0xa8, 0x20, 0xcc, 0xa8, 0x20, 0x2a, 0xa5, 0xa9,
   0x00, 0x85, 0x87, 0xa9, 0x01, 0x20, 0x20, 0x06, 0xad, 0x01, 0xd5, 0xc9,
-  0x01, 0xd0, 0x06, 0x20, 0x87, 0xa2, 0x4c, 0x23, 0xa0, 0xad, 0x02, 0xd5,
-  0x85, 0x80, 0xa9, 0x00, 0x85, 0x84, 0xa9, 0x00, 0x85, 0x85, 0x20, 0xc2,
-  0xa4, 0x20, 0x3b, 0xa3, 0xa5, 0x80, 0xd0, 0x09, 0x20, 0xed, 0xa4, 0x20,
-  0x09, 0xa4, 0x4c, 0x5f, 0xa0, 0x20, 0xde, 0xa2, 0x20, 0x70, 0xa3, 0x20,
-  0x7e, 0xa3, 0xf0, 0xfb, 0xc9, 0x1c, 0xf0, 0x57, 0xc9, 0x2d, 0xf0, 0x53,
-  0xc9, 0x1d, 0xf0, 0x2a, 0xc9, 0x3d, 0xf0, 0x26, 0xc9, 0x62, 0xd0, 0x03,
-  0x4c, 0x13, 0xa1, 0xc9, 0x1e, 0xd0, 0x03, 0x4c, 0x13, 0xa1, 0xc9, 0x9b,
-  0xd0, 0x03, 0x4c, 0xdd, 0xa0, 0xc9, 0x78, 0xd0, 0x03, 0x4c, 0x21, 0xa1,
-  0xc9, 0x1b, 0xd0, 0x03, 0x4c, 0x42, 0xa1, 0x4c, 0x5f, 0xa0, 0xa5, 0x85,
-  0x18, 0x69, 0x01, 0xc5, 0x80, 0xb0, 0xbc, 0xe6, 0x85, 0xa5, 0x85, 0x38,
-  0xe5, 0x84, 0x18, 0xc9, 0x0f, 0xf0, 0x06, 0x20, 0x70, 0xa3, 0x4c, 0x5f,
-  0xa0, 0xa5, 0x84, 0x18, 0x69, 0x0f, 0x85, 0x84, 0x4c, 0x46, 0xa0, 0xa5,
-  0x85, 0xc9, 0x00, 0xf0, 0x9a, 0xc6, 0x85, 0xa5, 0x85, 0xc5, 0x84, 0x30,
-  0x06, 0x20, 0x70, 0xa3, 0x4c, 0x5f, 0xa0, 0xa5, 0x84, 0x38, 0xe9, 0x0f,
-  0x85, 0x84, 0x4c, 0x46, 0xa0, 0xa5, 0x80, 0xd0, 0x03, 0x4c, 0x5f, 0xa0,
-  0xa5, 0x85, 0x8d, 0x00, 0xd5, 0xa9, 0x00, 0x20, 0x20, 0x06, 0xad, 0x01,
-  0xd5, 0xc9, 0x00, 0xf0, 0x12, 0xc9, 0x01, 0xf0, 0x11, 0xc9, 0x02, 0xf0,
-  0x10, 0xc9, 0x03, 0xf0, 0x0f, 0x20, 0x87, 0xa2, 0x4c, 0x23, 0xa0, 0x4c,
-  0x23, 0xa0, 0x4c, 0x30, 0x06, 0x4c, 0x29, 0xa1, 0x4c, 0x32, 0xa1, 0xa5,
-  0x87, 0xc9, 0x01, 0xf0, 0x05, 0xa9, 0x03, 0x20, 0x20, 0x06, 0x4c, 0x23,
-  0xa0, 0xa9, 0xfe, 0x20, 0x20, 0x06, 0x4c, 0x30, 0x06, 0x20, 0xdc, 0xa3,
-  0x20, 0x4d, 0xa6, 0x4c, 0x03, 0x07, 0x20, 0xdc, 0xa3, 0x20, 0x76, 0xa1,
-  0xc9, 0x00, 0xf0, 0x03, 0x4c, 0x23, 0xa0, 0x4c, 0x30, 0x06, 0x20, 0x1d,
-  0xa5, 0x20, 0x03, 0xa2, 0xa5, 0x86, 0xc9, 0x00, 0xd0, 0x03, 0x4c, 0x46,
-  0xa0, 0xa0, 0x00, 0xb9, 0x00, 0x06, 0x99, 0x00, 0xd5, 0xc8, 0x98, 0xc5,
-  0x86, 0x90, 0xf4, 0xa9, 0x00, 0x99, 0x00, 0xd5, 0x20, 0x3b, 0xa3, 0x20,
-  0x05, 0xa5, 0xa9, 0x05, 0x20, 0x20, 0x06, 0xa9, 0x01, 0x85, 0x87, 0x4c,
-  0x2c, 0xa0, 0xa9, 0x10, 0x20, 0x20, 0x06, 0xad, 0x01, 0xd5, 0xc9, 0x01,
-  0xd0, 0x06, 0x20, 0x87, 0xa2, 0xa9, 0x01, 0x60, 0x08, 0x78, 0xad, 0x0e,
-  0xd4, 0x48, 0xa9, 0x00, 0x8d, 0x0e, 0xd4, 0xa9, 0xb2, 0x8d, 0x17, 0xd0,
-  0xa9, 0xb2, 0x8d, 0x18, 0xd0, 0xad, 0x01, 0xd3, 0x29, 0xfe, 0x8d, 0x01,
-  0xd3, 0xa9, 0x00, 0x85, 0x90, 0xa9, 0xc0, 0x85, 0x91, 0xa9, 0x00, 0x85,
-  0x99, 0xa5, 0x91, 0xc9, 0xd0, 0xd0, 0x08, 0xa9, 0xd8, 0x85, 0x91, 0xa9,
-  0x30, 0x85, 0x99, 0xa9, 0x00, 0x85, 0x90, 0xa5, 0x99, 0x8d, 0x00, 0xd5,
-  0xa9, 0x11, 0x20, 0x20, 0x06, 0xa0, 0x00, 0xb9, 0x01, 0xd5, 0x91, 0x90,
-  0xc8, 0xc0, 0x80, 0xd0, 0xf6, 0xe6, 0x99, 0xa9, 0x80, 0x85, 0x90, 0xa5,
-  0x99, 0x8d, 0x00, 0xd5, 0xa9, 0x11, 0x20, 0x20, 0x06, 0xa0, 0x00, 0xb9,
-  0x01, 0xd5, 0x91, 0x90, 0xc8, 0xc0, 0x80, 0xd0, 0xf6, 0xe6, 0x99, 0xe6,
-  0x91, 0xd0, 0xb6, 0x68, 0x8d, 0x0e, 0xd4, 0x28, 0xa9, 0x00, 0x60, 0xa9,
-  0x00, 0x85, 0x86, 0x4c, 0x48, 0xa2, 0x20, 0x7e, 0xa3, 0xf0, 0xfb, 0xc9,
-  0x1b, 0xf0, 0x65, 0xc9, 0x7e, 0xf0, 0x0d, 0xc9, 0x9b, 0xf0, 0x61, 0xa4,
-  0x86, 0xc0, 0x0e, 0xf0, 0xe9, 0x4c, 0x41, 0xa2, 0xa5, 0x86, 0xf0, 0xe2,
-  0x18, 0x69, 0x10, 0x85, 0x92, 0xa9, 0x8a, 0x85, 0x96, 0xa9, 0xa8, 0x85,
-  0x97, 0xa9, 0x01, 0x85, 0x98, 0x20, 0xa0, 0xa5, 0xc6, 0x86, 0x4c, 0x48,
-  0xa2, 0xa4, 0x86, 0x99, 0x00, 0x06, 0xe6, 0x86, 0xa9, 0x10, 0x85, 0x92,
-  0xa9, 0x09, 0x85, 0x94, 0xa9, 0x00, 0x85, 0x96, 0xa9, 0x06, 0x85, 0x97,
-  0xa5, 0x86, 0x85, 0x98, 0x20, 0xa0, 0xa5, 0xa5, 0x92, 0x18, 0x65, 0x98,
-  0x85, 0x92, 0xa9, 0x8a, 0x85, 0x96, 0xa9, 0xa8, 0x85, 0x97, 0xa9, 0x01,
-  0x85, 0x98, 0x20, 0xe2, 0xa5, 0x4c, 0x0a, 0xa2, 0xa9, 0x00, 0x85, 0x86,
-  0x60, 0xa9, 0x03, 0x85, 0x09, 0xa9, 0x04, 0x20, 0x20, 0x06, 0x60, 0x20,
-  0x09, 0xa4, 0xa9, 0x01, 0x85, 0x92, 0xa9, 0x08, 0x85, 0x94, 0xa9, 0xa6,
-  0x85, 0x96, 0xa9, 0xa7, 0x85, 0x97, 0xa9, 0x26, 0x85, 0x98, 0x20, 0x6c,
-  0xa5, 0xe6, 0x94, 0xa9, 0xcc, 0x85, 0x96, 0xa9, 0xa7, 0x85, 0x97, 0xa9,
-  0x26, 0x85, 0x98, 0x20, 0x6c, 0xa5, 0xe6, 0x94, 0xa9, 0xf2, 0x85, 0x96,
-  0xa9, 0xa7, 0x85, 0x97, 0xa9, 0x26, 0x85, 0x98, 0x20, 0x6c, 0xa5, 0xa9,
-  0x08, 0x85, 0x92, 0xa9, 0x09, 0x85, 0x94, 0xa9, 0x02, 0x85, 0x96, 0xa9,
-  0xd5, 0x85, 0x97, 0xa9, 0x1e, 0x85, 0x98, 0x20, 0xa0, 0xa5, 0x20, 0x5a,
-  0xa5, 0x60, 0xa5, 0x84, 0x85, 0x81, 0xa9, 0x07, 0x85, 0x82, 0xa4, 0x82,
-  0x88, 0x98, 0xc9, 0x15, 0xf0, 0x4c, 0xa5, 0x81, 0xc5, 0x80, 0xf0, 0x46,
-  0x8d, 0x00, 0xd5, 0xa9, 0x02, 0x20, 0x20, 0x06, 0xa5, 0x82, 0x85, 0x94,
-  0xa9, 0x04, 0x85, 0x92, 0xae, 0x01, 0xd5, 0xa9, 0x02, 0x85, 0x96, 0xa9,
-  0xd5, 0x85, 0x97, 0xa9, 0x1f, 0x85, 0x98, 0xe0, 0x01, 0xf0, 0x06, 0x20,
-  0xa0, 0xa5, 0x4c, 0x33, 0xa3, 0x20, 0xa0, 0xa5, 0xa9, 0x00, 0x85, 0x92,
-  0xa9, 0x03, 0x85, 0x98, 0xa9, 0x60, 0x85, 0x96, 0xa9, 0xa8, 0x85, 0x97,
-  0x20, 0xe2, 0xa5, 0xe6, 0x82, 0xe6, 0x81, 0x4c, 0xe6, 0xa2, 0x60, 0xa5,
-  0x58, 0x85, 0x90, 0xa5, 0x59, 0x85, 0x91, 0xa0, 0x07, 0x88, 0x30, 0x0e,
-  0x18, 0xa5, 0x90, 0x69, 0x28, 0x85, 0x90, 0x90, 0x02, 0xe6, 0x91, 0x4c,
-  0x45, 0xa3, 0xa2, 0x0f, 0xa9, 0x00, 0xa0, 0x27, 0x91, 0x90, 0x88, 0x10,
-  0xfb, 0x18, 0xa5, 0x90, 0x69, 0x28, 0x85, 0x90, 0x90, 0x02, 0xe6, 0x91,
-  0xca, 0xd0, 0xe9, 0x60, 0xa5, 0x85, 0x38, 0xe5, 0x84, 0x18, 0x69, 0x07,
-  0x85, 0x83, 0x20, 0x15, 0xa4, 0x60, 0xae, 0xfc, 0x02, 0xe0, 0xff, 0xf0,
-  0x0a, 0xa9, 0xff, 0x8d, 0xfc, 0x02, 0xbd, 0x91, 0xa8, 0xc9, 0xff, 0x60,
-  0xa9, 0x08, 0x8d, 0x07, 0xd4, 0xa9, 0x2e, 0x8d, 0x2f, 0x02, 0xa9, 0x03,
-  0x8d, 0x08, 0xd0, 0xa9, 0x18, 0x8d, 0xc0, 0x02, 0xa9, 0x40, 0x8d, 0x00,
-  0xd0, 0xa9, 0x03, 0x8d, 0x09, 0xd0, 0xa9, 0x18, 0x8d, 0xc1, 0x02, 0xa9,
-  0x60, 0x8d, 0x01, 0xd0, 0xa9, 0x03, 0x8d, 0x0a, 0xd0, 0xa9, 0x18, 0x8d,
-  0xc2, 0x02, 0xa9, 0x80, 0x8d, 0x02, 0xd0, 0xa9, 0x03, 0x8d, 0x0b, 0xd0,
-  0xa9, 0x18, 0x8d, 0xc3, 0x02, 0xa9, 0xa0, 0x8d, 0x03, 0xd0, 0xa9, 0x01,
-  0x8d, 0x6f, 0x02, 0x60, 0xa9, 0x22, 0x8d, 0x2f, 0x02, 0xa9, 0x00, 0x8d,
-  0x1d, 0xd0, 0xa0, 0x0c, 0x99, 0x00, 0xd0, 0x88, 0x10, 0xfa, 0xa9, 0x00,
-  0x8d, 0xc0, 0x02, 0xa9, 0x00, 0x8d, 0xc1, 0x02, 0xa9, 0x00, 0x8d, 0xc2,
-  0x02, 0xa9, 0x00, 0x8d, 0xc3, 0x02, 0xa5, 0x14, 0xc5, 0x14, 0xf0, 0xfc,
-  0x60, 0xa5, 0x14, 0xc5, 0x14, 0xf0, 0xfc, 0xa9, 0x00, 0x8d, 0x1d, 0xd0,
-  0x60, 0xa5, 0x14, 0xc5, 0x14, 0xf0, 0xfc, 0xa9, 0x03, 0x8d, 0x1d, 0xd0,
-  0xa9, 0x00, 0xa0, 0x7f, 0x99, 0x00, 0x0a, 0x99, 0x80, 0x0a, 0x99, 0x00,
-  0x0b, 0x99, 0x80, 0x0b, 0x88, 0x10, 0xf1, 0xa9, 0x0c, 0xa4, 0x83, 0x18,
-  0x69, 0x04, 0x88, 0x10, 0xfb, 0xa8, 0xa9, 0xff, 0xa2, 0x03, 0x99, 0x00,
-  0x0a, 0x99, 0x80, 0x0a, 0x99, 0x00, 0x0b, 0x99, 0x80, 0x0b, 0xc8, 0xca,
-  0x10, 0xf0, 0x60, 0xa9, 0x00, 0x85, 0x92, 0xa9, 0x00, 0x85, 0x94, 0xa9,
-  0x8e, 0x85, 0x96, 0xa9, 0xa6, 0x85, 0x97, 0xa9, 0x28, 0x85, 0x98, 0x20,
-  0x6c, 0xa5, 0xe6, 0x94, 0xa9, 0xb6, 0x85, 0x96, 0xa9, 0xa6, 0x85, 0x97,
-  0xa9, 0x28, 0x85, 0x98, 0x20, 0x6c, 0xa5, 0xe6, 0x94, 0xa9, 0xde, 0x85,
-  0x96, 0xa9, 0xa6, 0x85, 0x97, 0xa9, 0x28, 0x85, 0x98, 0x20, 0x6c, 0xa5,
-  0xe6, 0x94, 0xa9, 0x06, 0x85, 0x96, 0xa9, 0xa7, 0x85, 0x97, 0xa9, 0x28,
-  0x85, 0x98, 0x20, 0x6c, 0xa5, 0xe6, 0x94, 0xa9, 0x2e, 0x85, 0x96, 0xa9,
-  0xa7, 0x85, 0x97, 0xa9, 0x28, 0x85, 0x98, 0x20, 0x6c, 0xa5, 0xa9, 0x17,
-  0x85, 0x94, 0xa9, 0x56, 0x85, 0x96, 0xa9, 0xa7, 0x85, 0x97, 0xa9, 0x28,
-  0x85, 0x98, 0x20, 0xe2, 0xa5, 0x60, 0xa9, 0x09, 0x85, 0x92, 0xa9, 0x05,
-  0x85, 0x94, 0xa5, 0x87, 0xd0, 0x0f, 0xa9, 0x7e, 0x85, 0x96, 0xa9, 0xa7,
-  0x85, 0x97, 0xa9, 0x14, 0x85, 0x98, 0x4c, 0xe9, 0xa4, 0xa9, 0x92, 0x85,
-  0x96, 0xa9, 0xa7, 0x85, 0x97, 0xa9, 0x14, 0x85, 0x98, 0x20, 0xe2, 0xa5,
-  0x60, 0xa9, 0x06, 0x85, 0x92, 0xa9, 0x08, 0x85, 0x94, 0xa9, 0x64, 0x85,
-  0x96, 0xa9, 0xa8, 0x85, 0x97, 0xa9, 0x19, 0x85, 0x98, 0x20, 0xa0, 0xa5,
-  0x60, 0xa9, 0x0c, 0x85, 0x92, 0xa9, 0x09, 0x85, 0x94, 0xa9, 0x7d, 0x85,
-  0x96, 0xa9, 0xa8, 0x85, 0x97, 0xa9, 0x0d, 0x85, 0x98, 0x20, 0xa0, 0xa5,
-  0x60, 0x20, 0x09, 0xa4, 0xa9, 0x08, 0x85, 0x92, 0xa9, 0x08, 0x85, 0x94,
-  0xa9, 0x18, 0x85, 0x96, 0xa9, 0xa8, 0x85, 0x97, 0xa9, 0x18, 0x85, 0x98,
-  0x20, 0x6c, 0xa5, 0xe6, 0x94, 0xa9, 0x30, 0x85, 0x96, 0xa9, 0xa8, 0x85,
-  0x97, 0xa9, 0x18, 0x85, 0x98, 0x20, 0x6c, 0xa5, 0xe6, 0x94, 0xa9, 0x48,
-  0x85, 0x96, 0xa9, 0xa8, 0x85, 0x97, 0xa9, 0x18, 0x85, 0x98, 0x20, 0x6c,
-  0xa5, 0x60, 0xa9, 0xff, 0x8d, 0xfc, 0x02, 0xae, 0xfc, 0x02, 0xe0, 0xff,
+  0x01, 0xd0, 0x06, 0x20, 0x0e, 0xa4, 0x4c, 0x23, 0xa0, 0xad, 0x02, 0xd5,
+  0x85, 0x80, 0xa9, 0x00, 0x85, 0x84, 0xad, 0x03, 0xd5, 0xc5, 0x80, 0x90,
+  0x02, 0xa9, 0x00, 0x85, 0x85, 0xa5, 0x85, 0x38, 0xe5, 0x84, 0xc9, 0x0f,
+  0x90, 0x0a, 0xa5, 0x84, 0x18, 0x69, 0x0f, 0x85, 0x84, 0x4c, 0x4d, 0xa0,
+  0xa9, 0x00, 0x85, 0x9a, 0xa9, 0xff, 0x85, 0x9d, 0xa5, 0x14, 0x85, 0x9e,
+  0x20, 0x5c, 0xa6, 0x20, 0xd5, 0xa4, 0xa5, 0x80, 0xd0, 0x09, 0x20, 0x87,
+  0xa6, 0x20, 0xa3, 0xa5, 0x4c, 0x85, 0xa0, 0x20, 0x65, 0xa4, 0x20, 0x0a,
+  0xa5, 0x20, 0x18, 0xa5, 0xd0, 0x06, 0x20, 0xbf, 0xa3, 0x4c, 0x85, 0xa0,
+  0xc9, 0x1c, 0xf0, 0x7e, 0xc9, 0x2d, 0xf0, 0x7a, 0xc9, 0x1d, 0xf0, 0x4d,
+  0xc9, 0x3d, 0xf0, 0x49, 0xc9, 0x62, 0xd0, 0x03, 0x4c, 0x6d, 0xa1, 0xc9,
+  0x1e, 0xd0, 0x03, 0x4c, 0x6d, 0xa1, 0xc9, 0x9b, 0xd0, 0x03, 0x4c, 0x37,
+  0xa1, 0xc9, 0x78, 0xd0, 0x03, 0x4c, 0x7b, 0xa1, 0xc9, 0x1b, 0xd0, 0x03,
+  0x4c, 0x94, 0xa2, 0xc9, 0x66, 0xd0, 0x03, 0x4c, 0x83, 0xa1, 0xc9, 0x6f,
+  0xd0, 0x03, 0x4c, 0xa0, 0xa1, 0xc9, 0x74, 0xd0, 0x03, 0x4c, 0xbd, 0xa1,
+  0xc9, 0x3f, 0xd0, 0x03, 0x4c, 0xe4, 0xa1, 0xc9, 0x73, 0xd0, 0x03, 0x4c,
+  0x49, 0xa2, 0x4c, 0x85, 0xa0, 0xa5, 0x14, 0x85, 0x9e, 0xa5, 0x85, 0x18,
+  0x69, 0x01, 0xc5, 0x80, 0xb0, 0x8f, 0xe6, 0x85, 0xa5, 0x85, 0x38, 0xe5,
+  0x84, 0x18, 0xc9, 0x0f, 0xf0, 0x06, 0x20, 0x0a, 0xa5, 0x4c, 0x85, 0xa0,
+  0xa5, 0x84, 0x18, 0x69, 0x0f, 0x85, 0x84, 0x4c, 0x6c, 0xa0, 0xa5, 0x14,
+  0x85, 0x9e, 0xa5, 0x85, 0xc9, 0x00, 0xd0, 0x03, 0x4c, 0x85, 0xa0, 0xc6,
+  0x85, 0xa5, 0x85, 0xc5, 0x84, 0x30, 0x06, 0x20, 0x0a, 0xa5, 0x4c, 0x85,
+  0xa0, 0xa5, 0x84, 0x38, 0xe9, 0x0f, 0x85, 0x84, 0x4c, 0x6c, 0xa0, 0xa5,
+  0x80, 0xd0, 0x03, 0x4c, 0x85, 0xa0, 0xa5, 0x85, 0x8d, 0x00, 0xd5, 0xa9,
+  0x00, 0x20, 0x20, 0x06, 0xad, 0x01, 0xd5, 0xc9, 0x00, 0xf0, 0x12, 0xc9,
+  0x01, 0xf0, 0x11, 0xc9, 0x02, 0xf0, 0x10, 0xc9, 0x03, 0xf0, 0x0f, 0x20,
+  0x0e, 0xa4, 0x4c, 0x23, 0xa0, 0x4c, 0x23, 0xa0, 0x4c, 0x30, 0x06, 0x4c,
+  0x7b, 0xa2, 0x4c, 0x84, 0xa2, 0xa5, 0x87, 0xc9, 0x01, 0xf0, 0x05, 0xa9,
+  0x03, 0x20, 0x20, 0x06, 0x4c, 0x23, 0xa0, 0xa9, 0xfe, 0x20, 0x20, 0x06,
+  0x4c, 0x30, 0x06, 0xa9, 0xff, 0x8d, 0x00, 0xd5, 0xa9, 0x30, 0x20, 0x20,
+  0x06, 0xad, 0x02, 0xd5, 0x49, 0x01, 0x8d, 0x00, 0xd5, 0xa9, 0x30, 0x20,
+  0x20, 0x06, 0x20, 0x9f, 0xa6, 0x4c, 0x85, 0xa0, 0xa9, 0xff, 0x8d, 0x00,
+  0xd5, 0xa9, 0x26, 0x20, 0x20, 0x06, 0xad, 0x02, 0xd5, 0x49, 0x01, 0x8d,
+  0x00, 0xd5, 0xa9, 0x26, 0x20, 0x20, 0x06, 0x20, 0xc4, 0xa6, 0x4c, 0x85,
+  0xa0, 0xa9, 0xff, 0x8d, 0x00, 0xd5, 0xa9, 0x50, 0x20, 0x20, 0x06, 0xa2,
+  0x01, 0xad, 0x02, 0xd5, 0xf0, 0x08, 0xa2, 0x04, 0xc9, 0x01, 0xf0, 0x02,
+  0xa2, 0x00, 0x8e, 0x00, 0xd5, 0xa9, 0x50, 0x20, 0x20, 0x06, 0x20, 0xe9,
+  0xa6, 0x4c, 0x85, 0xa0, 0x20, 0xa3, 0xa5, 0x20, 0x2a, 0xa7, 0x20, 0x18,
+  0xa5, 0xf0, 0xfb, 0xc9, 0x72, 0xd0, 0x0d, 0xa9, 0x03, 0x8d, 0x00, 0xd5,
+  0xa9, 0x51, 0x20, 0x20, 0x06, 0x4c, 0xe4, 0xa1, 0xc9, 0x70, 0xd0, 0x1a,
+  0xa9, 0xff, 0x8d, 0x00, 0xd5, 0xa9, 0x53, 0x20, 0x20, 0x06, 0xad, 0x02,
+  0xd5, 0x49, 0x01, 0x8d, 0x00, 0xd5, 0xa9, 0x53, 0x20, 0x20, 0x06, 0x4c,
+  0xe4, 0xa1, 0xc9, 0x6c, 0xd0, 0x24, 0xa9, 0x04, 0x8d, 0x00, 0xd5, 0xa9,
+  0xff, 0x8d, 0x01, 0xd5, 0xa9, 0x51, 0x20, 0x20, 0x06, 0xad, 0x02, 0xd5,
+  0x49, 0x01, 0x8d, 0x01, 0xd5, 0xa9, 0x04, 0x8d, 0x00, 0xd5, 0xa9, 0x51,
+  0x20, 0x20, 0x06, 0x4c, 0xe4, 0xa1, 0x4c, 0x6c, 0xa0, 0x20, 0xa3, 0xa5,
+  0x20, 0xd5, 0xa4, 0xa9, 0x09, 0x85, 0x92, 0xa9, 0x05, 0x85, 0x94, 0xa9,
+  0x60, 0x85, 0x96, 0xa9, 0xab, 0x85, 0x97, 0xa9, 0x14, 0x85, 0x98, 0x20,
+  0x76, 0xa8, 0xa9, 0x01, 0x8d, 0x00, 0xd5, 0xa9, 0x52, 0x20, 0x20, 0x06,
+  0xa9, 0x52, 0x20, 0x66, 0xa7, 0x20, 0xee, 0xa7, 0x4c, 0x6c, 0xa0, 0x20,
+  0x76, 0xa5, 0x20, 0xe1, 0xa8, 0x4c, 0x03, 0x07, 0x20, 0x76, 0xa5, 0x20,
+  0x28, 0xa3, 0xc9, 0x00, 0xf0, 0x03, 0x4c, 0x23, 0xa0, 0x4c, 0x30, 0x06,
+  0xa9, 0x01, 0x85, 0x87, 0xa9, 0x00, 0x85, 0x86, 0x20, 0xa3, 0xa5, 0xa9,
+  0x00, 0x8d, 0x00, 0xd5, 0xa9, 0x0f, 0x8d, 0x01, 0xd5, 0xa9, 0x08, 0x20,
+  0x20, 0x06, 0xad, 0x01, 0xd5, 0xf0, 0x06, 0x20, 0x0e, 0xa4, 0x4c, 0x23,
+  0xa0, 0xad, 0x02, 0xd5, 0x85, 0x80, 0xa9, 0x00, 0x85, 0x84, 0xa9, 0x00,
+  0x85, 0x85, 0x20, 0xd5, 0xa4, 0x20, 0x65, 0xa4, 0x20, 0xa9, 0xa7, 0xa5,
+  0x80, 0xd0, 0x07, 0xa5, 0x86, 0xf0, 0x03, 0x20, 0x87, 0xa6, 0x20, 0x18,
+  0xa5, 0xf0, 0xfb, 0xc9, 0x1b, 0xd0, 0x03, 0x4c, 0x23, 0xa0, 0xc9, 0x9b,
+  0xf0, 0x25, 0xc9, 0x7e, 0xd0, 0x0b, 0xa5, 0x86, 0xf0, 0xe8, 0xc6, 0x86,
+  0xa9, 0x7e, 0x4c, 0xa1, 0xa2, 0xc9, 0x20, 0x90, 0xdd, 0xc9, 0x7d, 0xb0,
+  0xd9, 0xa4, 0x86, 0xc0, 0x0c, 0xf0, 0xd3, 0x99, 0x00, 0x06, 0xe6, 0x86,
+  0x4c, 0xa1, 0xa2, 0xa5, 0x86, 0xd0, 0x03, 0x4c, 0x23, 0xa0, 0xa9, 0x9b,
+  0x8d, 0x00, 0xd5, 0xa9, 0xff, 0x8d, 0x01, 0xd5, 0xa9, 0x08, 0x20, 0x20,
+  0x06, 0x4c, 0x2c, 0xa0, 0xa9, 0x10, 0x20, 0x20, 0x06, 0xad, 0x01, 0xd5,
+  0xc9, 0x01, 0xd0, 0x06, 0x20, 0x0e, 0xa4, 0xa9, 0x01, 0x60, 0x08, 0x78,
+  0xad, 0x0e, 0xd4, 0x48, 0xa9, 0x00, 0x8d, 0x0e, 0xd4, 0xa9, 0xb2, 0x8d,
+  0x17, 0xd0, 0xa9, 0xb2, 0x8d, 0x18, 0xd0, 0xad, 0x01, 0xd3, 0x29, 0xfe,
+  0x8d, 0x01, 0xd3, 0xa9, 0x00, 0x85, 0x90, 0xa9, 0xc0, 0x85, 0x91, 0xa9,
+  0x00, 0x85, 0x99, 0xa5, 0x91, 0xc9, 0xd0, 0xd0, 0x08, 0xa9, 0xd8, 0x85,
+  0x91, 0xa9, 0x30, 0x85, 0x99, 0xa9, 0x00, 0x85, 0x90, 0xa5, 0x99, 0x8d,
+  0x00, 0xd5, 0xa9, 0x11, 0x20, 0x20, 0x06, 0xa0, 0x00, 0xb9, 0x01, 0xd5,
+  0x91, 0x90, 0xc8, 0xc0, 0x80, 0xd0, 0xf6, 0xe6, 0x99, 0xa9, 0x80, 0x85,
+  0x90, 0xa5, 0x99, 0x8d, 0x00, 0xd5, 0xa9, 0x11, 0x20, 0x20, 0x06, 0xa0,
+  0x00, 0xb9, 0x01, 0xd5, 0x91, 0x90, 0xc8, 0xc0, 0x80, 0xd0, 0xf6, 0xe6,
+  0x99, 0xe6, 0x91, 0xd0, 0xb6, 0x68, 0x8d, 0x0e, 0xd4, 0x28, 0xa9, 0x00,
+  0x60, 0xa9, 0x03, 0x85, 0x09, 0xa9, 0x04, 0x20, 0x20, 0x06, 0x60, 0xa5,
+  0x80, 0xf0, 0x23, 0xa5, 0x14, 0xc5, 0x9b, 0xf0, 0x1d, 0x85, 0x9b, 0xa5,
+  0x9a, 0xd0, 0x18, 0xa5, 0x84, 0x8d, 0x00, 0xd5, 0xa9, 0x07, 0x20, 0x20,
+  0x06, 0xad, 0x02, 0xd5, 0x85, 0x9a, 0xad, 0x01, 0xd5, 0xf0, 0x03, 0x20,
+  0x65, 0xa4, 0x60, 0xa5, 0x87, 0xd0, 0xfb, 0xa5, 0x85, 0xc5, 0x9d, 0xf0,
+  0xf5, 0xa5, 0x14, 0x38, 0xe5, 0x9e, 0xc9, 0x0f, 0x90, 0xec, 0xa5, 0x85,
+  0x8d, 0x00, 0xd5, 0xa9, 0x09, 0x20, 0x20, 0x06, 0xad, 0x01, 0xd5, 0xf0,
+  0xdd, 0xa5, 0x85, 0x85, 0x9d, 0x60, 0x20, 0xa3, 0xa5, 0xa9, 0x01, 0x85,
+  0x92, 0xa9, 0x08, 0x85, 0x94, 0xa9, 0x3a, 0x85, 0x96, 0xa9, 0xaa, 0x85,
+  0x97, 0xa9, 0x26, 0x85, 0x98, 0x20, 0x00, 0xa8, 0xe6, 0x94, 0xa9, 0x60,
+  0x85, 0x96, 0xa9, 0xaa, 0x85, 0x97, 0xa9, 0x26, 0x85, 0x98, 0x20, 0x00,
+  0xa8, 0xe6, 0x94, 0xa9, 0x86, 0x85, 0x96, 0xa9, 0xaa, 0x85, 0x97, 0xa9,
+  0x26, 0x85, 0x98, 0x20, 0x00, 0xa8, 0xa9, 0x08, 0x85, 0x92, 0xa9, 0x09,
+  0x85, 0x94, 0xa9, 0x02, 0x85, 0x96, 0xa9, 0xd5, 0x85, 0x97, 0xa9, 0x1e,
+  0x85, 0x98, 0x20, 0x34, 0xa8, 0x20, 0xee, 0xa7, 0x60, 0xa5, 0x84, 0x85,
+  0x81, 0xa9, 0x07, 0x85, 0x82, 0xa4, 0x82, 0x88, 0x98, 0xc9, 0x15, 0xf0,
+  0x5f, 0xa5, 0x81, 0xc5, 0x80, 0xf0, 0x59, 0x8d, 0x00, 0xd5, 0xa9, 0x02,
+  0x20, 0x20, 0x06, 0xa5, 0x82, 0x85, 0x94, 0xa9, 0x04, 0x85, 0x92, 0xae,
+  0x01, 0xd5, 0xa9, 0x02, 0x85, 0x96, 0xa9, 0xd5, 0x85, 0x97, 0xa9, 0x1f,
+  0x85, 0x98, 0xe0, 0x01, 0xf0, 0x19, 0x20, 0x34, 0xa8, 0xa9, 0x24, 0x85,
+  0x92, 0xa9, 0x22, 0x85, 0x96, 0xa9, 0xd5, 0x85, 0x97, 0xa9, 0x04, 0x85,
+  0x98, 0x20, 0x34, 0xa8, 0x4c, 0xcd, 0xa4, 0x20, 0x34, 0xa8, 0xa9, 0x00,
+  0x85, 0x92, 0xa9, 0x03, 0x85, 0x98, 0xa9, 0x9c, 0x85, 0x96, 0xa9, 0xab,
+  0x85, 0x97, 0x20, 0x76, 0xa8, 0xe6, 0x82, 0xe6, 0x81, 0x4c, 0x6d, 0xa4,
+  0x60, 0xa5, 0x58, 0x85, 0x90, 0xa5, 0x59, 0x85, 0x91, 0xa0, 0x07, 0x88,
+  0x30, 0x0e, 0x18, 0xa5, 0x90, 0x69, 0x28, 0x85, 0x90, 0x90, 0x02, 0xe6,
+  0x91, 0x4c, 0xdf, 0xa4, 0xa2, 0x0f, 0xa9, 0x00, 0xa0, 0x27, 0x91, 0x90,
+  0x88, 0x10, 0xfb, 0x18, 0xa5, 0x90, 0x69, 0x28, 0x85, 0x90, 0x90, 0x02,
+  0xe6, 0x91, 0xca, 0xd0, 0xe9, 0x60, 0xa5, 0x85, 0x38, 0xe5, 0x84, 0x18,
+  0x69, 0x07, 0x85, 0x83, 0x20, 0xaf, 0xa5, 0x60, 0xae, 0xfc, 0x02, 0xe0,
+  0xff, 0xf0, 0x0a, 0xa9, 0xff, 0x8d, 0xfc, 0x02, 0xbd, 0xc0, 0xab, 0xc9,
+  0xff, 0x60, 0xa9, 0x08, 0x8d, 0x07, 0xd4, 0xa9, 0x2e, 0x8d, 0x2f, 0x02,
+  0xa9, 0x03, 0x8d, 0x08, 0xd0, 0xa9, 0x18, 0x8d, 0xc0, 0x02, 0xa9, 0x40,
+  0x8d, 0x00, 0xd0, 0xa9, 0x03, 0x8d, 0x09, 0xd0, 0xa9, 0x18, 0x8d, 0xc1,
+  0x02, 0xa9, 0x60, 0x8d, 0x01, 0xd0, 0xa9, 0x03, 0x8d, 0x0a, 0xd0, 0xa9,
+  0x18, 0x8d, 0xc2, 0x02, 0xa9, 0x80, 0x8d, 0x02, 0xd0, 0xa9, 0x03, 0x8d,
+  0x0b, 0xd0, 0xa9, 0x18, 0x8d, 0xc3, 0x02, 0xa9, 0xa0, 0x8d, 0x03, 0xd0,
+  0xa9, 0x01, 0x8d, 0x6f, 0x02, 0x60, 0xa9, 0x22, 0x8d, 0x2f, 0x02, 0xa9,
+  0x00, 0x8d, 0x1d, 0xd0, 0xa0, 0x0c, 0x99, 0x00, 0xd0, 0x88, 0x10, 0xfa,
+  0xa9, 0x00, 0x8d, 0xc0, 0x02, 0xa9, 0x00, 0x8d, 0xc1, 0x02, 0xa9, 0x00,
+  0x8d, 0xc2, 0x02, 0xa9, 0x00, 0x8d, 0xc3, 0x02, 0xa5, 0x14, 0xc5, 0x14,
+  0xf0, 0xfc, 0x60, 0xa5, 0x14, 0xc5, 0x14, 0xf0, 0xfc, 0xa9, 0x00, 0x8d,
+  0x1d, 0xd0, 0x60, 0xa5, 0x14, 0xc5, 0x14, 0xf0, 0xfc, 0xa9, 0x03, 0x8d,
+  0x1d, 0xd0, 0xa9, 0x00, 0xa0, 0x7f, 0x99, 0x00, 0x0a, 0x99, 0x80, 0x0a,
+  0x99, 0x00, 0x0b, 0x99, 0x80, 0x0b, 0x88, 0x10, 0xf1, 0xa9, 0x0c, 0xa4,
+  0x83, 0x18, 0x69, 0x04, 0x88, 0x10, 0xfb, 0xa8, 0xa9, 0xff, 0xa2, 0x03,
+  0x99, 0x00, 0x0a, 0x99, 0x80, 0x0a, 0x99, 0x00, 0x0b, 0x99, 0x80, 0x0b,
+  0xc8, 0xca, 0x10, 0xf0, 0x60, 0xa9, 0x00, 0x85, 0x92, 0xa9, 0x00, 0x85,
+  0x94, 0xa9, 0x22, 0x85, 0x96, 0xa9, 0xa9, 0x85, 0x97, 0xa9, 0x28, 0x85,
+  0x98, 0x20, 0x00, 0xa8, 0xe6, 0x94, 0xa9, 0x4a, 0x85, 0x96, 0xa9, 0xa9,
+  0x85, 0x97, 0xa9, 0x28, 0x85, 0x98, 0x20, 0x00, 0xa8, 0xe6, 0x94, 0xa9,
+  0x72, 0x85, 0x96, 0xa9, 0xa9, 0x85, 0x97, 0xa9, 0x28, 0x85, 0x98, 0x20,
+  0x00, 0xa8, 0xe6, 0x94, 0xa9, 0x9a, 0x85, 0x96, 0xa9, 0xa9, 0x85, 0x97,
+  0xa9, 0x28, 0x85, 0x98, 0x20, 0x00, 0xa8, 0xe6, 0x94, 0xa9, 0xc2, 0x85,
+  0x96, 0xa9, 0xa9, 0x85, 0x97, 0xa9, 0x28, 0x85, 0x98, 0x20, 0x00, 0xa8,
+  0xa9, 0x17, 0x85, 0x94, 0xa9, 0xea, 0x85, 0x96, 0xa9, 0xa9, 0x85, 0x97,
+  0xa9, 0x28, 0x85, 0x98, 0x20, 0x76, 0xa8, 0x60, 0xa9, 0x09, 0x85, 0x92,
+  0xa9, 0x05, 0x85, 0x94, 0xa5, 0x87, 0xd0, 0x0f, 0xa9, 0x12, 0x85, 0x96,
+  0xa9, 0xaa, 0x85, 0x97, 0xa9, 0x14, 0x85, 0x98, 0x4c, 0x83, 0xa6, 0xa9,
+  0x26, 0x85, 0x96, 0xa9, 0xaa, 0x85, 0x97, 0xa9, 0x14, 0x85, 0x98, 0x20,
+  0x76, 0xa8, 0x60, 0xa9, 0x06, 0x85, 0x92, 0xa9, 0x08, 0x85, 0x94, 0xa9,
+  0xa0, 0x85, 0x96, 0xa9, 0xab, 0x85, 0x97, 0xa9, 0x19, 0x85, 0x98, 0x20,
+  0x34, 0xa8, 0x60, 0xa9, 0x09, 0x85, 0x92, 0xa9, 0x05, 0x85, 0x94, 0xa9,
+  0xc0, 0x85, 0x96, 0xa9, 0xaa, 0x85, 0x97, 0xad, 0x02, 0xd5, 0xf0, 0x08,
+  0xa9, 0xac, 0x85, 0x96, 0xa9, 0xaa, 0x85, 0x97, 0xa9, 0x14, 0x85, 0x98,
+  0x20, 0x76, 0xa8, 0x60, 0xa9, 0x09, 0x85, 0x92, 0xa9, 0x05, 0x85, 0x94,
+  0xa9, 0xe8, 0x85, 0x96, 0xa9, 0xaa, 0x85, 0x97, 0xad, 0x02, 0xd5, 0xf0,
+  0x08, 0xa9, 0xd4, 0x85, 0x96, 0xa9, 0xaa, 0x85, 0x97, 0xa9, 0x14, 0x85,
+  0x98, 0x20, 0x76, 0xa8, 0x60, 0xa9, 0x09, 0x85, 0x92, 0xa9, 0x05, 0x85,
+  0x94, 0xa9, 0x74, 0x85, 0x96, 0xa9, 0xab, 0x85, 0x97, 0xad, 0x01, 0xd5,
+  0xd0, 0x24, 0xa9, 0x10, 0x85, 0x96, 0xa9, 0xab, 0x85, 0x97, 0xad, 0x02,
+  0xd5, 0xf0, 0x17, 0xa9, 0xfc, 0x85, 0x96, 0xa9, 0xaa, 0x85, 0x97, 0xad,
+  0x02, 0xd5, 0xc9, 0x01, 0xf0, 0x08, 0xa9, 0x24, 0x85, 0x96, 0xa9, 0xab,
+  0x85, 0x97, 0xa9, 0x14, 0x85, 0x98, 0x20, 0x76, 0xa8, 0x60, 0x20, 0xd5,
+  0xa4, 0xa9, 0x04, 0x8d, 0x00, 0xd5, 0xa9, 0xff, 0x8d, 0x01, 0xd5, 0xa9,
+  0x51, 0x20, 0x20, 0x06, 0xa9, 0x09, 0x85, 0x92, 0xa9, 0x05, 0x85, 0x94,
+  0xa9, 0x4c, 0x85, 0x96, 0xa9, 0xab, 0x85, 0x97, 0xad, 0x02, 0xd5, 0xf0,
+  0x08, 0xa9, 0x38, 0x85, 0x96, 0xa9, 0xab, 0x85, 0x97, 0xa9, 0x14, 0x85,
+  0x98, 0x20, 0x76, 0xa8, 0xa9, 0x51, 0x20, 0x66, 0xa7, 0x60, 0x85, 0x9c,
+  0xa9, 0x07, 0x85, 0x82, 0xa9, 0x00, 0x85, 0x81, 0xa5, 0x82, 0xc9, 0x16,
+  0xf0, 0x32, 0xa5, 0x81, 0x8d, 0x01, 0xd5, 0xa9, 0x00, 0x8d, 0x00, 0xd5,
+  0xa5, 0x9c, 0x20, 0x20, 0x06, 0xad, 0x01, 0xd5, 0xd0, 0x1e, 0xa5, 0x82,
+  0x85, 0x94, 0xa9, 0x01, 0x85, 0x92, 0xa9, 0x02, 0x85, 0x96, 0xa9, 0xd5,
+  0x85, 0x97, 0xa9, 0x26, 0x85, 0x98, 0x20, 0x34, 0xa8, 0xe6, 0x82, 0xe6,
+  0x81, 0x4c, 0x70, 0xa7, 0x60, 0xa9, 0x09, 0x85, 0x92, 0xa9, 0x05, 0x85,
+  0x94, 0xa9, 0x88, 0x85, 0x96, 0xa9, 0xab, 0x85, 0x97, 0xa9, 0x14, 0x85,
+  0x98, 0x20, 0x76, 0xa8, 0xa9, 0x0f, 0x85, 0x92, 0xa5, 0x86, 0xf0, 0x16,
+  0xa9, 0x00, 0x85, 0x96, 0xa9, 0x06, 0x85, 0x97, 0xa5, 0x86, 0x85, 0x98,
+  0x20, 0x76, 0xa8, 0xa5, 0x92, 0x18, 0x65, 0x86, 0x85, 0x92, 0xa9, 0xb9,
+  0x85, 0x96, 0xa9, 0xab, 0x85, 0x97, 0xa9, 0x01, 0x85, 0x98, 0x20, 0x34,
+  0xa8, 0x60, 0xa9, 0xff, 0x8d, 0xfc, 0x02, 0xae, 0xfc, 0x02, 0xe0, 0xff,
   0xf0, 0xf9, 0xa9, 0xff, 0x8d, 0xfc, 0x02, 0x60, 0xa5, 0x58, 0x85, 0x90,
   0xa5, 0x59, 0x85, 0x91, 0xa4, 0x94, 0x88, 0x30, 0x0e, 0x18, 0xa5, 0x90,
-  0x69, 0x28, 0x85, 0x90, 0x90, 0x02, 0xe6, 0x91, 0x4c, 0x76, 0xa5, 0x18,
+  0x69, 0x28, 0x85, 0x90, 0x90, 0x02, 0xe6, 0x91, 0x4c, 0x0a, 0xa8, 0x18,
   0xa5, 0x92, 0x65, 0x90, 0x85, 0x90, 0xa5, 0x93, 0x65, 0x91, 0x85, 0x91,
   0xa0, 0x00, 0xb1, 0x96, 0x91, 0x90, 0xc8, 0xc4, 0x98, 0xd0, 0xf7, 0x60,
   0xa5, 0x98, 0xd0, 0x01, 0x60, 0xa5, 0x58, 0x85, 0x90, 0xa5, 0x59, 0x85,
   0x91, 0xa4, 0x94, 0x88, 0x30, 0x0e, 0x18, 0xa5, 0x90, 0x69, 0x28, 0x85,
-  0x90, 0x90, 0x02, 0xe6, 0x91, 0x4c, 0xaf, 0xa5, 0x18, 0xa5, 0x92, 0x65,
+  0x90, 0x90, 0x02, 0xe6, 0x91, 0x4c, 0x43, 0xa8, 0x18, 0xa5, 0x92, 0x65,
   0x90, 0x85, 0x90, 0xa5, 0x93, 0x65, 0x91, 0x85, 0x91, 0xa0, 0x00, 0xb1,
   0x96, 0xf0, 0x0e, 0xc9, 0x60, 0xb0, 0x03, 0x38, 0xe9, 0x20, 0x91, 0x90,
   0xc8, 0xc4, 0x98, 0xd0, 0xee, 0x60, 0xa5, 0x58, 0x85, 0x90, 0xa5, 0x59,
   0x85, 0x91, 0xa4, 0x94, 0x88, 0x30, 0x0e, 0x18, 0xa5, 0x90, 0x69, 0x28,
-  0x85, 0x90, 0x90, 0x02, 0xe6, 0x91, 0x4c, 0xec, 0xa5, 0x18, 0xa5, 0x92,
+  0x85, 0x90, 0x90, 0x02, 0xe6, 0x91, 0x4c, 0x80, 0xa8, 0x18, 0xa5, 0x92,
   0x65, 0x90, 0x85, 0x90, 0xa5, 0x93, 0x65, 0x91, 0x85, 0x91, 0xa0, 0x00,
   0xb1, 0x96, 0xf0, 0x10, 0xc9, 0x60, 0xb0, 0x03, 0x38, 0xe9, 0x20, 0x09,
   0x80, 0x91, 0x90, 0xc8, 0xc4, 0x98, 0xd0, 0xec, 0x60, 0xa0, 0x0b, 0xb9,
-  0x2c, 0xa6, 0x99, 0x1f, 0x06, 0x88, 0xd0, 0xf7, 0x60, 0x8d, 0xdf, 0xd5,
-  0xad, 0x00, 0xd5, 0xc9, 0x11, 0xd0, 0xf9, 0x60, 0xa0, 0x09, 0xb9, 0x43,
-  0xa6, 0x99, 0x2f, 0x06, 0x88, 0xd0, 0xf7, 0x60, 0x78, 0xa9, 0xff, 0x8d,
-  0xdf, 0xd5, 0x4c, 0x77, 0xe4, 0xa9, 0x91, 0x85, 0x43, 0xa9, 0xa9, 0x85,
+  0xc0, 0xa8, 0x99, 0x1f, 0x06, 0x88, 0xd0, 0xf7, 0x60, 0x8d, 0xdf, 0xd5,
+  0xad, 0x00, 0xd5, 0xc9, 0x11, 0xd0, 0xf9, 0x60, 0xa0, 0x09, 0xb9, 0xd7,
+  0xa8, 0x99, 0x2f, 0x06, 0x88, 0xd0, 0xf7, 0x60, 0x78, 0xa9, 0xff, 0x8d,
+  0xdf, 0xd5, 0x4c, 0x77, 0xe4, 0xa9, 0xc0, 0x85, 0x43, 0xa9, 0xac, 0x85,
   0x44, 0xa9, 0x00, 0x85, 0x45, 0xa9, 0x07, 0x85, 0x46, 0xa9, 0xff, 0x85,
-  0x47, 0xa9, 0x01, 0x85, 0x48, 0x4c, 0x68, 0xa6, 0xa5, 0x47, 0x49, 0xff,
+  0x47, 0xa9, 0x01, 0x85, 0x48, 0x4c, 0xfc, 0xa8, 0xa5, 0x47, 0x49, 0xff,
   0x69, 0x01, 0x85, 0x47, 0xa5, 0x48, 0x49, 0xff, 0x69, 0x00, 0x85, 0x48,
   0xa0, 0x00, 0xb1, 0x43, 0x91, 0x45, 0xc8, 0xd0, 0x04, 0xe6, 0x44, 0xe6,
   0x46, 0xe6, 0x47, 0xd0, 0xf1, 0xe6, 0x48, 0xd0, 0xed, 0x60, 0x51, 0x52,
@@ -155,10 +210,10 @@ unsigned char UnoCart_rom[] = {
   0x16, 0x7c, 0x5a, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52,
   0x52, 0x52, 0x58, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52,
   0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52,
-  0x52, 0x52, 0x52, 0x52, 0x52, 0x43, 0x43, 0x75, 0x72, 0x55, 0x70, 0x2f,
-  0x44, 0x6e, 0x2f, 0x52, 0x65, 0x74, 0x6e, 0x3d, 0x53, 0x65, 0x6c, 0x20,
-  0x42, 0x3d, 0x42, 0x61, 0x63, 0x6b, 0x20, 0x58, 0x3d, 0x42, 0x6f, 0x6f,
-  0x74, 0x20, 0x45, 0x73, 0x63, 0x3d, 0x46, 0x69, 0x6e, 0x64, 0x5b, 0x44,
+  0x52, 0x52, 0x52, 0x52, 0x52, 0x43, 0x20, 0x42, 0x3d, 0x42, 0x61, 0x63,
+  0x6b, 0x20, 0x58, 0x3d, 0x42, 0x6f, 0x6f, 0x74, 0x20, 0x45, 0x73, 0x63,
+  0x3d, 0x46, 0x69, 0x6e, 0x64, 0x20, 0x46, 0x3d, 0x46, 0x50, 0x20, 0x4f,
+  0x3d, 0x4f, 0x76, 0x65, 0x72, 0x6c, 0x61, 0x79, 0x20, 0x20, 0x5b, 0x44,
   0x69, 0x72, 0x65, 0x63, 0x74, 0x6f, 0x72, 0x79, 0x20, 0x63, 0x6f, 0x6e,
   0x74, 0x65, 0x6e, 0x74, 0x73, 0x5d, 0x5b, 0x20, 0x20, 0x53, 0x65, 0x61,
   0x72, 0x63, 0x68, 0x20, 0x72, 0x65, 0x73, 0x75, 0x6c, 0x74, 0x73, 0x20,
@@ -171,149 +226,94 @@ unsigned char UnoCart_rom[] = {
   0x00, 0x00, 0x00, 0x00, 0x00, 0x7c, 0x5a, 0x52, 0x52, 0x52, 0x52, 0x52,
   0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52,
   0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0xb0, 0xf2, 0xe5, 0xf3,
-  0xf3, 0x80, 0xe1, 0x80, 0xeb, 0xe5, 0xf9, 0x43, 0x51, 0x52, 0x52, 0x52,
-  0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52,
-  0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x45, 0x7c, 0x33, 0x65, 0x61,
-  0x72, 0x63, 0x68, 0x1a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7c, 0x5a, 0x52, 0x52, 0x52,
-  0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0x52, 0xa5, 0xb3, 0xa3,
-  0x80, 0xa3, 0xe1, 0xee, 0xe3, 0xe5, 0xec, 0x43, 0x44, 0x49, 0x52, 0x00,
+  0xf3, 0x80, 0xe1, 0x80, 0xeb, 0xe5, 0xf9, 0x43, 0x5b, 0x20, 0x20, 0x46,
+  0x61, 0x73, 0x74, 0x20, 0x46, 0x50, 0x3a, 0x20, 0x20, 0x20, 0x6f, 0x6e,
+  0x20, 0x20, 0x20, 0x5d, 0x5b, 0x20, 0x20, 0x46, 0x61, 0x73, 0x74, 0x20,
+  0x46, 0x50, 0x3a, 0x20, 0x20, 0x20, 0x6f, 0x66, 0x66, 0x20, 0x20, 0x5d,
+  0x5b, 0x20, 0x41, 0x54, 0x52, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x6c, 0x61,
+  0x79, 0x3a, 0x20, 0x20, 0x6f, 0x6e, 0x20, 0x5d, 0x5b, 0x20, 0x41, 0x54,
+  0x52, 0x20, 0x6f, 0x76, 0x65, 0x72, 0x6c, 0x61, 0x79, 0x3a, 0x20, 0x20,
+  0x6f, 0x66, 0x66, 0x5d, 0x5b, 0x20, 0x20, 0x42, 0x75, 0x73, 0x20, 0x74,
+  0x72, 0x61, 0x63, 0x65, 0x3a, 0x20, 0x20, 0x6f, 0x6e, 0x20, 0x20, 0x5d,
+  0x5b, 0x20, 0x20, 0x42, 0x75, 0x73, 0x20, 0x74, 0x72, 0x61, 0x63, 0x65,
+  0x3a, 0x20, 0x20, 0x6f, 0x66, 0x66, 0x20, 0x5d, 0x5b, 0x20, 0x20, 0x42,
+  0x75, 0x73, 0x20, 0x74, 0x72, 0x61, 0x63, 0x65, 0x3a, 0x20, 0x20, 0x68,
+  0x6f, 0x74, 0x20, 0x5d, 0x5b, 0x20, 0x53, 0x74, 0x61, 0x74, 0x73, 0x20,
+  0x2d, 0x20, 0x6c, 0x6f, 0x67, 0x3a, 0x20, 0x20, 0x6f, 0x6e, 0x20, 0x5d,
+  0x5b, 0x20, 0x53, 0x74, 0x61, 0x74, 0x73, 0x20, 0x2d, 0x20, 0x6c, 0x6f,
+  0x67, 0x3a, 0x20, 0x20, 0x6f, 0x66, 0x66, 0x5d, 0x5b, 0x53, 0x44, 0x20,
+  0x63, 0x61, 0x72, 0x64, 0x20, 0x73, 0x70, 0x65, 0x65, 0x64, 0x20, 0x74,
+  0x65, 0x73, 0x74, 0x5d, 0x5b, 0x20, 0x42, 0x75, 0x73, 0x20, 0x74, 0x72,
+  0x61, 0x63, 0x65, 0x3a, 0x20, 0x6e, 0x2f, 0x61, 0x20, 0x20, 0x20, 0x5d,
+  0x5b, 0x46, 0x69, 0x6e, 0x64, 0x3a, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x5d, 0x44, 0x49, 0x52, 0x00,
   0x4e, 0x6f, 0x20, 0x76, 0x61, 0x6c, 0x69, 0x64, 0x20, 0x66, 0x69, 0x6c,
   0x65, 0x73, 0x20, 0x74, 0x6f, 0x20, 0x64, 0x69, 0x73, 0x70, 0x6c, 0x61,
-  0x79, 0x53, 0x65, 0x61, 0x72, 0x63, 0x68, 0x69, 0x6e, 0x67, 0x2e, 0x2e,
-  0x2e, 0x2e, 0x20, 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x00, 0x6c, 0x6a, 0x3b,
-  0x8a, 0x8b, 0x6b, 0x2b, 0x2a, 0x6f, 0x80, 0x70, 0x75, 0x9b, 0x69, 0x2d,
-  0x3d, 0x76, 0x80, 0x63, 0x8c, 0x8d, 0x62, 0x78, 0x7a, 0x34, 0x80, 0x33,
-  0x36, 0x1b, 0x35, 0x32, 0x31, 0x2c, 0x20, 0x2e, 0x6e, 0x80, 0x6d, 0x2f,
-  0x81, 0x72, 0x80, 0x65, 0x79, 0x7f, 0x74, 0x77, 0x71, 0x39, 0x80, 0x30,
-  0x37, 0x7e, 0x38, 0x3c, 0x3e, 0x66, 0x68, 0x64, 0x80, 0x82, 0x67, 0x73,
-  0x61, 0x4c, 0x4a, 0x3a, 0x8a, 0x8b, 0x4b, 0x5c, 0x5e, 0x4f, 0x80, 0x50,
-  0x55, 0x9b, 0x49, 0x5f, 0x7c, 0x56, 0x80, 0x43, 0x8c, 0x8d, 0x42, 0x58,
-  0x5a, 0x24, 0x80, 0x23, 0x26, 0x1b, 0x25, 0x22, 0x21, 0x5b, 0x20, 0x5d,
-  0x4e, 0x80, 0x4d, 0x3f, 0x81, 0x52, 0x80, 0x45, 0x59, 0x9f, 0x54, 0x57,
-  0x51, 0x28, 0x80, 0x29, 0x27, 0x9c, 0x40, 0x7d, 0x9d, 0x46, 0x48, 0x44,
-  0x80, 0x83, 0x47, 0x53, 0x41, 0x0c, 0x0a, 0x7b, 0x80, 0x80, 0x0b, 0x1e,
-  0x1f, 0x0f, 0x80, 0x10, 0x15, 0x9b, 0x09, 0x1c, 0x1d, 0x16, 0x80, 0x03,
-  0x89, 0x80, 0x02, 0x18, 0x1a, 0x80, 0x80, 0x85, 0x80, 0x1b, 0x80, 0xfd,
-  0x80, 0x00, 0x20, 0x60, 0x0e, 0x80, 0x0d, 0x80, 0x81, 0x12, 0x80, 0x05,
-  0x19, 0x9e, 0x14, 0x17, 0x11, 0x80, 0x80, 0x80, 0x80, 0xfe, 0x80, 0x7d,
-  0xff, 0x06, 0x08, 0x04, 0x80, 0x84, 0x07, 0x13, 0x01, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x9c,
-  0x9d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0x4c, 0x01, 0x02, 0x20, 0x3b, 0x08, 0xa9, 0x38, 0x8d, 0xe2, 0x02,
-  0xa9, 0x07, 0x8d, 0xe3, 0x02, 0x20, 0x3c, 0x07, 0x30, 0x20, 0xad, 0xe1,
-  0x02, 0xc9, 0x07, 0xd0, 0x05, 0xad, 0xe0, 0x02, 0xc9, 0x38, 0xd0, 0x0c,
-  0xad, 0x37, 0x08, 0x8d, 0xe0, 0x02, 0xad, 0x38, 0x08, 0x8d, 0xe1, 0x02,
-  0x20, 0x39, 0x07, 0x4c, 0x06, 0x07, 0x6c, 0xe0, 0x02, 0x60, 0x6c, 0xe2,
-  0x02, 0x20, 0x8a, 0x07, 0x30, 0x48, 0xad, 0x35, 0x08, 0x2d, 0x36, 0x08,
-  0xc9, 0xff, 0xd0, 0x05, 0x20, 0x8a, 0x07, 0x30, 0x39, 0xad, 0x35, 0x08,
-  0x8d, 0x37, 0x08, 0xad, 0x36, 0x08, 0x8d, 0x38, 0x08, 0x20, 0x8a, 0x07,
-  0x30, 0x28, 0x38, 0xad, 0x35, 0x08, 0xed, 0x37, 0x08, 0x8d, 0x39, 0x08,
-  0xad, 0x36, 0x08, 0xed, 0x38, 0x08, 0x8d, 0x3a, 0x08, 0xee, 0x39, 0x08,
-  0xd0, 0x03, 0xee, 0x3a, 0x08, 0xad, 0x37, 0x08, 0x85, 0x43, 0xad, 0x38,
-  0x08, 0x85, 0x44, 0x20, 0x9c, 0x07, 0x60, 0xa9, 0x35, 0x85, 0x43, 0xa9,
-  0x08, 0x85, 0x44, 0xa9, 0x02, 0x8d, 0x39, 0x08, 0xa9, 0x00, 0x8d, 0x3a,
-  0x08, 0x20, 0x22, 0x08, 0xad, 0x39, 0x08, 0x0d, 0x3a, 0x08, 0xf0, 0x75,
-  0xa5, 0x45, 0x05, 0x46, 0x05, 0x47, 0x05, 0x48, 0xf0, 0x6e, 0xee, 0xf3,
-  0x07, 0xd0, 0x3c, 0xee, 0x23, 0x08, 0xd0, 0x03, 0xee, 0x25, 0x08, 0x20,
-  0x22, 0x08, 0xad, 0x3a, 0x08, 0xf0, 0x2c, 0xa5, 0x46, 0x05, 0x47, 0x05,
-  0x48, 0xf0, 0x24, 0xa0, 0x00, 0xb9, 0x00, 0xd5, 0x91, 0x43, 0xc8, 0xd0,
-  0xf8, 0xe6, 0x44, 0xa2, 0x03, 0x38, 0xb9, 0x45, 0x00, 0xf9, 0x31, 0x08,
-  0x99, 0x45, 0x00, 0xc8, 0xca, 0x10, 0xf3, 0xce, 0x3a, 0x08, 0xce, 0xf3,
-  0x07, 0xd0, 0xaa, 0xad, 0x00, 0xd5, 0xa0, 0x00, 0x91, 0x43, 0xe6, 0x43,
-  0xd0, 0x02, 0xe6, 0x44, 0xad, 0x39, 0x08, 0xd0, 0x03, 0xce, 0x3a, 0x08,
-  0xce, 0x39, 0x08, 0xa2, 0x03, 0x38, 0xb9, 0x45, 0x00, 0xf9, 0x2d, 0x08,
-  0x99, 0x45, 0x00, 0xc8, 0xca, 0x10, 0xf3, 0x30, 0x83, 0xa0, 0x01, 0x60,
-  0xa0, 0x88, 0x60, 0xa0, 0x00, 0xa2, 0x00, 0x8c, 0x00, 0xd5, 0x8e, 0x01,
-  0xd5, 0x60, 0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x78, 0xa9, 0xff, 0x8d, 0xdf, 0xd5, 0x20, 0x8e,
-  0x08, 0x20, 0x7c, 0x08, 0x58, 0x20, 0xd6, 0x08, 0xa9, 0xff, 0x8d, 0xe7,
-  0x02, 0xa9, 0x08, 0x8d, 0xe8, 0x02, 0xa9, 0x38, 0x8d, 0xe0, 0x02, 0xa9,
-  0x07, 0x8d, 0xe1, 0x02, 0xa0, 0x00, 0x98, 0x99, 0x80, 0x00, 0xc8, 0x10,
-  0xfa, 0x20, 0x9b, 0x08, 0xa0, 0x03, 0xb9, 0x00, 0xd5, 0x99, 0x45, 0x00,
-  0x88, 0x10, 0xf7, 0xa9, 0x03, 0x8d, 0xf3, 0x07, 0x60, 0xa9, 0x01, 0x8d,
-  0xf8, 0x03, 0xa9, 0xc0, 0x85, 0x6a, 0xad, 0x01, 0xd3, 0x09, 0x02, 0x8d,
-  0x01, 0xd3, 0x60, 0x8d, 0x0a, 0xd4, 0x8d, 0x0a, 0xd4, 0xad, 0x13, 0xd0,
-  0x8d, 0xfa, 0x03, 0x60, 0xa9, 0xff, 0x85, 0x43, 0xa9, 0x08, 0x85, 0x44,
-  0x38, 0xad, 0x30, 0x02, 0xe5, 0x43, 0x85, 0x45, 0xad, 0x31, 0x02, 0xe5,
-  0x44, 0x85, 0x46, 0xa5, 0x45, 0x49, 0xff, 0x18, 0x69, 0x01, 0x85, 0x45,
-  0xa5, 0x46, 0x49, 0xff, 0x69, 0x00, 0x85, 0x46, 0xa0, 0x00, 0x98, 0x91,
-  0x43, 0xc8, 0xd0, 0x02, 0xe6, 0x44, 0xe6, 0x45, 0xd0, 0xf5, 0xe6, 0x46,
-  0xd0, 0xf1, 0x60, 0xa2, 0x00, 0xa9, 0x0c, 0x8d, 0x42, 0x03, 0x20, 0x56,
-  0xe4, 0xa9, 0xfc, 0x8d, 0x44, 0x03, 0xa9, 0x08, 0x8d, 0x45, 0x03, 0xa9,
-  0x0c, 0x8d, 0x4a, 0x03, 0xa9, 0x00, 0x8d, 0x4b, 0x03, 0xa9, 0x03, 0x8d,
-  0x42, 0x03, 0x4c, 0x56, 0xe4, 0x45, 0x3a, 0x9b, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0x79, 0x20, 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x00, 0x6c, 0x6a, 0x3b, 0x8a,
+  0x8b, 0x6b, 0x2b, 0x2a, 0x6f, 0x80, 0x70, 0x75, 0x9b, 0x69, 0x2d, 0x3d,
+  0x76, 0x80, 0x63, 0x8c, 0x8d, 0x62, 0x78, 0x7a, 0x34, 0x80, 0x33, 0x36,
+  0x1b, 0x35, 0x32, 0x31, 0x2c, 0x20, 0x2e, 0x6e, 0x80, 0x6d, 0x2f, 0x81,
+  0x72, 0x80, 0x65, 0x79, 0x7f, 0x74, 0x77, 0x71, 0x39, 0x80, 0x30, 0x37,
+  0x7e, 0x38, 0x3c, 0x3e, 0x66, 0x68, 0x64, 0x80, 0x82, 0x67, 0x73, 0x61,
+  0x4c, 0x4a, 0x3a, 0x8a, 0x8b, 0x4b, 0x5c, 0x5e, 0x4f, 0x80, 0x50, 0x55,
+  0x9b, 0x49, 0x5f, 0x7c, 0x56, 0x80, 0x43, 0x8c, 0x8d, 0x42, 0x58, 0x5a,
+  0x24, 0x80, 0x23, 0x26, 0x1b, 0x25, 0x22, 0x21, 0x5b, 0x20, 0x5d, 0x4e,
+  0x80, 0x4d, 0x3f, 0x81, 0x52, 0x80, 0x45, 0x59, 0x9f, 0x54, 0x57, 0x51,
+  0x28, 0x80, 0x29, 0x27, 0x9c, 0x40, 0x7d, 0x9d, 0x46, 0x48, 0x44, 0x80,
+  0x83, 0x47, 0x53, 0x41, 0x0c, 0x0a, 0x7b, 0x80, 0x80, 0x0b, 0x1e, 0x1f,
+  0x0f, 0x80, 0x10, 0x15, 0x9b, 0x09, 0x1c, 0x1d, 0x16, 0x80, 0x03, 0x89,
+  0x80, 0x02, 0x18, 0x1a, 0x80, 0x80, 0x85, 0x80, 0x1b, 0x80, 0xfd, 0x80,
+  0x00, 0x20, 0x60, 0x0e, 0x80, 0x0d, 0x80, 0x81, 0x12, 0x80, 0x05, 0x19,
+  0x9e, 0x14, 0x17, 0x11, 0x80, 0x80, 0x80, 0x80, 0xfe, 0x80, 0x7d, 0xff,
+  0x06, 0x08, 0x04, 0x80, 0x84, 0x07, 0x13, 0x01, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x9c, 0x9d,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0x4c, 0x01, 0x02, 0x20, 0x3b, 0x08, 0xa9, 0x38, 0x8d, 0xe2, 0x02, 0xa9,
+  0x07, 0x8d, 0xe3, 0x02, 0x20, 0x3c, 0x07, 0x30, 0x20, 0xad, 0xe1, 0x02,
+  0xc9, 0x07, 0xd0, 0x05, 0xad, 0xe0, 0x02, 0xc9, 0x38, 0xd0, 0x0c, 0xad,
+  0x37, 0x08, 0x8d, 0xe0, 0x02, 0xad, 0x38, 0x08, 0x8d, 0xe1, 0x02, 0x20,
+  0x39, 0x07, 0x4c, 0x06, 0x07, 0x6c, 0xe0, 0x02, 0x60, 0x6c, 0xe2, 0x02,
+  0x20, 0x8a, 0x07, 0x30, 0x48, 0xad, 0x35, 0x08, 0x2d, 0x36, 0x08, 0xc9,
+  0xff, 0xd0, 0x05, 0x20, 0x8a, 0x07, 0x30, 0x39, 0xad, 0x35, 0x08, 0x8d,
+  0x37, 0x08, 0xad, 0x36, 0x08, 0x8d, 0x38, 0x08, 0x20, 0x8a, 0x07, 0x30,
+  0x28, 0x38, 0xad, 0x35, 0x08, 0xed, 0x37, 0x08, 0x8d, 0x39, 0x08, 0xad,
+  0x36, 0x08, 0xed, 0x38, 0x08, 0x8d, 0x3a, 0x08, 0xee, 0x39, 0x08, 0xd0,
+  0x03, 0xee, 0x3a, 0x08, 0xad, 0x37, 0x08, 0x85, 0x43, 0xad, 0x38, 0x08,
+  0x85, 0x44, 0x20, 0x9c, 0x07, 0x60, 0xa9, 0x35, 0x85, 0x43, 0xa9, 0x08,
+  0x85, 0x44, 0xa9, 0x02, 0x8d, 0x39, 0x08, 0xa9, 0x00, 0x8d, 0x3a, 0x08,
+  0x20, 0x22, 0x08, 0xad, 0x39, 0x08, 0x0d, 0x3a, 0x08, 0xf0, 0x75, 0xa5,
+  0x45, 0x05, 0x46, 0x05, 0x47, 0x05, 0x48, 0xf0, 0x6e, 0xee, 0xf3, 0x07,
+  0xd0, 0x3c, 0xee, 0x23, 0x08, 0xd0, 0x03, 0xee, 0x25, 0x08, 0x20, 0x22,
+  0x08, 0xad, 0x3a, 0x08, 0xf0, 0x2c, 0xa5, 0x46, 0x05, 0x47, 0x05, 0x48,
+  0xf0, 0x24, 0xa0, 0x00, 0xb9, 0x00, 0xd5, 0x91, 0x43, 0xc8, 0xd0, 0xf8,
+  0xe6, 0x44, 0xa2, 0x03, 0x38, 0xb9, 0x45, 0x00, 0xf9, 0x31, 0x08, 0x99,
+  0x45, 0x00, 0xc8, 0xca, 0x10, 0xf3, 0xce, 0x3a, 0x08, 0xce, 0xf3, 0x07,
+  0xd0, 0xaa, 0xad, 0x00, 0xd5, 0xa0, 0x00, 0x91, 0x43, 0xe6, 0x43, 0xd0,
+  0x02, 0xe6, 0x44, 0xad, 0x39, 0x08, 0xd0, 0x03, 0xce, 0x3a, 0x08, 0xce,
+  0x39, 0x08, 0xa2, 0x03, 0x38, 0xb9, 0x45, 0x00, 0xf9, 0x2d, 0x08, 0x99,
+  0x45, 0x00, 0xc8, 0xca, 0x10, 0xf3, 0x30, 0x83, 0xa0, 0x01, 0x60, 0xa0,
+  0x88, 0x60, 0xa0, 0x00, 0xa2, 0x00, 0x8c, 0x00, 0xd5, 0x8e, 0x01, 0xd5,
+  0x60, 0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x78, 0xa9, 0xff, 0x8d, 0xdf, 0xd5, 0x20, 0x8e, 0x08,
+  0x20, 0x7c, 0x08, 0x58, 0x20, 0xd6, 0x08, 0xa9, 0xff, 0x8d, 0xe7, 0x02,
+  0xa9, 0x08, 0x8d, 0xe8, 0x02, 0xa9, 0x38, 0x8d, 0xe0, 0x02, 0xa9, 0x07,
+  0x8d, 0xe1, 0x02, 0xa0, 0x00, 0x98, 0x99, 0x80, 0x00, 0xc8, 0x10, 0xfa,
+  0x20, 0x9b, 0x08, 0xa0, 0x03, 0xb9, 0x00, 0xd5, 0x99, 0x45, 0x00, 0x88,
+  0x10, 0xf7, 0xa9, 0x03, 0x8d, 0xf3, 0x07, 0x60, 0xa9, 0x01, 0x8d, 0xf8,
+  0x03, 0xa9, 0xc0, 0x85, 0x6a, 0xad, 0x01, 0xd3, 0x09, 0x02, 0x8d, 0x01,
+  0xd3, 0x60, 0x8d, 0x0a, 0xd4, 0x8d, 0x0a, 0xd4, 0xad, 0x13, 0xd0, 0x8d,
+  0xfa, 0x03, 0x60, 0xa9, 0xff, 0x85, 0x43, 0xa9, 0x08, 0x85, 0x44, 0x38,
+  0xad, 0x30, 0x02, 0xe5, 0x43, 0x85, 0x45, 0xad, 0x31, 0x02, 0xe5, 0x44,
+  0x85, 0x46, 0xa5, 0x45, 0x49, 0xff, 0x18, 0x69, 0x01, 0x85, 0x45, 0xa5,
+  0x46, 0x49, 0xff, 0x69, 0x00, 0x85, 0x46, 0xa0, 0x00, 0x98, 0x91, 0x43,
+  0xc8, 0xd0, 0x02, 0xe6, 0x44, 0xe6, 0x45, 0xd0, 0xf5, 0xe6, 0x46, 0xd0,
+  0xf1, 0x60, 0xa2, 0x00, 0xa9, 0x0c, 0x8d, 0x42, 0x03, 0x20, 0x56, 0xe4,
+  0xa9, 0xfc, 0x8d, 0x44, 0x03, 0xa9, 0x08, 0x8d, 0x45, 0x03, 0xa9, 0x0c,
+  0x8d, 0x4a, 0x03, 0xa9, 0x00, 0x8d, 0x4b, 0x03, 0xa9, 0x03, 0x8d, 0x42,
+  0x03, 0x4c, 0x56, 0xe4, 0x45, 0x3a, 0x9b, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
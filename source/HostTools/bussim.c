@@ -0,0 +1,610 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * bussim - run the firmware's XEGS emulation loop against a simulated Atari
+ *
+ * Loads a cart from a card image with the firmware's own load_file, then
+ * runs emulate_cartridge with the bus lines coming from here instead of the
+ * GPIO ports (see host/stm32f4xx.h): either a made-up game that runs from
+ * the fixed bank for a while and then switches banks all the time, or the
+ * accesses in a bus trace from the cart. Every read is checked against the
+ * image. AtariMax 1Mbit and SIC! carts run a made-up game that saves to the
+ * flash chip now and then (src/flashcart.h), and the file is read back from
+ * the card image at the end to check it got everything. See README.md.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "hostdisk.h"
+#include "cartinfo.h"
+#include "flashcart.h"
+#include "bustrace.h"
+#include "ff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <setjmp.h>
+
+/* in main.c */
+extern char errorBuf[40];
+extern int doneFatFsInit;
+void init();
+int mount_sd();
+int load_file(char *filename, FILE_META *meta);
+void emulate_cartridge(int cartType);
+
+#define NTSC_HZ		1789773
+#define PAL_HZ		1773447
+
+// CONTROL_IN, active low
+#define BUS_S5		0x0002
+#define BUS_S4		0x0004
+#define BUS_CCTL	0x0010
+#define BUS_RW		0x0020
+#define BUS_IDLE	(BUS_S5 | BUS_S4 | BUS_CCTL | BUS_RW)
+
+#define BANK_SIZE	8192
+#define MAX_BANKS	16
+
+static uint8_t image[MAX_BANKS * BANK_SIZE];
+static int banks;
+static double cycleUs;
+static int verbose = 0;
+
+/* The Atari: a made-up game, or a trace */
+static double bootMs = 0, runMs = 1500;
+static int idlePct = 30, switchEvery = 2000;
+static uint32_t seed = 1;
+static TRACE_ENTRY *trace;
+static uint32_t traceCount, traceCpuHz;
+
+static uint64_t cycles;
+static uint32_t traceNext, traceGap;
+static int bank;			// what the cart should have at $8000
+static jmp_buf finished;
+
+static struct {
+	uint64_t reads, switches, wrong, unanswered, badStatus, drove;
+} result;
+
+static uint32_t rnd(void) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 8;
+}
+
+static double now_ms(void) {
+	return cycles * cycleUs / 1000;
+}
+
+static void made_up_cycle(HOST_BUS_CYCLE *c) {
+	if (now_ms() >= runMs)
+		longjmp(finished, 1);
+	c->addr = rnd() & 0x1FFF;
+	c->data = 0;
+	if ((int)(rnd() % 100) < idlePct)
+		c->control = BUS_IDLE;
+	else if (now_ms() < bootMs)
+		c->control = BUS_IDLE & ~BUS_S5;
+	else if (rnd() % switchEvery == 0) {
+		c->control = BUS_IDLE & ~(BUS_CCTL | BUS_RW);
+		c->addr = 0x1500;
+		c->data = rnd() % banks;
+	}
+	else
+		c->control = BUS_IDLE & ~(rnd() & 1 ? BUS_S4 : BUS_S5);
+}
+
+static void trace_cycle(HOST_BUS_CYCLE *c) {
+	if (traceNext == traceCount)
+		longjmp(finished, 1);
+	TRACE_ENTRY *e = &trace[traceNext];
+	if (!traceGap) {
+		// the CPU cycles since the last access, as bus cycles
+		traceGap = (uint32_t)((double)e->cycles * (1 / cycleUs) * 1e6 / traceCpuHz + 0.5);
+		if (!traceGap) traceGap = 1;
+	}
+	if (--traceGap) {
+		c->control = BUS_IDLE;
+		c->addr = 0;
+		return;
+	}
+	c->control = e->ctrl & BUS_IDLE;
+	c->addr = e->addr & 0x1FFF;
+	c->data = e->data;
+	traceNext++;
+}
+
+/* Flash carts: a made-up game that runs from one bank, switching now and
+   then, and saves a few times by erasing a sector and programming some bytes
+   of it, polling the chip for each as a game would from RAM. Every other save
+   goes to the same sector as the one before, as soon as the cart starts
+   writing that one back to the card */
+static int flashType;		// CART_TYPE_ATARIMAX_1MBIT or CART_TYPE_SIC_128K, 0 for XEGS
+static int saves = 4, saveBytes = 256;
+static uint8_t chip[FLASH_SIZE];	// what the game expects the flash to hold
+
+enum { KIND_OTHER = 0, KIND_READ, KIND_ERASE_POLL, KIND_PROGRAM_POLL };
+enum { GAME_PLAY, GAME_ERASING, GAME_PROGRAMMING, GAME_FLUSH };
+
+#define QUEUE_SIZE	64
+
+static struct {
+	int state;
+	struct { HOST_BUS_CYCLE c; int kind; } queue[QUEUE_SIZE];
+	int qHead, qLen;
+	int kind;				// of the cycle on the bus
+	int playBank;			// the game's bank
+	int genBank;			// the cart's bank once the queue has gone out
+	int genWrite;			// and whether the flash is writable (SIC!)
+	int cartBank;			// the cart's bank now
+	int writeEnable;		// SIC! bit 7
+	uint32_t addr;			// being programmed
+	int left;				// bytes still to program
+	uint8_t data;
+	int lastStatus;			// last status read while erasing, -1 for none
+	int sector;				// of the last save
+	double eraseMs;			// when the erase command went out
+	int savesDone;
+	double lastWriteMs;		// the game's last write to the flash
+	double savedMs;			// when the cart had written it all back
+} game;
+
+static int bank_size(void) {
+	return flashType == CART_TYPE_SIC_128K ? 16384 : 8192;
+}
+
+static void push(uint16_t control, uint16_t addr, uint8_t data, int kind) {
+	int i = (game.qHead + game.qLen++) % QUEUE_SIZE;
+	game.queue[i].c.control = control;
+	game.queue[i].c.addr = addr;
+	game.queue[i].c.data = data;
+	game.queue[i].kind = kind;
+}
+
+static void push_idle(int n) {
+	while (n--) push(BUS_IDLE, 0, 0, KIND_OTHER);
+}
+
+static void push_select(int b, int writeEnable) {
+	if (flashType == CART_TYPE_SIC_128K)
+		// both windows on, and the flash writable while saving
+		push(BUS_IDLE & ~(BUS_CCTL | BUS_RW), 0x1500, b | 0x20 | (writeEnable ? 0x80 : 0), KIND_OTHER);
+	else
+		push(BUS_IDLE & ~BUS_CCTL, 0x1500 | b, 0, KIND_OTHER);
+	game.genBank = b;
+	game.genWrite = writeEnable;
+}
+
+// an access to a byte of the chip, through the window it's in
+static void push_chip(uint32_t a, int write, uint8_t data, int kind) {
+	int b = a / bank_size(), offset = a % bank_size();
+	int writeEnable = write || game.state != GAME_PLAY;
+	if (b != game.genBank || (flashType == CART_TYPE_SIC_128K && writeEnable != game.genWrite))
+		push_select(b, writeEnable);
+	uint16_t control = BUS_IDLE & ~(offset < 0x2000 && flashType == CART_TYPE_SIC_128K ? BUS_S4 : BUS_S5);
+	if (write) control &= ~BUS_RW;
+	push(control, offset & 0x1FFF, data, kind);
+}
+
+static void push_cmd(uint32_t a, uint8_t data) {
+	push_chip(a, 1, data, KIND_OTHER);
+	push_idle(2);
+}
+
+static int flash_pending(void) {
+	return flash.numDirty || flash.writing >= 0 || flash.mode != FLASH_READ;
+}
+
+static void flash_game_cycle(HOST_BUS_CYCLE *c) {
+	if (!game.qLen) {
+		switch (game.state) {
+		case GAME_PLAY:
+			if (now_ms() >= runMs) {
+				game.state = GAME_FLUSH;
+				break;
+			}
+			if (game.savesDone < saves && (game.savesDone & 1 ? flash.writing >= 0 :
+					now_ms() >= runMs * (game.savesDone + 1) / (saves + 1))) {
+				int sector = game.savesDone & 1 ? game.sector : rnd() % (FLASH_SIZE / FLASH_SECTOR_SIZE);
+				game.state = GAME_ERASING;
+				game.sector = sector;
+				game.eraseMs = now_ms();
+				game.lastStatus = -1;
+				game.addr = sector * FLASH_SECTOR_SIZE + rnd() % (FLASH_SECTOR_SIZE - saveBytes);
+				game.left = saveBytes;
+				push_cmd(0x5555, 0xAA);
+				push_cmd(0x2AAA, 0x55);
+				push_cmd(0x5555, 0x80);
+				push_cmd(0x5555, 0xAA);
+				push_cmd(0x2AAA, 0x55);
+				push_cmd(sector * FLASH_SECTOR_SIZE, 0x30);
+				if (verbose) printf("%10.3f ms  erasing sector %d%s\n", now_ms(), sector,
+					flash.writing >= 0 ? ", the last save being written back" : "");
+				break;
+			}
+			if ((int)(rnd() % 100) < idlePct)
+				push_idle(1);
+			else if (rnd() % switchEvery == 0)
+				push_select(game.playBank = rnd() % (FLASH_SIZE / bank_size()), 0);
+			else
+				push_chip(game.playBank * bank_size() + rnd() % bank_size(), 0, 0, KIND_READ);
+			break;
+		case GAME_ERASING:
+			if (now_ms() - game.eraseMs > 1000) {
+				printf("%10.3f ms  the erase didn't finish\n", now_ms());
+				result.badStatus++;
+				longjmp(finished, 1);
+			}
+			push_chip(game.addr & ~(FLASH_SECTOR_SIZE - 1), 0, 0, KIND_ERASE_POLL);
+			push_idle(3);
+			break;
+		case GAME_PROGRAMMING:
+			if (!game.left) {
+				push_select(game.playBank, 0);
+				game.state = GAME_PLAY;
+				game.savesDone++;
+				if (verbose) printf("%10.3f ms  saved\n", now_ms());
+				break;
+			}
+			game.data = rnd();
+			push_cmd(0x5555, 0xAA);
+			push_cmd(0x2AAA, 0x55);
+			push_cmd(0x5555, 0xA0);
+			push_cmd(game.addr, game.data);
+			push_chip(game.addr, 0, 0, KIND_PROGRAM_POLL);
+			break;
+		case GAME_FLUSH:
+			if (!flash_pending()) {
+				game.savedMs = now_ms();
+				longjmp(finished, 1);
+			}
+			if (now_ms() >= runMs + 5000)
+				longjmp(finished, 1);
+			push_idle(1);
+			break;
+		}
+	}
+	if (!game.qLen) {
+		// the game just changed state
+		c->control = BUS_IDLE;
+		c->addr = 0;
+		game.kind = KIND_OTHER;
+		return;
+	}
+	*c = game.queue[game.qHead].c;
+	game.kind = game.queue[game.qHead].kind;
+	game.qHead = (game.qHead + 1) % QUEUE_SIZE;
+	game.qLen--;
+}
+
+static void flash_end_cycle(const HOST_BUS_CYCLE *c, int driven, uint8_t data) {
+	cycles++;
+	hostdisk_stats.simUs += cycleUs;
+	if (!(c->control & BUS_CCTL)) {
+		game.cartBank = flashType == CART_TYPE_SIC_128K ? c->data & 7 : c->addr & 0xF;
+		result.switches++;
+		return;
+	}
+	if ((c->control & BUS_S4) && (c->control & BUS_S5))
+		return;
+	uint32_t a = game.cartBank * bank_size() + c->addr;
+	if (flashType == CART_TYPE_SIC_128K && (c->control & BUS_S4))
+		a += 0x2000;	// S5, the top half of the bank
+	if (!(c->control & BUS_RW)) {
+		game.lastWriteMs = now_ms();
+		if (driven) {
+			result.drove++;
+			printf("%10.3f ms  the cart drove the bus on a write to $%05X\n", now_ms(), a);
+		}
+		return;
+	}
+	const char *what = NULL;
+	uint8_t want = chip[a];
+	result.reads++;
+	if (!driven) {
+		result.unanswered++;
+		what = "not answered";
+	}
+	else if (game.kind == KIND_ERASE_POLL) {
+		if (data == 0xFF) {
+			// erased
+			memset(&chip[a], 0xFF, FLASH_SECTOR_SIZE);
+			game.state = GAME_PROGRAMMING;
+			if (verbose) printf("%10.3f ms  erased, programming %d bytes at $%05X\n", now_ms(), game.left, game.addr);
+			return;
+		}
+		if ((data & 0x80) || (game.lastStatus >= 0 && !((data ^ game.lastStatus) & 0x40))) {
+			result.badStatus++;
+			what = "bad status while erasing";
+			want = game.lastStatus ^ 0x40;
+		}
+		game.lastStatus = data;
+	}
+	else if (game.kind == KIND_PROGRAM_POLL) {
+		want = chip[a] &= game.data;
+		if (data != want) {
+			result.wrong++;
+			what = "wrong data after programming";
+		}
+		game.addr++;
+		game.left--;
+	}
+	else if (data != want) {
+		result.wrong++;
+		what = "wrong data";
+	}
+	if (what && (verbose || result.badStatus + result.wrong + result.unanswered <= 10))
+		printf("%10.3f ms  $%05X: read $%02X, expected $%02X, %s\n", now_ms(), a, data, want, what);
+}
+
+static void next_cycle(HOST_BUS_CYCLE *c) {
+	if (trace) trace_cycle(c);
+	else if (flashType) flash_game_cycle(c);
+	else made_up_cycle(c);
+}
+
+static void end_cycle(const HOST_BUS_CYCLE *c, int driven, uint8_t data) {
+	if (flashType) {
+		flash_end_cycle(c, driven, data);
+		return;
+	}
+	cycles++;
+	hostdisk_stats.simUs += cycleUs;
+	if (!(c->control & BUS_CCTL) && !(c->control & BUS_RW)) {
+		bank = c->data & (banks - 1);
+		result.switches++;
+		return;
+	}
+	if ((c->control & BUS_S4) && (c->control & BUS_S5))
+		return;
+	int b = (c->control & BUS_S4) ? banks - 1 : bank;
+	uint8_t want = image[b * BANK_SIZE + c->addr];
+	const char *what = NULL;
+	result.reads++;
+	if (!driven) {
+		result.unanswered++;
+		what = "not answered";
+	}
+	else if (data != want) {
+		result.wrong++;
+		what = "wrong data";
+	}
+	if (what && (verbose || result.wrong + result.unanswered <= 10))
+		printf("%10.3f ms  %s $%04X bank %d: read $%02X, image has $%02X, %s\n", now_ms(),
+			(c->control & BUS_S4) ? "S5" : "S4", ((c->control & BUS_S4) ? 0xA000 : 0x8000) | c->addr,
+			b, data, want, what);
+}
+
+static const HOST_BUS atari = { next_cycle, end_cycle };
+
+static uint8_t *load(const char *filename, long *size) {
+	FILE *f = fopen(filename, "rb");
+	uint8_t *data;
+	if (!f) return NULL;
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	rewind(f);
+	data = malloc(*size + 1);
+	if (fread(data, 1, *size, f) != (size_t)*size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	return data;
+}
+
+static int read_trace(const char *filename) {
+	long size;
+	uint8_t *data = load(filename, &size);
+	TRACE_HEADER *h = (TRACE_HEADER *)data;
+	if (!data || size < (long)sizeof(TRACE_HEADER) || memcmp(h->magic, "UNOTRACE", 8)
+			|| h->version != TRACE_VERSION
+			|| sizeof(TRACE_HEADER) + (uint64_t)h->count * sizeof(TRACE_ENTRY) > (uint64_t)size)
+		return 0;
+	trace = (TRACE_ENTRY *)(data + sizeof(TRACE_HEADER));
+	traceCount = h->count;
+	traceCpuHz = h->cpuHz ? h->cpuHz : 168000000;
+	return 1;
+}
+
+// the image as the cart should have it
+static int read_image(char *path) {
+	FIL fil;
+	UINT br;
+	int ok;
+	if (f_open(&fil, path, FA_READ) != FR_OK) return 0;
+	if (f_size(&fil) & 0x1FFF)
+		f_lseek(&fil, 16);	// .CAR header
+	ok = f_read(&fil, image, sizeof(image), &br) == FR_OK && br == (UINT)banks * BANK_SIZE;
+	f_close(&fil);
+	return ok;
+}
+
+// the file as the cart left it on the card, against what the game wrote
+static int check_saved(char *path) {
+	static uint8_t data[FLASH_SIZE];
+	uint8_t head[16];
+	FIL fil;
+	UINT br;
+	if (f_open(&fil, path, FA_READ) != FR_OK) return 0;
+	int ok = f_read(&fil, head, 16, &br) == FR_OK && br == 16
+		&& f_read(&fil, data, FLASH_SIZE, &br) == FR_OK && br == FLASH_SIZE;
+	f_close(&fil);
+	if (!ok) {
+		printf("can't read %s back\n", path);
+		return 0;
+	}
+	uint32_t sum = 0, headSum = (uint32_t)head[8] << 24 | head[9] << 16 | head[10] << 8 | head[11];
+	int diffs = 0, first = -1;
+	for (int i = 0; i < FLASH_SIZE; i++) {
+		sum += chip[i];
+		if (data[i] != chip[i] && !diffs++) first = i;
+	}
+	if (diffs)
+		printf("the file differs from the flash in %d bytes, the first at $%05X\n", diffs, first);
+	else
+		printf("the file holds what the game wrote to the flash\n");
+	printf("header checksum %08X, %s\n", headSum, headSum == sum ? "right" : "wrong");
+	return !diffs && headSum == sum;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: bussim [options] <card image> <cart>\n"
+		"  -m MODEL  card timing model (default uno)\n"
+		"  -t FILE   play the accesses in a bus trace (UNOTRACE.BIN)\n"
+		"  -b MS     made-up game: time it runs from the fixed bank first (default 0)\n"
+		"  -s N      made-up game: switch banks once in N cart cycles (default 2000)\n"
+		"  -i PCT    made-up game: cycles that aren't for the cart (default 30)\n"
+		"  -d MS     made-up game: run for this long (default 1500)\n"
+		"  -r SEED   made-up game: random seed (default 1)\n"
+		"  -n N      flash cart: times the game saves (default 4)\n"
+		"  -k N      flash cart: bytes it programs each time (default 256)\n"
+		"  -w        open the card image for writing, needed for flash carts\n"
+		"  -p        PAL, 1.77MHz (default NTSC, 1.79MHz)\n"
+		"  -v        list every bad read, and the flash cart's saves\n"
+		"models:\n");
+	for (const HOSTDISK_MODEL *m = hostdisk_models; m->name; m++)
+		fprintf(stderr, "  %-8s %s\n", m->name, m->desc);
+	exit(2);
+}
+
+int main(int argc, char *argv[]) {
+	const HOSTDISK_MODEL *model = &hostdisk_models[0];
+	int busHz = NTSC_HZ, writable = 0, c;
+
+	while ((c = getopt(argc, argv, "m:t:b:s:i:d:r:n:k:wpv")) != -1) {
+		switch (c) {
+		case 'm':
+			if (!(model = hostdisk_find_model(optarg))) usage();
+			break;
+		case 't':
+			if (!read_trace(optarg)) {
+				fprintf(stderr, "%s isn't a bus trace\n", optarg);
+				return 1;
+			}
+			break;
+		case 'b': bootMs = atof(optarg); break;
+		case 's': switchEvery = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+		case 'i': idlePct = atoi(optarg); break;
+		case 'd': runMs = atof(optarg); break;
+		case 'r': seed = strtoul(optarg, NULL, 0); break;
+		case 'n': saves = atoi(optarg); break;
+		case 'k':
+			saveBytes = atoi(optarg);
+			if (saveBytes < 1 || saveBytes > FLASH_SECTOR_SIZE - 1) usage();
+			break;
+		case 'w': writable = 1; break;
+		case 'p': busHz = PAL_HZ; break;
+		case 'v': verbose = 1; break;
+		default: usage();
+		}
+	}
+	if (optind != argc - 2) usage();
+	if (!hostdisk_open(argv[optind], !writable)) {
+		fprintf(stderr, "can't open %s\n", argv[optind]);
+		return 1;
+	}
+	hostdisk_set_model(model);
+	cycleUs = 1e6 / busHz;
+	init();
+	if (!mount_sd()) {
+		fprintf(stderr, "%s\n", errorBuf);
+		return 1;
+	}
+
+	char *path = argv[optind + 1];
+	hostdisk_reset_stats();
+	int type = load_file(path, NULL);
+	double startMs = hostdisk_stats.simUs / 1000;
+	if (!type) {
+		fprintf(stderr, "%s: %s\n", path, errorBuf);
+		return 1;
+	}
+	if (type == CART_TYPE_XEGS_32K || type == CART_TYPE_SW_XEGS_32K) banks = 4;
+	else if (type == CART_TYPE_XEGS_64K || type == CART_TYPE_SW_XEGS_64K) banks = 8;
+	else if (type == CART_TYPE_XEGS_128K || type == CART_TYPE_SW_XEGS_128K) banks = 16;
+	else if (flash_cart_type(type)) {
+		flashType = type;
+		banks = FLASH_SIZE / BANK_SIZE;
+		if (trace) {
+			fprintf(stderr, "traces are only played to XEGS carts\n");
+			return 1;
+		}
+		if (!writable) {
+			fprintf(stderr, "%s saves to the card image, give -w (and use a copy)\n", path);
+			return 1;
+		}
+	}
+	else {
+		fprintf(stderr, "%s is cart type %d, only XEGS and flash ones are simulated\n", path, type);
+		return 1;
+	}
+
+	// read the image now, the loop's own card time starts from the load's
+	double loadedUs = hostdisk_stats.simUs;
+	if (!read_image(path)) {
+		fprintf(stderr, "can't read %s\n", path);
+		return 1;
+	}
+	hostdisk_reset_stats();
+	hostdisk_stats.simUs = loadedUs;
+
+	if (flashType) {
+		memcpy(chip, image, FLASH_SIZE);
+		printf("%s: %s, flash cart, %s\n", path, cart_type_tag(type, META_OK),
+			flash.blocks ? "saved to the file" : "can't be saved");
+		if (flashType == CART_TYPE_SIC_128K)
+			push_select(0, 0);
+	}
+	else
+		printf("%s: %s, %d banks\n", path, cart_type_tag(type, META_OK), banks);
+	printf("model %s, %s bus\n", model->name, busHz == PAL_HZ ? "PAL" : "NTSC");
+	printf("cart started after %.1f ms of card time\n", startMs);
+
+	host_bus_attach(&atari);
+	if (!setjmp(finished))
+		emulate_cartridge(type);
+
+	if (flashType) {
+		printf("%d saves: %u bytes programmed, %u erases, %u blocks written back, %u failed\n",
+			game.savesDone, flash.programs, flash.erases, flash.blocksWritten, flash.blocksFailed);
+		if (game.savedMs)
+			printf("all saved %.1f ms after the game's last write to the flash\n", game.savedMs - game.lastWriteMs);
+		else
+			printf("still not saved %.1f ms after the game's last write to the flash\n", now_ms() - game.lastWriteMs);
+		printf("%llu cycles (%.1f ms), %llu cart reads, %llu bank switches\n",
+			(unsigned long long)cycles, now_ms(), (unsigned long long)result.reads,
+			(unsigned long long)result.switches);
+		printf("wrong data: %llu, bad erase status: %llu, not answered: %llu, writes driven: %llu\n",
+			(unsigned long long)result.wrong, (unsigned long long)result.badStatus,
+			(unsigned long long)result.unanswered, (unsigned long long)result.drove);
+		int saved = check_saved(path);
+		return result.wrong || result.badStatus || result.unanswered || result.drove || !saved;
+	}
+
+	printf("%llu cycles (%.1f ms), %llu cart reads, %llu bank switches\n",
+		(unsigned long long)cycles, now_ms(), (unsigned long long)result.reads,
+		(unsigned long long)result.switches);
+	printf("wrong data: %llu, not answered: %llu\n",
+		(unsigned long long)result.wrong, (unsigned long long)result.unanswered);
+	return result.wrong || result.unanswered;
+}
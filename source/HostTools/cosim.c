@@ -0,0 +1,600 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * cosim - the Atari and the cart together, from power on
+ *
+ * A 6502 (host6502.c) runs the Atari's OS ROM, and through it the menu,
+ * the soft OS and the XEX loader that the firmware serves, against the
+ * firmware's own command loop and cart emulation (main.c built for the host,
+ * as for bussim) over the cart port in host/stm32f4xx.h, with a card image
+ * and hostdisk's timing model underneath. The Atari runs in a coroutine that
+ * hands the firmware one bus cycle at a time; cycles that go by while the
+ * firmware is off doing a command (by the card model's clock) happen without
+ * the cart, as they do on a real machine.
+ *
+ * Each benchmark powers both on, waits for the menu's first key poll, then
+ * presses the keys a user would to get to a file and times Return to the
+ * file running. See README.md.
+ */
+
+#define _GNU_SOURCE
+
+#include "hostdisk.h"
+#include "host6502.h"
+#include "stm32f4xx.h"
+#include "cartinfo.h"
+#include "ff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <setjmp.h>
+#include <ucontext.h>
+#include <sys/wait.h>
+
+/* in main.c */
+extern int num_dir_entries;
+extern unsigned char cart_ram1[64*1024];
+int firmware_main(void);
+
+/* the start of main.c's DIR_ENTRY */
+typedef struct {
+	char isDir;
+	char filename[13];
+	char long_filename[32];
+	char full_path[194];
+} ENTRY_NAMES;
+#define ENTRY_SIZE		256
+
+#define NTSC_HZ		1789773
+#define PAL_HZ		1773447
+#define LINE_CYCLES	114
+#define SIO_BYTE	932			// cycles to send a byte at 19200 baud
+#define VBLANK_LINE	248
+
+// CONTROL_IN, active low
+#define BUS_S5		0x0002
+#define BUS_S4		0x0004
+#define BUS_CCTL	0x0010
+#define BUS_RW		0x0020
+#define BUS_IDLE	(BUS_S5 | BUS_S4 | BUS_CCTL | BUS_RW)
+
+// OS variables
+#define DOSVEC		0x000A
+#define CH			0x02FC
+#define RUNAD		0x02E0
+
+// CH codes
+#define KEY_DOWN	0x0F		// '=', cursor down in the menu
+#define KEY_RETURN	0x0C
+
+#define CART_CMD_ACTIVATE_CART	0xFF
+
+static const char *osPath = "../Atari/UnoCartOS/os.rom";
+static uint8_t osRom[16384];
+static int pal = 0, verbose = 0;
+static double cycleUs, limitSecs = 60;
+
+/* The machine: an XL/XE with 64k, the OS ROM switched by PORTB bit 0, and
+   as much of ANTIC, GTIA, POKEY and the PIA as the OS and the menu need */
+static struct {
+	M6502 cpu;
+	uint8_t ram[65536];
+	uint8_t portb, ddrb, pactl, pbctl;
+	uint8_t dmactl, nmien, nmist;
+	uint8_t irqen, irqst;	// POKEY, irqst active high
+	int serHeld;			// a byte in SEROUT waiting for the shift register
+	uint64_t serDone;		// when the shift register empties, 0 if it is
+	int wsync;
+	int x, line, lines;
+	uint16_t random;
+	uint64_t cycles;		// since power on
+	uint64_t away;			// of them, with the firmware not listening
+} atari;
+
+// the benchmark
+enum { BOOT, NAV, OPEN, DONE };
+static struct {
+	const char *path;		// to open, NULL to stop at the menu
+	const char *next;		// the part of it still to find
+	int state;
+	int downs, enter;		// keys still to press for the current part
+	int activated;
+	uint64_t menuAt, openAt, activateAt, endAt;
+	HOSTDISK_STATS sdAtOpen;
+	uint64_t awayAtOpen;
+	const char *how, *fail;
+	char failBuf[80];
+	int cmd;				// last command sent, -1 once reported
+	uint64_t cmdAt;
+} run;
+
+static ucontext_t fwContext, atariContext;
+static HOST_BUS_CYCLE busCycle;
+static int busDriven;
+static uint8_t busData;
+static jmp_buf finished;
+
+static double ms(uint64_t cycles) {
+	return cycles * cycleUs / 1000;
+}
+
+static int rd_line(uint16_t pin) {
+	return (GPIOB->ODR & pin) != 0;
+}
+
+static int os_in(void) {
+	return ((atari.portb & atari.ddrb) | ~atari.ddrb) & 1;
+}
+
+// the cart lines an access drives, active low as CONTROL_IN has them
+static uint16_t cart_select(uint16_t addr) {
+	if ((addr & 0xE000) == 0xA000 && rd_line(GPIO_Pin_2)) return BUS_IDLE & ~BUS_S5;
+	if ((addr & 0xE000) == 0x8000 && rd_line(GPIO_Pin_4)) return BUS_IDLE & ~BUS_S4;
+	if ((addr & 0xFF00) == 0xD500) return BUS_IDLE & ~BUS_CCTL;
+	return BUS_IDLE;
+}
+
+static void finish(const char *how) {
+	run.how = how;
+	run.endAt = atari.cycles;
+	run.state = DONE;
+	swapcontext(&atariContext, &fwContext);
+}
+
+static void fail(const char *why) {
+	snprintf(run.failBuf, sizeof run.failBuf, "%s", why);
+	run.fail = run.failBuf;
+	finish(NULL);
+}
+
+static void beam_step(void) {
+	if (++atari.x < LINE_CYCLES) return;
+	atari.x = 0;
+	if (++atari.line == atari.lines) atari.line = 0;
+	if (atari.line == VBLANK_LINE) {
+		atari.nmist |= 0x40;
+		if (atari.nmien & 0x40) atari.cpu.nmi = 1;
+	}
+}
+
+/* POKEY's serial output, for the OS's polls of the SIO bus at power on,
+   which nothing answers. Bit 4 of IRQST is SEROUT being free for the next
+   byte, bit 3 the last one having gone */
+static void pokey_step(void) {
+	if (atari.serDone && atari.cycles >= atari.serDone) {
+		if (atari.serHeld) {
+			atari.serHeld = 0;
+			atari.serDone += SIO_BYTE;
+			atari.irqst |= atari.irqen & 0x10;
+		}
+		else
+			atari.serDone = 0;
+	}
+	atari.cpu.irq = ((atari.irqst | (atari.serDone ? 0 : 0x08)) & atari.irqen) != 0;
+}
+
+static void serout(void) {
+	if (atari.serDone)
+		atari.serHeld = 1;
+	else {
+		atari.serDone = atari.cycles + SIO_BYTE;
+		atari.irqst |= atari.irqen & 0x10;
+	}
+}
+
+/* Cycles ANTIC takes from the CPU on a line: memory refresh, players and
+   missiles, and a GRAPHICS 0 screen's fetches when playfield DMA is on, which
+   is what the menu and the OS's own screen have */
+static int antic_cycles(int line) {
+	int n = 9;
+	if (line >= 8 && line < VBLANK_LINE && (atari.dmactl & 0x0C)) n += 5;
+	if (line >= 24 && line < 216 && (atari.dmactl & 0x03)) n += (line - 24) % 8 ? 40 : 81;
+	return n;
+}
+
+/* One bus cycle, through the cart if the firmware is listening: returns 1
+   with its data in *data if the cart drove the bus */
+static int bus(uint16_t control, uint16_t addr, uint8_t *data) {
+	double start = atari.cycles * cycleUs;
+	beam_step();
+	atari.cycles++;
+	pokey_step();
+	if (start + cycleUs / 2 < hostdisk_stats.simUs) {
+		atari.away++;
+		return 0;
+	}
+	if (run.cmd >= 0) {
+		if (verbose)
+			printf("%10.3f ms  command $%02X, the cart was away %.3f ms\n", ms(run.cmdAt), run.cmd,
+				ms(atari.cycles - 1 - run.cmdAt));
+		run.cmd = -1;
+	}
+	busCycle.control = control;
+	busCycle.addr = addr & 0x1FFF;
+	busCycle.data = *data;
+	busDriven = 0;
+	swapcontext(&atariContext, &fwContext);
+	*data = busData;
+	return busDriven;
+}
+
+// a cycle the CPU doesn't get: ANTIC's, or WSYNC holding it
+static void lost_cycle(void) {
+	uint8_t d = 0;
+	bus(BUS_IDLE, 0, &d);
+}
+
+static void cpu_wait(void) {
+	if (atari.wsync) {
+		atari.wsync = 0;
+		while (atari.x != 105) lost_cycle();
+	}
+	while (atari.x >= 12 && atari.x < 12 + antic_cycles(atari.line))
+		lost_cycle();
+}
+
+static uint8_t io_read(uint16_t addr) {
+	switch (addr & 0xFF00) {
+	case 0xD000:	// GTIA
+		switch (addr & 0x1F) {
+		case 0x10: case 0x11: case 0x12: return 1;			// TRIG0-2
+		case 0x13: return rd_line(GPIO_Pin_2);				// TRIG3, the cart's there
+		case 0x14: return pal ? 0x01 : 0x0F;
+		case 0x1F: return 0x0F;								// CONSOL, nothing held
+		}
+		return 0;
+	case 0xD200:	// POKEY
+		if ((addr & 0x0F) == 0x0A) {
+			atari.random = (atari.random >> 1) ^ (-(atari.random & 1) & 0xB400);
+			return atari.random;
+		}
+		if ((addr & 0x0F) == 0x0E)
+			return ~(atari.irqst | (atari.serDone ? 0 : 0x08));
+		return 0xFF;	// no keys, nothing coming in on the serial bus
+	case 0xD300:	// PIA
+		switch (addr & 3) {
+		case 1: return (atari.pbctl & 4) ? ((atari.portb & atari.ddrb) | ~atari.ddrb) : atari.ddrb;
+		case 2: return atari.pactl & 0x3F;
+		case 3: return atari.pbctl & 0x3F;
+		}
+		return 0xFF;
+	case 0xD400:	// ANTIC
+		if ((addr & 0x0F) == 0x0B) return atari.line >> 1;
+		if ((addr & 0x0F) == 0x0F) return atari.nmist | 0x1F;
+		return 0xFF;
+	}
+	return 0xFF;
+}
+
+static void io_write(uint16_t addr, uint8_t data) {
+	if ((addr & 0xFF00) == 0xD300) {
+		switch (addr & 3) {
+		case 1:
+			if (atari.pbctl & 4) atari.portb = data;
+			else atari.ddrb = data;
+			break;
+		case 2: atari.pactl = data; break;
+		case 3: atari.pbctl = data; break;
+		}
+	}
+	else if ((addr & 0xFF00) == 0xD200) {
+		if ((addr & 0x0F) == 0x0D) serout();
+		else if ((addr & 0x0F) == 0x0E) {
+			atari.irqen = data;
+			atari.irqst &= data;
+		}
+		pokey_step();
+	}
+	else if ((addr & 0xFF00) == 0xD400) {
+		switch (addr & 0x0F) {
+		case 0x00: atari.dmactl = data; break;
+		case 0x0A: atari.wsync = 1; break;
+		case 0x0E: atari.nmien = data; break;
+		case 0x0F: atari.nmist = 0; break;
+		}
+	}
+}
+
+// memory as the CPU sees it without a bus cycle, for looking ahead
+static uint8_t peek(uint16_t addr) {
+	if (addr >= 0xD000 && addr < 0xD800) return 0;
+	if (addr >= 0xC000 && os_in()) return osRom[addr - 0xC000];
+	return atari.ram[addr];
+}
+
+static const ENTRY_NAMES *entry(int n) {
+	return (const ENTRY_NAMES *)&cart_ram1[n * ENTRY_SIZE];
+}
+
+static int name_matches(const ENTRY_NAMES *e, const char *name, int len) {
+	int longLen = strlen(e->long_filename);
+	if (longLen == len && !strncasecmp(e->long_filename, name, len)) return 1;
+	// the menu only has the start of a long name
+	if (longLen == sizeof(e->long_filename) - 1 && len > longLen && !strncasecmp(e->long_filename, name, longLen))
+		return 1;
+	return (int)strlen(e->filename) == len && !strncasecmp(e->filename, name, len);
+}
+
+/* The menu's looking for a key, with the listing for the current folder up.
+   Keys go straight into CH, just before the menu reads it */
+static void menu_poll(void) {
+	if (run.state == BOOT) {
+		run.menuAt = atari.cycles;
+		if (verbose) printf("%10.3f ms  menu up\n", ms(run.menuAt));
+		if (!run.path) {
+			finish("menu up");
+			return;
+		}
+		run.state = NAV;
+		run.next = run.path;
+	}
+	if (run.state == OPEN && !run.activated)
+		fail("back at the menu, it wouldn't load");
+	if (run.state != NAV || atari.ram[CH] != 0xFF)
+		return;
+	if (!run.downs && !run.enter) {
+		while (*run.next == '/') run.next++;
+		int len = strcspn(run.next, "/"), n;
+		for (n = 0; n < num_dir_entries && !name_matches(entry(n), run.next, len); n++) ;
+		if (n == num_dir_entries) {
+			char why[80];
+			snprintf(why, sizeof why, "%.*s isn't in the menu's listing", len, run.next);
+			fail(why);
+		}
+		run.next += len;
+		run.downs = n;
+		run.enter = 1;
+	}
+	if (run.downs) {
+		run.downs--;
+		atari.ram[CH] = KEY_DOWN;
+		return;
+	}
+	run.enter = 0;
+	atari.ram[CH] = KEY_RETURN;
+	while (*run.next == '/') run.next++;
+	if (!*run.next) {
+		run.state = OPEN;
+		run.openAt = atari.cycles;
+		run.sdAtOpen = hostdisk_stats;
+		run.awayAtOpen = atari.away;
+		if (verbose) printf("%10.3f ms  Return on %s\n", ms(run.openAt), run.path);
+	}
+}
+
+static uint8_t cpu_read(M6502 *c, uint16_t addr) {
+	uint16_t control = cart_select(addr);
+	uint8_t data = 0;
+	cpu_wait();
+	// the menu's GetKey is LDX CH
+	if (addr == CH && control == BUS_IDLE && (c->pc & 0xE000) == 0xA000 && rd_line(GPIO_Pin_2))
+		menu_poll();
+	int driven = bus(control, addr, &data);
+	if (control != BUS_IDLE)
+		return driven ? data : 0xFF;
+	if (addr >= 0xD000 && addr < 0xD800) return io_read(addr);
+	return peek(addr);
+}
+
+static void cpu_write(M6502 *c, uint16_t addr, uint8_t data) {
+	uint16_t control = cart_select(addr);
+	uint8_t out = data;
+	cpu_wait();
+	bus(control & ~BUS_RW, addr, &out);
+	if (addr == 0xD5DF) {
+		run.cmd = data;
+		run.cmdAt = atari.cycles;
+		if (run.state == OPEN && data == CART_CMD_ACTIVATE_CART && !run.activated) {
+			run.activated = 1;
+			run.activateAt = atari.cycles;
+		}
+	}
+	if (control != BUS_IDLE) return;	// the cart's, or nobody's
+	if (addr >= 0xD000 && addr < 0xD800) io_write(addr, data);
+	else if (addr < 0xC000 || !os_in()) atari.ram[addr] = data;
+}
+
+// the coroutine
+static void atari_main(void) {
+	uint64_t limit = (uint64_t)(limitSecs * 1e6 / cycleUs);
+	m6502_reset(&atari.cpu);
+	while (1) {
+		uint16_t pc = atari.cpu.pc;
+		if (run.state == OPEN && run.activated) {
+			if (cart_select(pc) != BUS_IDLE && (pc & 0xFF00) != 0xD500)
+				finish("cart code running");
+			else if (peek(pc) == 0x6C) {
+				uint16_t v = peek(pc + 1) | peek(pc + 2) << 8;
+				if (v == RUNAD) finish("XEX run address");
+				else if (v == DOSVEC) finish("DOSVEC");
+			}
+		}
+		if (atari.cycles > limit)
+			fail("timed out");
+		if (!m6502_step(&atari.cpu)) {
+			char why[80];
+			snprintf(why, sizeof why, "opcode $%02X at $%04X", peek(pc), pc);
+			fail(why);
+		}
+	}
+}
+
+static void next_cycle(HOST_BUS_CYCLE *c) {
+	swapcontext(&fwContext, &atariContext);
+	if (run.state == DONE)
+		longjmp(finished, 1);
+	*c = busCycle;
+}
+
+static void end_cycle(const HOST_BUS_CYCLE *c, int driven, uint8_t data) {
+	double t = atari.cycles * cycleUs;
+	busDriven = driven;
+	busData = data;
+	if (hostdisk_stats.simUs < t)
+		hostdisk_stats.simUs = t;
+}
+
+static const HOST_BUS port = { next_cycle, end_cycle };
+
+// one benchmark, in a process of its own as the firmware can't be restarted
+static int bench(const char *path) {
+	static char stack[256*1024];
+
+	memset(&atari, 0, sizeof(atari));
+	memset(&run, 0, sizeof(run));
+	atari.lines = pal ? 312 : 262;
+	atari.random = 0xACE1;
+	atari.cpu.read = cpu_read;
+	atari.cpu.write = cpu_write;
+	run.path = path;
+	run.cmd = -1;
+	hostdisk_reset_stats();
+
+	getcontext(&atariContext);
+	atariContext.uc_stack.ss_sp = stack;
+	atariContext.uc_stack.ss_size = sizeof stack;
+	atariContext.uc_link = NULL;
+	makecontext(&atariContext, atari_main, 0);
+	host_bus_attach(&port);
+	if (!setjmp(finished))
+		firmware_main();
+
+	if (run.fail) {
+		printf("%-28s %s after %.1f ms\n", path ? path : "power on", run.fail, ms(run.endAt));
+		return 1;
+	}
+	if (!path) {
+		printf("%-28s %-18s %9llu cycles %9.1f ms  %llu sectors read, cart away %.0f%%\n",
+			"power on", run.how, (unsigned long long)run.menuAt, ms(run.menuAt),
+			(unsigned long long)hostdisk_stats.sectorsRead, 100.0 * atari.away / run.menuAt);
+		return 0;
+	}
+	uint64_t took = run.endAt - run.openAt;
+	printf("%-28s %-18s %9llu cycles %9.1f ms  %llu sectors read, cart away %.0f%%\n",
+		path, run.how, (unsigned long long)took, ms(took),
+		(unsigned long long)(hostdisk_stats.sectorsRead - run.sdAtOpen.sectorsRead),
+		100.0 * (atari.away - run.awayAtOpen) / took);
+	if (verbose)
+		printf("%10.3f ms  cart activated\n%10.3f ms  %s\n", ms(run.activateAt), ms(run.endAt), run.how);
+	return 0;
+}
+
+// the first file of a kind in the root folder, as the standard set
+static int find_file(int kind, char *found, int size) {
+	FATFS fs;
+	DIR dir;
+	FILINFO fi;
+	char lfn[_MAX_LFN + 1];
+	int ret = 0;
+	fi.lfname = lfn;
+	fi.lfsize = sizeof lfn;
+	if (f_mount(&fs, "", 1) != FR_OK) return 0;
+	if (f_opendir(&dir, "") == FR_OK) {
+		while (!ret && f_readdir(&dir, &fi) == FR_OK && fi.fname[0]) {
+			int k = file_kind(fi.fname);
+			if (fi.fattrib & (AM_HID | AM_SYS | AM_DIR)) continue;
+			if (k == kind || (kind == FILE_KIND_CAR && k == FILE_KIND_ROM)) {
+				snprintf(found, size, "/%s", lfn[0] ? lfn : fi.fname);
+				ret = 1;
+			}
+		}
+		f_closedir(&dir);
+	}
+	f_mount(NULL, "", 0);
+	return ret;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: cosim [options] <card image> [file ..]\n"
+		"  -m MODEL  card timing model (default uno)\n"
+		"  -o FILE   the Atari's OS ROM, 16k (default %s)\n"
+		"  -d SECS   give up on a benchmark after this long (default 60)\n"
+		"  -p        PAL, 1.77MHz (default NTSC, 1.79MHz)\n"
+		"  -v        list the commands, how long the cart was away for each, and\n"
+		"            when each step happened\n"
+		"Without files, opens the first cart, XEX and ATR in the root folder.\n"
+		"models:\n", osPath);
+	for (const HOSTDISK_MODEL *m = hostdisk_models; m->name; m++)
+		fprintf(stderr, "  %-8s %s\n", m->name, m->desc);
+	exit(2);
+}
+
+int main(int argc, char *argv[]) {
+	const HOSTDISK_MODEL *model = &hostdisk_models[0];
+	char found[3][_MAX_LFN + 2];
+	const char *files[64];
+	int numFiles = 0, failures = 0, c;
+
+	while ((c = getopt(argc, argv, "m:o:d:pv")) != -1) {
+		switch (c) {
+		case 'm':
+			if (!(model = hostdisk_find_model(optarg))) usage();
+			break;
+		case 'o': osPath = optarg; break;
+		case 'd': limitSecs = atof(optarg); break;
+		case 'p': pal = 1; break;
+		case 'v': verbose = 1; break;
+		default: usage();
+		}
+	}
+	if (optind >= argc || argc - optind - 1 > 64) usage();
+
+	FILE *f = fopen(osPath, "rb");
+	if (!f || fread(osRom, 1, sizeof osRom, f) != sizeof osRom) {
+		fprintf(stderr, "can't read a 16k OS ROM from %s\n", osPath);
+		return 1;
+	}
+	fclose(f);
+	// mount_atr opens the ATR for writing, as the cart does, so the image is
+	// opened read/write if it can be
+	char *image = argv[optind];
+	if (!hostdisk_open(image, 0) && !hostdisk_open(image, 1)) {
+		fprintf(stderr, "can't open %s\n", image);
+		return 1;
+	}
+	hostdisk_set_model(model);
+	cycleUs = 1e6 / (pal ? PAL_HZ : NTSC_HZ);
+
+	for (int i = optind + 1; i < argc; i++)
+		files[numFiles++] = argv[i];
+	if (!numFiles) {
+		static const int kinds[3] = { FILE_KIND_CAR, FILE_KIND_XEX, FILE_KIND_ATR };
+		for (int k = 0; k < 3; k++)
+			if (find_file(kinds[k], found[k], sizeof found[k]))
+				files[numFiles++] = found[k];
+	}
+
+	printf("model %s, %s, OS %s\n", model->name, pal ? "PAL" : "NTSC", osPath);
+	printf("%-28s %-18s %16s %12s\n", "benchmark", "until", "Atari", "time");
+	for (int i = -1; i < numFiles; i++) {
+		int status;
+		fflush(stdout);
+		pid_t pid = fork();
+		if (pid == 0)
+			exit(bench(i < 0 ? NULL : files[i]));
+		if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+			failures++;
+	}
+	hostdisk_close();
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,13 @@
+/*
+ * Host build replacement for src/defines.h, for the FatFs library sources.
+ * (main.c gets src/defines.h from its own directory, which is harmless.)
+ */
+#ifndef TM_DEFINES_H
+#define TM_DEFINES_H
+
+#include <stdint.h>
+
+/* No SPI/SDIO card driver on the host, drive 0 is provided by hostdisk.c */
+#define FATFS_USE_SDIO			2
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * Host build stand-in for the SPI SD card driver. The card is always ready,
+ * drive 0 is provided by ../hostdisk.c.
+ */
+#ifndef HOST_FATFS_SD_H
+#define HOST_FATFS_SD_H
+
+#include "diskio.h"
+#include <stdint.h>
+
+void TM_FATFS_SD_BgInitStart(void);
+uint8_t TM_FATFS_SD_BgInitStep(void);
+uint8_t TM_FATFS_SD_BgInitReady(void);
+
+void TM_FATFS_SD_BgWriteStart(DWORD sector, const BYTE *buff);
+uint8_t TM_FATFS_SD_BgWriteStep(void);
+uint8_t TM_FATFS_SD_BgWriteOk(void);
+
+#endif
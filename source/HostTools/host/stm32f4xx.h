@@ -0,0 +1,123 @@
+/*
+ * Host build stand-in for the CMSIS/StdPeriph device header: just enough
+ * of the registers and driver calls used by main.c for it to compile and
+ * run on a PC. Implemented in ../hoststm32.c.
+ */
+#ifndef HOST_STM32F4XX_H
+#define HOST_STM32F4XX_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#define UNOCART_HOST	1
+
+/* newlib has stricmp, glibc doesn't */
+#define stricmp strcasecmp
+
+typedef enum { DISABLE = 0, ENABLE = !DISABLE } FunctionalState;
+
+typedef struct {
+	volatile uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR;
+	volatile uint16_t BSRRL, BSRRH;
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef host_gpio[5];
+#define GPIOA	(&host_gpio[0])
+#define GPIOB	(&host_gpio[1])
+#define GPIOC	(&host_gpio[2])
+#define GPIOD	(&host_gpio[3])
+#define GPIOE	(&host_gpio[4])
+
+#define GPIO_Pin_0		0x0001
+#define GPIO_Pin_1		0x0002
+#define GPIO_Pin_2		0x0004
+#define GPIO_Pin_3		0x0008
+#define GPIO_Pin_4		0x0010
+#define GPIO_Pin_5		0x0020
+#define GPIO_Pin_6		0x0040
+#define GPIO_Pin_7		0x0080
+#define GPIO_Pin_8		0x0100
+#define GPIO_Pin_9		0x0200
+#define GPIO_Pin_10		0x0400
+#define GPIO_Pin_11		0x0800
+#define GPIO_Pin_12		0x1000
+#define GPIO_Pin_13		0x2000
+#define GPIO_Pin_14		0x4000
+#define GPIO_Pin_15		0x8000
+
+typedef enum { GPIO_Mode_IN, GPIO_Mode_OUT, GPIO_Mode_AF, GPIO_Mode_AN } GPIOMode_TypeDef;
+typedef enum { GPIO_OType_PP, GPIO_OType_OD } GPIOOType_TypeDef;
+typedef enum { GPIO_Speed_2MHz, GPIO_Speed_25MHz, GPIO_Speed_50MHz, GPIO_Speed_100MHz } GPIOSpeed_TypeDef;
+typedef enum { GPIO_PuPd_NOPULL, GPIO_PuPd_UP, GPIO_PuPd_DOWN } GPIOPuPd_TypeDef;
+
+typedef struct {
+	uint32_t GPIO_Pin;
+	GPIOMode_TypeDef GPIO_Mode;
+	GPIOSpeed_TypeDef GPIO_Speed;
+	GPIOOType_TypeDef GPIO_OType;
+	GPIOPuPd_TypeDef GPIO_PuPd;
+} GPIO_InitTypeDef;
+
+void GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *init);
+
+#define RCC_AHB1Periph_GPIOA	0x00000001
+#define RCC_AHB1Periph_GPIOB	0x00000002
+#define RCC_AHB1Periph_GPIOC	0x00000004
+#define RCC_AHB1Periph_GPIOD	0x00000008
+#define RCC_AHB1Periph_GPIOE	0x00000010
+#define RCC_AHB1Periph_CRC		0x00001000
+void RCC_AHB1PeriphClockCmd(uint32_t periph, FunctionalState state);
+
+void CRC_ResetDR(void);
+uint32_t CRC_CalcBlockCRC(uint32_t pBuffer[], uint32_t BufferLength);
+uint32_t CRC_GetCRC(void);
+
+/* The cycle counter follows the simulated time of the SD card model, so
+   time budgets in the firmware behave as they would on the cart */
+typedef struct {
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+} DWT_Type;
+DWT_Type *host_dwt(void);
+#define DWT		(host_dwt())
+#define DWT_CTRL_CYCCNTENA_Msk	1
+
+typedef struct {
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+extern CoreDebug_Type host_coredebug;
+#define CoreDebug	(&host_coredebug)
+#define CoreDebug_DEMCR_TRCENA_Msk	(1UL << 24)
+
+extern uint32_t SystemCoreClock;
+
+#define __disable_irq()
+#define __enable_irq()
+
+/* The cart port, for running the emulation loops against the Atari that
+   HostTools/bussim or cosim plays (main.c reads the lines through these on
+   the host). Reading the control lines is what moves the bus on: a read
+   while phi2 is low starts the Atari's next cycle, the second one after
+   that ends it. */
+typedef struct {
+	uint16_t control;		// S5, S4, CCTL and RW as CONTROL_IN has them, active low
+	uint16_t addr;			// A0-A12
+	uint8_t data;			// the Atari's, for a write
+} HOST_BUS_CYCLE;
+
+typedef struct {
+	void (*next)(HOST_BUS_CYCLE *cycle);	// doesn't return at the end of the run
+	// the cycle is over, driven if the cart put data on the bus
+	void (*end)(const HOST_BUS_CYCLE *cycle, int driven, uint8_t data);
+} HOST_BUS;
+
+void host_bus_attach(const HOST_BUS *atari);
+uint16_t host_bus_control(void);
+uint16_t host_bus_addr(void);
+uint16_t host_bus_data(void);
+extern uint16_t host_bus_out;
+// RD4 (GPIO_Pin_4) and RD5 (GPIO_Pin_2), kept in GPIOB->ODR as the real port has them
+void host_bus_rd(uint16_t pin, int high);
+
+#endif
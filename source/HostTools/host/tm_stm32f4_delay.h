@@ -0,0 +1,9 @@
+/*
+ * Host build stand-in for the TM delay library.
+ */
+#ifndef HOST_TM_STM32F4_DELAY_H
+#define HOST_TM_STM32F4_DELAY_H
+
+void TM_DELAY_Init(void);
+
+#endif
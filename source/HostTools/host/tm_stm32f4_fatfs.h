@@ -0,0 +1,15 @@
+/*
+ * Host build stand-in for the TM FatFs wrapper header.
+ */
+#ifndef HOST_TM_STM32F4_FATFS_H
+#define HOST_TM_STM32F4_FATFS_H
+
+#include "stm32f4xx.h"
+#include "defines.h"
+#include "ff.h"
+#include "diskio.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#endif
@@ -0,0 +1,350 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "host6502.h"
+
+#define RD(a)		c->read(c, (a))
+#define WR(a, d)	c->write(c, (a), (d))
+
+// addressing modes
+enum { IMM, ZP, ZPX, ZPY, ABS, ABX, ABY, IZX, IZY, ACC, BAD };
+
+static void nz(M6502 *c, uint8_t v) {
+	c->p = (c->p & ~(M6502_N | M6502_Z)) | (v & M6502_N) | (v ? 0 : M6502_Z);
+}
+
+static void push(M6502 *c, uint8_t v) {
+	WR(0x100 | c->s, v);
+	c->s--;
+}
+
+static uint8_t pull(M6502 *c) {
+	c->s++;
+	return RD(0x100 | c->s);
+}
+
+// B and bit 5 only exist on the stack
+static void set_p(M6502 *c, uint8_t v) {
+	c->p = (v & ~M6502_B) | 0x20;
+}
+
+/* The address the instruction works on, after its operand cycles. Indexing
+   that crosses a page costs a read of the wrong address while the high byte
+   is fixed, and stores and read-modify-writes always take that cycle */
+static uint16_t operand(M6502 *c, int mode, int store) {
+	uint16_t base, a;
+	uint8_t z;
+	switch (mode) {
+	case IMM:
+		return c->pc++;
+	case ZP:
+		return RD(c->pc++);
+	case ZPX:
+	case ZPY:
+		z = RD(c->pc++);
+		RD(z);
+		return (uint8_t)(z + (mode == ZPX ? c->x : c->y));
+	case ABS:
+		a = RD(c->pc++);
+		return a | RD(c->pc++) << 8;
+	case ABX:
+	case ABY:
+		base = RD(c->pc++);
+		base |= RD(c->pc++) << 8;
+		a = base + (mode == ABX ? c->x : c->y);
+		if (store || ((a ^ base) & 0xFF00))
+			RD((base & 0xFF00) | (a & 0xFF));
+		return a;
+	case IZX:
+		z = RD(c->pc++);
+		RD(z);
+		z += c->x;
+		a = RD(z);
+		return a | RD((uint8_t)(z + 1)) << 8;
+	default:	// IZY
+		z = RD(c->pc++);
+		base = RD(z);
+		base |= RD((uint8_t)(z + 1)) << 8;
+		a = base + c->y;
+		if (store || ((a ^ base) & 0xFF00))
+			RD((base & 0xFF00) | (a & 0xFF));
+		return a;
+	}
+}
+
+static void adc(M6502 *c, uint8_t v) {
+	unsigned carry = c->p & M6502_C, bin = c->a + v + carry;
+	if (c->p & M6502_D) {
+		// Z comes from the binary sum, N and V from the high digit before it's adjusted
+		unsigned lo = (c->a & 0x0F) + (v & 0x0F) + carry, hi;
+		if (lo > 9) lo += 6;
+		hi = (c->a >> 4) + (v >> 4) + (lo > 0x0F);
+		c->p &= ~(M6502_N | M6502_V | M6502_Z | M6502_C);
+		if (!(bin & 0xFF)) c->p |= M6502_Z;
+		if (hi & 8) c->p |= M6502_N;
+		if (~(c->a ^ v) & (c->a ^ (hi << 4)) & 0x80) c->p |= M6502_V;
+		if (hi > 9) hi += 6;
+		if (hi > 0x0F) c->p |= M6502_C;
+		c->a = (hi << 4) | (lo & 0x0F);
+		return;
+	}
+	c->p &= ~(M6502_V | M6502_C);
+	if (~(c->a ^ v) & (c->a ^ bin) & 0x80) c->p |= M6502_V;
+	if (bin > 0xFF) c->p |= M6502_C;
+	c->a = bin;
+	nz(c, c->a);
+}
+
+static void sbc(M6502 *c, uint8_t v) {
+	unsigned borrow = !(c->p & M6502_C), bin = c->a - v - borrow;
+	uint8_t r = bin;
+	// the flags are the binary ones in decimal mode too
+	c->p &= ~(M6502_V | M6502_C);
+	if ((c->a ^ v) & (c->a ^ bin) & 0x80) c->p |= M6502_V;
+	if (bin < 0x100) c->p |= M6502_C;
+	if (c->p & M6502_D) {
+		int lo = (c->a & 0x0F) - (v & 0x0F) - (int)borrow, hi = (c->a >> 4) - (v >> 4);
+		if (lo < 0) { lo -= 6; hi--; }
+		if (hi < 0) hi -= 6;
+		r = (hi << 4) | (lo & 0x0F);
+	}
+	nz(c, bin);
+	c->a = r;
+}
+
+static void cmp(M6502 *c, uint8_t r, uint8_t v) {
+	c->p = (c->p & ~M6502_C) | (r >= v ? M6502_C : 0);
+	nz(c, r - v);
+}
+
+// ASL, ROL, LSR, ROR
+static uint8_t shift(M6502 *c, int aaa, uint8_t v) {
+	uint8_t carry = c->p & M6502_C;
+	if (aaa < 2) {
+		c->p = (c->p & ~M6502_C) | (v >> 7);
+		v = (v << 1) | (aaa == 1 ? carry : 0);
+	}
+	else {
+		c->p = (c->p & ~M6502_C) | (v & 1);
+		v = (v >> 1) | (aaa == 3 ? carry << 7 : 0);
+	}
+	nz(c, v);
+	return v;
+}
+
+static void branch(M6502 *c, int taken) {
+	int8_t off = RD(c->pc++);
+	if (!taken) return;
+	uint16_t to = c->pc + off;
+	RD(c->pc);
+	if ((to ^ c->pc) & 0xFF00)
+		RD((c->pc & 0xFF00) | (to & 0xFF));
+	c->pc = to;
+}
+
+static void interrupt(M6502 *c, uint16_t vector, int brk) {
+	uint16_t lo;
+	push(c, c->pc >> 8);
+	push(c, c->pc);
+	push(c, c->p | 0x20 | (brk ? M6502_B : 0));
+	c->p |= M6502_I;
+	lo = RD(vector);
+	c->pc = lo | RD(vector + 1) << 8;
+}
+
+void m6502_reset(M6502 *c) {
+	uint16_t lo;
+	c->a = c->x = c->y = 0;
+	c->s = 0xFD;
+	c->p = 0x20 | M6502_I;
+	c->nmi = c->irq = c->sync = 0;
+	lo = RD(0xFFFC);
+	c->pc = lo | RD(0xFFFD) << 8;
+}
+
+// ORA AND EOR ADC STA LDA CMP SBC, by bbb
+static const uint8_t modes1[8] = { IZX, ZP, IMM, ABS, IZY, ZPX, ABY, ABX };
+// ASL ROL LSR ROR STX LDX DEC INC, and BIT STY LDY CPY CPX
+static const uint8_t modes2[8] = { IMM, ZP, ACC, ABS, BAD, ZPX, BAD, ABX };
+
+int m6502_step(M6502 *c) {
+	uint16_t at = c->pc, a, lo;
+	uint8_t op, v;
+
+	if (c->nmi) {
+		c->nmi = 0;
+		RD(c->pc);
+		RD(c->pc);
+		interrupt(c, 0xFFFA, 0);
+		return 1;
+	}
+	if (c->irq && !(c->p & M6502_I)) {
+		RD(c->pc);
+		RD(c->pc);
+		interrupt(c, 0xFFFE, 0);
+		return 1;
+	}
+	c->sync = 1;
+	op = RD(c->pc++);
+	c->sync = 0;
+
+	if ((op & 0x1F) == 0x10) {
+		// BPL BMI BVC BVS BCC BCS BNE BEQ
+		static const uint8_t flag[4] = { M6502_N, M6502_V, M6502_C, M6502_Z };
+		branch(c, !(c->p & flag[op >> 6]) == !(op & 0x20));
+		return 1;
+	}
+	switch (op) {
+	case 0x00:	// BRK
+		RD(c->pc++);
+		interrupt(c, 0xFFFE, 1);
+		return 1;
+	case 0x20:	// JSR
+		lo = RD(c->pc++);
+		RD(0x100 | c->s);
+		push(c, c->pc >> 8);
+		push(c, c->pc);
+		c->pc = lo | RD(c->pc) << 8;
+		return 1;
+	case 0x40:	// RTI
+		RD(c->pc);
+		RD(0x100 | c->s);
+		set_p(c, pull(c));
+		lo = pull(c);
+		c->pc = lo | pull(c) << 8;
+		return 1;
+	case 0x60:	// RTS
+		RD(c->pc);
+		RD(0x100 | c->s);
+		lo = pull(c);
+		c->pc = lo | pull(c) << 8;
+		RD(c->pc++);
+		return 1;
+	case 0x4C:	// JMP abs
+		lo = RD(c->pc++);
+		c->pc = lo | RD(c->pc) << 8;
+		return 1;
+	case 0x6C:	// JMP (ind), which doesn't carry into the high byte
+		a = operand(c, ABS, 0);
+		lo = RD(a);
+		c->pc = lo | RD((a & 0xFF00) | ((a + 1) & 0xFF)) << 8;
+		return 1;
+	case 0x08: RD(c->pc); push(c, c->p | 0x20 | M6502_B); return 1;	// PHP
+	case 0x48: RD(c->pc); push(c, c->a); return 1;						// PHA
+	case 0x28: RD(c->pc); RD(0x100 | c->s); set_p(c, pull(c)); return 1;	// PLP
+	case 0x68: RD(c->pc); RD(0x100 | c->s); c->a = pull(c); nz(c, c->a); return 1;	// PLA
+	}
+
+	// the rest of the one byte instructions read the next byte and drop it
+	switch (op) {
+	case 0x18: RD(c->pc); c->p &= ~M6502_C; return 1;
+	case 0x38: RD(c->pc); c->p |= M6502_C; return 1;
+	case 0x58: RD(c->pc); c->p &= ~M6502_I; return 1;
+	case 0x78: RD(c->pc); c->p |= M6502_I; return 1;
+	case 0xB8: RD(c->pc); c->p &= ~M6502_V; return 1;
+	case 0xD8: RD(c->pc); c->p &= ~M6502_D; return 1;
+	case 0xF8: RD(c->pc); c->p |= M6502_D; return 1;
+	case 0x88: RD(c->pc); nz(c, --c->y); return 1;
+	case 0xC8: RD(c->pc); nz(c, ++c->y); return 1;
+	case 0xCA: RD(c->pc); nz(c, --c->x); return 1;
+	case 0xE8: RD(c->pc); nz(c, ++c->x); return 1;
+	case 0xA8: RD(c->pc); nz(c, c->y = c->a); return 1;
+	case 0x98: RD(c->pc); nz(c, c->a = c->y); return 1;
+	case 0xAA: RD(c->pc); nz(c, c->x = c->a); return 1;
+	case 0x8A: RD(c->pc); nz(c, c->a = c->x); return 1;
+	case 0xBA: RD(c->pc); nz(c, c->x = c->s); return 1;
+	case 0x9A: RD(c->pc); c->s = c->x; return 1;
+	case 0xEA: RD(c->pc); return 1;
+	}
+
+	int aaa = op >> 5, bbb = (op >> 2) & 7, mode;
+	switch (op & 3) {
+	case 1:
+		mode = modes1[bbb];
+		if (op == 0x89) break;		// STA #
+		if (aaa == 4) {
+			WR(operand(c, mode, 1), c->a);
+			return 1;
+		}
+		v = RD(operand(c, mode, 0));
+		switch (aaa) {
+		case 0: nz(c, c->a |= v); break;
+		case 1: nz(c, c->a &= v); break;
+		case 2: nz(c, c->a ^= v); break;
+		case 3: adc(c, v); break;
+		case 5: nz(c, c->a = v); break;
+		case 6: cmp(c, c->a, v); break;
+		case 7: sbc(c, v); break;
+		}
+		return 1;
+
+	case 2:
+		mode = modes2[bbb];
+		if ((aaa == 4 || aaa == 5) && (mode == ZPX || mode == ABX))
+			mode = mode == ZPX ? ZPY : ABY;		// STX and LDX index by Y
+		if (mode == BAD || (mode == IMM && aaa != 5) || op == 0x9E)
+			break;
+		if (mode == ACC) {
+			RD(c->pc);
+			c->a = shift(c, aaa, c->a);
+			return 1;
+		}
+		if (aaa == 4) {
+			WR(operand(c, mode, 1), c->x);
+			return 1;
+		}
+		if (aaa == 5) {
+			nz(c, c->x = RD(operand(c, mode, 0)));
+			return 1;
+		}
+		// read-modify-write, which writes the old value back first
+		a = operand(c, mode, 1);
+		v = RD(a);
+		WR(a, v);
+		if (aaa < 4) v = shift(c, aaa, v);
+		else nz(c, v += aaa == 6 ? -1 : 1);
+		WR(a, v);
+		return 1;
+
+	case 0:
+		mode = modes2[bbb];
+		// BIT, STY, LDY, CPY and CPX, each with its own set of modes
+		if (!((aaa == 1 && (mode == ZP || mode == ABS))
+				|| (aaa == 4 && (mode == ZP || mode == ABS || mode == ZPX))
+				|| (aaa == 5 && mode != BAD && mode != ACC)
+				|| (aaa >= 6 && (mode == IMM || mode == ZP || mode == ABS))))
+			break;
+		if (aaa == 4) {
+			WR(operand(c, mode, 1), c->y);
+			return 1;
+		}
+		v = RD(operand(c, mode, 0));
+		switch (aaa) {
+		case 1:
+			c->p = (c->p & ~(M6502_N | M6502_V | M6502_Z)) | (v & (M6502_N | M6502_V))
+				| ((v & c->a) ? 0 : M6502_Z);
+			break;
+		case 5: nz(c, c->y = v); break;
+		case 6: cmp(c, c->y, v); break;
+		case 7: cmp(c, c->x, v); break;
+		}
+		return 1;
+	}
+	c->pc = at;
+	return 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * An NMOS 6502 for cosim. Each cycle of an instruction is a call to read
+ * or write, with the address the real chip puts on the bus, dummy reads and
+ * the extra write of a read-modify-write included, since a cart sees them
+ * all. The undocumented opcodes aren't there: m6502_step stops at one.
+ */
+
+#ifndef HOST6502_H
+#define HOST6502_H
+
+#include <stdint.h>
+
+#define M6502_C		0x01
+#define M6502_Z		0x02
+#define M6502_I		0x04
+#define M6502_D		0x08
+#define M6502_B		0x10
+#define M6502_V		0x40
+#define M6502_N		0x80
+
+typedef struct M6502 {
+	uint16_t pc;
+	uint8_t a, x, y, s, p;
+	int nmi;				// an NMI edge, taken before the next instruction
+	int irq;				// the IRQ line, held by whoever's asserting it
+	int sync;				// set while the opcode is fetched
+	uint8_t (*read)(struct M6502 *c, uint16_t addr);
+	void (*write)(struct M6502 *c, uint16_t addr, uint8_t data);
+	void *user;
+} M6502;
+
+// the reset sequence, which reads the vector at $FFFC
+void m6502_reset(M6502 *c);
+/* One instruction, or an interrupt if one is pending. Returns 0 without
+   running anything for an opcode it doesn't know, with pc on it */
+int m6502_step(M6502 *c);
+
+#endif
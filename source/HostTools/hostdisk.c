@@ -0,0 +1,208 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include "hostdisk.h"
+#include "diskio.h"
+#include "ff.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+
+extern DISKIO_LowLevelDriver_t FATFS_LowLevelDrivers[_VOLUMES];
+
+HOSTDISK_STATS hostdisk_stats;
+
+/* Rough figures for typical cards, from the SD physical layer spec limits
+   and measurements of ordinary 2-32GB cards in SPI mode */
+const HOSTDISK_MODEL hostdisk_models[] = {
+	{ "uno",	1312500,	50,	300,	900,	30,	250000, "cart as built: SPI2 at 42MHz/32" },
+	{ "fast",	21000000,	10,	300,	900,	30,	250000, "same card, SPI at 42MHz/2" },
+	{ "slow",	1312500,	50,	1500,	4000,	100, 500000, "old or cheap card at 42MHz/32" },
+	{ "none",	0,			0,	0,		0,		0,	0,		"count I/O only" },
+	{ NULL }
+};
+
+static const HOSTDISK_MODEL *model = &hostdisk_models[0];
+
+static FILE *image = NULL;
+static DWORD imageSectors = 0;
+static int imageReadOnly = 0;
+
+// time to clock n bytes over SPI
+static double spi_us(double bytes) {
+	return model->spiHz ? bytes * 8 * 1000000 / model->spiHz : 0;
+}
+
+static void charge(UINT count, int write) {
+	// command frame + R1, then per block: token, 512 bytes, CRC (+ data response)
+	double us = model->cmdUs + spi_us(8);
+	us += count * ((write ? model->writeBlockUs : model->readBlockUs) + spi_us(512 + 3 + write));
+	if (count > 1) us += model->stopUs + spi_us(8);
+	hostdisk_stats.simUs += us;
+}
+
+const HOSTDISK_MODEL *hostdisk_find_model(const char *name) {
+	for (const HOSTDISK_MODEL *m = hostdisk_models; m->name; m++)
+		if (!strcmp(m->name, name)) return m;
+	return NULL;
+}
+
+void hostdisk_set_model(const HOSTDISK_MODEL *m) {
+	model = m;
+}
+
+const HOSTDISK_MODEL *hostdisk_get_model(void) {
+	return model;
+}
+
+double hostdisk_spi_us(double bytes) {
+	return spi_us(bytes);
+}
+
+int hostdisk_write_raw(const uint8_t *buff, uint32_t sector, uint32_t count) {
+	if (!image || imageReadOnly || sector + count > imageSectors) return 0;
+	return fseeko(image, (off_t)sector * 512, SEEK_SET) == 0
+		&& fwrite(buff, 512, count, image) == count;
+}
+
+void hostdisk_reset_stats(void) {
+	memset(&hostdisk_stats, 0, sizeof(hostdisk_stats));
+}
+
+static DSTATUS host_disk_initialize(void) {
+	hostdisk_stats.inits++;
+	hostdisk_stats.simUs += model->initUs;
+	return image ? 0 : STA_NOINIT | STA_NODISK;
+}
+
+static DSTATUS host_disk_status(void) {
+	if (!image) return STA_NOINIT | STA_NODISK;
+	return imageReadOnly ? STA_PROTECT : 0;
+}
+
+static DRESULT host_disk_read(BYTE *buff, DWORD sector, UINT count) {
+	if (!image) return RES_NOTRDY;
+	if (sector + count > imageSectors) return RES_PARERR;
+	hostdisk_stats.readCmds++;
+	hostdisk_stats.sectorsRead += count;
+	if (count > 1) hostdisk_stats.multiReads++;
+	charge(count, 0);
+	if (fseeko(image, (off_t)sector * 512, SEEK_SET) != 0
+			|| fread(buff, 512, count, image) != count)
+		return RES_ERROR;
+	return RES_OK;
+}
+
+static DRESULT host_disk_write(const BYTE *buff, DWORD sector, UINT count) {
+	if (!image) return RES_NOTRDY;
+	if (imageReadOnly) return RES_WRPRT;
+	if (sector + count > imageSectors) return RES_PARERR;
+	hostdisk_stats.writeCmds++;
+	hostdisk_stats.sectorsWritten += count;
+	if (count > 1) hostdisk_stats.multiWrites++;
+	charge(count, 1);
+	if (fseeko(image, (off_t)sector * 512, SEEK_SET) != 0
+			|| fwrite(buff, 512, count, image) != count)
+		return RES_ERROR;
+	return RES_OK;
+}
+
+static DRESULT host_disk_ioctl(BYTE cmd, void *buff) {
+	if (!image) return RES_NOTRDY;
+	switch (cmd) {
+	case CTRL_SYNC:
+		hostdisk_stats.syncs++;
+		fflush(image);
+		return RES_OK;
+	case GET_SECTOR_COUNT:
+		*(DWORD *)buff = imageSectors;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD *)buff = 512;
+		return RES_OK;
+	case GET_BLOCK_SIZE:
+		*(DWORD *)buff = 1;
+		return RES_OK;
+	case MMC_GET_TYPE:
+		*(BYTE *)buff = CT_SD2 | CT_BLOCK;
+		return RES_OK;
+	case MMC_GET_CID: {
+		// made up: maker 0, OEM "HD", product "IMAGE", rev 1.0, the size as
+		// the serial number, made 2016/1
+		static const BYTE cid[16] = { 0x00, 'H', 'D', 'I', 'M', 'A', 'G', 'E', 0x10 };
+		memcpy(buff, cid, 16);
+		((BYTE *)buff)[9] = imageSectors >> 24;
+		((BYTE *)buff)[10] = imageSectors >> 16;
+		((BYTE *)buff)[11] = imageSectors >> 8;
+		((BYTE *)buff)[12] = imageSectors;
+		((BYTE *)buff)[13] = 0x01;
+		((BYTE *)buff)[14] = 0x01;
+		return RES_OK;
+	}
+	case MMC_GET_CSD: {
+		// version 2.0, 25MHz, C_SIZE for the image in 512k units
+		DWORD cSize = imageSectors / 1024 ? imageSectors / 1024 - 1 : 0;
+		BYTE *csd = buff;
+		memset(csd, 0, 16);
+		csd[0] = 0x40;
+		csd[3] = 0x32;
+		csd[7] = (cSize >> 16) & 63;
+		csd[8] = cSize >> 8;
+		csd[9] = cSize;
+		return RES_OK;
+	}
+	}
+	return RES_PARERR;
+}
+
+int hostdisk_open(const char *imagePath, int readOnly) {
+	hostdisk_close();
+	image = fopen(imagePath, readOnly ? "rb" : "r+b");
+	if (!image) return 0;
+	fseeko(image, 0, SEEK_END);
+	imageSectors = (DWORD)(ftello(image) / 512);
+	imageReadOnly = readOnly;
+
+	DISKIO_LowLevelDriver_t *drv = &FATFS_LowLevelDrivers[0];
+	drv->disk_initialize = host_disk_initialize;
+	drv->disk_status = host_disk_status;
+	drv->disk_ioctl = host_disk_ioctl;
+	drv->disk_write = host_disk_write;
+	drv->disk_read = host_disk_read;
+	return 1;
+}
+
+void hostdisk_close(void) {
+	if (image) fclose(image);
+	image = NULL;
+}
+
+// overrides the fixed date in diskio.c
+DWORD get_fattime(void) {
+	time_t now = time(NULL);
+	struct tm *t = localtime(&now);
+	return	  ((DWORD)(t->tm_year - 80) << 25)
+			| ((DWORD)(t->tm_mon + 1) << 21)
+			| ((DWORD)t->tm_mday << 16)
+			| ((DWORD)t->tm_hour << 11)
+			| ((DWORD)t->tm_min << 5)
+			| ((DWORD)t->tm_sec >> 1);
+}
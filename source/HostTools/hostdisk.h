@@ -0,0 +1,70 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * FatFs drive 0 backed by an SD card image file, so the firmware's FatFs
+ * can be run on a PC. Every command is charged the time it would take a
+ * card on the cart's SPI bus, according to a simple model.
+ */
+
+#ifndef HOSTDISK_H
+#define HOSTDISK_H
+
+#include <stdint.h>
+
+// open the image and install it as FatFs drive 0. 0 on failure
+int hostdisk_open(const char *imagePath, int readOnly);
+void hostdisk_close(void);
+
+/* Timing of an SD card in SPI mode. Each disk_read/disk_write is one
+   single or multiple block command; the bytes on the bus are charged at
+   the SPI clock and the card's own delays are added on top. */
+typedef struct {
+	const char *name;
+	double spiHz;			// SPI clock
+	double cmdUs;			// command and response, per command
+	double readBlockUs;		// wait for the data token, per block read
+	double writeBlockUs;	// programming (busy) time, per block written
+	double stopUs;			// CMD12 / stop token after a multiple block transfer
+	double initUs;			// disk_initialize
+	const char *desc;
+} HOSTDISK_MODEL;
+
+extern const HOSTDISK_MODEL hostdisk_models[];	// ends with a NULL name
+const HOSTDISK_MODEL *hostdisk_find_model(const char *name);
+void hostdisk_set_model(const HOSTDISK_MODEL *model);
+const HOSTDISK_MODEL *hostdisk_get_model(void);
+// time to clock n bytes over SPI with the model in use
+double hostdisk_spi_us(double bytes);
+// write sectors without counting them or charging any time, for the
+// background writes, which are charged as they go (see hoststm32.c). 0 if
+// the image is read only
+int hostdisk_write_raw(const uint8_t *buff, uint32_t sector, uint32_t count);
+
+typedef struct {
+	uint64_t readCmds, writeCmds;		// disk_read/disk_write calls
+	uint64_t sectorsRead, sectorsWritten;
+	uint64_t multiReads, multiWrites;	// commands for more than one sector
+	uint64_t syncs, inits;
+	double simUs;						// simulated card time
+} HOSTDISK_STATS;
+
+extern HOSTDISK_STATS hostdisk_stats;
+void hostdisk_reset_stats(void);
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The STM32 peripherals main.c touches, for running it on a PC
+ * (see host/stm32f4xx.h). The SD card is already up, so the background
+ * init in fatfs_sd.c has nothing to do. The background write lands in the
+ * image once its time is up, by the card model and hostdisk_stats.simUs,
+ * which bussim moves on a bus cycle at a time.
+ */
+
+#include "stm32f4xx.h"
+#include "tm_stm32f4_delay.h"
+#include "fatfs_sd.h"
+#include "hostdisk.h"
+#include "stackmark.h"
+
+#include <stdio.h>
+#include <string.h>
+
+GPIO_TypeDef host_gpio[5];
+CoreDebug_Type host_coredebug;
+uint32_t SystemCoreClock = 168000000;
+
+static DWT_Type dwt;
+
+DWT_Type *host_dwt(void) {
+	dwt.CYCCNT = (uint32_t)(hostdisk_stats.simUs * (SystemCoreClock / 1000000));
+	return &dwt;
+}
+
+void GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *init) {
+}
+
+void RCC_AHB1PeriphClockCmd(uint32_t periph, FunctionalState state) {
+}
+
+// same as the STM32 CRC unit: CRC-32 polynomial, 32 bit words MSB first,
+// no reflection or final XOR
+static uint32_t crc = 0xFFFFFFFF;
+
+void CRC_ResetDR(void) {
+	crc = 0xFFFFFFFF;
+}
+
+uint32_t CRC_CalcBlockCRC(uint32_t pBuffer[], uint32_t BufferLength) {
+	for (uint32_t i=0; i<BufferLength; i++) {
+		crc ^= pBuffer[i];
+		for (int b=0; b<32; b++)
+			crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+	}
+	return crc;
+}
+
+uint32_t CRC_GetCRC(void) {
+	return crc;
+}
+
+void TM_DELAY_Init(void) {
+}
+
+void TM_FATFS_SD_BgInitStart(void) {
+}
+
+uint8_t TM_FATFS_SD_BgInitStep(void) {
+	return 0;
+}
+
+uint8_t TM_FATFS_SD_BgInitReady(void) {
+	return 1;
+}
+
+/* The background write is done when the command, the block and the card's
+   programming time would have been, and goes to the image then */
+static struct {
+	uint8_t data[512];
+	DWORD sector;
+	double done;
+	int busy, ok;
+} wr;
+
+void TM_FATFS_SD_BgWriteStart(DWORD sector, const BYTE *buff) {
+	const HOSTDISK_MODEL *m = hostdisk_get_model();
+	memcpy(wr.data, buff, 512);
+	wr.sector = sector;
+	wr.done = hostdisk_stats.simUs + m->cmdUs + hostdisk_spi_us(8 + 512 + 4) + m->writeBlockUs
+		+ hostdisk_spi_us(1);
+	wr.busy = 1;
+	wr.ok = 0;
+}
+
+uint8_t TM_FATFS_SD_BgWriteStep(void) {
+	if (!wr.busy)
+		return 0;
+	if (hostdisk_stats.simUs < wr.done)
+		return 1;
+	wr.busy = 0;
+	wr.ok = hostdisk_write_raw(wr.data, wr.sector, 1);
+	if (wr.ok) {
+		hostdisk_stats.writeCmds++;
+		hostdisk_stats.sectorsWritten++;
+	}
+	return 0;
+}
+
+uint8_t TM_FATFS_SD_BgWriteOk(void) {
+	return wr.ok;
+}
+
+/* The cart port: each cycle of the Atari's is asked for when the loop
+   polls the control lines with phi2 low, and ends at the second poll after
+   that. Phi2 stays high for one poll so the standard 8k/16k loops, which
+   only watch S4 and S5, have put their data out by the end */
+static const HOST_BUS *atari;
+static HOST_BUS_CYCLE cycle;
+static int phi2;
+uint16_t host_bus_out;
+
+#define HOST_PHI2		0x0001
+#define HOST_IDLE		0x0036	// S5, S4, CCTL high, RW read
+
+void host_bus_attach(const HOST_BUS *a) {
+	atari = a;
+	phi2 = 0;
+}
+
+uint16_t host_bus_control(void) {
+	if (!atari) {
+		fprintf(stderr, "an emulation loop ran without a bus attached\n");
+		exit(3);
+	}
+	if (!phi2) {
+		atari->next(&cycle);
+		host_bus_out = 0;
+		phi2 = 1;
+		return cycle.control | HOST_PHI2;
+	}
+	if (phi2 == 1) {
+		phi2 = 2;
+		return cycle.control | HOST_PHI2;
+	}
+	atari->end(&cycle, GPIOE->MODER != 0, host_bus_out >> 8);
+	phi2 = 0;
+	return HOST_IDLE;
+}
+
+uint16_t host_bus_addr(void) {
+	return cycle.addr;
+}
+
+uint16_t host_bus_data(void) {
+	return cycle.data << 8;
+}
+
+void host_bus_rd(uint16_t pin, int high) {
+	if (high) GPIOB->ODR |= pin;
+	else GPIOB->ODR &= ~pin;
+}
+
+/* the stack isn't painted on the PC */
+void stack_paint(void) {
+}
+
+uint32_t stack_high_water(void) {
+	return 0;
+}
+
+uint32_t stack_budget(void) {
+	return 0;
+}
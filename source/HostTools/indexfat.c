@@ -0,0 +1,98 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+
+#include "unoindex.h"
+#include "ff.h"
+#include "hostdisk.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static FATFS fs;
+
+int fat_open_image(const char *path, int readOnly) {
+	return hostdisk_open(path, readOnly) && f_mount(&fs, "", 1) == FR_OK;
+}
+
+void fat_close_image(void) {
+	f_mount(NULL, "", 0);
+	hostdisk_close();
+}
+
+// read as much of the file as the scan can use
+static void preload_fat(ENTRY *e) {
+	FIL fil;
+	UINT br;
+	uint32_t len = e->size;
+	if (file_kind(e->name) == FILE_KIND_ATR || file_kind(e->name) == FILE_KIND_CAS
+			|| file_kind(e->name) == FILE_KIND_LZ4) len = 16;
+	else if (len > CART_MAX_IMAGE_SIZE + 16) len = 16;	// too big, the header is enough
+	e->data = malloc(len ? len : 1);
+	if (!e->data || f_open(&fil, e->path, FA_READ) != FR_OK) return;
+	if (f_read(&fil, e->data, len, &br) == FR_OK)
+		e->dataLen = br;
+	f_close(&fil);
+}
+
+void fat_collect(char *path) {
+	static char lfn[_MAX_LFN + 1];
+	FILINFO fno;
+	DIR dir;
+	fno.lfname = lfn;
+	fno.lfsize = sizeof lfn;
+	if (f_opendir(&dir, path) != FR_OK) { fprintf(stderr, "can't read %s\n", path); return; }
+	while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0]) {
+		if (fno.fattrib & (AM_HID | AM_SYS)) continue;
+		char *name = lfn[0] ? lfn : fno.fname;
+		char *sub;
+		if (asprintf(&sub, "%s/%s", path, fno.fname) < 0) continue;
+		if (fno.fattrib & AM_DIR) {
+			ENTRY *e = new_entry();
+			e->isDir = 1;
+			e->name = strdup(name);
+			e->dir = strdup(path);
+			fat_collect(sub);
+			free(sub);
+		}
+		else if (is_valid_file(fno.fname)) {
+			ENTRY *e = new_entry();
+			e->path = sub;
+			e->name = strdup(name);
+			e->dir = strdup(path);
+			e->fatDir = e->dir;
+			e->size = fno.fsize;
+			e->fdate = fno.fdate;
+			e->ftime = fno.ftime;
+			preload_fat(e);
+		}
+		else
+			free(sub);
+	}
+	f_closedir(&dir);
+}
+
+int fat_write_file(const char *path, const void *data, size_t len) {
+	FIL fil;
+	UINT bw;
+	if (f_open(&fil, path, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK)
+		return 0;
+	int ok = f_write(&fil, data, len, &bw) == FR_OK && bw == len;
+	return f_close(&fil) == FR_OK && ok;
+}
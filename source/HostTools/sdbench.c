@@ -0,0 +1,632 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * sdbench - time the firmware's SD card work on a PC
+ *
+ * Links the firmware's own main.c (with its main() renamed) and FatFs
+ * against an SD card image, and runs the things the menu and the SIO
+ * handler do: directory listings, search, loading a 128k cart, booting and
+ * copying an ATR, and the same from inside a .ZIP. Each test reports the simulated card time from the
+ * hostdisk.c model and the block I/O it took, so changes to the firmware or
+ * FatFs settings can be compared without a cart. See README.md.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "hostdisk.h"
+#include "cartinfo.h"
+#include "sdtest.h"
+#include "lz4load.h"
+#include "zipfile.h"
+#include "ff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <time.h>
+
+/* in main.c */
+extern char errorBuf[40];
+extern int num_dir_entries;
+extern int doneFatFsInit;
+extern unsigned char cart_ram1[64*1024];
+extern unsigned char cart_ram2[64*1024];
+extern LZ4_RESULT lz4Result;
+void init();
+int mount_sd();
+int read_directory(char *path);
+int list_directory(char *path, int *cursor);
+int dir_hint_step(char *curPath, int item, uint32_t budget);
+int preload_step(char *curPath, int item, uint32_t budget);
+void dirc_flush(void);
+int search_directory(char *path, char *search);
+int search_key(char *path, uint8_t key, int maxResults);
+int load_file(char *filename, FILE_META *meta);
+int mount_atr(char *filename);
+int read_atr_sector(uint16_t sector, uint8_t page, uint8_t *buf);
+int write_atr_sector(uint16_t sector, uint8_t page, uint8_t *buf);
+void meta_scan_reset();
+int meta_scan_step(char *curPath, int top, uint32_t budget, int *updated);
+extern uint32_t SystemCoreClock;
+
+/* the start of main.c's DIR_ENTRY */
+typedef struct {
+	char isDir;
+	char filename[13];
+	char long_filename[32];
+	char full_path[194];
+	uint8_t cartType;
+	uint8_t metaStatus;
+	uint16_t fdate, ftime;
+	uint32_t size;
+} ENTRY_NAMES;
+#define ENTRY_SIZE		256
+
+static int cold = 0;
+static int repeat = 1;
+static int failures = 0;
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Tests */
+
+static double wallStart;
+
+static void begin(void) {
+	if (cold) {
+		// start from an empty FatFs window, as after a card change
+		doneFatFsInit = 0;
+		mount_sd();
+	}
+	hostdisk_reset_stats();
+	wallStart = now();
+}
+
+static void end(const char *name, const char *detail, int ok) {
+	double wall = (now() - wallStart) * 1e6;
+	HOSTDISK_STATS *s = &hostdisk_stats;
+	if (!ok) failures++;
+	printf("%-10s %10.1f %6llu %5llu %7llu %6llu %7llu %9.0f  %s%s\n", name,
+		s->simUs / 1000,
+		(unsigned long long)s->readCmds, (unsigned long long)s->multiReads,
+		(unsigned long long)s->sectorsRead,
+		(unsigned long long)s->writeCmds, (unsigned long long)s->sectorsWritten,
+		wall, ok ? "" : "FAILED ", detail);
+}
+
+static void test_mount(void) {
+	doneFatFsInit = 0;
+	hostdisk_reset_stats();
+	wallStart = now();
+	int ok = mount_sd();
+	end("mount", ok ? "" : "Can't mount the card", ok);
+}
+
+static void test_list(char *path) {
+	char detail[300];
+	for (int r=0; r<repeat; r++) {
+		begin();
+		int ok = read_directory(path);
+		if (ok) snprintf(detail, sizeof detail, "%s (%d entries)", path[0] ? path : "/", num_dir_entries);
+		else snprintf(detail, sizeof detail, "%s: %s", path[0] ? path : "/", errorBuf);
+		end("list", detail, ok);
+	}
+}
+
+// every directory under path, as if the user opened each one in turn
+static void test_list_tree(char *path, int depth) {
+	test_list(path);
+	if (depth >= 8) return;
+	// read_directory reuses cart_ram1, so take the names first
+	int n = num_dir_entries, numDirs = 0;
+	char (*dirs)[256] = malloc(n * 256);
+	for (int i=0; i<n; i++) {
+		ENTRY_NAMES *e = (ENTRY_NAMES *)&cart_ram1[i * ENTRY_SIZE];
+		if (e->isDir && strlen(path) + 14 < 256) {
+			strcpy(dirs[numDirs], path);
+			strcat(dirs[numDirs], "/");
+			strcat(dirs[numDirs++], e->filename);
+		}
+	}
+	for (int i=0; i<numDirs; i++)
+		test_list_tree(dirs[i], depth + 1);
+	free(dirs);
+}
+
+// the menu coming back to path, which is in the directory cache, then
+// resting on its first folder until that's read ahead, then opening it
+static void test_cached(char *path) {
+	char detail[300], sub[256];
+	int cursor, i, ok, steps = 0;
+
+	dirc_flush();
+	list_directory(path, &cursor);
+	begin();
+	ok = list_directory(path, &cursor);
+	snprintf(detail, sizeof detail, "%s (%d entries)", path[0] ? path : "/", num_dir_entries);
+	end("back", detail, ok);
+	for (i=0; i<num_dir_entries; i++)
+		if (((ENTRY_NAMES *)&cart_ram1[i * ENTRY_SIZE])->isDir) break;
+	if (i == num_dir_entries || strlen(path) + 14 >= 256)
+		return;
+	snprintf(sub, sizeof sub, "%s/%s", path, ((ENTRY_NAMES *)&cart_ram1[i * ENTRY_SIZE])->filename);
+	begin();
+	do steps++;
+	while (!dir_hint_step(path, i, SystemCoreClock / 50));
+	snprintf(detail, sizeof detail, "%s (%d calls)", sub, steps);
+	end("hint", detail, 1);
+	begin();
+	ok = list_directory(sub, &cursor);
+	snprintf(detail, sizeof detail, "%s (%d entries)", sub, num_dir_entries);
+	end("enter", detail, ok);
+}
+
+static void test_search(char *text) {
+	char detail[300];
+	for (int r=0; r<repeat; r++) {
+		begin();
+		int ok = search_directory("", text);
+		if (ok) snprintf(detail, sizeof detail, "\"%s\" (%d found)", text, num_dir_entries);
+		else snprintf(detail, sizeof detail, "\"%s\": %s", text, errorBuf);
+		end("search", detail, ok);
+	}
+}
+
+// the same text typed into the incremental search, a key at a time
+static void test_isearch(char *text) {
+	char detail[300];
+	for (int r=0; r<repeat; r++) {
+		begin();
+		int ok = search_key("", 0, 15);
+		for (char *k=text; ok && *k; k++)
+			ok = search_key("", *k, 15);
+		if (ok) ok = search_key("", 0x9B, 255);
+		if (ok) snprintf(detail, sizeof detail, "\"%s\" (%d found)", text, num_dir_entries);
+		else snprintf(detail, sizeof detail, "\"%s\": %s", text, errorBuf);
+		end("isearch", detail, ok);
+	}
+}
+
+static void test_load(char *path) {
+	char detail[300];
+	for (int r=0; r<repeat; r++) {
+		begin();
+		int type = load_file(path, NULL);
+		if (type) snprintf(detail, sizeof detail, "%s (type %d)", path, type);
+		else snprintf(detail, sizeof detail, "%s: %s", path, errorBuf);
+		end("load", detail, type != CART_TYPE_NONE);
+	}
+}
+
+// the same, after the menu's cursor has rested on it long enough for the
+// part that goes in cart_ram2 to be read ahead
+static void test_preload(char *path) {
+	char detail[300], dir[256];
+	char *name = strrchr(path, '/');
+	int cursor, i, steps = 0;
+
+	snprintf(dir, sizeof dir, "%.*s", (int)(name - path), path);
+	list_directory(dir, &cursor);
+	for (i=0; i<num_dir_entries; i++)
+		if (!strcasecmp(((ENTRY_NAMES *)&cart_ram1[i * ENTRY_SIZE])->filename, name + 1)) break;
+	if (i == num_dir_entries)
+		return;
+	begin();
+	do steps++;
+	while (!preload_step(dir, i, SystemCoreClock / 50));
+	snprintf(detail, sizeof detail, "%s (%d calls)", path, steps);
+	end("preload", detail, 1);
+	begin();
+	int type = load_file(path, NULL);
+	if (type) snprintf(detail, sizeof detail, "%s (type %d)", path, type);
+	else snprintf(detail, sizeof detail, "%s: %s", path, errorBuf);
+	end("open", detail, type != CART_TYPE_NONE);
+}
+
+/* Cortex-M4 cycles to unpack an LZ4 cart, from the counts lz4_load keeps.
+   The card time is already in the model; these are the CPU's share, for
+   -O3 code running from flash at 168MHz: the token and length bytes and
+   the calls for each sequence, memcpy for literals, a byte loop for
+   matches, and the FatFs call for each 4k read. */
+#define M4_CYCLES_SEQUENCE	40
+#define M4_CYCLES_LITERAL	1
+#define M4_CYCLES_MATCH		4
+#define M4_CYCLES_READ		400
+
+static void test_load_lz4(char *path) {
+	char detail[300];
+	for (int r=0; r<repeat; r++) {
+		begin();
+		int type = load_file(path, NULL);
+		LZ4_RESULT *z = &lz4Result;
+		double cycles = (double)z->sequences * M4_CYCLES_SEQUENCE + (double)z->literalBytes * M4_CYCLES_LITERAL
+			+ (double)z->matchBytes * M4_CYCLES_MATCH + (double)(z->inBytes + LZ4_IN_BUF - 1) / LZ4_IN_BUF * M4_CYCLES_READ;
+		uint32_t out = z->literalBytes + z->matchBytes;
+		if (type) snprintf(detail, sizeof detail, "%s (type %d, %u -> %u bytes, unpack %.2f ms at %.1f MB/s)",
+			path, type, z->inBytes, out, cycles / 168e3, out / (cycles / 168e6) / 1e6);
+		else snprintf(detail, sizeof detail, "%s: %s", path, errorBuf);
+		end("load lz4", detail, type != CART_TYPE_NONE);
+	}
+}
+
+static void test_scan(void) {
+	int updated, steps = 0;
+	// the whole root directory, one idle slice at a time as the menu does
+	if (!read_directory("")) return;
+	begin();
+	meta_scan_reset();
+	while (!meta_scan_step("", 0, SystemCoreClock / 50, &updated))
+		steps++;
+	char detail[64];
+	snprintf(detail, sizeof detail, "/ (%d slices)", steps + 1);
+	end("metascan", detail, 1);
+}
+
+// the cart's own SD card self-test, against the image and the timing model
+static void test_selftest(void) {
+	char line[64];
+	begin();
+	int status = sdtest_run(&cart_ram2[0]);
+	end("selftest", SDTEST_FILENAME, status == SDTEST_OK);
+	for (int n = 0; sdtest_line(n, line); n++)
+		printf("    %s\n", line);
+}
+
+/* ATRs - the firmware is asked for 128 byte pages, as the SIO handler does */
+
+typedef struct {
+	int secSize;
+	int numSectors;
+	int bootSectors;
+} ATR_INFO;
+
+static int atr_info(char *path, ATR_INFO *info) {
+	FIL fil;
+	uint8_t hdr[16 + 128];
+	UINT br;
+	if (f_open(&fil, path, FA_READ) != FR_OK) return 0;
+	int ok = f_read(&fil, hdr, sizeof hdr, &br) == FR_OK && br == sizeof hdr
+		&& hdr[0] == 0x96 && hdr[1] == 0x02;
+	if (ok) {
+		info->secSize = hdr[4] | (hdr[5] << 8);
+		if (info->secSize != 256) info->secSize = 128;
+		uint32_t data = f_size(&fil) - 16;
+		info->numSectors = data <= 3*128 ? data / 128 : 3 + (data - 3*128) / info->secSize;
+		info->bootSectors = hdr[16 + 1] ? hdr[16 + 1] : 3;
+	}
+	f_close(&fil);
+	return ok;
+}
+
+static int atr_io(ATR_INFO *info, int sector, int write, uint8_t *buf) {
+	int pages = (sector <= 3 || info->secSize == 128) ? 1 : 2;
+	for (int p=0; p<pages; p++) {
+		int err = write ? write_atr_sector(sector, p, buf + p*128) : read_atr_sector(sector, p, buf + p*128);
+		if (err) return 0;
+	}
+	return 1;
+}
+
+// the boot sectors, then a DOS 2 style VTOC/directory read and a 12k file load
+static void test_atr_boot(char *path, ATR_INFO *info) {
+	uint8_t buf[256];
+	char detail[300];
+	for (int r=0; r<repeat; r++) {
+		begin();
+		int ok = mount_atr(path) == 0, sector;
+		for (sector=1; ok && sector<=info->bootSectors && sector<=info->numSectors; sector++)
+			ok = atr_io(info, sector, 0, buf);
+		for (int s=360; ok && s<=368 && s<=info->numSectors; s++)
+			ok = atr_io(info, s, 0, buf);
+		int fileSectors = 12*1024 / (info->secSize - 3);
+		for (int n=0; ok && n<fileSectors && sector<=info->numSectors; n++, sector++)
+			ok = atr_io(info, sector, 0, buf);
+		snprintf(detail, sizeof detail, "%s (%d byte sectors)", path, info->secSize);
+		end("atr boot", detail, ok);
+	}
+}
+
+// read the whole disk, then write it all back (only if the image is writable)
+static void test_atr_copy(char *path, ATR_INFO *info, int writable) {
+	uint8_t *disk = malloc(info->numSectors * 256);
+	char detail[300];
+	int ok = 1;
+	begin();
+	ok = mount_atr(path) == 0;
+	for (int s=1; ok && s<=info->numSectors; s++)
+		ok = atr_io(info, s, 0, disk + (s-1)*256);
+	snprintf(detail, sizeof detail, "%s (%d sectors)", path, info->numSectors);
+	end("atr read", detail, ok);
+	if (ok && writable) {
+		begin();
+		ok = mount_atr(path) == 0;
+		for (int s=1; ok && s<=info->numSectors; s++)
+			ok = atr_io(info, s, 1, disk + (s-1)*256);
+		end("atr write", detail, ok);
+	}
+	free(disk);
+}
+
+// lines of "R sector" or "W sector", e.g. from an emulator's SIO log
+static void test_trace(char *path, ATR_INFO *info, const char *traceFile, int writable) {
+	FILE *f = fopen(traceFile, "r");
+	if (!f) { fprintf(stderr, "can't open %s\n", traceFile); failures++; return; }
+	uint8_t buf[256];
+	char line[80], detail[300];
+	int ops = 0, skipped = 0;
+	memset(buf, 0, sizeof buf);
+	begin();
+	int ok = mount_atr(path) == 0;
+	while (ok && fgets(line, sizeof line, f)) {
+		char op;
+		int sector;
+		if (sscanf(line, " %c %d", &op, &sector) != 2) continue;
+		if (sector < 1 || sector > info->numSectors || (op != 'R' && op != 'W') || (op == 'W' && !writable)) {
+			skipped++;
+			continue;
+		}
+		ok = atr_io(info, sector, op == 'W', buf);
+		ops++;
+	}
+	fclose(f);
+	snprintf(detail, sizeof detail, "%s (%d ops, %d skipped)", traceFile, ops, skipped);
+	end("trace", detail, ok);
+}
+
+/* .ZIPs */
+
+/* the start of main.c's MountedATR, for the geometry of an ATR that is only
+   in a .ZIP */
+typedef struct {
+	char path[256];
+	uint16_t signature, pars, secSize, parsHigh;
+} MOUNTED_ATR_HEAD;
+extern MOUNTED_ATR_HEAD mountedATRs[1];
+
+static int atr_info_mounted(char *path, ATR_INFO *info) {
+	uint8_t sector1[128];
+	if (mount_atr(path) || read_atr_sector(1, 0, sector1))
+		return 0;
+	MOUNTED_ATR_HEAD *h = &mountedATRs[0];
+	uint32_t data = ((uint32_t)h->parsHigh << 20) | ((uint32_t)h->pars << 4);
+	info->secSize = h->secSize == 256 ? 256 : 128;
+	info->numSectors = data <= 3*128 ? data / 128 : 3 + (data - 3*128) / info->secSize;
+	info->bootSectors = sector1[1] ? sector1[1] : 3;
+	return 1;
+}
+
+// the biggest cart and an ATR in the listing in cart_ram1
+static void zip_pick(char *dir, char *cart, uint32_t *cartSize, char *atr) {
+	for (int i=0; i<num_dir_entries; i++) {
+		ENTRY_NAMES *e = (ENTRY_NAMES *)&cart_ram1[i * ENTRY_SIZE];
+		int kind = file_kind(e->filename);
+		if (e->isDir) continue;
+		if (kind == FILE_KIND_ATR && !atr[0])
+			snprintf(atr, 256, "%.127s/%.127s", dir, e->filename);
+		else if (kind != FILE_KIND_ATR && e->size > *cartSize) {
+			snprintf(cart, 256, "%.127s/%.127s", dir, e->filename);
+			*cartSize = e->size;
+		}
+	}
+}
+
+static void test_zip_list(const char *name, char *path) {
+	char detail[300];
+	errorBuf[0] = 0;
+	begin();
+	int ok = read_directory(path) && !errorBuf[0];
+	if (ok) snprintf(detail, sizeof detail, "%s (%d entries)", path, num_dir_entries);
+	else snprintf(detail, sizeof detail, "%s: %s", path, errorBuf);
+	end(name, detail, ok);
+}
+
+/* The first listing of the archive reads its central directory into the
+   index, later ones only the names in the folder. Then the biggest cart in
+   its top folder or the folders in that, and an ATR, as for the plain
+   files. The inflate speed is the host's, over the whole load */
+static void test_zip(char *zip) {
+	char detail[300], cart[256] = "", atr[256] = "", sub[256];
+	uint32_t cartSize = 0;
+	int i, numDirs;
+	char (*dirs)[256];
+
+	zip_forget();
+	test_zip_list("zip index", zip);
+	test_zip_list("zip list", zip);
+	zip_pick(zip, cart, &cartSize, atr);
+	numDirs = num_dir_entries;
+	dirs = malloc(numDirs * 256);
+	for (i=0, numDirs=0; i<num_dir_entries; i++) {
+		ENTRY_NAMES *e = (ENTRY_NAMES *)&cart_ram1[i * ENTRY_SIZE];
+		if (e->isDir)
+			snprintf(dirs[numDirs++], 256, "%.127s/%.127s", zip, e->filename);
+	}
+	for (i=0; i<numDirs; i++) {
+		test_zip_list("zip sub", dirs[i]);
+		zip_pick(dirs[i], cart, &cartSize, atr);
+		// and the first folder in that
+		for (int j=0; j<num_dir_entries; j++) {
+			ENTRY_NAMES *e = (ENTRY_NAMES *)&cart_ram1[j * ENTRY_SIZE];
+			if (!e->isDir) continue;
+			snprintf(sub, sizeof sub, "%s/%s", dirs[i], e->filename);
+			test_zip_list("zip sub", sub);
+			zip_pick(sub, cart, &cartSize, atr);
+			break;
+		}
+	}
+	free(dirs);
+	for (int r=0; cart[0] && r<repeat; r++) {
+		begin();
+		int type = load_file(cart, NULL);
+		double wall = now() - wallStart;
+		if (type) snprintf(detail, sizeof detail, "%s (type %d, %u bytes, inflate %.1f MB/s)",
+			cart, type, cartSize, cartSize / wall / 1e6);
+		else snprintf(detail, sizeof detail, "%s: %s", cart, errorBuf);
+		end("zip load", detail, type != CART_TYPE_NONE);
+	}
+	if (atr[0]) {
+		ATR_INFO info;
+		uint8_t buf[256];
+		if (!atr_info_mounted(atr, &info)) {
+			printf("%s: can't mount\n", atr);
+			failures++;
+			return;
+		}
+		test_atr_boot(atr, &info);
+		test_atr_copy(atr, &info, 0);
+		// backwards, unpacked from the start again when it runs out of the ring
+		begin();
+		int ok = mount_atr(atr) == 0;
+		for (int s=info.numSectors; ok && s>=1; s--)
+			ok = atr_io(&info, s, 0, buf);
+		snprintf(detail, sizeof detail, "%s (%d sectors)", atr, info.numSectors);
+		end("atr back", detail, ok);
+	}
+}
+
+/* Finding something to load */
+
+static int find_file(char *path, int kind, int minSize, char *found) {
+	DIR dir;
+	FILINFO fi;
+	char lfn[_MAX_LFN + 1];
+	int ret = 0;
+	fi.lfname = lfn;
+	fi.lfsize = sizeof lfn;
+	if (f_opendir(&dir, path) != FR_OK) return 0;
+	while (!ret && f_readdir(&dir, &fi) == FR_OK && fi.fname[0]) {
+		if (fi.fattrib & (AM_HID | AM_SYS)) continue;
+		char sub[256];
+		snprintf(sub, sizeof sub, "%s/%s", path, fi.fname);
+		if (fi.fattrib & AM_DIR)
+			ret = find_file(sub, kind, minSize, found);
+		else if (fi.fsize >= minSize && (file_kind(fi.fname) == kind
+				|| (kind == FILE_KIND_CAR && file_kind(fi.fname) == FILE_KIND_ROM))) {
+			strcpy(found, sub);
+			ret = 1;
+		}
+	}
+	f_closedir(&dir);
+	return ret;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: sdbench [options] <card image>\n"
+		"  -m MODEL  card timing model (default uno)\n"
+		"  -s TEXT   search for TEXT (default \"a\")\n"
+		"  -c FILE   cart to load (default: the first 128k one found)\n"
+		"  -z FILE   LZ4 packed cart to load (default: the first .LZ4 found)\n"
+		"  -a FILE   ATR to boot and copy (default: the first one found)\n"
+		"  -Z FILE   .ZIP to list and load from (default: the first one found)\n"
+		"  -r FILE   replay a sector trace against the ATR\n"
+		"  -n N      run the listing, search, load and boot tests N times\n"
+		"  -k        cold: remount before every test\n"
+		"  -w        allow writes: ATR write-back, the metadata scan and the\n"
+		"            SD self-test (a 256k scratch file)\n"
+		"models:\n");
+	for (const HOSTDISK_MODEL *m = hostdisk_models; m->name; m++)
+		fprintf(stderr, "  %-8s %s\n", m->name, m->desc);
+	exit(2);
+}
+
+int main(int argc, char *argv[]) {
+	const HOSTDISK_MODEL *model = &hostdisk_models[0];
+	char *search = "a", *trace = NULL;
+	char cart[256] = "", lz4[256] = "", atr[256] = "", zip[256] = "";
+	int writable = 0, c;
+
+	while ((c = getopt(argc, argv, "m:s:c:z:a:Z:r:n:kw")) != -1) {
+		switch (c) {
+		case 'm':
+			if (!(model = hostdisk_find_model(optarg))) usage();
+			break;
+		case 's': search = optarg; break;
+		case 'c': snprintf(cart, sizeof cart, "%s", optarg); break;
+		case 'z': snprintf(lz4, sizeof lz4, "%s", optarg); break;
+		case 'a': snprintf(atr, sizeof atr, "%s", optarg); break;
+		case 'Z': snprintf(zip, sizeof zip, "%s", optarg); break;
+		case 'r': trace = optarg; break;
+		case 'n': repeat = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+		case 'k': cold = 1; break;
+		case 'w': writable = 1; break;
+		default: usage();
+		}
+	}
+	if (optind != argc - 1) usage();
+	// mount_atr opens the ATR for writing, as the cart does, so the image is
+	// opened read/write if it can be. Only the -w tests actually write
+	if (!hostdisk_open(argv[optind], 0) && !hostdisk_open(argv[optind], 1)) {
+		fprintf(stderr, "can't open %s\n", argv[optind]);
+		return 1;
+	}
+	hostdisk_set_model(model);
+	init();
+
+	printf("model %s: SPI %.3f MHz, %s\n", model->name, model->spiHz / 1e6, model->desc);
+	printf("%-10s %10s %6s %5s %7s %6s %7s %9s\n", "test", "card ms",
+		"reads", "multi", "sectors", "writes", "sectors", "wall us");
+
+	test_mount();
+	if (!doneFatFsInit) {
+		fprintf(stderr, "%s\n", errorBuf);
+		return 1;
+	}
+	test_list_tree("", 0);
+	test_cached("");
+	test_search(search);
+	test_isearch(search);
+
+	if (!cart[0] && !find_file("", FILE_KIND_CAR, 128*1024, cart))
+		printf("no 128k cart on the card, skipping load\n");
+	if (cart[0]) {
+		test_load(cart);
+		test_preload(cart);
+	}
+	if (lz4[0] || find_file("", FILE_KIND_LZ4, 0, lz4)) test_load_lz4(lz4);
+
+	if (!atr[0] && !find_file("", FILE_KIND_ATR, 0, atr))
+		printf("no ATR on the card, skipping ATR tests\n");
+	if (atr[0]) {
+		ATR_INFO info;
+		if (!atr_info(atr, &info)) {
+			printf("%s is not an ATR\n", atr);
+			failures++;
+		}
+		else {
+			test_atr_boot(atr, &info);
+			test_atr_copy(atr, &info, writable);
+			if (trace) test_trace(atr, &info, trace, writable);
+		}
+	}
+	if (zip[0] || find_file("", FILE_KIND_ZIP, 0, zip)) test_zip(zip);
+	if (writable) {
+		test_scan();
+		test_selftest();
+	}
+
+	hostdisk_close();
+	return failures ? 1 : 0;
+}
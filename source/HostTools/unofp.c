@@ -0,0 +1,226 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * unofp - checks the firmware's FMUL and FDIV (src/fpmath.c) against the
+ * soft OS's own, run on host6502.c
+ *
+ * Each operation is done on the same random page zero both ways: by
+ * fp_op, and by the 6502 calling into os.rom. Everything the 6502 routine
+ * can leave behind is compared: page zero from $D0 up, A, X, Y and the
+ * carry. Operations fp_op hands back to the 6502 are counted, not run.
+ * See README.md.
+ */
+
+#include "host6502.h"
+#include "fpmath.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FMUL		0xDADB
+#define FDIV		0xDB28
+#define FR0			0xD4
+#define FR1			0xE0
+#define FLPTR		0xFC
+#define ZP_FIRST	0xD0		// compared from here to $FF
+#define RETURN		0x0600		// the routine returns to a BRK here
+#define MAX_CYCLES	10000000
+
+static const char *osPath = "../Atari/UnoCartOS/os.rom";
+static uint8_t mem[65536];
+static uint64_t cycles;
+static int verbose = 0;
+
+static uint8_t mem_read(M6502 *c, uint16_t addr) {
+	cycles++;
+	return mem[addr];
+}
+
+static void mem_write(M6502 *c, uint16_t addr, uint8_t data) {
+	cycles++;
+	if (addr < 0xC000)
+		mem[addr] = data;
+}
+
+static uint32_t seed = 1;
+
+static uint8_t rnd(void) {
+	seed = seed * 1103515245 + 12345;
+	return seed >> 16;
+}
+
+static uint8_t rnd_bcd(void) {
+	return (rnd() % 10) << 4 | rnd() % 10;
+}
+
+/* the kinds of operand pair: FR0 is a normalised number, apart from junk,
+   and FR1 is the kind named */
+enum { OP_VALID, OP_UNNORM, OP_DIGIT, OP_JUNK, NUM_KINDS };
+static const char *kindNames[NUM_KINDS] = { "normalised", "unnormalised", "digit over 9", "junk" };
+
+/* a number at FR0 or FR1, exponents from the whole range */
+static void make_operand(uint8_t *p, int kind) {
+	p[0] = rnd();
+	for (int i = 1; i < 6; i++)
+		p[i] = kind == OP_JUNK ? rnd() : rnd_bcd();
+	if (kind == OP_VALID && p[1] < 0x10)
+		p[1] |= (1 + rnd() % 9) << 4;
+	else if (kind == OP_UNNORM)
+		p[1] = 0;
+	else if (kind == OP_DIGIT) {
+		int i = 1 + rnd() % 5;
+		if (rnd() & 1)
+			p[i] = (p[i] & 0x0f) | (10 + rnd() % 6) << 4;
+		else
+			p[i] = (p[i] & 0xf0) | (10 + rnd() % 6);
+	}
+}
+
+/* runs the OS routine, returns 0 if it ran away */
+static int run_6502(uint16_t entry, uint8_t *a, uint8_t *x, uint8_t *y, int *carry) {
+	M6502 cpu;
+
+	memset(&cpu, 0, sizeof(cpu));
+	cpu.read = mem_read;
+	cpu.write = mem_write;
+	cpu.s = 0xFD;
+	cpu.p = M6502_I;
+	// an RTS from the routine goes to RETURN
+	mem[0x1FE] = (RETURN - 1) & 0xFF;
+	mem[0x1FF] = (RETURN - 1) >> 8;
+	cpu.pc = entry;
+	uint64_t start = cycles;
+	while (cpu.pc != RETURN) {
+		if (!m6502_step(&cpu) || cycles - start > MAX_CYCLES)
+			return 0;
+	}
+	*a = cpu.a;
+	*x = cpu.x;
+	*y = cpu.y;
+	*carry = cpu.p & M6502_C;
+	return 1;
+}
+
+static void dump(const char *what, const uint8_t *zp) {
+	printf("  %-8s", what);
+	for (int i = ZP_FIRST; i < 0x100; i++)
+		printf(" %02X", zp[i - ZP_FIRST]);
+	printf("\n");
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: unofp [options]\n"
+		"  -o FILE  the soft OS ROM, 16k (default ../Atari/UnoCartOS/os.rom)\n"
+		"  -n N     operations of each kind (default 200000)\n"
+		"  -r SEED  random seed (default 1)\n"
+		"  -v       list every operation that doesn't match\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[]) {
+	int count = 200000, c;
+	int tried[2][NUM_KINDS] = { { 0 } }, handed[2][NUM_KINDS] = { { 0 } }, bad[2][NUM_KINDS] = { { 0 } };
+	int ranAway = 0, failures = 0;
+
+	while ((c = getopt(argc, argv, "o:n:r:v")) != -1) {
+		switch (c) {
+		case 'o': osPath = optarg; break;
+		case 'n': count = atoi(optarg); break;
+		case 'r': seed = strtoul(optarg, NULL, 0); break;
+		case 'v': verbose = 1; break;
+		default: usage();
+		}
+	}
+	if (optind != argc || count <= 0) usage();
+
+	FILE *f = fopen(osPath, "rb");
+	if (!f || fread(&mem[0xC000], 1, 16384, f) != 16384) {
+		fprintf(stderr, "can't read a 16k OS ROM from %s\n", osPath);
+		return 1;
+	}
+	fclose(f);
+	mem[RETURN] = 0x00;
+
+	for (int op = FP_OP_MUL; op <= FP_OP_DIV; op++) {
+		for (int n = 0; n < count * NUM_KINDS; n++) {
+			int kind = n % NUM_KINDS;
+			uint8_t zp[0x100 - ZP_FIRST], before[0x100 - ZP_FIRST];
+			FP_STATE state;
+
+			for (int i = ZP_FIRST; i < 0x100; i++)
+				mem[i] = rnd();
+			make_operand(&mem[FR0], kind == OP_JUNK ? OP_JUNK : OP_VALID);
+			make_operand(&mem[FR1], kind);
+			if (op == FP_OP_MUL && rnd() & 1) {
+				// FMUL either way round
+				uint8_t t[6];
+				memcpy(t, &mem[FR0], 6);
+				memcpy(&mem[FR0], &mem[FR1], 6);
+				memcpy(&mem[FR1], t, 6);
+			}
+			memcpy(before, &mem[ZP_FIRST], sizeof(before));
+			tried[op][kind]++;
+
+			memset(&state, 0, sizeof(state));
+			memcpy(state.zp, &mem[FR0], FP_ZP_SIZE);
+			memcpy(state.flptr, &mem[FLPTR], 2);
+			int carry = fp_op(op, &state);
+			if (carry < 0) {
+				handed[op][kind]++;
+				continue;
+			}
+			memcpy(zp, before, sizeof(zp));
+			memcpy(&zp[FR0 - ZP_FIRST], state.zp, FP_ZP_SIZE);
+			memcpy(&zp[FLPTR - ZP_FIRST], state.flptr, 2);
+
+			uint8_t a, x, y;
+			int carry6502;
+			if (!run_6502(op == FP_OP_MUL ? FMUL : FDIV, &a, &x, &y, &carry6502)) {
+				ranAway++;
+				continue;
+			}
+			if (!memcmp(zp, &mem[ZP_FIRST], sizeof(zp)) && a == state.a && x == state.x &&
+					y == state.y && !carry6502 == !carry)
+				continue;
+			bad[op][kind]++;
+			if (verbose) {
+				printf("%s, %s operands: 6502 A=%02X X=%02X Y=%02X C=%d, cart A=%02X X=%02X Y=%02X C=%d\n",
+					op == FP_OP_MUL ? "FMUL" : "FDIV", kindNames[kind],
+					a, x, y, !!carry6502, state.a, state.x, state.y, carry);
+				dump("before", before);
+				dump("6502", &mem[ZP_FIRST]);
+				dump("cart", zp);
+			}
+		}
+	}
+
+	printf("%-6s %-14s %10s %10s %10s\n", "", "operands", "tried", "to 6502", "differ");
+	for (int op = FP_OP_MUL; op <= FP_OP_DIV; op++)
+		for (int k = 0; k < NUM_KINDS; k++) {
+			printf("%-6s %-14s %10d %10d %10d\n", op == FP_OP_MUL ? "FMUL" : "FDIV", kindNames[k],
+				tried[op][k], handed[op][k], bad[op][k]);
+			failures += bad[op][k];
+		}
+	if (ranAway)
+		printf("%d operations didn't return on the 6502 within %d cycles\n", ranAway, MAX_CYCLES);
+	return failures || ranAway ? 1 : 0;
+}
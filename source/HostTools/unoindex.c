@@ -0,0 +1,453 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * unoindex - build the UnoCart metadata cache (UNOMETA.DAT) on a PC
+ *
+ * Reads an SD card image (through the firmware's FatFs) or a mounted card /
+ * directory tree, identifies every file the menu would show using the same
+ * cartinfo.c as the firmware, and writes the cache the firmware's background
+ * scan would otherwise take minutes to fill. Files are scanned on all cores
+ * by a work-stealing thread pool. See README.md for building.
+ */
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include "unoindex.h"
+#include "filemeta.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <ctype.h>
+#include <sys/stat.h>
+
+ENTRY *entries = NULL;
+int numEntries = 0;
+static int maxEntries = 0;
+static int imageMode = 0;
+static int verbose = 0;
+
+ENTRY *new_entry(void) {
+	if (numEntries == maxEntries) {
+		maxEntries = maxEntries ? maxEntries * 2 : 1024;
+		entries = realloc(entries, maxEntries * sizeof(ENTRY));
+		if (!entries) { fprintf(stderr, "out of memory\n"); exit(1); }
+	}
+	ENTRY *e = &entries[numEntries++];
+	memset(e, 0, sizeof(ENTRY));
+	return e;
+}
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Collecting files */
+
+static void fat_timestamp(time_t t, uint16_t *fdate, uint16_t *ftime) {
+	struct tm *tm = localtime(&t);
+	*fdate = ((tm->tm_year - 80) << 9) | ((tm->tm_mon + 1) << 5) | tm->tm_mday;
+	*ftime = (tm->tm_hour << 11) | (tm->tm_min << 5) | (tm->tm_sec >> 1);
+}
+
+// a name that fits 8.3 is its own short name (in capitals). Anything else
+// gets one made up by whatever wrote the card, which can't be told from here
+static int is_short_name(const char *name) {
+	const char *dot = strchr(name, '.');
+	int base = dot ? dot - name : strlen(name);
+	if (base < 1 || base > 8 || (dot && (strlen(dot + 1) < 1 || strlen(dot + 1) > 3 || strchr(dot + 1, '.'))))
+		return 0;
+	for (const char *p = name; *p; p++)
+		if (p != dot && !isalnum((unsigned char)*p) && !strchr("!#$%&'()-@^_`{}~", *p))
+			return 0;
+	return 1;
+}
+
+// fatPath is NULL under a folder whose short name isn't known
+static void collect_tree(const char *dirPath, const char *menuPath, const char *fatPath) {
+	DIR *d = opendir(dirPath);
+	if (!d) { fprintf(stderr, "can't read %s\n", dirPath); return; }
+	struct dirent *de;
+	while ((de = readdir(d))) {
+		if (de->d_name[0] == '.') continue;	// hidden, as AM_HID
+		char *path, *sub, *fatSub = NULL;
+		struct stat st;
+		if (asprintf(&path, "%s/%s", dirPath, de->d_name) < 0) continue;
+		if (stat(path, &st) != 0) { free(path); continue; }
+		if (S_ISDIR(st.st_mode)) {
+			ENTRY *e = new_entry();
+			e->isDir = 1;
+			e->name = strdup(de->d_name);
+			e->dir = strdup(menuPath);
+			if (fatPath && is_short_name(de->d_name) && asprintf(&fatSub, "%s/%s", fatPath, de->d_name) < 0)
+				fatSub = NULL;
+			if (asprintf(&sub, "%s/%s", menuPath, de->d_name) >= 0) {
+				collect_tree(path, sub, fatSub);
+				free(sub);
+			}
+			free(fatSub);
+			free(path);
+		}
+		else if (S_ISREG(st.st_mode) && is_valid_file(de->d_name)) {
+			ENTRY *e = new_entry();
+			e->path = path;
+			e->name = strdup(de->d_name);
+			e->dir = strdup(menuPath);
+			e->fatDir = fatPath ? strdup(fatPath) : NULL;
+			e->size = st.st_size > 0xFFFFFFFF ? 0xFFFFFFFF : st.st_size;
+			fat_timestamp(st.st_mtime, &e->fdate, &e->ftime);
+		}
+		else
+			free(path);
+	}
+	closedir(d);
+}
+
+static void preload_tree(ENTRY *e) {
+	FILE *f = fopen(e->path, "rb");
+	if (!f) return;
+	e->data = malloc(e->size ? e->size : 1);
+	if (e->data) e->dataLen = fread(e->data, 1, e->size, f);
+	fclose(f);
+}
+
+/* Scanning */
+
+static void scan_entry(ENTRY *e) {
+	CART_SCAN s;
+	memset(&e->meta, 0, sizeof(FILE_META));
+	e->meta.nameHash = e->fatDir ? meta_path_hash(e->fatDir, e->name) : 0;
+	e->meta.fdate = e->fdate;
+	e->meta.ftime = e->ftime;
+	cart_scan_begin(&s, e->name, e->size, &e->meta);
+	if (!s.failed) {
+		if (e->data)
+			cart_scan_feed(&s, e->data, e->dataLen);
+		else {
+			static __thread uint32_t buf[16384];
+			FILE *f = fopen(e->path, "rb");
+			size_t n;
+			if (f) {
+				while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+					if (!cart_scan_feed(&s, (uint8_t *)buf, n)) break;
+				fclose(f);
+			}
+		}
+	}
+	cart_scan_end(&s);
+}
+
+/* Work-stealing pool. Each worker takes jobs from the back of its own deque
+   and, once that is empty, steals from the front of the others'. No new work
+   is created while running, so when every deque is empty the pool is done. */
+
+typedef struct {
+	pthread_mutex_t lock;
+	int *jobs;
+	int head, tail;
+	pthread_t thread;
+	int id;
+	long done, stolen;
+} WORKER;
+
+static WORKER *workers;
+static int numWorkers;
+
+static int take_own(WORKER *w, int *job) {
+	int ok = 0;
+	pthread_mutex_lock(&w->lock);
+	if (w->tail > w->head) { *job = w->jobs[--w->tail]; ok = 1; }
+	pthread_mutex_unlock(&w->lock);
+	return ok;
+}
+
+static int steal(WORKER *victim, int *job) {
+	int ok = 0;
+	pthread_mutex_lock(&victim->lock);
+	if (victim->tail > victim->head) { *job = victim->jobs[victim->head++]; ok = 1; }
+	pthread_mutex_unlock(&victim->lock);
+	return ok;
+}
+
+static void *worker_main(void *arg) {
+	WORKER *w = arg;
+	int job;
+	for (;;) {
+		if (!take_own(w, &job)) {
+			int found = 0;
+			for (int i=1; i<numWorkers && !found; i++)
+				found = steal(&workers[(w->id + i) % numWorkers], &job);
+			if (!found) break;
+			w->stolen++;
+		}
+		scan_entry(&entries[job]);
+		w->done++;
+	}
+	return NULL;
+}
+
+static void run_pool(int threads, int *jobs, int numJobs) {
+	numWorkers = threads;
+	workers = calloc(threads, sizeof(WORKER));
+	for (int i=0; i<threads; i++) {
+		WORKER *w = &workers[i];
+		// contiguous slices, so neighbouring (similar sized) files stay together
+		int from = (long)numJobs * i / threads, to = (long)numJobs * (i + 1) / threads;
+		pthread_mutex_init(&w->lock, NULL);
+		w->id = i;
+		w->jobs = malloc((to - from + 1) * sizeof(int));
+		memcpy(w->jobs, &jobs[from], (to - from) * sizeof(int));
+		w->head = 0;
+		w->tail = to - from;
+	}
+	for (int i=0; i<threads; i++)
+		pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+	for (int i=0; i<threads; i++)
+		pthread_join(workers[i].thread, NULL);
+	if (verbose) {
+		for (int i=0; i<threads; i++)
+			fprintf(stderr, "worker %d: %ld files, %ld stolen\n", i, workers[i].done, workers[i].stolen);
+	}
+	for (int i=0; i<threads; i++) {
+		pthread_mutex_destroy(&workers[i].lock);
+		free(workers[i].jobs);
+	}
+	free(workers);
+}
+
+/* Cache file, built in memory with the same placement as meta_store() */
+
+static uint8_t *metaFile;
+static size_t metaFileSize;
+static uint32_t metaBuckets;
+
+static void meta_table_put(FILE_META *m) {
+	FILE_META (*buckets)[META_PER_BUCKET] = (void *)&metaFile[512];
+	int home = m->nameHash % metaBuckets;
+	for (int p=0; p<META_PROBE; p++) {
+		FILE_META *b = buckets[(home + p) % metaBuckets];
+		for (int i=0; i<META_PER_BUCKET; i++) {
+			if (!b[i].nameHash || b[i].nameHash == m->nameHash) {
+				b[i] = *m;
+				return;
+			}
+		}
+	}
+	buckets[home][(m->nameHash / metaBuckets) % META_PER_BUCKET] = *m;
+}
+
+static int build_meta_file(void) {
+	int stored = 0, files = 0, unkeyed = 0;
+	for (int i=0; i<numEntries; i++)
+		if (!entries[i].isDir) files++;
+	// keep the buckets under half full, leaving room for files added later
+	metaBuckets = META_DEFAULT_BUCKETS;
+	while (metaBuckets < META_MAX_BUCKETS && metaBuckets * META_PER_BUCKET < files * 2)
+		metaBuckets *= 2;
+	META_HEADER hdr = { META_MAGIC, META_VERSION, metaBuckets, sizeof(FILE_META) };
+	metaFileSize = (metaBuckets + 1) * 512;
+	metaFile = calloc(1, metaFileSize);
+	memcpy(metaFile, &hdr, sizeof(hdr));
+	for (int i=0; i<numEntries; i++) {
+		ENTRY *e = &entries[i];
+		if (e->isDir || e->meta.status == META_UNKNOWN || e->meta.status == META_READ_ERROR)
+			continue;
+		if (!e->meta.nameHash) {
+			unkeyed++;
+			continue;
+		}
+		meta_table_put(&e->meta);
+		stored++;
+	}
+	if (unkeyed)
+		printf("%d files under folders with long names left out, index the card image to include them\n", unkeyed);
+	return stored;
+}
+
+static int write_meta_host(const char *path) {
+	FILE *f = fopen(path, "wb");
+	if (!f) return 0;
+	int ok = fwrite(metaFile, 1, metaFileSize, f) == metaFileSize;
+	return fclose(f) == 0 && ok;
+}
+
+/* Listing, in the order the menu shows it */
+
+static int listing_compare(const void *p1, const void *p2) {
+	const ENTRY *e1 = *(const ENTRY **)p1, *e2 = *(const ENTRY **)p2;
+	int r = strcmp(e1->dir, e2->dir);
+	if (r) return r;
+	if (e1->isDir != e2->isDir) return e1->isDir ? -1 : 1;
+	return strncasecmp(e1->name, e2->name, MAX_NAME);	// the menu compares 31 chars
+}
+
+static void write_listing(FILE *out) {
+	ENTRY **sorted = malloc(numEntries * sizeof(ENTRY *));
+	for (int i=0; i<numEntries; i++) sorted[i] = &entries[i];
+	qsort(sorted, numEntries, sizeof(ENTRY *), listing_compare);
+	const char *curDir = NULL;
+	int inDir = 0;
+	for (int i=0; i<numEntries; i++) {
+		ENTRY *e = sorted[i];
+		if (!curDir || strcmp(curDir, e->dir)) {
+			curDir = e->dir;
+			inDir = 0;
+			fprintf(out, "%s/\n", curDir);
+		}
+		if (++inDir == MAX_DIR_ENTRIES + 1)
+			fprintf(out, "  (more than %d entries, the menu shows only some of them)\n", MAX_DIR_ENTRIES);
+		if (e->isDir)
+			fprintf(out, "  DIR  %.*s\n", MAX_NAME, e->name);
+		else
+			fprintf(out, "  %s %-31.31s %8u %08x %08x %s\n", cart_type_tag(e->meta.cartType, e->meta.status),
+					e->name, e->size, e->meta.crc[0], e->meta.crc[1], meta_status_text(e->meta.status));
+	}
+	free(sorted);
+}
+
+/* Benchmark - scan the preloaded files repeatedly with 1, 2, 4 .. threads */
+
+static void benchmark(int maxThreads, int repeats, int *jobs, int numJobs) {
+	uint64_t bytes = 0;
+	for (int i=0; i<numJobs; i++)
+		bytes += entries[jobs[i]].dataLen;
+	printf("benchmark: %d files, %.1f MB, %d passes\n", numJobs, bytes / 1048576.0, repeats);
+	printf("threads    files/s       MB/s  speedup\n");
+	double base = 0;
+	for (int t=1; ; t*=2) {
+		if (t > maxThreads) t = maxThreads;
+		double t0 = now();
+		for (int r=0; r<repeats; r++)
+			run_pool(t, jobs, numJobs);
+		double secs = (now() - t0) / repeats;
+		if (t == 1) base = secs;
+		printf("%7d %10.0f %10.1f %8.2f\n", t, numJobs / secs, bytes / secs / 1048576.0, base / secs);
+		if (t == maxThreads) break;
+	}
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: unoindex [options] <card image | directory>\n"
+		"  -t N     worker threads (default: all cores)\n"
+		"  -o FILE  write the cache to FILE instead of onto the card\n"
+		"  -n       don't write the cache\n"
+		"  -l FILE  write a listing in menu order, with types and CRCs ('-' = stdout)\n"
+		"  -b N     benchmark: scan everything N times with 1, 2, 4 .. threads\n"
+		"  -v       verbose\n");
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	int threads = sysconf(_SC_NPROCESSORS_ONLN), noWrite = 0, benchPasses = 0, opt;
+	char *outPath = NULL, *listPath = NULL;
+
+	while ((opt = getopt(argc, argv, "t:o:nl:b:v")) != -1) {
+		switch (opt) {
+		case 't': threads = atoi(optarg); break;
+		case 'o': outPath = optarg; break;
+		case 'n': noWrite = 1; break;
+		case 'l': listPath = optarg; break;
+		case 'b': benchPasses = atoi(optarg); break;
+		case 'v': verbose = 1; break;
+		default: usage();
+		}
+	}
+	if (optind != argc - 1) usage();
+	if (threads < 1) threads = 1;
+	char *input = argv[optind];
+	struct stat st;
+	if (stat(input, &st) != 0) { perror(input); return 1; }
+	imageMode = !S_ISDIR(st.st_mode);
+
+	double t0 = now();
+	if (imageMode) {
+		if (!fat_open_image(input, noWrite || outPath)) {
+			fprintf(stderr, "%s: not a FAT card image\n", input);
+			return 1;
+		}
+		fat_collect("");
+	}
+	else
+		collect_tree(input, "", "");
+	double tCollect = now() - t0;
+
+	int *jobs = malloc((numEntries + 1) * sizeof(int)), numJobs = 0;
+	for (int i=0; i<numEntries; i++)
+		if (!entries[i].isDir) jobs[numJobs++] = i;
+
+	cart_crc_reset();	// fill the CRC table before the threads start
+	t0 = now();
+	run_pool(threads, jobs, numJobs);
+	double tScan = now() - t0;
+
+	uint64_t bytes = 0;
+	int counts[16] = {0};
+	for (int i=0; i<numJobs; i++) {
+		ENTRY *e = &entries[jobs[i]];
+		bytes += e->size;
+		counts[e->meta.status & 15]++;
+		if (verbose)
+			fprintf(stderr, "%s/%s: %s %s\n", e->dir, e->name,
+					cart_type_tag(e->meta.cartType, e->meta.status), meta_status_text(e->meta.status));
+	}
+	printf("%d files in %d directories, %.1f MB\n", numJobs, numEntries - numJobs, bytes / 1048576.0);
+	printf("collect %.3fs, scan %.3fs on %d threads (%.1f MB/s)\n", tCollect, tScan, threads,
+			tScan > 0 ? bytes / tScan / 1048576.0 : 0);
+	printf("ok %d, bad CAR type %d, wrong size %d, too big %d, bad XEX %d, bad ATR %d, bad CAS %d, unreadable %d\n",
+			counts[META_OK], counts[META_BAD_CAR_TYPE], counts[META_BAD_SIZE], counts[META_TOO_BIG],
+			counts[META_BAD_XEX], counts[META_BAD_ATR], counts[META_BAD_CAS], counts[META_READ_ERROR]);
+
+	int ret = 0;
+	if (!noWrite) {
+		int stored = build_meta_file();
+		int ok;
+		if (outPath) ok = write_meta_host(outPath);
+		else if (imageMode) ok = fat_write_file(META_FILE_NAME, metaFile, metaFileSize);
+		else {
+			char *p;
+			ok = asprintf(&p, "%s%s", input, META_FILE_NAME) >= 0 && write_meta_host(p);
+		}
+		if (ok) printf("wrote %d records in %u buckets to %s\n", stored, metaBuckets, outPath ? outPath : META_FILE_NAME);
+		else { fprintf(stderr, "failed to write the cache\n"); ret = 1; }
+	}
+	if (listPath) {
+		FILE *out = strcmp(listPath, "-") ? fopen(listPath, "w") : stdout;
+		if (out) {
+			write_listing(out);
+			if (out != stdout) fclose(out);
+		}
+	}
+	if (benchPasses > 0) {
+		for (int i=0; i<numJobs; i++)
+			if (!imageMode) preload_tree(&entries[jobs[i]]);
+		benchmark(threads, benchPasses, jobs, numJobs);
+	}
+	if (imageMode)
+		fat_close_image();
+	return ret;
+}
@@ -0,0 +1,53 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UNOINDEX_H
+#define UNOINDEX_H
+
+#include "cartinfo.h"
+#include <stddef.h>
+
+#define MAX_DIR_ENTRIES		255		// per directory, as read_directory()
+#define MAX_NAME			31		// DIR_ENTRY long_filename
+
+typedef struct {
+	char *path;			// to open the file (host path, or FatFs path)
+	char *name;			// long name, as the menu shows it
+	char *dir;			// containing directory, for the listing
+	char *fatDir;		// the same with 8.3 names, as the firmware has it. NULL if not known
+	int isDir;
+	uint32_t size;
+	uint16_t fdate, ftime;
+	uint8_t *data;		// file contents when preloaded, else NULL
+	uint32_t dataLen;
+	FILE_META meta;
+} ENTRY;
+
+extern ENTRY *entries;
+extern int numEntries;
+ENTRY *new_entry(void);
+
+/* indexfat.c - card images, through the firmware's FatFs. Kept apart since
+   FatFs and <dirent.h> both define DIR */
+int fat_open_image(const char *path, int readOnly);
+void fat_close_image(void);
+// add everything the menu would list under path, file contents preloaded
+void fat_collect(char *path);
+int fat_write_file(const char *path, const void *data, size_t len);
+
+#endif
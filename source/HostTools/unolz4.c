@@ -0,0 +1,327 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * unolz4 - pack a .CAR, .ROM or .XEX into an LZ4 frame for the cart to
+ * unpack as it loads (see src/lz4load.h)
+ *
+ * The frame is standard ("lz4 -d" unpacks it, and the cart takes frames
+ * from "lz4 -9" too), packed with a long hash chain search and a lazy step,
+ * which comes within a percent of lz4 -9. Blocks are linked so matches can
+ * reach back into the block before. Each file is unpacked again and
+ * compared before it's written.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LZ4_FRAME_MAGIC	0x184D2204
+#define BLOCK_SIZE		65536		// BD = 4, 64k blocks
+#define MIN_MATCH		4
+#define LAST_LITERALS	5			// a block ends with at least 5 literals
+#define MF_LIMIT		12			// and the last match starts 12 from the end
+#define MAX_OFFSET		65535
+#define HASH_BITS		16
+
+static int maxChain = 4096;
+
+/* xxHash32, for the frame header checksum */
+#define PRIME1	2654435761u
+#define PRIME2	2246822519u
+#define PRIME3	3266489917u
+#define PRIME4	668265263u
+#define PRIME5	374761393u
+
+static uint32_t rotl(uint32_t x, int r) {
+	return (x << r) | (x >> (32 - r));
+}
+
+static uint32_t read32(const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint32_t xxh32(const uint8_t *p, size_t len) {
+	const uint8_t *end = p + len;
+	uint32_t h;
+	if (len >= 16) {
+		uint32_t v1 = PRIME1 + PRIME2, v2 = PRIME2, v3 = 0, v4 = -PRIME1;
+		while (p + 16 <= end) {
+			v1 = rotl(v1 + read32(p) * PRIME2, 13) * PRIME1; p += 4;
+			v2 = rotl(v2 + read32(p) * PRIME2, 13) * PRIME1; p += 4;
+			v3 = rotl(v3 + read32(p) * PRIME2, 13) * PRIME1; p += 4;
+			v4 = rotl(v4 + read32(p) * PRIME2, 13) * PRIME1; p += 4;
+		}
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+	}
+	else
+		h = PRIME5;
+	h += (uint32_t)len;
+	for (; p + 4 <= end; p += 4)
+		h = rotl(h + read32(p) * PRIME3, 17) * PRIME4;
+	for (; p < end; p++)
+		h = rotl(h + *p * PRIME5, 11) * PRIME1;
+	h ^= h >> 15;
+	h *= PRIME2;
+	h ^= h >> 13;
+	h *= PRIME3;
+	h ^= h >> 16;
+	return h;
+}
+
+/* Packing */
+
+static const uint8_t *in;
+static int32_t *head, *chain;
+
+static uint32_t hash4(int pos) {
+	return read32(in + pos) * PRIME1 >> (32 - HASH_BITS);
+}
+
+static void insert(int pos) {
+	uint32_t h = hash4(pos);
+	chain[pos] = head[h];
+	head[h] = pos;
+}
+
+// longest match for pos that ends by limit, 0 if none
+static int find_match(int pos, int limit, int *offset) {
+	int best = 0, n = maxChain;
+	for (int cand = head[hash4(pos)]; cand >= 0 && pos - cand <= MAX_OFFSET && n--; cand = chain[cand]) {
+		if (in[cand + best] != in[pos + best]) continue;
+		int len = 0;
+		while (pos + len < limit && in[cand + len] == in[pos + len])
+			len++;
+		if (len > best) {
+			best = len;
+			*offset = pos - cand;
+			if (pos + len == limit) break;
+		}
+	}
+	return best >= MIN_MATCH ? best : 0;
+}
+
+static uint8_t *put_length(uint8_t *out, int len) {
+	for (; len >= 255; len -= 255)
+		*out++ = 255;
+	*out++ = len;
+	return out;
+}
+
+static uint8_t *put_sequence(uint8_t *out, int anchor, int literals, int offset, int matchLen) {
+	int ml = matchLen ? matchLen - MIN_MATCH : 0;
+	*out++ = (literals < 15 ? literals : 15) << 4 | (ml < 15 ? ml : 15);
+	if (literals >= 15)
+		out = put_length(out, literals - 15);
+	memcpy(out, in + anchor, literals);
+	out += literals;
+	if (matchLen) {
+		*out++ = offset & 0xFF;
+		*out++ = offset >> 8;
+		if (ml >= 15)
+			out = put_length(out, ml - 15);
+	}
+	return out;
+}
+
+// one block, from start to end. Returns the packed size
+static int pack_block(int start, int end, uint8_t *out) {
+	uint8_t *o = out;
+	int pos = start, anchor = start;
+	int matchEnd = end - LAST_LITERALS;
+
+	while (pos < end - MF_LIMIT) {
+		int offset, len = find_match(pos, matchEnd, &offset);
+		insert(pos);
+		if (!len) {
+			pos++;
+			continue;
+		}
+		// is the match one byte on any better?
+		int offset2, len2;
+		while (pos + 1 < end - MF_LIMIT && (len2 = find_match(pos + 1, matchEnd, &offset2)) > len) {
+			insert(++pos);
+			len = len2;
+			offset = offset2;
+		}
+		o = put_sequence(o, anchor, pos - anchor, offset, len);
+		for (int i = 1; i < len; i++)
+			if (pos + i + 3 < end)
+				insert(pos + i);
+		pos += len;
+		anchor = pos;
+	}
+	for (; pos + 3 < end; pos++)
+		insert(pos);
+	return put_sequence(o, anchor, end - anchor, 0, 0) - out;
+}
+
+static uint8_t *pack(const uint8_t *data, int size, int *packedSize) {
+	uint8_t *out = malloc(size + size / 255 + 64), *o = out;
+	in = data;
+	head = malloc(sizeof(int32_t) << HASH_BITS);
+	chain = malloc(sizeof(int32_t) * (size + 1));
+	memset(head, 0xFF, sizeof(int32_t) << HASH_BITS);
+
+	// frame descriptor: version 1, linked blocks, content size; 64k blocks
+	uint8_t *desc = o + 4;
+	o[0] = 0x04; o[1] = 0x22; o[2] = 0x4D; o[3] = 0x18;
+	desc[0] = 0x48;
+	desc[1] = 0x40;
+	for (int i = 0; i < 8; i++)
+		desc[2 + i] = i < 4 ? (uint32_t)size >> (8 * i) : 0;
+	desc[10] = xxh32(desc, 10) >> 8;
+	o += 4 + 11;
+
+	for (int start = 0; start < size; start += BLOCK_SIZE) {
+		int end = start + BLOCK_SIZE < size ? start + BLOCK_SIZE : size;
+		uint32_t len = pack_block(start, end, o + 4);
+		if (len >= (uint32_t)(end - start)) {
+			// stored as it is
+			len = end - start;
+			memcpy(o + 4, data + start, len);
+			len |= 0x80000000;
+		}
+		for (int i = 0; i < 4; i++)
+			o[i] = len >> (8 * i);
+		o += 4 + (len & 0x7FFFFFFF);
+	}
+	memset(o, 0, 4);	// end mark
+	o += 4;
+	free(head);
+	free(chain);
+	*packedSize = o - out;
+	return out;
+}
+
+/* Unpacking, to check */
+
+static int unpack(const uint8_t *p, int len, uint8_t *out, int outSize) {
+	const uint8_t *end = p + len;
+	int o = 0;
+	if (len < 7 || read32(p) != LZ4_FRAME_MAGIC) return -1;
+	p += 4;
+	int flags = p[0];
+	p += 3 + ((flags & 0x08) ? 8 : 0) + ((flags & 0x01) ? 4 : 0);
+	while (p + 4 <= end) {
+		uint32_t size = read32(p);
+		p += 4;
+		if (!size) return o;
+		const uint8_t *blockEnd = p + (size & 0x7FFFFFFF);
+		if (blockEnd > end) return -1;
+		if (size & 0x80000000) {
+			if (o + (blockEnd - p) > outSize) return -1;
+			memcpy(out + o, p, blockEnd - p);
+			o += blockEnd - p;
+			p = blockEnd;
+		}
+		while (p < blockEnd) {
+			int token = *p++, n = token >> 4, b;
+			if (n == 15) do { b = *p++; n += b; } while (b == 255 && p < blockEnd);
+			if (p + n > blockEnd || o + n > outSize) return -1;
+			memcpy(out + o, p, n);
+			p += n;
+			o += n;
+			if (p == blockEnd) break;
+			int offset = p[0] | p[1] << 8;
+			p += 2;
+			n = token & 15;
+			if (n == 15) do { b = *p++; n += b; } while (b == 255 && p < blockEnd);
+			n += MIN_MATCH;
+			if (!offset || offset > o || o + n > outSize) return -1;
+			for (int i = 0; i < n; i++, o++)
+				out[o] = out[o - offset];
+		}
+		if (flags & 0x10) p += 4;
+	}
+	return -1;
+}
+
+static uint8_t *load(const char *filename, long *size) {
+	FILE *f = fopen(filename, "rb");
+	uint8_t *data;
+	if (!f) return NULL;
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	rewind(f);
+	data = malloc(*size + 1);
+	if (fread(data, 1, *size, f) != (size_t)*size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	return data;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: unolz4 [options] <file> [<file.lz4>]\n"
+		"  -f        overwrite the output if it's there\n"
+		"  -c N      candidates to try for each match (default 4096, fewer is faster)\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[]) {
+	int force = 0, c;
+	while ((c = getopt(argc, argv, "fc:")) != -1) {
+		switch (c) {
+		case 'f': force = 1; break;
+		case 'c': maxChain = atoi(optarg) > 0 ? atoi(optarg) : 1; break;
+		default: usage();
+		}
+	}
+	if (optind != argc - 1 && optind != argc - 2) usage();
+
+	const char *inName = argv[optind];
+	char outName[1024];
+	if (optind == argc - 2)
+		snprintf(outName, sizeof outName, "%s", argv[optind + 1]);
+	else
+		snprintf(outName, sizeof outName, "%s.lz4", inName);
+
+	long size;
+	uint8_t *data = load(inName, &size);
+	if (!data) {
+		fprintf(stderr, "can't read %s\n", inName);
+		return 1;
+	}
+	if (size > 128*1024 + 16)
+		fprintf(stderr, "warning: %s is bigger than the cart can hold\n", inName);
+
+	int packedSize;
+	uint8_t *packed = pack(data, size, &packedSize);
+	uint8_t *check = malloc(size + 1);
+	if (unpack(packed, packedSize, check, size) != size || memcmp(check, data, size)) {
+		fprintf(stderr, "%s: didn't unpack to the same again, not written\n", inName);
+		return 1;
+	}
+
+	if (!force && access(outName, F_OK) == 0) {
+		fprintf(stderr, "%s is there already (-f to overwrite)\n", outName);
+		return 1;
+	}
+	FILE *f = fopen(outName, "wb");
+	if (!f || fwrite(packed, 1, packedSize, f) != (size_t)packedSize || fclose(f)) {
+		fprintf(stderr, "can't write %s\n", outName);
+		return 1;
+	}
+	printf("%s: %ld -> %d bytes (%.1f%%)\n", outName, size, packedSize, 100.0 * packedSize / (size ? size : 1));
+	return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * unoprof - put names to the PC samples in UNOPROF.BIN (see
+ * src/profiler.h), from the symbol table of the firmware's ELF file
+ *
+ * Prints the functions the samples fell in, busiest first, and with -a
+ * every sampled address as function+offset, for looking up in a listing
+ * (arm-none-eabi-objdump -d) or with addr2line. See README.md.
+ */
+
+#include "profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* just enough of ELF32, the firmware is little endian */
+typedef struct {
+	uint8_t ident[16];
+	uint16_t type, machine;
+	uint32_t version, entry, phoff, shoff, flags;
+	uint16_t ehsize, phentsize, phnum, shentsize, shnum, shstrndx;
+} ELF_HEADER;
+
+typedef struct {
+	uint32_t name, type, flags, addr, offset, size, link, info, addralign, entsize;
+} ELF_SECTION;
+
+typedef struct {
+	uint32_t name, value, size;
+	uint8_t info, other;
+	uint16_t shndx;
+} ELF_SYMBOL;
+
+#define SHT_SYMTAB	2
+#define STT_FUNC	2
+
+typedef struct {
+	uint32_t addr, size;
+	const char *name;
+	uint64_t samples;
+} FUNC;
+
+static FUNC *funcs;
+static int numFuncs;
+
+static uint8_t *load(const char *filename, long *size) {
+	FILE *f = fopen(filename, "rb");
+	uint8_t *data;
+	if (!f) return NULL;
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	rewind(f);
+	data = malloc(*size + 1);
+	if (fread(data, 1, *size, f) != (size_t)*size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	return data;
+}
+
+static int func_compare(const void *p1, const void *p2) {
+	const FUNC *a = p1, *b = p2;
+	return a->addr < b->addr ? -1 : a->addr > b->addr;
+}
+
+static int read_symbols(uint8_t *elf, long size) {
+	ELF_HEADER *h = (ELF_HEADER *)elf;
+	if (size < (long)sizeof(ELF_HEADER) || memcmp(h->ident, "\177ELF", 4) || h->ident[4] != 1 || h->ident[5] != 1)
+		return 0;	// not a little endian ELF32
+	if (h->shoff + (uint64_t)h->shnum * sizeof(ELF_SECTION) > (uint64_t)size)
+		return 0;
+	ELF_SECTION *sec = (ELF_SECTION *)(elf + h->shoff);
+	for (int s = 0; s < h->shnum; s++) {
+		if (sec[s].type != SHT_SYMTAB || sec[s].link >= h->shnum) continue;
+		ELF_SYMBOL *sym = (ELF_SYMBOL *)(elf + sec[s].offset);
+		const char *strtab = (const char *)elf + sec[sec[s].link].offset;
+		int n = sec[s].size / sizeof(ELF_SYMBOL);
+		funcs = calloc(n, sizeof(FUNC));
+		for (int i = 0; i < n; i++) {
+			if ((sym[i].info & 15) != STT_FUNC || !sym[i].shndx) continue;	// defined functions only
+			funcs[numFuncs].addr = sym[i].value & ~1;	// Thumb bit
+			funcs[numFuncs].size = sym[i].size;
+			funcs[numFuncs].name = strtab + sym[i].name;
+			numFuncs++;
+		}
+		qsort(funcs, numFuncs, sizeof(FUNC), func_compare);
+		return 1;
+	}
+	return 0;
+}
+
+static FUNC *find_func(uint32_t pc) {
+	int lo = 0, hi = numFuncs - 1, found = -1;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (funcs[mid].addr <= pc) {
+			found = mid;
+			lo = mid + 1;
+		}
+		else
+			hi = mid - 1;
+	}
+	if (found < 0) return NULL;
+	// symbols without a size run up to the next one
+	if (funcs[found].size && pc >= funcs[found].addr + funcs[found].size) return NULL;
+	return &funcs[found];
+}
+
+static int sample_compare(const void *p1, const void *p2) {
+	const PROF_ENTRY *a = p1, *b = p2;
+	return a->count > b->count ? -1 : a->count < b->count;
+}
+
+static int samples_compare(const void *p1, const void *p2) {
+	const FUNC *a = p1, *b = p2;
+	return a->samples > b->samples ? -1 : a->samples < b->samples;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: unoprof [options] <firmware.elf> <UNOPROF.BIN>\n"
+		"  -a        list every sampled address too\n"
+		"  -n N      show the N busiest functions (default 30, 0 for all)\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[]) {
+	int all = 0, top = 30, c;
+	long elfSize, profSize;
+	uint8_t *elf, *prof;
+
+	while ((c = getopt(argc, argv, "an:")) != -1) {
+		switch (c) {
+		case 'a': all = 1; break;
+		case 'n': top = atoi(optarg); break;
+		default: usage();
+		}
+	}
+	if (optind != argc - 2) usage();
+
+	if (!(elf = load(argv[optind], &elfSize)) || !read_symbols(elf, elfSize)) {
+		fprintf(stderr, "can't read the symbols from %s (a 32 bit ELF with a symbol table)\n", argv[optind]);
+		return 1;
+	}
+	PROF_HEADER *hdr;
+	if (!(prof = load(argv[optind + 1], &profSize)) || profSize < (long)sizeof(PROF_HEADER) ||
+			memcmp((hdr = (PROF_HEADER *)prof)->magic, "UNOPROF", 8)) {
+		fprintf(stderr, "%s isn't a profile\n", argv[optind + 1]);
+		return 1;
+	}
+	if (hdr->version != PROF_VERSION || sizeof(PROF_HEADER) + (uint64_t)hdr->count * sizeof(PROF_ENTRY) > (uint64_t)profSize) {
+		fprintf(stderr, "%s is the wrong version or cut short\n", argv[optind + 1]);
+		return 1;
+	}
+	PROF_ENTRY *samples = (PROF_ENTRY *)(prof + sizeof(PROF_HEADER));
+	uint64_t total = 0, unknown = 0;
+
+	for (uint32_t i = 0; i < hdr->count; i++) {
+		FUNC *f = find_func(samples[i].pc);
+		if (f) f->samples += samples[i].count;
+		else unknown += samples[i].count;
+		total += samples[i].count;
+	}
+	printf("%u samples at %u Hz (%.1f s of firmware time), %u dropped (table full)\n",
+		hdr->samples, hdr->hz, hdr->hz ? (double)hdr->samples / hdr->hz : 0.0, hdr->dropped);
+	if (!total) return 0;
+
+	qsort(funcs, numFuncs, sizeof(FUNC), samples_compare);
+	printf("\n %8s %6s  %s\n", "samples", "%", "function");
+	for (int i = 0; i < numFuncs && funcs[i].samples && (!top || i < top); i++)
+		printf(" %8llu %6.2f  %s\n", (unsigned long long)funcs[i].samples, 100.0 * funcs[i].samples / total, funcs[i].name);
+	if (unknown)
+		printf(" %8llu %6.2f  (not in any function)\n", (unsigned long long)unknown, 100.0 * unknown / total);
+
+	if (all) {
+		qsort(funcs, numFuncs, sizeof(FUNC), func_compare);
+		qsort(samples, hdr->count, sizeof(PROF_ENTRY), sample_compare);
+		printf("\n %8s %6s  %-10s %s\n", "samples", "%", "address", "where");
+		for (uint32_t i = 0; i < hdr->count; i++) {
+			FUNC *f = find_func(samples[i].pc);
+			printf(" %8u %6.2f  0x%08x ", samples[i].count, 100.0 * samples[i].count / total, samples[i].pc);
+			if (f) printf("%s+0x%x\n", f->name, samples[i].pc - f->addr);
+			else printf("?\n");
+		}
+	}
+	return 0;
+}
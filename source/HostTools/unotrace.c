@@ -0,0 +1,308 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * unotrace - decode a bus trace (UNOTRACE.BIN) from a firmware built with
+ * UNOCART_TRACE, see src/bustrace.h
+ *
+ * Lists every access with its time, and with -c plays the reads back
+ * against the cart image to work out which 4k pages of it each half of the
+ * S4 and S5 windows was showing. A read that no page explains is reported,
+ * so a bank switch the emulation got wrong shows up at the access it went
+ * wrong at. Also lists the busiest addresses from a hot spots run
+ * (UNOHOT.BIN). See README.md.
+ */
+
+#include "bustrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* CONTROL_IN bits, active low */
+#define TR_S5		0x02
+#define TR_S4		0x04
+#define TR_CCTL		0x10
+#define TR_RW		0x20
+
+#define MAX_PAGES	256		// 1MB of 4k pages
+
+/* what each 4k half window could be showing: [S4/S5][low/high half] */
+typedef struct {
+	uint8_t cand[MAX_PAGES];
+	int numCand;
+	int page;				// the only candidate, or -1
+} WINDOW;
+
+static uint8_t *image;
+static int numPages;
+static WINDOW win[2][2];
+static int quiet = 0;
+static int top = 20;
+
+static const char *region(const TRACE_ENTRY *e) {
+	if (!(e->ctrl & TR_CCTL)) return "D5";
+	if (!(e->ctrl & TR_S4)) return "S4";
+	if (!(e->ctrl & TR_S5)) return "S5";
+	return "--";
+}
+
+static unsigned base_addr(const TRACE_ENTRY *e) {
+	if (!(e->ctrl & TR_CCTL)) return 0xD500 | (e->addr & 0xFF);
+	if (!(e->ctrl & TR_S4)) return 0x8000 | (e->addr & 0x1FFF);
+	if (!(e->ctrl & TR_S5)) return 0xA000 | (e->addr & 0x1FFF);
+	return e->addr;
+}
+
+static void window_reset(WINDOW *w) {
+	for (int i = 0; i < numPages; i++)
+		w->cand[i] = 1;
+	w->numCand = numPages;
+	w->page = -1;
+}
+
+static void window_report(const char *name, WINDOW *w, uint32_t index) {
+	int page = -1;
+	if (w->numCand == 1)
+		for (int i = 0; i < numPages; i++)
+			if (w->cand[i]) page = i;
+	if (page != -1 && page != w->page)
+		printf("%8u  %s = image $%05X\n", index, name, page * 4096);
+	w->page = page;
+}
+
+/* narrow down the pages a read could have come from. Returns 0 if the
+ * window had to be reset to explain it, -1 if nothing in the image could */
+static int window_read(WINDOW *w, unsigned offset, uint8_t data) {
+	int n = 0, reset = 0;
+	for (int i = 0; i < numPages; i++)
+		if (w->cand[i] && image[i * 4096 + offset] == data) n++;
+	if (!n) {
+		// switched without a CCTL access (or wrongly), start again
+		window_reset(w);
+		reset = 1;
+		for (int i = 0; i < numPages; i++)
+			if (image[i * 4096 + offset] == data) n++;
+		if (!n) return -1;
+	}
+	for (int i = 0; i < numPages; i++)
+		if (w->cand[i] && image[i * 4096 + offset] != data) w->cand[i] = 0;
+	w->numCand = n;
+	return reset ? 0 : 1;
+}
+
+static int load_image(const char *filename) {
+	FILE *f = fopen(filename, "rb");
+	long size, skip = 0;
+	char hdr[4];
+
+	if (!f) return 0;
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	rewind(f);
+	// .CAR files have a 16 byte header in front of the ROM
+	if (fread(hdr, 1, 4, f) == 4 && !memcmp(hdr, "CART", 4))
+		skip = 16;
+	size -= skip;
+	if (size <= 0 || size > MAX_PAGES * 4096) {
+		fclose(f);
+		return 0;
+	}
+	numPages = (size + 4095) / 4096;
+	image = calloc(numPages, 4096);
+	fseek(f, skip, SEEK_SET);
+	if (fread(image, 1, size, f) != (size_t)size) {
+		fclose(f);
+		return 0;
+	}
+	fclose(f);
+	return 1;
+}
+
+static const uint32_t *hotCounts;
+
+static int hot_compare(const void *a, const void *b) {
+	uint32_t ca = hotCounts[*(const int *)a], cb = hotCounts[*(const int *)b];
+	return ca < cb ? 1 : ca > cb ? -1 : *(const int *)a - *(const int *)b;
+}
+
+/* the buckets of a hot spots run, busiest first */
+static int hot_list(FILE *f, const char *name, const HOT_HEADER *hdr) {
+	uint32_t *counts = malloc(hdr->count * sizeof(uint32_t) + 1);
+	int *order = malloc(hdr->count * sizeof(int) + 1);
+	double total = 0, sum = 0;
+	uint32_t size = 1u << hdr->shift;
+
+	if (hdr->version != HOT_VERSION) {
+		fprintf(stderr, "%s is version %u, this is for version %u\n", name, hdr->version, HOT_VERSION);
+		return 1;
+	}
+	if (fread(counts, sizeof(uint32_t), hdr->count, f) != hdr->count) {
+		fprintf(stderr, "%s is cut short\n", name);
+		return 1;
+	}
+	for (uint32_t i = 0; i < hdr->count; i++) {
+		order[i] = i;
+		total += counts[i];
+	}
+	hotCounts = counts;
+	qsort(order, hdr->count, sizeof(int), hot_compare);
+
+	printf("cart type %u, %.0f reads of the cart in %.2f s\n", hdr->cartType, total,
+		hdr->cpuHz ? (double)hdr->cycles / hdr->cpuHz : 0);
+	printf("  addr          reads       %%   total %%\n");
+	for (uint32_t i = 0; i < hdr->count && (int)i < top && counts[order[i]]; i++) {
+		unsigned addr = 0x8000 + order[i] * size;
+		sum += counts[order[i]];
+		printf("$%04X-$%04X %10u  %6.2f  %6.2f\n", addr, addr + size - 1, counts[order[i]],
+			100.0 * counts[order[i]] / total, 100.0 * sum / total);
+	}
+	return 0;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: unotrace [options] <UNOTRACE.BIN or UNOHOT.BIN>\n"
+		"  -c FILE   replay the reads against this cart image (.CAR or raw)\n"
+		"  -q        with -c, only report bank changes and misses, not every access\n"
+		"  -n N      hot spots: how many to list (default 20)\n");
+	exit(2);
+}
+
+int main(int argc, char *argv[]) {
+	TRACE_HEADER hdr;
+	TRACE_ENTRY *trace;
+	char *cart = NULL;
+	FILE *f;
+	int c;
+
+	while ((c = getopt(argc, argv, "c:qn:")) != -1) {
+		switch (c) {
+		case 'c': cart = optarg; break;
+		case 'q': quiet = 1; break;
+		case 'n': top = atoi(optarg); break;
+		default: usage();
+		}
+	}
+	if (optind != argc - 1) usage();
+
+	if (!(f = fopen(argv[optind], "rb")) || fread(&hdr, sizeof(hdr), 1, f) != 1) {
+		fprintf(stderr, "%s isn't a bus trace\n", argv[optind]);
+		return 1;
+	}
+	// the headers are the same size
+	if (!memcmp(hdr.magic, "UNOHOT", 7)) {
+		HOT_HEADER hot;
+		memcpy(&hot, &hdr, sizeof(hot));
+		return hot_list(f, argv[optind], &hot);
+	}
+	if (memcmp(hdr.magic, "UNOTRACE", 8)) {
+		fprintf(stderr, "%s isn't a bus trace\n", argv[optind]);
+		return 1;
+	}
+	if (hdr.version != TRACE_VERSION) {
+		fprintf(stderr, "%s is version %u, this is for version %u\n", argv[optind], hdr.version, TRACE_VERSION);
+		return 1;
+	}
+	trace = malloc(hdr.count * sizeof(TRACE_ENTRY) + 1);
+	if (fread(trace, sizeof(TRACE_ENTRY), hdr.count, f) != hdr.count) {
+		fprintf(stderr, "%s is cut short\n", argv[optind]);
+		return 1;
+	}
+	fclose(f);
+	if (cart && !load_image(cart)) {
+		fprintf(stderr, "can't load %s (up to 1MB)\n", cart);
+		return 1;
+	}
+	if (!hdr.cpuHz) hdr.cpuHz = 168000000;
+
+	printf("cart type %u, %u accesses", hdr.cartType, hdr.count);
+	if (hdr.trigger != TRACE_NO_TRIGGER)
+		printf(", triggered at %u", hdr.trigger);
+	printf("\n");
+	if (!quiet)
+		printf("   index      time us   delta  bus   addr  data\n");
+
+	double t = 0;
+	uint32_t reads = 0, misses = 0, remaps = 0, switches = 0;
+	for (int s = 0; s < 2; s++)
+		for (int h = 0; h < 2; h++)
+			window_reset(&win[s][h]);
+
+	for (uint32_t i = 0; i < hdr.count; i++) {
+		const TRACE_ENTRY *e = &trace[i];
+		// the first delta is from starting the trace, not an access
+		double dt = i ? (double)e->cycles * 1e6 / hdr.cpuHz : 0;
+		int read = (e->ctrl & TR_RW) != 0;
+		t += dt;
+		if (!quiet)
+			printf("%8u %12.2f %7.2f  %s %c $%04X   $%02X%s\n", i, t, dt, region(e),
+				read ? 'R' : 'W', base_addr(e), e->data, i == hdr.trigger ? "  <- trigger" : "");
+		if (!cart)
+			continue;
+		if (!(e->ctrl & TR_CCTL)) {
+			// anything in $D5xx may have switched banks
+			for (int s = 0; s < 2; s++)
+				for (int h = 0; h < 2; h++)
+					window_reset(&win[s][h]);
+			switches++;
+			continue;
+		}
+		if (!read || (e->ctrl & (TR_S4|TR_S5)) == (TR_S4|TR_S5))
+			continue;
+		int s = !(e->ctrl & TR_S5);
+		int h = (e->addr >> 12) & 1;
+		WINDOW *w = &win[s][h];
+		char name[8];
+		sprintf(name, "$%04X", (s ? 0xA000 : 0x8000) + h * 0x1000);
+		reads++;
+		switch (window_read(w, e->addr & 0xFFF, e->data)) {
+		case -1:
+			misses++;
+			printf("%8u  %s R $%04X = $%02X: not in any page of the image\n", i, region(e), base_addr(e), e->data);
+			break;
+		case 0:
+			remaps++;
+			printf("%8u  %s changed without a $D5xx access\n", i, name);
+			// fall through
+		default:
+			window_report(name, w, i);
+		}
+	}
+
+	printf("%.0f us traced", t);
+	if (cart) {
+		printf(", %u reads checked, %u $D5xx accesses, %u unexplained reads, %u changes without $D5xx\n",
+			reads, switches, misses, remaps);
+		for (int s = 0; s < 2; s++)
+			for (int h = 0; h < 2; h++) {
+				WINDOW *w = &win[s][h];
+				printf("  $%04X: ", (s ? 0xA000 : 0x8000) + h * 0x1000);
+				if (w->numCand == numPages)
+					printf("not read since the last switch\n");
+				else if (w->page != -1)
+					printf("image $%05X\n", w->page * 4096);
+				else
+					printf("one of %d pages\n", w->numCand);
+			}
+	}
+	else
+		printf("\n");
+	return misses != 0;
+}
@@ -0,0 +1,1161 @@
+/*
+ * --------------------------------------
+ * UNOCart Host Tools (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * unowcet - worst case cycle counts of the cart emulation loops, from the
+ * machine code in the firmware's ELF file
+ *
+ * Each emulate_* function is decoded (the Thumb-2 gcc emits for them), and
+ * the registers holding constants are followed far enough to tell which
+ * loads and stores are CONTROL_IN, ADDR_IN, DATA_IN and DATA_OUT. Then every
+ * path from a CONTROL_IN poll to the next DATA_OUT store or DATA_IN load is
+ * walked and costed with the Cortex-M4's instruction timings. A path's
+ * figure is the poll loop's own length (the edge can come just after a
+ * poll) plus the path, and has to fit the function's budget. Functions it
+ * calls are costed the same way, entry to return. A path from a poll to the
+ * next one that doesn't touch the bus, such as the work done after phi2
+ * falls, has half a cycle. See README.md.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* just enough of ELF32, the firmware is little endian */
+typedef struct {
+	uint8_t ident[16];
+	uint16_t type, machine;
+	uint32_t version, entry, phoff, shoff, flags;
+	uint16_t ehsize, phentsize, phnum, shentsize, shnum, shstrndx;
+} ELF_HEADER;
+
+typedef struct {
+	uint32_t name, type, flags, addr, offset, size, link, info, addralign, entsize;
+} ELF_SECTION;
+
+typedef struct {
+	uint32_t name, value, size;
+	uint8_t info, other;
+	uint16_t shndx;
+} ELF_SYMBOL;
+
+#define SHT_PROGBITS	1
+#define SHT_SYMTAB		2
+#define SHF_ALLOC		2
+#define STT_FUNC		2
+#define ET_REL			1
+
+// the bus, as main.c has it
+#define CONTROL_IN_ADDR	0x40020810		// GPIOC->IDR
+#define ADDR_IN_ADDR	0x40020C10		// GPIOD->IDR
+#define DATA_IN_ADDR	0x40021010		// GPIOE->IDR
+#define DATA_OUT_ADDR	0x40021014		// GPIOE->ODR
+
+/* Cortex-M4 timings (TRM table 3-1), taking the slow end of each range. A
+   branch costs 1 + BRANCH_REFILL when taken. The GPIO ports are on AHB1,
+   and a load from them waits for the bus matrix. */
+#define BRANCH_REFILL	3
+#define PERIPH_LOAD		2		// extra cycles for a load from a peripheral
+#define DIV_CYCLES		12
+#define BARRIER_CYCLES	4
+/* Flash, as SystemInit sets it up: 5 wait states with the ART caches on and
+   prefetch off. Warm (the default), every fetch hits the ART; cold (-c),
+   every 16 byte line of code and every literal costs the wait states. */
+#define FLASH_WS		5
+#define FLASH_LINE		16
+#define ART_ICACHE		1024
+
+#define CPU_MHZ			168
+#define BUDGET_NS		230		// phi2 high (279ns NTSC) less the 6502's data setup time
+#define HALF_NS			279		// between polls, off the bus: half a cycle (NTSC)
+
+#define MAX_VISITS		20000000
+
+enum { K_ALU, K_LOAD, K_STORE, K_LDM, K_STM, K_BRANCH, K_CBRANCH, K_CALL, K_RETURN,
+	K_TABLE, K_INDIRECT, K_IT, K_BARRIER, K_UNKNOWN };
+
+enum { OP_NONE, OP_MOVI, OP_MOVT, OP_MOV, OP_ADDI, OP_SUBI, OP_ORRI, OP_ANDI, OP_BICI,
+	OP_EORI, OP_LSLI, OP_LIT };
+
+typedef struct {
+	uint32_t addr, target;
+	uint8_t len, kind, cycles, cond;	// cond: only runs some of the time (IT block, Bcc)
+	uint8_t op, rd, rn, rm;				// rm is 0xFF without a register offset
+	int32_t imm;						// offset of a load or store, or the operand of op
+	uint16_t writes;					// registers it changes
+	uint16_t extra;						// cycles for the address it touches, after const()
+	uint8_t io;							// IO_xxx
+	int tableLen;						// entries of a TBB/TBH
+} INSN;
+
+enum { IO_NONE, IO_CONTROL_IN, IO_ADDR_IN, IO_DATA_IN, IO_DATA_OUT, IO_OTHER };
+
+typedef struct {
+	uint32_t known;					// a bit per register
+	uint32_t val[16];
+} REGS;
+
+typedef struct FUNC {
+	uint32_t addr, size;
+	const char *name;
+	INSN **at;						// by (address - addr) / 2
+	int decoded, busy;
+	long wcet[2];					// entry to return, warm and cold; -1 unbounded, -2 not yet known
+	int failed;						// why it isn't bounded, FAIL_xxx
+	uint32_t why;					// where
+	const char *where;				// in which function
+} FUNC;
+
+static uint8_t *elf;
+static long elfSize;
+static ELF_SECTION *sections;
+static int numSections, relocatable;
+static FUNC *funcs;
+static int numFuncs;
+static int cold, verbose;
+
+static uint8_t *load(const char *filename, long *size) {
+	FILE *f = fopen(filename, "rb");
+	uint8_t *data;
+	if (!f) return NULL;
+	fseek(f, 0, SEEK_END);
+	*size = ftell(f);
+	rewind(f);
+	data = malloc(*size + 1);
+	if (fread(data, 1, *size, f) != (size_t)*size) {
+		free(data);
+		data = NULL;
+	}
+	fclose(f);
+	return data;
+}
+
+static int func_compare(const void *p1, const void *p2) {
+	const FUNC *a = p1, *b = p2;
+	return a->addr < b->addr ? -1 : a->addr > b->addr;
+}
+
+static int read_symbols(void) {
+	ELF_HEADER *h = (ELF_HEADER *)elf;
+	if (elfSize < (long)sizeof(ELF_HEADER) || memcmp(h->ident, "\177ELF", 4) || h->ident[4] != 1 || h->ident[5] != 1)
+		return 0;	// not a little endian ELF32
+	if (h->shoff + (uint64_t)h->shnum * sizeof(ELF_SECTION) > (uint64_t)elfSize)
+		return 0;
+	sections = (ELF_SECTION *)(elf + h->shoff);
+	numSections = h->shnum;
+	// an object file (for trying things out) has its code at 0 in its one section
+	relocatable = h->type == ET_REL;
+	for (int s = 0; s < h->shnum; s++) {
+		if (sections[s].type != SHT_SYMTAB || sections[s].link >= h->shnum) continue;
+		ELF_SYMBOL *sym = (ELF_SYMBOL *)(elf + sections[s].offset);
+		const char *strtab = (const char *)elf + sections[sections[s].link].offset;
+		int n = sections[s].size / sizeof(ELF_SYMBOL);
+		funcs = calloc(n, sizeof(FUNC));
+		for (int i = 0; i < n; i++) {
+			if ((sym[i].info & 15) != STT_FUNC || !sym[i].shndx || sym[i].shndx >= h->shnum) continue;
+			funcs[numFuncs].addr = (sym[i].value & ~1) + (relocatable ? sections[sym[i].shndx].addr : 0);
+			funcs[numFuncs].size = sym[i].size;
+			funcs[numFuncs].name = strtab + sym[i].name;
+			funcs[numFuncs].wcet[0] = funcs[numFuncs].wcet[1] = -2;
+			numFuncs++;
+		}
+		qsort(funcs, numFuncs, sizeof(FUNC), func_compare);
+		return 1;
+	}
+	return 0;
+}
+
+static FUNC *func_at(uint32_t addr) {
+	for (int i = 0; i < numFuncs; i++)
+		if (funcs[i].addr == addr) return &funcs[i];
+	return NULL;
+}
+
+static FUNC *func_named(const char *name) {
+	for (int i = 0; i < numFuncs; i++)
+		if (!strcmp(funcs[i].name, name)) return &funcs[i];
+	return NULL;
+}
+
+// the bytes at addr in the image, NULL if it isn't there
+static const uint8_t *image(uint32_t addr, uint32_t len) {
+	for (int s = 0; s < numSections; s++) {
+		ELF_SECTION *sec = &sections[s];
+		if (sec->type != SHT_PROGBITS || !(sec->flags & SHF_ALLOC)) continue;
+		if (addr >= sec->addr && addr + len <= sec->addr + sec->size && sec->offset + sec->size <= (uint64_t)elfSize)
+			return elf + sec->offset + (addr - sec->addr);
+	}
+	return NULL;
+}
+
+static int read16(uint32_t addr, uint16_t *v) {
+	const uint8_t *p = image(addr, 2);
+	if (!p) return 0;
+	*v = p[0] | p[1] << 8;
+	return 1;
+}
+
+static int read32(uint32_t addr, uint32_t *v) {
+	const uint8_t *p = image(addr, 4);
+	if (!p) return 0;
+	*v = p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+	return 1;
+}
+
+static int in_flash(uint32_t addr) {
+	return (addr >= 0x08000000 && addr < 0x08100000) || (relocatable && image(addr, 1));
+}
+
+static int bits(uint32_t x) {
+	int n = 0;
+	for (; x; x &= x - 1) n++;
+	return n;
+}
+
+static uint32_t expand_imm(uint32_t imm12) {
+	uint32_t imm8 = imm12 & 0xFF;
+	if (!(imm12 >> 10)) {
+		switch ((imm12 >> 8) & 3) {
+		case 0: return imm8;
+		case 1: return imm8 << 16 | imm8;
+		case 2: return imm8 << 24 | imm8 << 8;
+		default: return imm8 * 0x01010101;
+		}
+	}
+	uint32_t v = 0x80 | (imm12 & 0x7F), rot = imm12 >> 7;
+	return v >> rot | v << (32 - rot);
+}
+
+static int32_t sext(uint32_t x, int n) {
+	return (int32_t)(x << (32 - n)) >> (32 - n);
+}
+
+static void load_store(INSN *in, int load, int rt, int rn, int32_t imm, int rm) {
+	in->kind = load ? K_LOAD : K_STORE;
+	in->cycles = 2;
+	in->rd = rt;
+	in->rn = rn;
+	in->imm = imm;
+	in->rm = rm;
+	if (load) in->writes = 1 << rt;
+}
+
+static void alu(INSN *in, int op, int rd, int rn, int32_t imm) {
+	in->kind = K_ALU;
+	in->cycles = 1;
+	in->op = op;
+	in->rd = rd;
+	in->rn = rn;
+	in->imm = imm;
+	if (rd < 16) in->writes = 1 << rd;
+}
+
+static void decode16(INSN *in, uint16_t hw) {
+	uint32_t pc = in->addr + 4;
+	int lo = hw & 7, mid = (hw >> 3) & 7;
+
+	if (hw >> 13 == 0) {
+		if ((hw >> 11) < 3)		// LSL/LSR/ASR #imm
+			alu(in, (hw >> 11) == 0 ? OP_LSLI : OP_NONE, lo, mid, (hw >> 6) & 31);
+		else if ((hw >> 9 & 3) == 2)	// ADD/SUB #imm3
+			alu(in, (hw >> 9) & 1 ? OP_SUBI : OP_ADDI, lo, mid, (hw >> 6) & 7);
+		else
+			alu(in, OP_NONE, lo, 0, 0);
+	}
+	else if (hw >> 13 == 1) {
+		int rd = (hw >> 8) & 7, op = (hw >> 11) & 3;
+		if (op == 0) alu(in, OP_MOVI, rd, 0, hw & 0xFF);
+		else if (op == 1) alu(in, OP_NONE, 16, 0, 0);		// CMP
+		else alu(in, op == 2 ? OP_ADDI : OP_SUBI, rd, rd, hw & 0xFF);
+	}
+	else if (hw >> 10 == 0x10) {
+		int op = (hw >> 6) & 15;
+		alu(in, OP_NONE, (op == 8 || op == 10 || op == 11) ? 16 : lo, 0, 0);	// TST/CMP/CMN
+	}
+	else if (hw >> 10 == 0x11) {
+		int rd = lo | ((hw >> 4) & 8), rm = (hw >> 3) & 15;
+		switch ((hw >> 8) & 3) {
+		case 0: alu(in, OP_NONE, rd, 0, 0); break;		// ADD hi
+		case 1: alu(in, OP_NONE, 16, 0, 0); break;		// CMP hi
+		case 2: alu(in, OP_MOV, rd, rm, 0); break;		// MOV hi
+		default:
+			if (hw & 0x80) in->kind = K_INDIRECT;		// BLX reg
+			else in->kind = rm == 14 ? K_RETURN : K_INDIRECT;
+			in->cycles = 1 + BRANCH_REFILL;
+		}
+		if (rd == 15 && in->kind == K_ALU) {
+			in->kind = K_INDIRECT;
+			in->cycles = 1 + BRANCH_REFILL;
+		}
+	}
+	else if (hw >> 11 == 9) {		// LDR literal
+		load_store(in, 1, (hw >> 8) & 7, 15, (hw & 0xFF) * 4, 0xFF);
+		in->op = OP_LIT;
+	}
+	else if (hw >> 12 == 5) {		// register offset
+		int op = (hw >> 9) & 7;
+		load_store(in, op >= 3, lo, mid, 0, (hw >> 6) & 7);
+	}
+	else if (hw >> 13 == 3)			// LDR/STR(B) #imm
+		load_store(in, (hw >> 11) & 1, lo, mid, ((hw >> 6) & 31) * ((hw >> 12) & 1 ? 1 : 4), 0xFF);
+	else if (hw >> 12 == 8)			// LDRH/STRH #imm
+		load_store(in, (hw >> 11) & 1, lo, mid, ((hw >> 6) & 31) * 2, 0xFF);
+	else if (hw >> 12 == 9)			// SP relative
+		load_store(in, (hw >> 11) & 1, (hw >> 8) & 7, 13, (hw & 0xFF) * 4, 0xFF);
+	else if (hw >> 11 == 0x14)		// ADR
+		alu(in, OP_MOVI, (hw >> 8) & 7, 0, (pc & ~3) + (hw & 0xFF) * 4);
+	else if (hw >> 11 == 0x15)		// ADD rd, SP, #imm
+		alu(in, OP_NONE, (hw >> 8) & 7, 0, 0);
+	else if (hw >> 12 == 0xB) {
+		if ((hw & 0xFF00) == 0xB000)
+			alu(in, OP_NONE, 13, 0, 0);
+		else if ((hw & 0xF500) == 0xB100) {		// CBZ/CBNZ
+			in->kind = K_CBRANCH;
+			in->cycles = 1;
+			in->target = pc + (((hw >> 9) & 1) << 6 | ((hw >> 3) & 31) << 1);
+		}
+		else if ((hw & 0xFF00) == 0xB200 || (hw & 0xFF00) == 0xBA00)	// extend, REV
+			alu(in, OP_NONE, lo, 0, 0);
+		else if ((hw & 0xFE00) == 0xB400) {		// PUSH
+			in->kind = K_STM;
+			in->cycles = 1 + bits(hw & 0x1FF);
+			in->writes = 1 << 13;
+		}
+		else if ((hw & 0xFE00) == 0xBC00) {		// POP
+			in->kind = hw & 0x100 ? K_RETURN : K_LDM;
+			in->cycles = 1 + bits(hw & 0x1FF) + (hw & 0x100 ? BRANCH_REFILL : 0);
+			in->writes = (hw & 0xFF) | 1 << 13;
+		}
+		else if ((hw & 0xFFE8) == 0xB660)		// CPSIE/CPSID
+			alu(in, OP_NONE, 16, 0, 0);
+		else if ((hw & 0xFF00) == 0xBF00) {
+			if (hw & 15) {
+				in->kind = K_IT;
+				in->cycles = 1;
+				in->imm = hw & 0xFF;
+			}
+			else
+				alu(in, OP_NONE, 16, 0, 0);		// NOP, WFI ..
+		}
+		else
+			in->kind = K_UNKNOWN;
+	}
+	else if (hw >> 12 == 0xC) {		// STMIA/LDMIA
+		in->kind = (hw >> 11) & 1 ? K_LDM : K_STM;
+		in->cycles = 1 + bits(hw & 0xFF);
+		in->writes = 1 << ((hw >> 8) & 7) | ((hw >> 11) & 1 ? hw & 0xFF : 0);
+	}
+	else if (hw >> 12 == 0xD) {
+		if (((hw >> 8) & 15) >= 14)
+			in->kind = K_UNKNOWN;		// UDF, SVC
+		else {
+			in->kind = K_CBRANCH;
+			in->cycles = 1;
+			in->target = pc + sext(hw & 0xFF, 8) * 2;
+		}
+	}
+	else if (hw >> 11 == 0x1C) {	// B
+		in->kind = K_BRANCH;
+		in->cycles = 1 + BRANCH_REFILL;
+		in->target = pc + sext(hw & 0x7FF, 11) * 2;
+	}
+	else
+		in->kind = K_UNKNOWN;
+}
+
+static void decode32(INSN *in, uint16_t hw1, uint16_t hw2) {
+	uint32_t pc = in->addr + 4;
+	int rn = hw1 & 15, rd = (hw2 >> 8) & 15, rt = hw2 >> 12;
+
+	if ((hw1 & 0xFE40) == 0xE800) {		// LDM/STM, PUSH.W/POP.W
+		int l = (hw1 >> 4) & 1;
+		in->kind = l ? (hw2 & 0x8000 ? K_RETURN : K_LDM) : K_STM;
+		in->cycles = 1 + bits(hw2) + (l && (hw2 & 0x8000) ? BRANCH_REFILL : 0);
+		in->writes = (l ? hw2 & 0x7FFF : 0) | (hw1 & 0x20 ? 1 << rn : 0);
+	}
+	else if ((hw1 & 0xFFF0) == 0xE8D0 && (hw2 & 0xFFE0) == 0xF000) {	// TBB/TBH
+		in->kind = K_TABLE;
+		in->cycles = 2 + BRANCH_REFILL;
+		in->rn = rn;
+		in->rm = hw2 & 15;
+		in->imm = (hw2 >> 4) & 1;	// TBH
+	}
+	else if ((hw1 & 0xFE40) == 0xE840) {	// LDRD/STRD, LDREX/STREX
+		int dual = (hw1 & 0x120) != 0;
+		load_store(in, (hw1 >> 4) & 1, rt, rn, dual ? (hw2 & 0xFF) * 4 * (hw1 & 0x80 ? 1 : -1) : 0, 0xFF);
+		if (dual) {
+			in->cycles = 3;
+			if (in->kind == K_LOAD) in->writes |= 1 << rd;
+		}
+		else if (!((hw1 >> 4) & 1))
+			in->writes = 1 << rd;			// STREX status
+		if (hw1 & 0x20) in->writes |= 1 << rn;
+	}
+	else if ((hw1 & 0xFE00) == 0xEA00) {	// data processing, shifted register
+		int op = (hw1 >> 5) & 15, shifted = (hw2 & 0x70F0) != 0;
+		if ((op == 0 || op == 4 || op == 8 || op == 13) && rd == 15 && (hw1 & 0x10))
+			alu(in, OP_NONE, 16, 0, 0);		// TST/TEQ/CMN/CMP
+		else if (op == 2 && rn == 15 && !shifted)
+			alu(in, OP_MOV, rd, hw2 & 15, 0);
+		else
+			alu(in, OP_NONE, rd, 0, 0);
+	}
+	else if ((hw1 & 0xF800) == 0xF000 && !(hw2 & 0x8000)) {
+		uint32_t imm12 = (hw1 & 0x400) << 1 | (hw2 & 0x7000) >> 4 | (hw2 & 0xFF);
+		if (!(hw1 & 0x200)) {		// modified immediate
+			int op = (hw1 >> 5) & 15;
+			uint32_t imm = expand_imm(imm12);
+			if ((op == 0 || op == 4 || op == 8 || op == 13) && rd == 15 && (hw1 & 0x10))
+				alu(in, OP_NONE, 16, 0, 0);
+			else if ((op == 2 || op == 3) && rn == 15)
+				alu(in, OP_MOVI, rd, 0, op == 2 ? imm : ~imm);
+			else {
+				static const uint8_t ops[16] = { OP_ANDI, OP_BICI, OP_ORRI, OP_NONE, OP_EORI, OP_NONE, OP_NONE, OP_NONE,
+					OP_ADDI, OP_NONE, OP_NONE, OP_NONE, OP_NONE, OP_SUBI, OP_NONE, OP_NONE };
+				alu(in, ops[op], rd, rn, imm);
+			}
+		}
+		else {						// plain binary immediate
+			int op = (hw1 >> 4) & 31;
+			if (op == 0 || op == 10) {	// ADDW/SUBW, ADR
+				if (rn == 15) alu(in, OP_MOVI, rd, 0, (pc & ~3) + (op ? -(int32_t)imm12 : (int32_t)imm12));
+				else alu(in, op ? OP_SUBI : OP_ADDI, rd, rn, imm12);
+			}
+			else if (op == 4 || op == 12)	// MOVW/MOVT
+				alu(in, op == 4 ? OP_MOVI : OP_MOVT, rd, rd, (hw1 & 15) << 12 | imm12);
+			else
+				alu(in, OP_NONE, rd, 0, 0);	// bitfields, saturation
+		}
+	}
+	else if ((hw1 & 0xF800) == 0xF000) {	// branches and misc control
+		int op1 = (hw2 >> 12) & 7;
+		uint32_t s = (hw1 >> 10) & 1, j1 = (hw2 >> 13) & 1, j2 = (hw2 >> 11) & 1;
+		if (!(op1 & 5)) {
+			if (((hw1 >> 7) & 7) != 7) {	// Bcc.W
+				in->kind = K_CBRANCH;
+				in->cycles = 1;
+				in->target = pc + sext(s << 20 | j2 << 19 | j1 << 18 | (hw1 & 0x3F) << 12 | (hw2 & 0x7FF) << 1, 21);
+			}
+			else if ((hw1 & 0xFFF0) == 0xF3B0) {
+				in->kind = K_BARRIER;
+				in->cycles = BARRIER_CYCLES;
+			}
+			else if ((hw1 & 0xFFF0) == 0xF3E0)
+				alu(in, OP_NONE, rd, 0, 0);		// MRS
+			else
+				alu(in, OP_NONE, 16, 0, 0);		// MSR, hints
+		}
+		else if (op1 & 1) {
+			uint32_t i1 = !(j1 ^ s), i2 = !(j2 ^ s);
+			in->target = pc + sext(s << 24 | i1 << 23 | i2 << 22 | (hw1 & 0x3FF) << 12 | (hw2 & 0x7FF) << 1, 25);
+			in->cycles = 1 + BRANCH_REFILL;
+			if (op1 & 4) {
+				in->kind = K_CALL;
+				in->writes = 0x500F | 1 << 14;		// r0-r3, r12, lr
+			}
+			else
+				in->kind = K_BRANCH;
+		}
+		else
+			in->kind = K_UNKNOWN;		// BLX to ARM code
+	}
+	else if ((hw1 & 0xFE00) == 0xF800) {	// single loads and stores
+		int l = (hw1 >> 4) & 1, size = (hw1 >> 5) & 3;
+		int32_t off;
+		int rm = 0xFF, wb = 0;
+		if (rn == 15)
+			off = (hw1 & 0x80) ? (hw2 & 0xFFF) : -(int32_t)(hw2 & 0xFFF);
+		else if (hw1 & 0x80)
+			off = hw2 & 0xFFF;
+		else if (hw2 & 0x800) {
+			int p = (hw2 >> 10) & 1, u = (hw2 >> 9) & 1;
+			off = p ? (u ? (hw2 & 0xFF) : -(int32_t)(hw2 & 0xFF)) : 0;
+			wb = (hw2 >> 8) & 1 || !p;
+		}
+		else {
+			off = 0;
+			rm = hw2 & 15;
+		}
+		if (l && rt == 15) {
+			if (size == 2) {
+				// LDR pc: POP {pc} when it's off the stack
+				in->kind = rn == 13 && wb ? K_RETURN : K_INDIRECT;
+				in->cycles = 2 + BRANCH_REFILL;
+			}
+			else
+				alu(in, OP_NONE, 16, 0, 0);		// PLD
+		}
+		else {
+			load_store(in, l, rt, rn, off, rm);
+			if (l && rn == 15 && size == 2) in->op = OP_LIT;
+			if (wb) in->writes |= 1 << rn;
+		}
+	}
+	else if ((hw1 & 0xFF00) == 0xFA00)		// data processing, register
+		alu(in, OP_NONE, rd, 0, 0);
+	else if ((hw1 & 0xFF80) == 0xFB00) {	// MUL, MLA, MLS
+		alu(in, OP_NONE, rd, 0, 0);
+		in->cycles = ((hw2 >> 12) & 15) == 15 ? 1 : 2;
+	}
+	else if ((hw1 & 0xFF80) == 0xFB80) {
+		if ((hw2 & 0xF0) == 0xF0) {			// SDIV/UDIV
+			alu(in, OP_NONE, rd, 0, 0);
+			in->cycles = DIV_CYCLES;
+		}
+		else {								// long multiplies
+			alu(in, OP_NONE, rd, 0, 0);
+			in->writes |= 1 << rt;
+		}
+	}
+	else
+		in->kind = K_UNKNOWN;				// coprocessor, FPU
+}
+
+static INSN *decode_at(FUNC *f, uint32_t addr, int cond) {
+	uint32_t i = (addr - f->addr) / 2;
+	uint16_t hw1, hw2;
+	if (addr < f->addr || addr >= f->addr + f->size || (addr & 1)) return NULL;
+	if (f->at[i]) return f->at[i];
+	INSN *in = calloc(1, sizeof(INSN));
+	in->addr = addr;
+	in->rm = 0xFF;
+	in->cond = cond;
+	if (!read16(addr, &hw1))
+		in->kind = K_UNKNOWN;
+	else if ((hw1 >> 11) >= 0x1D) {
+		in->len = 4;
+		if (!read16(addr + 2, &hw2)) in->kind = K_UNKNOWN;
+		else decode32(in, hw1, hw2);
+	}
+	else {
+		in->len = 2;
+		decode16(in, hw1);
+	}
+	if (in->kind == K_LOAD && in->op == OP_LIT)
+		in->target = ((addr + 4) & ~3) + in->imm;
+	// IT blocks turn a branch into a conditional one, and a return
+	if (cond && in->kind == K_BRANCH)
+		in->kind = K_CBRANCH;
+	f->at[i] = in;
+	return in;
+}
+
+// a TBB/TBH's entries, from the CMP that bounds its index
+static int table_len(FUNC *f, INSN *t) {
+	for (uint32_t a = t->addr - 2; a + 8 >= t->addr && a >= f->addr; a -= 2) {
+		uint16_t hw;
+		if (!read16(a, &hw)) break;
+		// CMP Rm, #imm8 (16 bit)
+		if ((hw & 0xF800) == 0x2800 && ((hw >> 8) & 7) == t->rm)
+			return (hw & 0xFF) + 1;
+		if (a >= f->addr + 2) {
+			uint16_t hw0, hw1;
+			// CMP.W Rm, #imm
+			if (read16(a - 2, &hw0) && read16(a, &hw1) && (hw0 & 0xFBF0) == 0xF1B0 && (hw0 & 15) == t->rm
+					&& (hw1 & 0x8F00) == 0x0F00)
+				return expand_imm((hw0 & 0x400) << 1 | (hw1 & 0x7000) >> 4 | (hw1 & 0xFF)) + 1;
+		}
+	}
+	return 0;
+}
+
+static uint32_t table_target(INSN *t, int i) {
+	uint32_t base = t->addr + 4;
+	uint16_t e = 0;
+	if (t->imm) read16(base + i * 2, &e);
+	else {
+		const uint8_t *p = image(base + i, 1);
+		e = p ? *p : 0;
+	}
+	return base + e * 2;
+}
+
+static int successors(INSN *in, uint32_t *next) {
+	int n = 0;
+	switch (in->kind) {
+	case K_BRANCH:
+		next[n++] = in->target;
+		break;
+	case K_CBRANCH:
+		next[n++] = in->target;
+		next[n++] = in->addr + in->len;
+		break;
+	case K_RETURN:
+	case K_INDIRECT:
+		if (in->cond) next[n++] = in->addr + in->len;
+		break;
+	case K_TABLE:
+		for (int i = 0; i < in->tableLen && n < 256; i++)
+			next[n++] = table_target(in, i);
+		break;
+	case K_UNKNOWN:
+		break;
+	default:
+		next[n++] = in->addr + in->len;
+	}
+	return n;
+}
+
+
+// decode everything reachable from the entry point, which keeps clear of the literal pools
+static void decode_func(FUNC *f) {
+	uint32_t *work, next[256];
+	uint8_t *seen;
+	int top = 0;
+	if (f->decoded) return;
+	f->decoded = 1;
+	f->at = calloc(f->size / 2 + 1, sizeof(INSN *));
+	seen = calloc(f->size / 2 + 1, 1);
+	work = malloc(sizeof(uint32_t) * (f->size * 2 + 256));
+	work[top++] = f->addr;
+	while (top) {
+		uint32_t addr = work[--top];
+		INSN *in = decode_at(f, addr, 0);
+		if (!in || seen[(addr - f->addr) / 2]) continue;
+		seen[(addr - f->addr) / 2] = 1;
+		if (in->kind == K_IT) {
+			// the instructions an IT block covers are conditional
+			int count = 4 - __builtin_ctz(in->imm & 15);
+			uint32_t a = addr + 2;
+			for (int i = 0; i < count; i++) {
+				INSN *c = decode_at(f, a, 1);
+				if (!c) break;
+				a += c->len;
+			}
+		}
+		if (in->kind == K_TABLE) in->tableLen = table_len(f, in);
+		int n = successors(in, next);
+		for (int i = 0; i < n && top < (int)f->size * 2 + 256; i++)
+			work[top++] = next[i];
+	}
+	free(work);
+	free(seen);
+}
+
+static INSN *insn(FUNC *f, uint32_t addr) {
+	if (addr < f->addr || addr >= f->addr + f->size) return NULL;
+	return f->at[(addr - f->addr) / 2];
+}
+
+/* Constant registers, to see where the loads and stores go: every
+   instruction gets the registers known on every way into it. */
+static void apply(INSN *in, REGS *r) {
+	REGS old = *r;
+	uint32_t v = 0;
+	int ok = 0, rn = in->rn & 15;
+	switch (in->op) {
+	case OP_MOVI: v = in->imm; ok = 1; break;
+	case OP_MOVT: v = (r->val[in->rd] & 0xFFFF) | (uint32_t)in->imm << 16; ok = r->known >> in->rd & 1; break;
+	case OP_MOV: v = r->val[rn]; ok = r->known >> rn & 1; break;
+	case OP_ADDI: v = r->val[rn] + in->imm; ok = r->known >> rn & 1; break;
+	case OP_SUBI: v = r->val[rn] - in->imm; ok = r->known >> rn & 1; break;
+	case OP_ORRI: v = r->val[rn] | in->imm; ok = r->known >> rn & 1; break;
+	case OP_ANDI: v = r->val[rn] & in->imm; ok = r->known >> rn & 1; break;
+	case OP_BICI: v = r->val[rn] & ~in->imm; ok = r->known >> rn & 1; break;
+	case OP_EORI: v = r->val[rn] ^ in->imm; ok = r->known >> rn & 1; break;
+	case OP_LSLI: v = r->val[rn] << in->imm; ok = r->known >> rn & 1; break;
+	case OP_LIT: ok = read32(in->target, &v); break;
+	}
+	r->known &= ~in->writes;
+	if (ok && in->rd < 15 && (in->writes >> in->rd & 1)) {
+		r->known |= 1 << in->rd;
+		r->val[in->rd] = v;
+	}
+	if (in->cond) {
+		// it may not run, so only what it leaves as it was is known
+		for (int i = 0; i < 16; i++)
+			if ((in->writes >> i & 1) && !((old.known >> i & 1) && (r->known >> i & 1) && old.val[i] == r->val[i]))
+				r->known &= ~(1 << i);
+	}
+}
+
+static int join(REGS *into, const REGS *from, int first) {
+	uint32_t known = into->known;
+	if (first) {
+		*into = *from;
+		return 1;
+	}
+	for (int i = 0; i < 16; i++)
+		if ((known >> i & 1) && (!(from->known >> i & 1) || from->val[i] != into->val[i]))
+			known &= ~(1 << i);
+	if (known == into->known) return 0;
+	into->known = known;
+	return 1;
+}
+
+static int io_of(uint32_t addr) {
+	switch (addr) {
+	case CONTROL_IN_ADDR: return IO_CONTROL_IN;
+	case ADDR_IN_ADDR: return IO_ADDR_IN;
+	case DATA_IN_ADDR: return IO_DATA_IN;
+	case DATA_OUT_ADDR: return IO_DATA_OUT;
+	}
+	return addr >= 0x40000000 && addr < 0x60000000 ? IO_OTHER : IO_NONE;
+}
+
+static void classify(FUNC *f) {
+	int n = f->size / 2 + 1;
+	REGS *regs = calloc(n, sizeof(REGS));
+	uint8_t *have = calloc(n, 1);
+	uint32_t *work = malloc(sizeof(uint32_t) * n * 4), next[256];
+	int top = 0;
+
+	work[top++] = f->addr;
+	have[0] = 1;
+	while (top) {
+		uint32_t addr = work[--top];
+		INSN *in = insn(f, addr);
+		if (!in) continue;
+		REGS r = regs[(addr - f->addr) / 2];
+		apply(in, &r);
+		int ns = successors(in, next);
+		for (int i = 0; i < ns; i++) {
+			uint32_t j = (next[i] - f->addr) / 2;
+			if (!insn(f, next[i])) continue;
+			if (join(&regs[j], &r, !have[j]) && top < n * 4)
+				work[top++] = next[i];
+			have[j] = 1;
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		INSN *in = f->at[i];
+		if (!in || (in->kind != K_LOAD && in->kind != K_STORE)) continue;
+		REGS *r = &regs[i];
+		int load = in->kind == K_LOAD;
+		if (in->rn == 15) {
+			// literals, cached in the ART when warm
+			if (cold) in->extra = FLASH_WS;
+		}
+		else if (in->rn == 13)
+			;	// the stack, in SRAM
+		else if (!(r->known >> in->rn & 1)) {
+			// through a pointer it can't follow: SRAM or a peripheral, as the cart images are never in flash
+			if (load) in->extra = PERIPH_LOAD;
+		}
+		else {
+			uint32_t a = r->val[in->rn] + in->imm;
+			if (in->rm == 0xFF) in->io = io_of(a);
+			if (load && a >= 0x40000000 && a < 0x60000000) in->extra = PERIPH_LOAD;
+			// tables in flash are read all over, so the ART's 8 lines of data don't help
+			else if (load && in_flash(a)) in->extra = FLASH_WS;
+		}
+	}
+	free(regs);
+	free(have);
+	free(work);
+}
+
+/* Paths. Every one from a CONTROL_IN poll goes on until the next poll, or
+   a DATA_OUT store or DATA_IN load (the end of it), and is costed. The ones
+   that get to a poll without touching the bus are costed too. */
+enum { WALK_RETURN, WALK_LOOP, WALK_BUS, WALK_HALF };
+
+typedef struct {
+	FUNC *f;
+	int mode;				// WALK_xxx
+	INSN *poll;
+	uint8_t *reach;			// can get to the end of the walk from here
+	uint8_t *onPath;
+	uint32_t *path, *bestPath;
+	int depth, bestDepth;
+	long best;
+	INSN *bestEnd;
+	long visits;
+	int failed;				// FAIL_xxx
+	uint32_t why;			// where
+	const char *callee;
+} WALK;
+
+enum { FAIL_NONE, FAIL_LOOP, FAIL_FOLLOW, FAIL_CALL, FAIL_RECURSE, FAIL_PATHS };
+
+static long func_wcet(FUNC *f);
+
+static int is_poll(INSN *in) {
+	return in && in->kind == K_LOAD && in->io == IO_CONTROL_IN;
+}
+
+static int is_bus_end(INSN *in) {
+	return in && ((in->kind == K_STORE && in->io == IO_DATA_OUT) || (in->kind == K_LOAD && in->io == IO_DATA_IN));
+}
+
+static int cant_follow(INSN *in) {
+	return in->kind == K_INDIRECT || in->kind == K_UNKNOWN || (in->kind == K_TABLE && !in->tableLen);
+}
+
+static void fail(WALK *w, int why, uint32_t addr, const char *callee) {
+	if (w->failed) return;
+	w->failed = why;
+	w->why = addr;
+	w->callee = callee;
+}
+
+// what it costs to fetch in, if the code is cold
+static int fetch(INSN *in, uint32_t *line) {
+	int c = 0;
+	if (!cold) return 0;
+	for (uint32_t l = in->addr / FLASH_LINE; l <= (in->addr + in->len - 1) / FLASH_LINE; l++)
+		if (l != *line) {
+			c += FLASH_WS;
+			*line = l;
+		}
+	return c;
+}
+
+static void walk(WALK *w, uint32_t addr, long cost, uint32_t line) {
+	FUNC *f = w->f;
+	INSN *in = insn(f, addr);
+	uint32_t next[256];
+
+	if (w->failed) return;
+	if (!in) {
+		fail(w, FAIL_FOLLOW, addr, NULL);
+		return;
+	}
+	if (++w->visits > MAX_VISITS) {
+		fail(w, FAIL_PATHS, addr, NULL);
+		return;
+	}
+	if (w->mode == WALK_LOOP && in == w->poll) {
+		if (cost > w->best) {
+			w->best = cost;
+			w->bestEnd = in;
+		}
+		return;
+	}
+	if (w->mode == WALK_HALF && is_poll(in)) {
+		if (cost > w->best) {
+			w->best = cost;
+			w->bestEnd = in;
+			w->bestDepth = w->depth;
+			memcpy(w->bestPath, w->path, w->depth * sizeof(uint32_t));
+		}
+		return;
+	}
+	int i = (addr - f->addr) / 2;
+	if (w->mode != WALK_RETURN && is_poll(in)) return;
+	if (!w->reach[i]) return;
+	if (w->onPath[i]) {
+		fail(w, FAIL_LOOP, addr, NULL);
+		return;
+	}
+	if (cant_follow(in)) {
+		fail(w, FAIL_FOLLOW, addr, NULL);
+		return;
+	}
+	cost += in->cycles + in->extra + fetch(in, &line);
+	if (in->kind == K_CALL) {
+		FUNC *callee = func_at(in->target);
+		long c = callee ? func_wcet(callee) : -1;
+		if (c < 0) {
+			if (callee) fail(w, callee->failed, callee->why, callee->where);
+			else fail(w, FAIL_CALL, in->target, NULL);
+			return;
+		}
+		cost += c;
+		line = 0xFFFFFFFF;
+	}
+	w->path[w->depth++] = addr;
+	if ((w->mode == WALK_BUS && is_bus_end(in)) || (w->mode == WALK_RETURN && in->kind == K_RETURN)) {
+		if (cost > w->best) {
+			w->best = cost;
+			w->bestEnd = in;
+			w->bestDepth = w->depth;
+			memcpy(w->bestPath, w->path, w->depth * sizeof(uint32_t));
+		}
+		if (!(w->mode == WALK_RETURN && in->cond)) {
+			w->depth--;
+			return;
+		}
+	}
+	w->onPath[i] = 1;
+	int n = successors(in, next);
+	for (int s = 0; s < n; s++) {
+		uint32_t l = line;
+		long c = cost;
+		if (in->kind == K_CBRANCH && s == 0) c += BRANCH_REFILL;
+		if (in->kind == K_RETURN) c -= in->cycles - 1;	// an IT'd return that didn't
+		walk(w, next[s], c, l);
+	}
+	w->onPath[i] = 0;
+	w->depth--;
+}
+
+// which instructions can get to the end of a walk without passing a poll
+static uint8_t *reachable(FUNC *f, int mode, INSN *poll) {
+	int n = f->size / 2 + 1, changed = 1;
+	uint8_t *reach = calloc(n, 1);
+	uint32_t next[256];
+	while (changed) {
+		changed = 0;
+		for (int i = 0; i < n; i++) {
+			INSN *in = f->at[i];
+			if (!in || reach[i]) continue;
+			int r = 0;
+			if (mode == WALK_RETURN) r = 1;
+			else if (mode == WALK_BUS && is_bus_end(in)) r = 1;
+			else if (mode == WALK_HALF && is_poll(in)) r = 1;
+			else if (mode == WALK_HALF && is_bus_end(in)) ;
+			else if (cant_follow(in)) r = 1;	// so the walk says so
+			else if (!is_poll(in)) {
+				int ns = successors(in, next);
+				for (int s = 0; s < ns && !r; s++) {
+					INSN *t = insn(f, next[s]);
+					if (!t) r = 1;
+					else if (mode == WALK_LOOP && t == poll) r = 1;
+					else r = reach[(next[s] - f->addr) / 2];
+				}
+			}
+			if (r) {
+				reach[i] = 1;
+				changed = 1;
+			}
+		}
+	}
+	return reach;
+}
+
+static void walk_init(WALK *w, FUNC *f, int mode, INSN *poll) {
+	memset(w, 0, sizeof(WALK));
+	w->f = f;
+	w->mode = mode;
+	w->poll = poll;
+	w->reach = reachable(f, mode, poll);
+	w->onPath = calloc(f->size / 2 + 1, 1);
+	w->path = malloc(sizeof(uint32_t) * (f->size / 2 + 1));
+	w->bestPath = malloc(sizeof(uint32_t) * (f->size / 2 + 1));
+	w->best = -1;
+}
+
+static void walk_free(WALK *w) {
+	free(w->reach);
+	free(w->onPath);
+	free(w->path);
+	free(w->bestPath);
+}
+
+static void prepare(FUNC *f) {
+	if (f->decoded) return;
+	decode_func(f);
+	classify(f);
+}
+
+// entry to return, with what it calls; -1 if that isn't bounded
+static long func_wcet(FUNC *f) {
+	WALK w;
+	if (f->wcet[cold] != -2)
+		return f->wcet[cold];
+	if (f->busy || !f->size) {
+		// recursive, or no size to decode it by
+		f->failed = f->busy ? FAIL_RECURSE : FAIL_CALL;
+		f->why = f->addr;
+		f->where = f->name;
+		return -1;
+	}
+	prepare(f);
+	f->busy = 1;
+	walk_init(&w, f, WALK_RETURN, NULL);
+	walk(&w, f->addr, 0, 0xFFFFFFFF);
+	f->busy = 0;
+	f->wcet[cold] = w.failed ? -1 : w.best;
+	if (w.failed) {
+		f->failed = w.failed;
+		f->why = w.why;
+		f->where = w.callee ? w.callee : f->name;
+	}
+	walk_free(&w);
+	return f->wcet[cold];
+}
+
+typedef struct {
+	const char *name;
+	long cycles;
+} BUDGET;
+
+static const char *failure(int why) {
+	switch (why) {
+	case FAIL_LOOP: return "a loop with no poll in it";
+	case FAIL_FOLLOW: return "a jump it can't follow";
+	case FAIL_CALL: return "a call to code it can't find";
+	case FAIL_RECURSE: return "recursion";
+	case FAIL_PATHS: return "too many paths";
+	}
+	return "";
+}
+
+static void print_path(WALK *w) {
+	for (int i = 0; i < w->bestDepth; i++)
+		printf("%s%x", i % 12 ? " " : "\n      ", w->bestPath[i]);
+	printf("\n");
+}
+
+static void print_failure(FUNC *f, uint32_t a, WALK *w) {
+	printf("  %s: poll at %x: %s at %x%s%s\n", f->name, a, failure(w->failed), w->why,
+		w->callee ? " in " : "", w->callee ? w->callee : "");
+}
+
+/* the worst poll to bus path of f, and the worst from a poll to the next
+   without the bus; 0 if they're within budget */
+static int check(FUNC *f, long budget, long half, int mhz) {
+	long worst = -1, worstHalf = -1;
+	int bad = 0, polls = 0;
+	prepare(f);
+	for (uint32_t a = f->addr; a < f->addr + f->size; a += 2) {
+		INSN *p = insn(f, a);
+		WALK loop, bus, quiet;
+		if (!is_poll(p)) continue;
+		uint32_t line = p->addr / FLASH_LINE;
+		long pc = p->cycles + p->extra + (cold ? FLASH_WS : 0);
+
+		walk_init(&bus, f, WALK_BUS, p);
+		walk(&bus, a + p->len, 0, line);
+		walk_init(&quiet, f, WALK_HALF, p);
+		walk(&quiet, a + p->len, 0, line);
+		if (bus.best < 0 && !bus.failed && quiet.best < 0 && !quiet.failed) {
+			// nothing after this one
+			walk_free(&bus);
+			walk_free(&quiet);
+			continue;
+		}
+		polls++;
+		walk_init(&loop, f, WALK_LOOP, p);
+		walk(&loop, a + p->len, pc, line);
+		long period = loop.best < 0 ? 0 : loop.best;
+		if (loop.failed || bus.failed) {
+			print_failure(f, a, loop.failed ? &loop : &bus);
+			bad = 1;
+		}
+		else if (bus.best >= 0) {
+			long total = period + bus.best;
+			if (total > worst) worst = total;
+			if (verbose || total > budget) {
+				printf("  %s: poll at %x, %ld cycles round, then %ld to the %s at %x%s\n", f->name, a,
+					period, bus.best, bus.bestEnd->kind == K_STORE ? "DATA_OUT store" : "DATA_IN load",
+					bus.bestEnd->addr, total > budget ? " - over budget" : "");
+				if (verbose > 1 || total > budget) {
+					printf("    worst path:");
+					print_path(&bus);
+				}
+			}
+			if (total > budget) bad = 1;
+		}
+		if (!loop.failed && quiet.failed) {
+			print_failure(f, a, &quiet);
+			bad = 1;
+		}
+		else if (!loop.failed && quiet.best >= 0) {
+			long total = period + quiet.best;
+			if (total > worstHalf) worstHalf = total;
+			if (verbose || total > half) {
+				printf("  %s: poll at %x, %ld cycles round, then %ld off the bus to the poll at %x%s\n",
+					f->name, a, period, quiet.best, quiet.bestEnd->addr, total > half ? " - over half a cycle" : "");
+				if (verbose > 1 || total > half) {
+					printf("    worst path:");
+					print_path(&quiet);
+				}
+			}
+			if (total > half) bad = 1;
+		}
+		walk_free(&loop);
+		walk_free(&bus);
+		walk_free(&quiet);
+	}
+	if (!polls) {
+		printf("  %s: no CONTROL_IN polls found\n", f->name);
+		return 1;
+	}
+	printf("%-28s ", f->name);
+	if (worst < 0) printf("%6s %6ld %7s", "-", budget, "-");
+	else printf("%6ld %6ld %7.0f", worst, budget, worst * 1000.0 / mhz);
+	if (worstHalf < 0) printf(" %6s %6ld", "-", half);
+	else printf(" %6ld %6ld", worstHalf, half);
+	printf(" %s\n", bad ? "FAIL" : "ok");
+	if (!cold && f->size > ART_ICACHE)
+		printf("  %s: %u bytes, more than the ART's %d; -c gives the figure without it\n",
+			f->name, f->size, ART_ICACHE);
+	return bad;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"usage: unowcet [options] <firmware.elf> [function ..]\n"
+		"  -b F=N    budget of N cycles for function F (any number of these)\n"
+		"  -t NS     budget for the rest, in ns (default %d)\n"
+		"  -l NS     budget from a poll to the next off the bus, in ns (default %d)\n"
+		"  -f MHZ    CPU clock (default %d)\n"
+		"  -c        cold: charge the flash wait states for every line of code\n"
+		"  -v        say how each poll does (-vv with the paths)\n"
+		"Checks every emulate_* function if none are given. Exits with 1 if a\n"
+		"path is over budget or has no bound.\n", BUDGET_NS, HALF_NS, CPU_MHZ);
+	exit(2);
+}
+
+int main(int argc, char *argv[]) {
+	BUDGET budgets[64];
+	int numBudgets = 0, ns = BUDGET_NS, halfNs = HALF_NS, mhz = CPU_MHZ, c, bad = 0, checked = 0;
+
+	while ((c = getopt(argc, argv, "b:t:l:f:cv")) != -1) {
+		switch (c) {
+		case 'b': {
+			char *eq = strchr(optarg, '=');
+			if (!eq || numBudgets == 64) usage();
+			*eq = 0;
+			budgets[numBudgets].name = optarg;
+			budgets[numBudgets++].cycles = atol(eq + 1);
+			break;
+		}
+		case 't': ns = atoi(optarg); break;
+		case 'l': halfNs = atoi(optarg); break;
+		case 'f': mhz = atoi(optarg); break;
+		case 'c': cold = 1; break;
+		case 'v': verbose++; break;
+		default: usage();
+		}
+	}
+	if (optind >= argc || mhz <= 0) usage();
+
+	if (!(elf = load(argv[optind], &elfSize)) || !read_symbols()) {
+		fprintf(stderr, "can't read the symbols from %s (a 32 bit ELF with a symbol table)\n", argv[optind]);
+		return 2;
+	}
+	printf("%-28s %6s %6s %7s %6s %6s (%s, %d MHz)\n", "function", "cycles", "budget", "ns", "half",
+		"budget", cold ? "cold" : "warm", mhz);
+	for (int i = 0; i < numFuncs; i++) {
+		FUNC *f = &funcs[i];
+		int wanted = optind + 1 == argc ? !strncmp(f->name, "emulate_", 8) : 0;
+		for (int a = optind + 1; a < argc; a++)
+			if (!strcmp(argv[a], f->name)) wanted = 1;
+		if (!wanted || (i && funcs[i - 1].addr == f->addr && !strcmp(funcs[i - 1].name, f->name))) continue;
+		long budget = (long)ns * mhz / 1000;
+		for (int b = 0; b < numBudgets; b++)
+			if (!strcmp(budgets[b].name, f->name)) budget = budgets[b].cycles;
+		bad |= check(f, budget, (long)halfNs * mhz / 1000, mhz);
+		checked++;
+	}
+	for (int a = optind + 1; a < argc; a++)
+		if (!func_named(argv[a])) {
+			fprintf(stderr, "no function %s\n", argv[a]);
+			bad = 1;
+		}
+	if (!checked) {
+		fprintf(stderr, "no emulate_ functions in %s\n", argv[optind]);
+		return 2;
+	}
+	return bad;
+}
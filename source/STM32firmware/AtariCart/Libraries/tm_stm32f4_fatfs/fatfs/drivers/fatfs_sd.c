@@ -4,6 +4,7 @@
 
 #include "diskio.h"
 #include "fatfs_sd.h"
+#include <string.h>
 
 /* MMC/SD command */
 #define CMD0	(0)			/* GO_IDLE_STATE */
@@ -272,16 +273,35 @@ uint8_t TM_FATFS_WriteEnabled(void) {
 #endif	
 }
 
+/* Set or clear STA_PROTECT from the write protect switch */
+static void update_protect (void) {
+	if (!TM_FATFS_WriteEnabled()) {
+		TM_FATFS_SD_Stat |= STA_PROTECT;
+	} else {
+		TM_FATFS_SD_Stat &= ~STA_PROTECT;
+	}
+}
+
 DSTATUS TM_FATFS_SD_disk_initialize (void) {
 	BYTE n, cmd, ty, ocr[4];
 	
 	//Initialize CS pin
 	TM_FATFS_InitPins();
-	init_spi();
 	
 	if (!TM_FATFS_Detect()) {
+		if (TM_FATFS_SD_BgInitTake()) {		/* the card it brought up has gone */
+			TM_FATFS_SD_Stat = STA_NOINIT;
+		}
 		return STA_NODISK;
 	}
+	
+	/* Card already brought up by the background initialisation? */
+	if (TM_FATFS_SD_BgInitTake()) {
+		update_protect();
+		return TM_FATFS_SD_Stat;
+	}
+	
+	init_spi();
 	for (n = 10; n; n--) {
 		TM_SPI_Send(FATFS_SPI, 0xFF);
 	}
@@ -322,17 +342,373 @@ DSTATUS TM_FATFS_SD_disk_initialize (void) {
 		TM_FATFS_SD_Stat = STA_NOINIT;
 	}
 
-	if (!TM_FATFS_WriteEnabled()) {
-		TM_FATFS_SD_Stat |= STA_PROTECT;
-	} else {
-		TM_FATFS_SD_Stat &= ~STA_PROTECT;
-	}
+	update_protect();
 	
 	return TM_FATFS_SD_Stat;
 }
 
 
 
+/*-----------------------------------------------------------------------*/
+/* Background (non-blocking) initialisation                              */
+/*-----------------------------------------------------------------------*/
+/* Runs the same power-up sequence as TM_FATFS_SD_disk_initialize(), but */
+/* one SPI byte per call, so it can be advanced from the idle gaps of a  */
+/* bus loop running with interrupts disabled. Timeouts use the DWT cycle */
+/* counter since SysTick is not serviced there.                          */
+
+#define BG_CYCLES_MS(ms)	((SystemCoreClock / 1000) * (ms))
+
+enum { BG_IDLE = 0, BG_POWER, BG_CLOCKS, BG_CMD, BG_DONE, BG_FAILED };	/* bg.state */
+enum { CP_DESELECT = 0, CP_SELECT, CP_READY, CP_SEND, CP_RESP, CP_EXTRA };	/* bg.phase */
+
+static struct {
+	BYTE state;		/* overall state */
+	BYTE step;		/* position in the init sequence (BG_CMD) */
+	BYTE phase;		/* position within the current command */
+	BYTE busy;		/* a byte is in flight on the SPI bus */
+	BYTE cmd, app;	/* current command, 1 while sending the CMD55 prefix */
+	BYTE n, idx, extra, res;
+	BYTE pkt[6];
+	BYTE ocr[4];
+	BYTE ty, loopcmd;
+	DWORD t0, timeout;
+	DWORD init_t0;	/* start of the 1 sec ACMD41/CMD1 init timeout */
+} bg;
+
+static int bg_elapsed(DWORD t0, DWORD cycles) {
+	return (DWT->CYCCNT - t0) >= cycles;
+}
+
+static void bg_start_cmd(BYTE cmd, DWORD arg, BYTE extra) {
+	bg.app = (cmd & 0x80) ? 1 : 0;
+	bg.cmd = cmd & 0x7F;
+	bg.extra = extra;
+	bg.pkt[0] = 0x40 | (bg.app ? CMD55 : bg.cmd);
+	bg.pkt[1] = bg.app ? 0 : (BYTE)(arg >> 24);
+	bg.pkt[2] = bg.app ? 0 : (BYTE)(arg >> 16);
+	bg.pkt[3] = bg.app ? 0 : (BYTE)(arg >> 8);
+	bg.pkt[4] = bg.app ? 0 : (BYTE)arg;
+	bg.pkt[5] = (cmd == CMD0) ? 0x95 : (cmd == CMD8) ? 0x87 : 0x01;
+	/* keep the argument for after the CMD55 prefix */
+	bg.ocr[0] = (BYTE)(arg >> 24); bg.ocr[1] = (BYTE)(arg >> 16);
+	bg.ocr[2] = (BYTE)(arg >> 8); bg.ocr[3] = (BYTE)arg;
+	bg.phase = CP_DESELECT;
+	bg.state = BG_CMD;
+}
+
+static void bg_fail(void) {
+	FATFS_CS_HIGH;
+	bg.state = BG_FAILED;
+}
+
+/* A command has completed with R1 in bg.res (and R3/R7 in bg.ocr) */
+static void bg_cmd_done(void) {
+	switch (bg.step) {
+	case 0:		/* CMD0 */
+		if (bg.res != 1) { bg_fail(); return; }
+		bg.init_t0 = DWT->CYCCNT;
+		bg.step = 1; bg_start_cmd(CMD8, 0x1AA, 4);
+		break;
+	case 1:		/* CMD8 */
+		if (bg.res == 1) {
+			if (bg.ocr[2] != 0x01 || bg.ocr[3] != 0xAA) { bg_fail(); return; }
+			bg.step = 2; bg_start_cmd(ACMD41, 1UL << 30, 0);
+		} else {
+			bg.step = 10; bg_start_cmd(ACMD41, 0, 0);
+		}
+		break;
+	case 2:		/* ACMD41(HCS), repeated until the card leaves idle */
+		if (bg.res == 0) { bg.step = 3; bg_start_cmd(CMD58, 0, 4); }
+		else if (bg_elapsed(bg.init_t0, BG_CYCLES_MS(1000))) bg_fail();
+		else bg_start_cmd(ACMD41, 1UL << 30, 0);
+		break;
+	case 3:		/* CMD58 */
+		if (bg.res != 0) { bg_fail(); return; }
+		bg.ty = (bg.ocr[0] & 0x40) ? CT_SD2 | CT_BLOCK : CT_SD2;
+		bg.state = BG_DONE;
+		break;
+	case 10:	/* ACMD41(0) - SDv1 or MMC? */
+		if (bg.res <= 1) { bg.ty = CT_SD1; bg.loopcmd = ACMD41; }
+		else { bg.ty = CT_MMC; bg.loopcmd = CMD1; }
+		bg.step = 11; bg_start_cmd(bg.loopcmd, 0, 0);
+		break;
+	case 11:
+		if (bg.res == 0) { bg.step = 12; bg_start_cmd(CMD16, 512, 0); }
+		else if (bg_elapsed(bg.init_t0, BG_CYCLES_MS(1000))) bg_fail();
+		else bg_start_cmd(bg.loopcmd, 0, 0);
+		break;
+	case 12:	/* CMD16 */
+		if (bg.res != 0) { bg_fail(); return; }
+		bg.state = BG_DONE;
+		break;
+	}
+	if (bg.state == BG_DONE) {
+		FATFS_CS_HIGH;
+		TM_FATFS_SD_CardType = bg.ty;
+		TM_FATFS_SD_Stat &= ~STA_NOINIT;
+	}
+}
+
+/* Handle a received byte and return the next byte to send, or -1 for none */
+static int bg_rx(BYTE d) {
+	switch (bg.state) {
+	case BG_CLOCKS:
+		if (--bg.n) return 0xFF;
+		bg.step = 0;
+		bg_start_cmd(CMD0, 0, 0);
+		return -1;
+	case BG_CMD:
+		switch (bg.phase) {
+		case CP_DESELECT:	/* dummy clock with CS high */
+			FATFS_CS_LOW;
+			bg.phase = CP_SELECT;
+			return 0xFF;
+		case CP_SELECT:		/* dummy clock with CS low */
+			bg.phase = CP_READY;
+			bg.t0 = DWT->CYCCNT;
+			return 0xFF;
+		case CP_READY:
+			if (d == 0xFF) {
+				bg.phase = CP_SEND;
+				bg.idx = 1;
+				return bg.pkt[0];
+			}
+			if (bg_elapsed(bg.t0, BG_CYCLES_MS(500))) { bg_fail(); return -1; }
+			return 0xFF;
+		case CP_SEND:
+			if (bg.idx < 6) return bg.pkt[bg.idx++];
+			bg.phase = CP_RESP;
+			bg.n = 10;
+			return 0xFF;
+		case CP_RESP:
+			if ((d & 0x80) && --bg.n) return 0xFF;
+			bg.res = d;
+			if (bg.app) {
+				/* CMD55 prefix done, now send the ACMD itself */
+				if (bg.res > 1) { bg_cmd_done(); return -1; }
+				bg_start_cmd(bg.cmd, ((DWORD)bg.ocr[0] << 24) | ((DWORD)bg.ocr[1] << 16) | ((WORD)bg.ocr[2] << 8) | bg.ocr[3], bg.extra);
+				return -1;
+			}
+			if (bg.extra) {
+				bg.phase = CP_EXTRA;
+				bg.idx = 0;
+				return 0xFF;
+			}
+			bg_cmd_done();
+			return -1;
+		case CP_EXTRA:
+			bg.ocr[bg.idx++] = d;
+			if (bg.idx < bg.extra) return 0xFF;
+			bg_cmd_done();
+			return -1;
+		}
+	}
+	return -1;
+}
+
+void TM_FATFS_SD_BgInitStart(void) {
+	/* cycle counter is used for timeouts */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	TM_FATFS_InitPins();
+	TM_SPI_Init(FATFS_SPI, FATFS_SPI_PINSPACK);
+	FATFS_CS_HIGH;
+
+	TM_FATFS_SD_Stat = STA_NOINIT;
+	memset(&bg, 0, sizeof(bg));
+	bg.state = BG_POWER;
+	bg.t0 = DWT->CYCCNT;
+}
+
+uint8_t TM_FATFS_SD_BgInitStep(void) {
+	int next;
+
+	if (bg.busy) {
+		if (!(FATFS_SPI->SR & SPI_SR_RXNE)) {
+			return 1;
+		}
+		bg.busy = 0;
+		next = bg_rx(FATFS_SPI->DR);
+	} else if (bg.state == BG_POWER) {
+		/* wait for the card supply to be stable, then 80 dummy clocks */
+		if (!bg_elapsed(bg.t0, BG_CYCLES_MS(10))) {
+			return 1;
+		}
+		bg.state = BG_CLOCKS;
+		bg.n = 10;
+		next = 0xFF;
+	} else if (bg.state == BG_CMD && bg.phase == CP_DESELECT) {
+		FATFS_CS_HIGH;
+		next = 0xFF;
+	} else {
+		return bg.state < BG_DONE;
+	}
+	if (next >= 0) {
+		FATFS_SPI->DR = (BYTE)next;
+		bg.busy = 1;
+	}
+	return bg.state < BG_DONE;
+}
+
+uint8_t TM_FATFS_SD_BgInitReady(void) {
+	return bg.state == BG_DONE;
+}
+
+uint8_t TM_FATFS_SD_BgInitTake(void) {
+	if (bg.state == BG_DONE) {
+		bg.state = BG_IDLE;
+		return 1;
+	}
+	/* abandon an unfinished sequence; disk_initialize starts again from CMD0 */
+	if (bg.busy) {
+		while (!(FATFS_SPI->SR & SPI_SR_RXNE)) ;
+		(void)FATFS_SPI->DR;
+	}
+	bg.busy = 0;
+	bg.state = BG_IDLE;
+	return 0;
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Background (non-blocking) single block write                          */
+/*-----------------------------------------------------------------------*/
+/* CMD24 for one sector, one SPI byte per call, for saving a flash       */
+/* cartridge back to its file while it runs. Finishes once the card has  */
+/* stopped being busy, so it's safe to power off after.                  */
+
+enum { WR_IDLE = 0, WR_DESELECT, WR_SELECT, WR_READY, WR_SEND, WR_RESP, WR_GAP,
+	WR_DATA, WR_CRC, WR_DRESP, WR_BUSY, WR_RELEASE, WR_DONE, WR_FAILED };
+
+static struct {
+	BYTE phase;
+	BYTE busy;		/* a byte is in flight on the SPI bus */
+	BYTE idx;
+	BYTE pkt[6];
+	UINT n;			/* bytes left in this phase */
+	const BYTE *buff;
+	DWORD t0;
+} wr;
+
+static void wr_fail(void) {
+	FATFS_CS_HIGH;
+	wr.phase = WR_FAILED;
+}
+
+/* Handle a received byte and return the next byte to send, or -1 for none */
+static int wr_rx(BYTE d) {
+	switch (wr.phase) {
+	case WR_DATA:
+		if (!--wr.n) {
+			wr.phase = WR_CRC;
+			wr.n = 3;
+		}
+		return *wr.buff++;
+	case WR_DESELECT:	/* dummy clock with CS high */
+		FATFS_CS_LOW;
+		wr.phase = WR_SELECT;
+		return 0xFF;
+	case WR_SELECT:		/* dummy clock with CS low */
+		wr.phase = WR_READY;
+		wr.t0 = DWT->CYCCNT;
+		return 0xFF;
+	case WR_READY:
+		if (d == 0xFF) {
+			wr.phase = WR_SEND;
+			return wr.pkt[0];
+		}
+		if (bg_elapsed(wr.t0, BG_CYCLES_MS(500))) { wr_fail(); return -1; }
+		return 0xFF;
+	case WR_SEND:
+		if (wr.idx < 6) return wr.pkt[wr.idx++];
+		wr.phase = WR_RESP;
+		wr.n = 10;
+		return 0xFF;
+	case WR_RESP:		/* R1 of CMD24 */
+		if ((d & 0x80) && --wr.n) return 0xFF;
+		if (d != 0) { wr_fail(); return -1; }
+		wr.phase = WR_GAP;
+		return 0xFF;
+	case WR_GAP:		/* a byte between the response and the data token */
+		wr.phase = WR_DATA;
+		wr.n = 512;
+		return 0xFE;
+	case WR_CRC:		/* two dummy CRC bytes, then clock in the data response */
+		if (--wr.n) return 0xFF;
+		wr.phase = WR_DRESP;
+		return 0xFF;
+	case WR_DRESP:
+		if ((d & 0x1F) != 0x05) { wr_fail(); return -1; }
+		wr.phase = WR_BUSY;
+		wr.t0 = DWT->CYCCNT;
+		return 0xFF;
+	case WR_BUSY:		/* MISO held low while the card programs the block */
+		if (d != 0xFF) {
+			if (bg_elapsed(wr.t0, BG_CYCLES_MS(500))) { wr_fail(); return -1; }
+			return 0xFF;
+		}
+		FATFS_CS_HIGH;
+		wr.phase = WR_RELEASE;
+		return 0xFF;	/* dummy clock with CS high, as _deselect() */
+	case WR_RELEASE:
+		wr.phase = WR_DONE;
+		return -1;
+	}
+	return -1;
+}
+
+void TM_FATFS_SD_BgWriteStart(DWORD sector, const BYTE *buff) {
+	/* no memset, this runs in the half cycle after phi2 falls too */
+	wr.busy = 0;
+	wr.n = 0;
+	wr.t0 = 0;
+	if ((TM_FATFS_SD_Stat & STA_NOINIT) || !TM_FATFS_WriteEnabled()) {
+		wr.phase = WR_FAILED;
+		return;
+	}
+	if (!(TM_FATFS_SD_CardType & CT_BLOCK)) sector *= 512;	/* byte addressed card */
+	wr.pkt[0] = 0x40 | CMD24;
+	wr.pkt[1] = (BYTE)(sector >> 24);
+	wr.pkt[2] = (BYTE)(sector >> 16);
+	wr.pkt[3] = (BYTE)(sector >> 8);
+	wr.pkt[4] = (BYTE)sector;
+	wr.pkt[5] = 0x01;
+	wr.idx = 1;
+	wr.buff = buff;
+	wr.phase = WR_DESELECT;
+}
+
+uint8_t TM_FATFS_SD_BgWriteStep(void) {
+	int next;
+
+	if (wr.busy) {
+		if (!(FATFS_SPI->SR & SPI_SR_RXNE)) {
+			return 1;
+		}
+		wr.busy = 0;
+		next = wr_rx(FATFS_SPI->DR);
+	} else if (wr.phase == WR_DESELECT) {
+		FATFS_CS_HIGH;
+		next = 0xFF;
+	} else {
+		return wr.phase > WR_IDLE && wr.phase < WR_DONE;
+	}
+	if (next >= 0) {
+		FATFS_SPI->DR = (BYTE)next;
+		wr.busy = 1;
+	}
+	return wr.phase > WR_IDLE && wr.phase < WR_DONE;
+}
+
+uint8_t TM_FATFS_SD_BgWriteOk(void) {
+	return wr.phase == WR_DONE;
+}
+
+
+
 /*-----------------------------------------------------------------------*/
 /* Get Disk Status                                                       */
 /*-----------------------------------------------------------------------*/
@@ -516,6 +892,29 @@ DRESULT TM_FATFS_SD_disk_ioctl (
 		}
 		break;
 
+	case MMC_GET_TYPE :		/* Get card type flags (1 byte) */
+		*(BYTE*)buff = TM_FATFS_SD_CardType;
+		res = RES_OK;
+		break;
+
+	case MMC_GET_CSD :		/* Receive CSD as a data block (16 bytes) */
+		if ((send_cmd(CMD9, 0) == 0) && rcvr_datablock((BYTE*)buff, 16))
+			res = RES_OK;
+		break;
+
+	case MMC_GET_CID :		/* Receive CID as a data block (16 bytes) */
+		if ((send_cmd(CMD10, 0) == 0) && rcvr_datablock((BYTE*)buff, 16))
+			res = RES_OK;
+		break;
+
+	case MMC_GET_OCR :		/* Receive OCR as an R3 resp (4 bytes) */
+		if (send_cmd(CMD58, 0) == 0) {
+			for (n = 0; n < 4; n++)
+				((BYTE*)buff)[n] = TM_SPI_Send(FATFS_SPI, 0xFF);
+			res = RES_OK;
+		}
+		break;
+
 	case CTRL_ERASE_SECTOR :	/* Erase a block of sectors (used when _USE_ERASE == 1) */
 		if (!(TM_FATFS_SD_CardType & CT_SDC)) break;				/* Check if the card is SDC */
 		if (TM_FATFS_SD_disk_ioctl(MMC_GET_CSD, csd)) break;	/* Get CSD */
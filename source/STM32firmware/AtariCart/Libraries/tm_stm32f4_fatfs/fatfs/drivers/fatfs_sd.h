@@ -58,5 +58,16 @@
 #define FATFS_CS_LOW						FATFS_CS_PORT->BSRRH = FATFS_CS_PIN
 #define FATFS_CS_HIGH						FATFS_CS_PORT->BSRRL = FATFS_CS_PIN
 
+/* Background card initialisation, see fatfs_sd.c */
+void TM_FATFS_SD_BgInitStart(void);
+uint8_t TM_FATFS_SD_BgInitStep(void);	/* returns 0 once finished (ready or failed) */
+uint8_t TM_FATFS_SD_BgInitReady(void);
+uint8_t TM_FATFS_SD_BgInitTake(void);
+
+/* Background single block write, see fatfs_sd.c */
+void TM_FATFS_SD_BgWriteStart(DWORD sector, const BYTE *buff);
+uint8_t TM_FATFS_SD_BgWriteStep(void);	/* returns 0 once finished (written or failed) */
+uint8_t TM_FATFS_SD_BgWriteOk(void);
+
 #endif
 
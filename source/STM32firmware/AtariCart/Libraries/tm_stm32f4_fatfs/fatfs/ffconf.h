@@ -51,7 +51,7 @@
 /* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
 
 
-#define	_USE_FASTSEEK	0
+#define	_USE_FASTSEEK	1	/* for .ZIPs, see zipfile.c */
 /* This option switches fast seek feature. (0:Disable or 1:Enable) */
 
 
@@ -101,7 +101,7 @@
 /   1    - ASCII (No extended character. Valid for only non-LFN configuration.) */
 
 
-#define	_USE_LFN	3
+#define	_USE_LFN	1	/* static buffer, the firmware doesn't use the heap */
 #define	_MAX_LFN	255
 /* The _USE_LFN option switches the LFN feature.
 /
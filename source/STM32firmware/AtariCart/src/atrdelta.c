@@ -0,0 +1,192 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "atrdelta.h"
+#include <string.h>
+
+static const char atrdMagic[8] = {'U','N','O','D','E','L','T','A'};
+
+static FIL atrdFil;
+static char atrdPath[256];
+static ATRD_ENTRY *atrdIndex;
+static int atrdMask;		// index entries - 1
+static int atrdPages;
+static int atrdOpen = 0;	// the delta file exists and is open
+static int atrdMounted = 0;
+static uint32_t atrdEnd;	// where the next record goes
+
+static ATRD_ENTRY *atrd_find(uint32_t page) {
+	uint32_t i = (page * 2654435761u) & atrdMask;
+	while (atrdIndex[i].page != ATRD_EMPTY && atrdIndex[i].page != page)
+		i = (i + 1) & atrdMask;
+	return &atrdIndex[i];
+}
+
+// a quarter of the index is kept free so the probes stay short
+static int atrd_full(void) {
+	return atrdPages >= (atrdMask + 1) / 4 * 3;
+}
+
+// later records for a page replace earlier ones
+static int atrd_add(uint32_t page, uint32_t offset) {
+	ATRD_ENTRY *e = atrd_find(page);
+	if (e->page == ATRD_EMPTY) {
+		if (atrd_full())
+			return ATRD_ERROR;
+		e->page = page;
+		atrdPages++;
+	}
+	e->offset = offset;
+	return ATRD_OK;
+}
+
+static void atrd_clear(void) {
+	for (int i = 0; i <= atrdMask; i++)
+		atrdIndex[i].page = ATRD_EMPTY;
+	atrdPages = 0;
+}
+
+int atrd_mount(const char *atrPath, ATRD_ENTRY *index, int numEntries) {
+	uint8_t hdr[ATRD_HEADER_SIZE];
+	uint32_t page, pos, size;
+	UINT br;
+
+	atrd_unmount();
+	strcpy(atrdPath, atrPath);
+	char *dot = strrchr(atrdPath, '.');
+	if (dot && !strchr(dot, '/'))
+		strcpy(dot, ".ATD");
+	else
+		strcat(atrdPath, ".ATD");
+	atrdIndex = index;
+	atrdMask = numEntries - 1;
+	atrd_clear();
+	atrdMounted = 1;
+
+	if (f_open(&atrdFil, atrdPath, FA_READ|FA_WRITE|FA_OPEN_EXISTING) != FR_OK)
+		return ATRD_NONE;
+	atrdOpen = 1;
+	size = f_size(&atrdFil);
+	if (size < ATRD_HEADER_SIZE) {
+		// cut short while being created, start again
+		atrd_discard();
+		return ATRD_NONE;
+	}
+	if (f_read(&atrdFil, hdr, ATRD_HEADER_SIZE, &br) != FR_OK || br != ATRD_HEADER_SIZE ||
+			memcmp(hdr, atrdMagic, sizeof(atrdMagic))) {
+		atrd_unmount();
+		return ATRD_BAD_FILE;
+	}
+	// replay the records, a partly written one at the end is dropped
+	for (pos = ATRD_HEADER_SIZE; pos + ATRD_RECORD_SIZE <= size; pos += ATRD_RECORD_SIZE) {
+		if (f_lseek(&atrdFil, pos) != FR_OK || f_read(&atrdFil, &page, 4, &br) != FR_OK || br != 4 ||
+				atrd_add(page, pos) != ATRD_OK) {
+			atrd_unmount();
+			return ATRD_BAD_FILE;
+		}
+	}
+	atrdEnd = pos;
+	if (pos != size && (f_lseek(&atrdFil, pos) != FR_OK || f_truncate(&atrdFil) != FR_OK)) {
+		atrd_unmount();
+		return ATRD_BAD_FILE;
+	}
+	return ATRD_OK;
+}
+
+void atrd_unmount(void) {
+	if (atrdOpen)
+		f_close(&atrdFil);
+	atrdOpen = atrdMounted = 0;
+	atrdPages = 0;
+}
+
+int atrd_active(void) {
+	return atrdMounted;
+}
+
+int atrd_num_pages(void) {
+	return atrdPages;
+}
+
+int atrd_read(uint32_t page, uint8_t *buf) {
+	UINT br;
+	if (!atrdPages)
+		return ATRD_NONE;
+	ATRD_ENTRY *e = atrd_find(page);
+	if (e->page == ATRD_EMPTY)
+		return ATRD_NONE;
+	if (f_lseek(&atrdFil, e->offset + 4) != FR_OK || f_read(&atrdFil, buf, ATRD_PAGE_SIZE, &br) != FR_OK ||
+			br != ATRD_PAGE_SIZE)
+		return ATRD_ERROR;
+	return ATRD_OK;
+}
+
+int atrd_write(uint32_t page, const uint8_t *buf) {
+	UINT bw;
+	if (!atrdMounted)
+		return ATRD_ERROR;
+	if (!atrdOpen) {
+		uint8_t hdr[ATRD_HEADER_SIZE] = {0};
+		memcpy(hdr, atrdMagic, sizeof(atrdMagic));
+		if (f_open(&atrdFil, atrdPath, FA_READ|FA_WRITE|FA_CREATE_ALWAYS) != FR_OK)
+			return ATRD_ERROR;
+		atrdOpen = 1;
+		if (f_write(&atrdFil, hdr, ATRD_HEADER_SIZE, &bw) != FR_OK || bw != ATRD_HEADER_SIZE)
+			return ATRD_ERROR;
+		atrdEnd = ATRD_HEADER_SIZE;
+	}
+	if (atrd_find(page)->page == ATRD_EMPTY && atrd_full())
+		return ATRD_FULL;
+	// the file size only changes at the sync, so a record cut short by a
+	// power cut is dropped when the delta is next mounted
+	if (f_lseek(&atrdFil, atrdEnd) != FR_OK || f_write(&atrdFil, &page, 4, &bw) != FR_OK || bw != 4 ||
+			f_write(&atrdFil, buf, ATRD_PAGE_SIZE, &bw) != FR_OK || bw != ATRD_PAGE_SIZE ||
+			f_sync(&atrdFil) != FR_OK)
+		return ATRD_ERROR;
+	atrd_add(page, atrdEnd);
+	atrdEnd += ATRD_RECORD_SIZE;
+	return ATRD_OK;
+}
+
+int atrd_merge(FIL *atr) {
+	uint8_t buf[ATRD_PAGE_SIZE];
+	UINT bw;
+	for (int i = 0; i <= atrdMask; i++) {
+		ATRD_ENTRY *e = &atrdIndex[i];
+		if (e->page == ATRD_EMPTY)
+			continue;
+		if (atrd_read(e->page, buf) != ATRD_OK ||
+				f_lseek(atr, ATRD_HEADER_SIZE + e->page * ATRD_PAGE_SIZE) != FR_OK ||
+				f_write(atr, buf, ATRD_PAGE_SIZE, &bw) != FR_OK || bw != ATRD_PAGE_SIZE)
+			return ATRD_ERROR;
+	}
+	if (f_sync(atr) != FR_OK)
+		return ATRD_ERROR;
+	return atrd_discard();
+}
+
+int atrd_discard(void) {
+	if (atrdOpen) {
+		f_close(&atrdFil);
+		atrdOpen = 0;
+		if (f_unlink(atrdPath) != FR_OK)
+			return ATRD_ERROR;
+	}
+	atrd_clear();
+	return ATRD_OK;
+}
@@ -0,0 +1,68 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Copy-on-write overlay for ATR images. Writes go to a sidecar file next to
+ * the ATR (GAME.ATR -> GAME.ATD) as records appended to the end, and a hash
+ * index in RAM says which 128 byte pages of the image have been replaced.
+ * The ATR itself isn't touched until the changes are merged back.
+ *
+ * Pages are numbered from the end of the ATR header, so page n is at offset
+ * 16 + n * 128 in the ATR whatever the sector size.
+ */
+
+#ifndef ATRDELTA_H
+#define ATRDELTA_H
+
+#include <stdint.h>
+#include "ff.h"
+
+#define ATRD_PAGE_SIZE		128
+#define ATRD_HEADER_SIZE	16
+#define ATRD_RECORD_SIZE	(4 + ATRD_PAGE_SIZE)	// page number, then the data
+
+typedef struct {
+	uint32_t page;		// ATRD_EMPTY if unused
+	uint32_t offset;	// of the record in the delta file
+} ATRD_ENTRY;
+
+#define ATRD_EMPTY			0xFFFFFFFF
+
+// status codes, as for ATRs
+#define ATRD_OK				0
+#define ATRD_NONE			1	// nothing written yet
+#define ATRD_ERROR			2	// read/write error
+#define ATRD_BAD_FILE		3
+#define ATRD_FULL			4	// the index has no room for another page
+
+// the index lives in the memory given, which must be a power of two entries.
+// Opens an existing delta for atrPath, returns ATRD_OK or ATRD_NONE if
+// there isn't one (it is created by the first write)
+int atrd_mount(const char *atrPath, ATRD_ENTRY *index, int numEntries);
+void atrd_unmount(void);
+int atrd_active(void);
+int atrd_num_pages(void);
+// returns ATRD_OK with the data if the page has been written, else ATRD_NONE
+int atrd_read(uint32_t page, uint8_t *buf);
+// ATRD_FULL once the index can't take a new page, rewriting one is fine
+int atrd_write(uint32_t page, const uint8_t *buf);
+// copy the changes into the ATR (open for writing) and delete the delta
+int atrd_merge(FIL *atr);
+int atrd_discard(void);
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bustrace.h"
+#include "ff.h"
+#include <string.h>
+
+#ifdef UNOCART_TRACE
+TRACE_ENTRY traceBuf[TRACE_ENTRIES];
+#else
+TRACE_ENTRY traceBuf[1];
+#endif
+uint32_t tracePos, traceStop, traceLast, traceTrigPos;
+uint8_t traceOn = 0, traceTrig = 0, traceTrigAddr, traceHot = 0;
+
+static int traceMode = TRACE_OFF;
+static int traceCartType;
+// off the stack, a FIL holds a sector buffer
+static FIL traceFil;
+
+int trace_arm(int mode, uint8_t arg) {
+#ifdef UNOCART_TRACE
+	traceMode = mode;
+	traceTrigAddr = arg;
+	return 0;
+#else
+	return 1;
+#endif
+}
+
+int trace_armed(void) {
+	return traceMode;
+}
+
+void trace_start(int cartType) {
+	if (traceMode == TRACE_OFF)
+		return;
+	traceCartType = cartType;
+	if (traceMode == TRACE_HOTSPOTS) {
+		uint32_t secs = traceTrigAddr ? traceTrigAddr : HOT_SECS;
+		if (secs > 25) secs = 25;
+		memset(hotBuf, 0, HOT_BUCKETS * sizeof(uint32_t));
+		traceStop = secs * SystemCoreClock;
+		traceLast = DWT->CYCCNT;
+		traceHot = 1;
+		traceOn = 1;
+		return;
+	}
+	tracePos = 0;
+	traceTrigPos = TRACE_NO_TRIGGER;
+	traceTrig = traceMode == TRACE_TRIGGER;
+	// triggered traces go round the ring until the trigger sets the end
+	traceStop = traceTrig ? 0xFFFFFFFF : TRACE_ENTRIES;
+	traceLast = DWT->CYCCNT;
+	traceOn = 1;
+}
+
+void trace_stop(void) {
+	// the SD card driver needs the SysTick interrupt
+	__enable_irq();
+	trace_dump();
+	__disable_irq();
+}
+
+static int hot_dump(void) {
+	HOT_HEADER hdr;
+	UINT bw;
+	int ok;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, "UNOHOT", 6);
+	hdr.version = HOT_VERSION;
+	hdr.count = HOT_BUCKETS;
+	hdr.cartType = traceCartType;
+	hdr.cpuHz = SystemCoreClock;
+	hdr.cycles = DWT->CYCCNT - traceLast;
+	hdr.shift = HOT_SHIFT;
+	traceOn = 0;
+	traceHot = 0;
+	traceMode = TRACE_OFF;
+	if (f_open(&traceFil, HOT_FILENAME, FA_WRITE|FA_CREATE_ALWAYS) != FR_OK)
+		return 1;
+	ok = f_write(&traceFil, &hdr, sizeof(hdr), &bw) == FR_OK && bw == sizeof(hdr);
+	if (ok)
+		ok = f_write(&traceFil, hotBuf, HOT_BUCKETS * sizeof(uint32_t), &bw) == FR_OK &&
+			bw == HOT_BUCKETS * sizeof(uint32_t);
+	if (f_close(&traceFil) != FR_OK)
+		ok = 0;
+	return !ok;
+}
+
+int trace_dump(void) {
+	TRACE_HEADER hdr;
+	UINT bw;
+	uint32_t count = tracePos < TRACE_ENTRIES ? tracePos : TRACE_ENTRIES;
+	uint32_t first = tracePos - count;
+	int ok;
+
+#ifndef UNOCART_TRACE
+	return 1;
+#endif
+	if (traceHot)
+		return hot_dump();
+	traceOn = 0;
+	traceMode = TRACE_OFF;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, "UNOTRACE", 8);
+	hdr.version = TRACE_VERSION;
+	hdr.count = count;
+	hdr.cartType = traceCartType;
+	hdr.cpuHz = SystemCoreClock;
+	hdr.trigger = traceTrigPos == TRACE_NO_TRIGGER ? TRACE_NO_TRIGGER : traceTrigPos - first;
+	if (f_open(&traceFil, TRACE_FILENAME, FA_WRITE|FA_CREATE_ALWAYS) != FR_OK)
+		return 1;
+	ok = f_write(&traceFil, &hdr, sizeof(hdr), &bw) == FR_OK && bw == sizeof(hdr);
+	// oldest first, in at most two pieces
+	while (ok && count) {
+		uint32_t i = first & (TRACE_ENTRIES-1);
+		uint32_t n = TRACE_ENTRIES - i < count ? TRACE_ENTRIES - i : count;
+		ok = f_write(&traceFil, &traceBuf[i], n * sizeof(TRACE_ENTRY), &bw) == FR_OK && bw == n * sizeof(TRACE_ENTRY);
+		first += n;
+		count -= n;
+	}
+	if (f_close(&traceFil) != FR_OK)
+		ok = 0;
+	return !ok;
+}
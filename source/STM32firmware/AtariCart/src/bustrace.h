@@ -0,0 +1,136 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Bus trace, for working out what the 6502 did to a cartridge. Each cart
+ * access (S4, S5 or CCTL) the emulation loops answer is recorded with the
+ * data that went over the bus and the CPU cycles since the one before, in
+ * a ring buffer in RAM. When it stops the buffer is written to UNOTRACE.BIN
+ * on the SD card, for HostTools/unotrace.
+ *
+ * The hot spots mode keeps no trace, but counts the reads of each 4 bytes
+ * of the S4 and S5 windows for a set time, in the same RAM, then writes the
+ * counts to UNOHOT.BIN: a profile of a cart game's code and tables with
+ * nothing added on the Atari's side. The port has no A13-A15, so RAM and the
+ * OS can't be told apart and aren't counted, nor is the bank a read was from.
+ *
+ * Tracing slows the loops down, so it is only built in with UNOCART_TRACE
+ * defined (uncomment below, or add it to the project's defines). Writing
+ * the dump stops the bus for a while, the Atari will usually crash.
+ */
+
+#ifndef BUSTRACE_H
+#define BUSTRACE_H
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+// #define UNOCART_TRACE
+
+#define TRACE_ENTRIES		2048	// power of two
+#define TRACE_FILENAME		"UNOTRACE.BIN"
+
+typedef struct {
+	uint16_t addr;
+	uint8_t data;
+	uint8_t ctrl;			// CONTROL_IN: S5, S4, CCTL, RW
+	uint32_t cycles;		// since the last entry
+} TRACE_ENTRY;
+
+/* UNOTRACE.BIN: this header, then count entries, oldest first */
+typedef struct {
+	char magic[8];			// "UNOTRACE"
+	uint32_t version;
+	uint32_t count;
+	uint32_t cartType;
+	uint32_t cpuHz;
+	uint32_t trigger;		// entry the trigger was hit at, or TRACE_NO_TRIGGER
+	uint32_t reserved;
+} TRACE_HEADER;
+
+#define TRACE_VERSION		1
+#define TRACE_NO_TRIGGER	0xFFFFFFFF
+
+#define HOT_FILENAME		"UNOHOT.BIN"
+#define HOT_SHIFT			2		// 4 bytes a bucket
+#define HOT_BUCKETS			(0x4000 >> HOT_SHIFT)	// $8000-$BFFF, in traceBuf
+#define HOT_SECS			20		// default run, at most 25 for CYCCNT not to wrap
+
+/* UNOHOT.BIN: this header, then count uint32_t read counts from $8000 up */
+typedef struct {
+	char magic[8];			// "UNOHOT"
+	uint32_t version;
+	uint32_t count;
+	uint32_t cartType;
+	uint32_t cpuHz;
+	uint32_t cycles;		// CPU cycles the counts are over
+	uint32_t shift;			// HOT_SHIFT
+} HOT_HEADER;
+
+#define HOT_VERSION			1
+
+/* modes */
+#define TRACE_OFF			0
+#define TRACE_FILL			1	// from the start of the emulation until the buffer is full
+#define TRACE_TRIGGER		2	// until half a buffer after a CCTL access to the trigger address
+#define TRACE_DUMP			3	// command only - dump what there is now
+#define TRACE_HOTSPOTS		4	// count reads for the seconds given (0 for HOT_SECS)
+
+extern TRACE_ENTRY traceBuf[];
+extern uint32_t tracePos, traceStop, traceLast, traceTrigPos;
+extern uint8_t traceOn, traceTrig, traceTrigAddr, traceHot;
+// hot spots go in the trace buffer. traceLast is when they started, and
+// traceStop how many CPU cycles to count for
+#define hotBuf ((uint32_t *)traceBuf)
+
+// set the mode for the next emulation started. Returns 0, or 1 if tracing
+// isn't built in. arg is the trigger address, or the seconds for hot spots
+int trace_arm(int mode, uint8_t arg);
+int trace_armed(void);
+// start recording, if armed
+void trace_start(int cartType);
+// the buffer is done, write it out and carry on without tracing
+void trace_stop(void);
+int trace_dump(void);
+
+// for the emulation loops in main.c, c is the CONTROL_IN value
+#ifdef UNOCART_TRACE
+#define TRACE_BUS(a, d, c) do { \
+	if (traceOn && traceHot) { \
+		if (((c) & (CCTL|RW)) == (CCTL|RW)) \
+			hotBuf[((((c) & S4) << 11) | ((a) & 0x1FFF)) >> HOT_SHIFT]++; \
+		if (DWT->CYCCNT - traceLast >= traceStop) trace_stop(); \
+	} \
+	else if (traceOn) { \
+		uint32_t now = DWT->CYCCNT; \
+		TRACE_ENTRY *e = &traceBuf[tracePos & (TRACE_ENTRIES-1)]; \
+		e->addr = (a); e->data = (d); e->ctrl = (c); \
+		e->cycles = now - traceLast; \
+		traceLast = now; \
+		if (traceTrig && !((c) & CCTL) && ((a) & 0xFF) == traceTrigAddr) { \
+			traceTrigPos = tracePos; \
+			traceStop = tracePos + TRACE_ENTRIES/2; \
+			traceTrig = 0; \
+		} \
+		if (++tracePos == traceStop) trace_stop(); \
+	} } while (0)
+#else
+#define TRACE_BUS(a, d, c) do { } while (0)
+#endif
+
+#endif
@@ -0,0 +1,407 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cartinfo.h"
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+char *get_filename_ext(char *filename) {
+    char *dot = strrchr(filename, '.');
+    if(!dot || dot == filename) return "";
+    return dot + 1;
+}
+
+int file_kind(char *filename) {
+	char *ext = get_filename_ext(filename);
+	if (strcasecmp(ext, "CAR") == 0) return FILE_KIND_CAR;
+	if (strcasecmp(ext, "ROM") == 0) return FILE_KIND_ROM;
+	if (strcasecmp(ext, "XEX") == 0) return FILE_KIND_XEX;
+	if (strcasecmp(ext, "ATR") == 0) return FILE_KIND_ATR;
+	if (strcasecmp(ext, "CAS") == 0) return FILE_KIND_CAS;
+	if (strcasecmp(ext, "LZ4") == 0) return FILE_KIND_LZ4;
+	if (strcasecmp(ext, "ZIP") == 0) return FILE_KIND_ZIP;
+	return FILE_KIND_NONE;
+}
+
+// a file the menu can open, a .ZIP is a folder
+int is_valid_file(char *filename) {
+	int kind = file_kind(filename);
+	return kind != FILE_KIND_NONE && kind != FILE_KIND_ZIP;
+}
+
+int car_header_type(int car_type, int *expectedSize) {
+	int cart_type = CART_TYPE_NONE, size = 0;
+	if (car_type == 1)			{ cart_type = CART_TYPE_8K; size = 8192; }
+	else if (car_type == 2)		{ cart_type = CART_TYPE_16K; size = 16384; }
+	else if (car_type == 3) 	{ cart_type = CART_TYPE_OSS_16K_034M; size = 16384; }
+	else if (car_type == 8)		{ cart_type = CART_TYPE_WILLIAMS_64K; size = 65536; }
+	else if (car_type == 9)		{ cart_type = CART_TYPE_EXPRESS_64K; size = 65536; }
+	else if (car_type == 10)	{ cart_type = CART_TYPE_DIAMOND_64K; size = 65536; }
+	else if (car_type == 11)	{ cart_type = CART_TYPE_SDX_64K; size = 65536; }
+	else if (car_type == 12) 	{ cart_type = CART_TYPE_XEGS_32K; size = 32768; }
+	else if (car_type == 13) 	{ cart_type = CART_TYPE_XEGS_64K; size = 65536; }
+	else if (car_type == 14) 	{ cart_type = CART_TYPE_XEGS_128K; size = 131072; }
+	else if (car_type == 15) 	{ cart_type = CART_TYPE_OSS_16K_TYPE_B; size = 16384; }
+	else if (car_type == 18) 	{ cart_type = CART_TYPE_BOUNTY_BOB; size = 40960; }
+	else if (car_type == 22)	{ cart_type = CART_TYPE_WILLIAMS_64K; size = 32768; }
+	else if (car_type == 26)	{ cart_type = CART_TYPE_MEGACART_16K; size = 16384; }
+	else if (car_type == 27)	{ cart_type = CART_TYPE_MEGACART_32K; size = 32768; }
+	else if (car_type == 28)	{ cart_type = CART_TYPE_MEGACART_64K; size = 65536; }
+	else if (car_type == 29)	{ cart_type = CART_TYPE_MEGACART_128K; size = 131072; }
+	else if (car_type == 33)	{ cart_type = CART_TYPE_SW_XEGS_32K; size = 32768; }
+	else if (car_type == 34)	{ cart_type = CART_TYPE_SW_XEGS_64K; size = 65536; }
+	else if (car_type == 35)	{ cart_type = CART_TYPE_SW_XEGS_128K; size = 131072; }
+	else if (car_type == 40)	{ cart_type = CART_TYPE_BLIZZARD_16K; size = 16384; }
+	else if (car_type == 41)	{ cart_type = CART_TYPE_ATARIMAX_1MBIT; size = 131072; }
+	else if (car_type == 43)	{ cart_type = CART_TYPE_SDX_128K; size = 131072; }
+	else if (car_type == 44)	{ cart_type = CART_TYPE_OSS_8K; size = 8192; }
+	else if (car_type == 45) 	{ cart_type = CART_TYPE_OSS_16K_043M; size = 16384; }
+	else if (car_type == 54)	{ cart_type = CART_TYPE_SIC_128K; size = 131072; }
+	if (expectedSize) *expectedSize = size;
+	return cart_type;
+}
+
+int rom_size_type(int size) {
+	if (size == 8*1024) return CART_TYPE_8K;
+	if (size == 16*1024) return CART_TYPE_16K;
+	if (size == 32*1024) return CART_TYPE_XEGS_32K;
+	if (size == 64*1024) return CART_TYPE_XEGS_64K;
+	if (size == 128*1024) return CART_TYPE_XEGS_128K;
+	return CART_TYPE_NONE;
+}
+
+const char *cart_type_tag(int cartType, int status) {
+	if (status == META_UNKNOWN) return "    ";
+	if (status != META_OK) return " BAD";
+	switch (cartType) {
+	case CART_TYPE_8K:				return "  8K";
+	case CART_TYPE_16K:				return " 16K";
+	case CART_TYPE_XEGS_32K:
+	case CART_TYPE_XEGS_64K:
+	case CART_TYPE_XEGS_128K:		return "XEGS";
+	case CART_TYPE_SW_XEGS_32K:
+	case CART_TYPE_SW_XEGS_64K:
+	case CART_TYPE_SW_XEGS_128K:	return "SWXE";
+	case CART_TYPE_MEGACART_16K:
+	case CART_TYPE_MEGACART_32K:
+	case CART_TYPE_MEGACART_64K:
+	case CART_TYPE_MEGACART_128K:	return "MEGA";
+	case CART_TYPE_BOUNTY_BOB:		return "BBOB";
+	case CART_TYPE_ATARIMAX_1MBIT:	return "AMAX";
+	case CART_TYPE_WILLIAMS_64K:	return "WILL";
+	case CART_TYPE_OSS_16K_TYPE_B:
+	case CART_TYPE_OSS_8K:
+	case CART_TYPE_OSS_16K_034M:
+	case CART_TYPE_OSS_16K_043M:	return " OSS";
+	case CART_TYPE_SIC_128K:		return "SIC!";
+	case CART_TYPE_SDX_64K:
+	case CART_TYPE_SDX_128K:		return " SDX";
+	case CART_TYPE_DIAMOND_64K:		return "DIAM";
+	case CART_TYPE_EXPRESS_64K:		return "EXPR";
+	case CART_TYPE_BLIZZARD_16K:	return "BLIZ";
+	case CART_TYPE_ATR:				return " ATR";
+	case CART_TYPE_CAS:				return " CAS";
+	case CART_TYPE_XEX:				return " XEX";
+	}
+	return "    ";
+}
+
+const char *meta_status_text(int status) {
+	switch (status) {
+	case META_BAD_CAR_TYPE:	return "Unsupported CAR type";
+	case META_BAD_SIZE:		return "Wrong size for cart type";
+	case META_TOO_BIG:		return "Cart file/XEX too big (>128k)";
+	case META_BAD_XEX:		return "Bad XEX file";
+	case META_BAD_ATR:		return "Bad ATR file";
+	case META_BAD_CAS:		return "Bad CAS file";
+	case META_READ_ERROR:	return "Can't read file";
+	}
+	return "";
+}
+
+static uint32_t name_hash_add(uint32_t h, const char *name) {
+	// FNV-1a, case insensitive
+	while (*name) {
+		h ^= (uint8_t)tolower((unsigned char)*name++);
+		h *= 16777619u;
+	}
+	return h;
+}
+
+uint32_t meta_name_hash(const char *name) {
+	uint32_t h = name_hash_add(2166136261u, name);
+	return h ? h : 1;	// 0 marks an empty slot
+}
+
+uint32_t meta_path_hash(const char *dir, const char *name) {
+	uint32_t h = name_hash_add(name_hash_add(2166136261u, dir), "/");
+	h = name_hash_add(h, name);
+	return h ? h : 1;
+}
+
+uint32_t meta_record_check(const FILE_META *m) {
+	const uint8_t *p = (const uint8_t *)m;
+	uint32_t h = 2166136261u;
+	for (unsigned i=0; i<sizeof(FILE_META)-sizeof(m->check); i++) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+	return h ^ 0x554E4F43;	// 'UNOC'
+}
+
+#ifdef CARTINFO_SOFT_CRC
+// host tools running several scans at once build with CARTINFO_TLS=__thread
+#ifndef CARTINFO_TLS
+#define CARTINFO_TLS
+#endif
+
+static CARTINFO_TLS uint32_t soft_crc;
+static uint32_t crc_table[256];
+
+void cart_crc_reset(void) {
+	// the table is filled on the first call, make that before starting threads
+	if (!crc_table[1]) {
+		for (uint32_t i=0; i<256; i++) {
+			uint32_t c = i << 24;
+			for (int j=0; j<8; j++)
+				c = (c & 0x80000000) ? (c << 1) ^ 0x04C11DB7 : (c << 1);
+			crc_table[i] = c;
+		}
+	}
+	soft_crc = 0xFFFFFFFF;
+}
+
+void cart_crc_words(const uint32_t *words, uint32_t count) {
+	uint32_t crc = soft_crc;
+	while (count--) {
+		uint32_t w = *words++;
+		for (int i=24; i>=0; i-=8)
+			crc = (crc << 8) ^ crc_table[(crc >> 24) ^ ((w >> i) & 0xFF)];
+	}
+	soft_crc = crc;
+}
+
+uint32_t cart_crc_value(void) {
+	return soft_crc;
+}
+#endif
+
+/* Streaming scan */
+
+static void scan_fail(CART_SCAN *s, int status) {
+	s->failed = 1;
+	s->meta->status = status;
+	s->meta->cartType = CART_TYPE_NONE;
+}
+
+static void scan_crc_flush(CART_SCAN *s) {
+	if (s->carryLen) {
+		uint32_t w = 0;
+		memcpy(&w, s->carry, s->carryLen);
+		cart_crc_words(&w, 1);
+		s->carryLen = 0;
+	}
+	s->meta->crc[s->part] = cart_crc_value();
+}
+
+static void scan_crc_bytes(CART_SCAN *s, const uint8_t *buf, uint32_t len) {
+	while (len) {
+		// move on to the cart_ram2 part?
+		if (s->part == 0 && s->imagePos == CART_RAM_SPLIT) {
+			scan_crc_flush(s);
+			cart_crc_reset();
+			s->part = 1;
+		}
+		uint32_t n = len;
+		if (s->part == 0 && s->imagePos + n > CART_RAM_SPLIT)
+			n = CART_RAM_SPLIT - s->imagePos;
+		s->imagePos += n;
+		len -= n;
+		// complete a partial word
+		while (n && s->carryLen) {
+			s->carry[s->carryLen++] = *buf++;
+			n--;
+			if (s->carryLen == 4) {
+				uint32_t w;
+				memcpy(&w, s->carry, 4);
+				cart_crc_words(&w, 1);
+				s->carryLen = 0;
+			}
+		}
+		// whole words
+		uint32_t words = n / 4;
+		if (words) {
+			if (((uintptr_t)buf & 3) == 0)
+				cart_crc_words((const uint32_t *)buf, words);
+			else {
+				for (uint32_t i=0; i<words; i++) {
+					uint32_t w;
+					memcpy(&w, buf + i*4, 4);
+					cart_crc_words(&w, 1);
+				}
+			}
+			buf += words * 4;
+			n -= words * 4;
+		}
+		while (n--)
+			s->carry[s->carryLen++] = *buf++;
+	}
+}
+
+static void scan_xex(CART_SCAN *s, const uint8_t *buf, uint32_t len) {
+	while (len && !s->failed) {
+		if (s->xexState == 4) {
+			// skip over segment data
+			uint32_t n = len < s->xexRemain ? len : s->xexRemain;
+			s->xexRemain -= n;
+			buf += n;
+			len -= n;
+			if (!s->xexRemain) {
+				s->xexState = 0;
+				s->xexSegments++;
+			}
+			continue;
+		}
+		uint8_t d = *buf++;
+		len--;
+		switch (s->xexState) {
+		case 0: s->xexWord = d; s->xexState = 1; break;
+		case 1:
+			s->xexWord |= d << 8;
+			// $FFFF header marker (required by DOS, optional for the loader)
+			if (s->xexWord == 0xFFFF) s->xexState = 0;
+			else { s->xexStart = s->xexWord; s->xexState = 2; }
+			break;
+		case 2: s->xexWord = d; s->xexState = 3; break;
+		case 3:
+			s->xexWord |= d << 8;
+			if (s->xexWord < s->xexStart) { scan_fail(s, META_BAD_XEX); break; }
+			s->xexRemain = (uint32_t)s->xexWord - s->xexStart + 1;
+			s->xexState = 4;
+			break;
+		}
+	}
+}
+
+void cart_scan_begin(CART_SCAN *s, char *filename, uint32_t size, FILE_META *m) {
+	memset(s, 0, sizeof(CART_SCAN));
+	s->meta = m;
+	s->kind = file_kind(filename);
+	m->size = size;
+	m->status = META_UNKNOWN;
+	m->cartType = CART_TYPE_NONE;
+	m->carType = 0;
+	m->crc[0] = m->crc[1] = 0;
+	cart_crc_reset();
+
+	if (s->kind == FILE_KIND_ROM) {
+		s->imageSize = size;
+		if (size > CART_MAX_IMAGE_SIZE) scan_fail(s, META_TOO_BIG);
+		else if ((m->cartType = rom_size_type(size)) == CART_TYPE_NONE) scan_fail(s, META_BAD_SIZE);
+	}
+	else if (s->kind == FILE_KIND_CAR) {
+		s->imageSize = size >= 16 ? size - 16 : 0;
+		if (size < 16) scan_fail(s, META_BAD_SIZE);
+	}
+	else if (s->kind == FILE_KIND_XEX) {
+		s->imageSize = size + 4;
+		if (s->imageSize > CART_MAX_IMAGE_SIZE) scan_fail(s, META_TOO_BIG);
+		else {
+			// the loader finds the file length in the first 4 bytes of sram
+			uint8_t len[4] = { size & 0xFF, (size >> 8) & 0xFF, (size >> 16) & 0xFF, 0 };
+			scan_crc_bytes(s, len, 4);
+			m->cartType = CART_TYPE_XEX;
+		}
+	}
+	else if (s->kind == FILE_KIND_ATR) {
+		if (size < 16) scan_fail(s, META_BAD_ATR);
+	}
+	else if (s->kind == FILE_KIND_CAS) {
+		if (size < 16) scan_fail(s, META_BAD_CAS);
+	}
+	else if (s->kind == FILE_KIND_LZ4) {
+		// what's inside is only known once it's unpacked, so it isn't
+		// checked or cached. Loading reports any problem
+		s->failed = 1;
+		m->status = META_OK;
+	}
+	else
+		scan_fail(s, META_READ_ERROR);
+}
+
+int cart_scan_feed(CART_SCAN *s, const uint8_t *buf, uint32_t len) {
+	// header bytes
+	if ((s->kind == FILE_KIND_CAR || s->kind == FILE_KIND_ATR || s->kind == FILE_KIND_CAS) && s->pos < 16 && !s->failed) {
+		uint32_t n = 16 - s->pos;
+		if (n > len) n = len;
+		memcpy(&s->head[s->pos], buf, n);
+		s->pos += n;
+		buf += n;
+		len -= n;
+		if (s->pos == 16) {
+			if (s->kind == FILE_KIND_ATR) {
+				if (s->head[0] != 0x96 || s->head[1] != 0x02) scan_fail(s, META_BAD_ATR);
+				else {
+					s->meta->cartType = CART_TYPE_ATR;
+					s->meta->status = META_OK;
+				}
+				return 0;
+			}
+			if (s->kind == FILE_KIND_CAS) {
+				// the tape description chunk always comes first
+				if (memcmp(s->head, "FUJI", 4)) scan_fail(s, META_BAD_CAS);
+				else {
+					s->meta->cartType = CART_TYPE_CAS;
+					s->meta->status = META_OK;
+				}
+				return 0;
+			}
+			int expectedSize;
+			s->meta->carType = s->head[7];
+			s->meta->cartType = car_header_type(s->head[7], &expectedSize);
+			if (s->meta->cartType == CART_TYPE_NONE) scan_fail(s, META_BAD_CAR_TYPE);
+			else if (s->imageSize > CART_MAX_IMAGE_SIZE) scan_fail(s, META_TOO_BIG);
+			else if (s->imageSize != (uint32_t)expectedSize) scan_fail(s, META_BAD_SIZE);
+		}
+	}
+	if (s->failed) return 0;
+	if (len) {
+		s->pos += len;
+		scan_crc_bytes(s, buf, len);
+		if (s->kind == FILE_KIND_XEX)
+			scan_xex(s, buf, len);
+	}
+	return !s->failed && s->pos < s->meta->size;
+}
+
+void cart_scan_end(CART_SCAN *s) {
+	FILE_META *m = s->meta;
+	if (!s->failed && m->status == META_UNKNOWN) {
+		if (s->pos < m->size)
+			scan_fail(s, META_READ_ERROR);
+		// trailing bytes or a cut off last segment are left to the loader
+		else if (s->kind == FILE_KIND_XEX && !s->xexSegments)
+			scan_fail(s, META_BAD_XEX);
+		else {
+			scan_crc_flush(s);
+			m->status = META_OK;
+		}
+	}
+	m->check = meta_record_check(m);
+}
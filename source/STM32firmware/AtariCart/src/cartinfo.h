@@ -0,0 +1,148 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Cartridge image identification. Plain C with no hardware or FatFs
+ * dependencies, so the same code can be built into host tools.
+ */
+
+#ifndef CARTINFO_H
+#define CARTINFO_H
+
+#include <stdint.h>
+
+#define CART_TYPE_NONE				0
+#define CART_TYPE_8K				1	// 8k
+#define CART_TYPE_16K				2	// 16k
+#define CART_TYPE_XEGS_32K			3	// 32k
+#define CART_TYPE_XEGS_64K			4	// 64k
+#define CART_TYPE_XEGS_128K			5	// 128k
+#define CART_TYPE_SW_XEGS_32K		6	// 32k
+#define CART_TYPE_SW_XEGS_64K		7	// 64k
+#define CART_TYPE_SW_XEGS_128K		8	// 128k
+#define CART_TYPE_MEGACART_16K		9	// 16k
+#define CART_TYPE_MEGACART_32K		10	// 32k
+#define CART_TYPE_MEGACART_64K		11	// 64k
+#define CART_TYPE_MEGACART_128K		12	// 128k
+#define CART_TYPE_BOUNTY_BOB		13	// 40k
+#define CART_TYPE_ATARIMAX_1MBIT	14	// 128k
+#define CART_TYPE_WILLIAMS_64K		15	// 32k/64k
+#define CART_TYPE_OSS_16K_TYPE_B	16	// 16k
+#define CART_TYPE_OSS_8K			17	// 8k
+#define CART_TYPE_OSS_16K_034M		18	// 16k
+#define CART_TYPE_OSS_16K_043M		19	// 16k
+#define CART_TYPE_SIC_128K			20	// 128k
+#define CART_TYPE_SDX_64K			21	// 64k
+#define CART_TYPE_SDX_128K			22	// 128k
+#define CART_TYPE_DIAMOND_64K		23	// 64k
+#define CART_TYPE_EXPRESS_64K		24	// 64k
+#define CART_TYPE_BLIZZARD_16K		25	// 16k
+#define CART_TYPE_CAS				253
+#define CART_TYPE_ATR				254
+#define CART_TYPE_XEX				255
+
+#define CART_MAX_IMAGE_SIZE			(128*1024)	// cart_ram1 + cart_ram2
+#define CART_RAM_SPLIT				(64*1024)	// where loading moves to cart_ram2
+
+// file kinds, from the extension
+#define FILE_KIND_NONE				0
+#define FILE_KIND_CAR				1
+#define FILE_KIND_ROM				2
+#define FILE_KIND_XEX				3
+#define FILE_KIND_ATR				4
+#define FILE_KIND_CAS				5
+#define FILE_KIND_LZ4				6	// a CAR, ROM or XEX in an LZ4 frame (lz4load.h)
+#define FILE_KIND_ZIP				7	// listed as a folder (zipfile.h)
+
+// FILE_META status
+#define META_UNKNOWN				0	// not scanned yet
+#define META_OK						1
+#define META_BAD_CAR_TYPE			2
+#define META_BAD_SIZE				3
+#define META_TOO_BIG				4
+#define META_BAD_XEX				5
+#define META_BAD_ATR				6
+#define META_READ_ERROR				7
+#define META_BAD_CAS				8
+
+/* What is known about a file without loading it. 32 bytes, so 16 fit in a
+   sector of the metadata cache file (see filemeta.c) */
+typedef struct {
+	uint32_t nameHash;		// meta_path_hash() of the folder and long file name
+	uint32_t size;			// file size in bytes
+	uint16_t fdate, ftime;	// FAT timestamp
+	uint8_t cartType;		// CART_TYPE_xxx, CART_TYPE_NONE if it won't load
+	uint8_t status;			// META_xxx
+	uint8_t carType;		// type byte from the .CAR header
+	uint8_t reserved1;
+	uint32_t crc[2];		// CRC of the image as loaded into cart_ram1, cart_ram2
+	uint32_t reserved2;
+	uint32_t check;			// meta_record_check(), to spot unwritten slots
+} FILE_META;
+
+char *get_filename_ext(char *filename);
+int is_valid_file(char *filename);
+int file_kind(char *filename);
+
+// CART_TYPE_xxx for a .CAR header type byte, or CART_TYPE_NONE if unsupported
+int car_header_type(int carType, int *expectedSize);
+// CART_TYPE_xxx guessed from the size of a raw .ROM, or CART_TYPE_NONE
+int rom_size_type(int size);
+// 4 character tag for the menu
+const char *cart_type_tag(int cartType, int status);
+const char *meta_status_text(int status);
+
+uint32_t meta_name_hash(const char *name);
+// meta_name_hash() of dir/name. dir is the folder as the firmware opens it
+// ("" for the root, 8.3 names), name the file's long name
+uint32_t meta_path_hash(const char *dir, const char *name);
+uint32_t meta_record_check(const FILE_META *m);
+
+/* CRC as computed by the STM32 CRC unit: polynomial 0x04C11DB7, initial
+   value 0xFFFFFFFF, little endian 32-bit words fed MSB first, no final xor.
+   A trailing partial word is zero padded. The firmware implements these
+   with the hardware unit, host builds define CARTINFO_SOFT_CRC. */
+void cart_crc_reset(void);
+void cart_crc_words(const uint32_t *words, uint32_t count);
+uint32_t cart_crc_value(void);
+
+/* Streaming scan of a file, fed sequentially from the start */
+typedef struct {
+	FILE_META *meta;
+	int kind;
+	uint32_t pos;			// file bytes consumed
+	uint32_t imagePos;		// bytes of the SRAM image seen
+	uint32_t imageSize;		// size of the SRAM image
+	uint8_t head[16];
+	uint8_t carry[4];
+	int carryLen;
+	int part;				// which CRC is being calculated
+	int failed;
+	// XEX segment parser
+	int xexState;
+	uint32_t xexRemain;
+	uint16_t xexStart, xexWord;
+	int xexSegments;		// complete ones
+} CART_SCAN;
+
+void cart_scan_begin(CART_SCAN *s, char *filename, uint32_t size, FILE_META *m);
+// returns 1 if more data is wanted, 0 when the result is known
+int cart_scan_feed(CART_SCAN *s, const uint8_t *buf, uint32_t len);
+void cart_scan_end(CART_SCAN *s);
+
+#endif
@@ -0,0 +1,117 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "castape.h"
+#include "ff.h"
+#include <string.h>
+
+static FIL casFil;
+static CAS_RECORD *casIndex;
+static int casMounted = 0;
+static int casRecords, casPos, casBoot;
+
+int cas_mount(const char *filename, CAS_RECORD *index, int maxRecords) {
+	uint8_t hdr[CAS_CHUNK_HEADER];
+	uint32_t pos = 0, size;
+	UINT br;
+
+	cas_unmount();
+	if (f_open(&casFil, filename, FA_READ) != FR_OK)
+		return CAS_BAD_FILE;
+	size = f_size(&casFil);
+	casIndex = index;
+	casRecords = 0;
+	while (pos + CAS_CHUNK_HEADER <= size) {
+		if (f_lseek(&casFil, pos) != FR_OK || f_read(&casFil, hdr, CAS_CHUNK_HEADER, &br) != FR_OK
+				|| br != CAS_CHUNK_HEADER)
+			goto bad;
+		uint32_t len = hdr[4] | (hdr[5] << 8);
+		if (pos == 0 && memcmp(hdr, "FUJI", 4))
+			goto bad;
+		pos += CAS_CHUNK_HEADER;
+		if (pos + len > size)
+			break;	// truncated
+		if (!memcmp(hdr, "data", 4) && len) {
+			if (casRecords == maxRecords)
+				break;
+			index[casRecords].offset = pos;
+			index[casRecords].length = len;
+			casRecords++;
+		}
+		pos += len;
+	}
+	if (!casRecords)
+		goto bad;
+
+	// a boot tape's first record starts with a zero flags byte and the number
+	// of records, BASIC's with the zero high byte of an offset, and a listing
+	// with a line number
+	uint8_t rec[5];
+	casBoot = index[0].length >= 5 && f_lseek(&casFil, index[0].offset) == FR_OK
+			&& f_read(&casFil, rec, 5, &br) == FR_OK && br == 5 && rec[3] == 0 && rec[4] != 0;
+	casPos = 0;
+	casMounted = 1;
+	return CAS_OK;
+bad:
+	f_close(&casFil);
+	return CAS_BAD_FILE;
+}
+
+void cas_unmount(void) {
+	if (casMounted)
+		f_close(&casFil);
+	casMounted = 0;
+}
+
+void cas_rewind(void) {
+	casPos = 0;
+}
+
+int cas_mounted(void) {
+	return casMounted;
+}
+
+int cas_num_records(void) {
+	return casMounted ? casRecords : 0;
+}
+
+int cas_position(void) {
+	return casPos;
+}
+
+int cas_is_boot_tape(void) {
+	return casMounted && casBoot;
+}
+
+int cas_read_record(uint8_t *buf, int bufSize, int *length) {
+	UINT br;
+
+	*length = 0;
+	if (!casMounted)
+		return CAS_NO_TAPE;
+	if (casPos >= casRecords)
+		return CAS_END_OF_TAPE;
+	CAS_RECORD *r = &casIndex[casPos];
+	UINT len = r->length > (uint32_t)bufSize ? (UINT)bufSize : r->length;
+	memset(buf, 0, bufSize);
+	if (f_lseek(&casFil, r->offset) != FR_OK || f_read(&casFil, buf, len, &br) != FR_OK || br != len)
+		return CAS_BAD_FILE;
+	casPos++;
+	*length = len;
+	return CAS_OK;
+}
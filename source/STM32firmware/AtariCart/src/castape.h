@@ -0,0 +1,57 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * CAS tape images, for the soft OS cassette handler. The chunks are indexed
+ * when the file is mounted, so each record can be handed over as soon as the
+ * 6502 asks for it: "data" chunks are standard records (sync bytes, control
+ * byte, 128 data bytes, checksum), "baud" only matters to a real recorder,
+ * and turbo chunks ("fsk ", "pwm*") can't go through SIO so are skipped.
+ */
+
+#ifndef CASTAPE_H
+#define CASTAPE_H
+
+#include <stdint.h>
+
+#define CAS_CHUNK_HEADER	8
+
+typedef struct {
+	uint32_t offset;		// of the record in the file
+	uint32_t length;
+} CAS_RECORD;
+
+// status codes, as for ATRs
+#define CAS_OK				0
+#define CAS_NO_TAPE			1
+#define CAS_END_OF_TAPE		2
+#define CAS_BAD_FILE		3	// also read errors
+
+// index the records into the memory given. Returns a CAS_xxx status
+int cas_mount(const char *filename, CAS_RECORD *index, int maxRecords);
+void cas_unmount(void);
+void cas_rewind(void);
+int cas_mounted(void);
+int cas_num_records(void);
+int cas_position(void);
+// a boot tape rather than a BASIC program or a listing, from the first record
+int cas_is_boot_tape(void);
+// the next record, zero padded to bufSize
+int cas_read_record(uint8_t *buf, int bufSize, int *length);
+
+#endif
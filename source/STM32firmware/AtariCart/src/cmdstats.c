@@ -0,0 +1,204 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cmdstats.h"
+#include "stackmark.h"
+#include "ff.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *phaseNames[STAT_NUM_PHASES] = {
+	"mount", "opendir", "readdir", "sort", "read", "write"
+};
+
+static uint8_t statCmds[STAT_MAX_CMDS];
+static STAT_ENTRY statCmdEntries[STAT_MAX_CMDS];
+static int statNumCmds = 0;
+static STAT_ENTRY statPhases[STAT_NUM_PHASES];
+
+// the command being timed
+static int statActive = 0;
+static uint8_t statCmd;
+static uint32_t statStart;
+static uint32_t statCmdPhases[STAT_NUM_PHASES];
+
+static int statLogOn = 0;
+static char statLogBuf[1024];
+static int statLogLen = 0;
+
+static void stat_add(STAT_ENTRY *e, uint32_t cycles) {
+	if (!e->count || cycles < e->min) e->min = cycles;
+	if (cycles > e->max) e->max = cycles;
+	e->total += cycles;
+	e->count++;
+}
+
+static uint32_t stat_us(uint32_t cycles) {
+	return cycles / (SystemCoreClock / 1000000);
+}
+
+void stat_cmd_begin(uint8_t cmd) {
+	statCmd = cmd;
+	memset(statCmdPhases, 0, sizeof(statCmdPhases));
+	statActive = 1;
+	statStart = stat_now();
+}
+
+void stat_phase(int phase, uint32_t start) {
+	uint32_t cycles = stat_now() - start;
+	stat_add(&statPhases[phase], cycles);
+	if (statActive)
+		statCmdPhases[phase] += cycles;
+}
+
+void stat_cmd_end(void) {
+	uint32_t cycles = stat_now() - statStart;
+	int i;
+
+	if (!statActive)
+		return;
+	statActive = 0;
+	for (i = 0; i < statNumCmds; i++)
+		if (statCmds[i] == statCmd) break;
+	if (i == statNumCmds) {
+		if (statNumCmds == STAT_MAX_CMDS)
+			return;
+		statCmds[statNumCmds++] = statCmd;
+		memset(&statCmdEntries[i], 0, sizeof(STAT_ENTRY));
+	}
+	stat_add(&statCmdEntries[i], cycles);
+
+	if (statLogOn) {
+		char line[80], *p = line;
+		p += sprintf(p, "%u,%u", statCmd, (unsigned)stat_us(cycles));
+		for (i = 0; i < STAT_NUM_PHASES; i++)
+			p += sprintf(p, ",%u", (unsigned)stat_us(statCmdPhases[i]));
+		*p++ = '\n';
+		if (statLogLen + (p - line) > sizeof(statLogBuf))
+			stat_log_flush();
+		memcpy(&statLogBuf[statLogLen], line, p - line);
+		statLogLen += p - line;
+	}
+}
+
+const STAT_ENTRY *stat_cmd_entry(uint8_t cmd) {
+	for (int i = 0; i < statNumCmds; i++)
+		if (statCmds[i] == cmd)
+			return &statCmdEntries[i];
+	return NULL;
+}
+
+const STAT_ENTRY *stat_phase_entry(int phase) {
+	if (phase < 0 || phase >= STAT_NUM_PHASES || !statPhases[phase].count)
+		return NULL;
+	return &statPhases[phase];
+}
+
+void stat_reset(void) {
+	statNumCmds = 0;
+	memset(statPhases, 0, sizeof(statPhases));
+}
+
+// right aligned in width characters
+static char *stat_field(char *p, uint32_t value, int width) {
+	char num[12];
+	int len = sprintf(num, "%u", (unsigned)value);
+	while (width-- > len)
+		*p++ = ' ';
+	strcpy(p, num);
+	return p + len;
+}
+
+static char *stat_entry_line(char *p, const STAT_ENTRY *e) {
+	p = stat_field(p, e->count, 6);
+	p = stat_field(p, stat_us(e->min), 8);
+	p = stat_field(p, stat_us(e->total / e->count), 8);
+	return stat_field(p, stat_us(e->max), 9);
+}
+
+// the header, the phases that have been used, then the commands slowest
+// (most time in all) first
+int stat_line(int n, char *buf) {
+	int i, j;
+
+	if (n-- == 0) {
+		sprintf(buf, "stack  %u of %u bytes at most", (unsigned)stack_high_water(), (unsigned)stack_budget());
+		return 1;
+	}
+	if (n-- == 0) {
+		strcpy(buf, "cmd      count  min us  avg us  max us");
+		return 1;
+	}
+	for (i = 0; i < STAT_NUM_PHASES; i++) {
+		if (!statPhases[i].count) continue;
+		if (n-- == 0) {
+			char *p = buf + sprintf(buf, "%s", phaseNames[i]);
+			while (p < buf + 7) *p++ = ' ';
+			stat_entry_line(p, &statPhases[i]);
+			return 1;
+		}
+	}
+	if (n >= statNumCmds)
+		return 0;
+	// the n'th largest total, ties in table order
+	for (i = 0; i < statNumCmds; i++) {
+		int rank = 0;
+		for (j = 0; j < statNumCmds; j++)
+			if (statCmdEntries[j].total > statCmdEntries[i].total ||
+					(statCmdEntries[j].total == statCmdEntries[i].total && j < i))
+				rank++;
+		if (rank == n) break;
+	}
+	char *p = buf;
+	*p++ = '$';
+	*p++ = "0123456789ABCDEF"[statCmds[i] >> 4];
+	*p++ = "0123456789ABCDEF"[statCmds[i] & 0xF];
+	while (p < buf + 7) *p++ = ' ';
+	stat_entry_line(p, &statCmdEntries[i]);
+	return 1;
+}
+
+void stat_log(int on) {
+	if (!on)
+		stat_log_flush();
+	statLogOn = on;
+}
+
+int stat_logging(void) {
+	return statLogOn;
+}
+
+void stat_log_flush(void) {
+	static FIL fil;	// off the stack, it holds a sector buffer
+	UINT bw;
+
+	if (!statLogLen)
+		return;
+	if (f_open(&fil, STAT_LOG_FILENAME, FA_WRITE|FA_OPEN_ALWAYS) == FR_OK) {
+		if (f_size(&fil) == 0) {
+			static const char header[] = "cmd,us,mount,opendir,readdir,sort,read,write\n";
+			f_write(&fil, header, sizeof(header) - 1, &bw);
+		}
+		else
+			f_lseek(&fil, f_size(&fil));
+		f_write(&fil, statLogBuf, statLogLen, &bw);
+		f_close(&fil);
+	}
+	// dropped if the card can't be written
+	statLogLen = 0;
+}
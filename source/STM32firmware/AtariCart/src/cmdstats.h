@@ -0,0 +1,75 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Command latency statistics. Each command the 6502 sends is timed with the
+ * DWT cycle counter from when the boot rom hands it over to when the answer
+ * is ready, and so is each call to the slow parts of the work (mounting the
+ * card, opening and reading directories, sorting, file reads and writes).
+ * Min, average and max are kept for each since the last reset, and with the
+ * log on every command is also appended to UNOSTATS.CSV on the card with
+ * the time it spent in each phase.
+ */
+
+#ifndef CMDSTATS_H
+#define CMDSTATS_H
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+#define STAT_MAX_CMDS		32
+#define STAT_LOG_FILENAME	"UNOSTATS.CSV"
+
+/* phases */
+#define STAT_PHASE_MOUNT	0
+#define STAT_PHASE_OPENDIR	1
+#define STAT_PHASE_READDIR	2
+#define STAT_PHASE_SORT		3
+#define STAT_PHASE_READ		4
+#define STAT_PHASE_WRITE	5
+#define STAT_NUM_PHASES		6
+
+typedef struct {
+	uint32_t count;
+	uint32_t min, max;		// cycles
+	uint64_t total;
+} STAT_ENTRY;
+
+// start of a phase, pass to stat_phase() at the end
+static inline uint32_t stat_now(void) {
+	return DWT->CYCCNT;
+}
+
+void stat_cmd_begin(uint8_t cmd);
+// the answer is ready. Also writes out the log, when it's on
+void stat_cmd_end(void);
+void stat_phase(int phase, uint32_t start);
+
+// NULL if the command hasn't been seen since the reset
+const STAT_ENTRY *stat_cmd_entry(uint8_t cmd);
+const STAT_ENTRY *stat_phase_entry(int phase);
+void stat_reset(void);
+// a line of the menu's stats screen, 0 if there's no line n
+int stat_line(int n, char *buf);
+
+void stat_log(int on);
+int stat_logging(void);
+// write out what's buffered, before the cart stops listening
+void stat_log_flush(void);
+
+#endif
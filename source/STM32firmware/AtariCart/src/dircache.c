@@ -0,0 +1,190 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dircache.h"
+#include <string.h>
+
+typedef struct {
+	uint16_t bytes;			// the whole listing, a multiple of 4
+	uint16_t id;
+	uint8_t count;
+	uint8_t cursor;
+	uint8_t pathLen;
+	uint8_t spare;
+	uint32_t lastUse;
+} DIRC_LISTING;				// then the path, padded to 4 bytes, and the entries
+
+#define DIRC_NONE		0xFFFFFFFF
+#define LISTING(off)	((DIRC_LISTING *)((uint8_t *)pool + (off)))
+
+static uint32_t pool[DIRC_BYTES / 4];
+static uint32_t used;		// bytes of finished listings, one being built follows
+static uint32_t useClock;
+static uint16_t lastId, shownId;
+static int building;
+
+static uint32_t head_bytes(int pathLen) {
+	return sizeof(DIRC_LISTING) + ((pathLen + 4) & ~3);
+}
+
+static DIRC_ENTRY *entries(DIRC_LISTING *l) {
+	return (DIRC_ENTRY *)((uint8_t *)l + head_bytes(l->pathLen));
+}
+
+static uint32_t find_path(const char *path) {
+	for (uint32_t off = 0; off < used; off += LISTING(off)->bytes)
+		if (!strcmp((char *)(LISTING(off) + 1), path))
+			return off;
+	return DIRC_NONE;
+}
+
+static DIRC_LISTING *find_id(uint16_t id) {
+	if (!id) return 0;
+	for (uint32_t off = 0; off < used; off += LISTING(off)->bytes)
+		if (LISTING(off)->id == id)
+			return LISTING(off);
+	return 0;
+}
+
+// take a listing out, moving the ones after it down
+static void drop(uint32_t off) {
+	uint32_t n = LISTING(off)->bytes;
+	uint32_t end = used + (building ? LISTING(used)->bytes : 0);
+	memmove((uint8_t *)pool + off, (uint8_t *)pool + off + n, end - off - n);
+	used -= n;
+}
+
+// drop the least recently used listing, 0 if there are none
+static int evict(void) {
+	uint32_t oldest = DIRC_NONE, oldestUse = 0xFFFFFFFF;
+	for (uint32_t off = 0; off < used; off += LISTING(off)->bytes)
+		if (LISTING(off)->lastUse < oldestUse) {
+			oldest = off;
+			oldestUse = LISTING(off)->lastUse;
+		}
+	if (oldest == DIRC_NONE)
+		return 0;
+	drop(oldest);
+	return 1;
+}
+
+void dirc_flush(void) {
+	used = 0;
+	building = 0;
+	shownId = 0;
+}
+
+const DIRC_ENTRY *dirc_find(const char *path, int *count, int *cursor) {
+	uint32_t off = find_path(path);
+	if (off == DIRC_NONE)
+		return 0;
+	DIRC_LISTING *l = LISTING(off);
+	l->lastUse = ++useClock;
+	*count = l->count;
+	*cursor = l->cursor;
+	return entries(l);
+}
+
+int dirc_has(const char *path) {
+	return find_path(path) != DIRC_NONE;
+}
+
+void dirc_show(const char *path) {
+	uint32_t off = path ? find_path(path) : DIRC_NONE;
+	shownId = off != DIRC_NONE ? LISTING(off)->id : 0;
+}
+
+void dirc_shown_meta(int n, uint8_t cartType, uint8_t metaStatus) {
+	DIRC_LISTING *l = find_id(shownId);
+	if (l && n < l->count) {
+		entries(l)[n].cartType = cartType;
+		entries(l)[n].metaStatus = metaStatus;
+	}
+}
+
+void dirc_shown_cursor(int n) {
+	DIRC_LISTING *l = find_id(shownId);
+	if (l && n < l->count)
+		l->cursor = n;
+}
+
+int dirc_begin(const char *path) {
+	uint32_t len = strlen(path), need = head_bytes(len), off;
+	DIRC_LISTING *l;
+
+	building = 0;
+	if (len > 255)
+		return 0;
+	if ((off = find_path(path)) != DIRC_NONE)
+		drop(off);
+	while (used + need > DIRC_BYTES)
+		if (!evict()) return 0;
+	l = LISTING(used);
+	memset(l, 0, need);
+	l->bytes = need;
+	l->pathLen = len;
+	strcpy((char *)(l + 1), path);
+	building = 1;
+	return 1;
+}
+
+DIRC_ENTRY *dirc_add(void) {
+	DIRC_LISTING *l = LISTING(used);
+	DIRC_ENTRY *e;
+
+	if (!building)
+		return 0;
+	if (l->count == 255) {
+		building = 0;
+		return 0;
+	}
+	while (used + l->bytes + sizeof(DIRC_ENTRY) > DIRC_BYTES) {
+		if (!evict()) {
+			building = 0;
+			return 0;
+		}
+		l = LISTING(used);
+	}
+	e = (DIRC_ENTRY *)((uint8_t *)l + l->bytes);
+	memset(e, 0, sizeof(DIRC_ENTRY));
+	l->bytes += sizeof(DIRC_ENTRY);
+	l->count++;
+	return e;
+}
+
+DIRC_ENTRY *dirc_building(int *count) {
+	if (!building)
+		return 0;
+	*count = LISTING(used)->count;
+	return entries(LISTING(used));
+}
+
+void dirc_end(void) {
+	DIRC_LISTING *l = LISTING(used);
+	if (!building)
+		return;
+	if (!++lastId) lastId = 1;
+	l->id = lastId;
+	l->lastUse = ++useClock;
+	used += l->bytes;
+	building = 0;
+}
+
+void dirc_cancel(void) {
+	building = 0;
+}
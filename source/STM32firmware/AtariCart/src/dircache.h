@@ -0,0 +1,68 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The last few directory listings, sorted and with what the metadata scan
+ * found, so going back up or out of search results doesn't touch the card.
+ * Each listing keeps the item the cursor was on when the menu left it.
+ * Listings are packed one after another in a pool in RAM and the least
+ * recently used goes when a new one needs the room. The card may have
+ * changed when the menu starts again, so it is flushed then.
+ */
+
+#ifndef DIRCACHE_H
+#define DIRCACHE_H
+
+#include <stdint.h>
+
+#define DIRC_BYTES			(12*1024)
+#define DIRC_MAX_ENTRIES	200			// always fit, whatever the path
+
+/* DIR_ENTRY without the search result path */
+typedef struct {
+	char isDir;
+	char filename[13];
+	char long_filename[32];
+	uint8_t cartType;
+	uint8_t metaStatus;
+	uint16_t fdate, ftime;
+	uint32_t size;
+	uint32_t nameHash;
+} DIRC_ENTRY;
+
+void dirc_flush(void);
+// the listing of path, or NULL. Counts as a use
+const DIRC_ENTRY *dirc_find(const char *path, int *count, int *cursor);
+int dirc_has(const char *path);
+
+/* the listing of path (NULL for none) is the one in cart_ram1, for the
+   metadata scan's results and the cursor to go to it */
+void dirc_show(const char *path);
+void dirc_shown_meta(int n, uint8_t cartType, uint8_t metaStatus);
+void dirc_shown_cursor(int n);
+
+/* building a listing an entry at a time: any listing of path already there
+   goes at dirc_begin, and the new one is dropped if dirc_add runs out of room
+   (dirc_add returns NULL) */
+int dirc_begin(const char *path);
+DIRC_ENTRY *dirc_add(void);
+DIRC_ENTRY *dirc_building(int *count);	// for sorting them
+void dirc_end(void);
+void dirc_cancel(void);
+
+#endif
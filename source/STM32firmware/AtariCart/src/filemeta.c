@@ -0,0 +1,151 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "filemeta.h"
+#include "ff.h"
+#include <string.h>
+
+static FIL metaFil;
+static int metaOpen = 0;
+static int bucketNo = -1;	// bucket held in bucketBuf
+static int numBuckets;
+static FILE_META bucketBuf[META_PER_BUCKET];
+
+void meta_forget(void) {
+	metaOpen = 0;
+	bucketNo = -1;
+}
+
+int meta_open(void) {
+	META_HEADER hdr;
+	UINT br;
+	if (metaOpen) return 1;
+	if (f_open(&metaFil, META_FILE_NAME, FA_READ|FA_WRITE|FA_OPEN_ALWAYS) != FR_OK)
+		return 0;
+	if (f_read(&metaFil, &hdr, sizeof(hdr), &br) != FR_OK || br != sizeof(hdr)
+			|| hdr.magic != META_MAGIC || hdr.version != META_VERSION
+			|| hdr.buckets < 1 || hdr.buckets > META_MAX_BUCKETS || hdr.recordSize != sizeof(FILE_META)
+			|| f_size(&metaFil) != (hdr.buckets + 1) * 512) {
+		// new or unrecognised - start again. The buckets are not cleared,
+		// the check word in each record tells us which slots are in use
+		memset(bucketBuf, 0, sizeof(bucketBuf));
+		hdr.magic = META_MAGIC;
+		hdr.version = META_VERSION;
+		hdr.buckets = META_DEFAULT_BUCKETS;
+		hdr.recordSize = sizeof(FILE_META);
+		memcpy(bucketBuf, &hdr, sizeof(hdr));
+		if (f_lseek(&metaFil, 0) != FR_OK || f_truncate(&metaFil) != FR_OK
+				|| f_write(&metaFil, bucketBuf, 512, &br) != FR_OK || br != 512
+				|| f_lseek(&metaFil, (hdr.buckets + 1) * 512) != FR_OK
+				|| f_tell(&metaFil) != (hdr.buckets + 1) * 512
+				|| f_sync(&metaFil) != FR_OK) {
+			f_close(&metaFil);
+			return 0;
+		}
+	}
+	metaOpen = 1;
+	bucketNo = -1;
+	numBuckets = hdr.buckets;
+	return 1;
+}
+
+static int read_bucket(int b) {
+	UINT br;
+	if (b == bucketNo) return 1;
+	bucketNo = -1;
+	if (f_lseek(&metaFil, (b + 1) * 512) != FR_OK
+			|| f_read(&metaFil, bucketBuf, 512, &br) != FR_OK || br != 512)
+		return 0;
+	bucketNo = b;
+	return 1;
+}
+
+static int write_bucket(void) {
+	UINT bw;
+	// whole aligned sectors go straight to the card, and the file size never
+	// changes, so there is no need to sync the directory entry
+	if (f_lseek(&metaFil, (bucketNo + 1) * 512) != FR_OK
+			|| f_write(&metaFil, bucketBuf, 512, &bw) != FR_OK || bw != 512) {
+		bucketNo = -1;
+		return 0;
+	}
+	return 1;
+}
+
+static int slot_used(FILE_META *s) {
+	return s->nameHash && s->check == meta_record_check(s);
+}
+
+static int slot_matches(FILE_META *s, FILE_META *m) {
+	return s->nameHash == m->nameHash && s->size == m->size
+			&& s->fdate == m->fdate && s->ftime == m->ftime;
+}
+
+int meta_lookup(FILE_META *m) {
+	if (!metaOpen) return 0;
+	int home = m->nameHash % numBuckets;
+	for (int p=0; p<META_PROBE; p++) {
+		if (!read_bucket((home + p) % numBuckets))
+			return 0;
+		int full = 1;
+		for (int i=0; i<META_PER_BUCKET; i++) {
+			FILE_META *s = &bucketBuf[i];
+			if (!slot_used(s)) full = 0;
+			else if (slot_matches(s, m)) {
+				*m = *s;
+				return 1;
+			}
+		}
+		// records are only stored further along if this bucket was full
+		if (!full) break;
+	}
+	return 0;
+}
+
+int meta_store(FILE_META *m) {
+	if (!metaOpen) return 0;
+	m->check = meta_record_check(m);
+	int home = m->nameHash % numBuckets;
+	int freeBucket = -1, freeSlot = 0;
+	for (int p=0; p<META_PROBE; p++) {
+		int b = (home + p) % numBuckets;
+		if (!read_bucket(b))
+			return 0;
+		for (int i=0; i<META_PER_BUCKET; i++) {
+			FILE_META *s = &bucketBuf[i];
+			if (!slot_used(s)) {
+				if (freeBucket < 0) { freeBucket = b; freeSlot = i; }
+			}
+			else if (s->nameHash == m->nameHash) {
+				// same file, replace the old details
+				*s = *m;
+				return write_bucket();
+			}
+		}
+		if (freeBucket >= 0) break;
+	}
+	if (freeBucket < 0) {
+		// probe sequence full, evict from the home bucket
+		freeBucket = home;
+		freeSlot = (m->nameHash / numBuckets) % META_PER_BUCKET;
+	}
+	if (!read_bucket(freeBucket))
+		return 0;
+	bucketBuf[freeSlot] = *m;
+	return write_bucket();
+}
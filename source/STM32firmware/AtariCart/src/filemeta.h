@@ -0,0 +1,53 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Metadata cache file in the root of the SD card. A header sector followed
+ * by a number of bucket sectors of 16 FILE_META records, hashed on the file's
+ * folder and name. The firmware creates it with META_DEFAULT_BUCKETS, the host
+ * indexer can make it bigger for large collections.
+ */
+
+#ifndef FILEMETA_H
+#define FILEMETA_H
+
+#include "cartinfo.h"
+
+#define META_FILE_NAME		"/UNOMETA.DAT"
+#define META_MAGIC			0x4154454D	// "META"
+#define META_VERSION		3		// 2: keyed on the folder as well as the name,
+									// 3: XEXs with a complete segment are OK
+#define META_DEFAULT_BUCKETS	256
+#define META_MAX_BUCKETS	8192
+#define META_PER_BUCKET		(512 / sizeof(FILE_META))
+#define META_PROBE			8			// buckets searched before evicting
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t buckets;
+	uint32_t recordSize;
+} META_HEADER;
+
+int meta_open(void);
+void meta_forget(void);	// call when the volume is remounted
+// fill m from the cache, keyed on nameHash, size, fdate and ftime. 1 if found
+int meta_lookup(FILE_META *m);
+int meta_store(FILE_META *m);
+
+#endif
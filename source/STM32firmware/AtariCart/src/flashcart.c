@@ -0,0 +1,280 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "flashcart.h"
+#include "cartinfo.h"
+#include "stm32f4xx.h"
+#include "fatfs_sd.h"
+#include <string.h>
+
+/* in ff.c, though ff.h doesn't declare them */
+DWORD get_fat(FATFS *fs, DWORD clst);
+DWORD clust2sect(FATFS *fs, DWORD clst);
+
+// command cycles written so far
+enum { CYCLE_NONE = 0, CYCLE_AA, CYCLE_55, CYCLE_PROGRAM, CYCLE_ERASE, CYCLE_ERASE_AA,
+	CYCLE_ERASE_55, CYCLE_ERASE_MORE };
+
+FLASH_CART flash;
+
+int flash_cart_type(int cartType) {
+	return cartType == CART_TYPE_ATARIMAX_1MBIT || cartType == CART_TYPE_SIC_128K;
+}
+
+static inline uint8_t *flash_byte(uint32_t addr) {
+	return (addr & 0x10000 ? flash.ram2 : flash.ram1) + (addr & 0xFFFF);
+}
+
+static void flash_dirty_block(uint32_t b) {
+	if (!(flash.dirty[b >> 5] & (1u << (b & 31)))) {
+		flash.dirty[b >> 5] |= 1u << (b & 31);
+		flash.numDirty++;
+	}
+}
+
+static void flash_dirty(uint32_t addr) {
+	flash_dirty_block((flash.offset + addr) / 512);
+}
+
+// the .CAR header's checksum changed by d
+static void flash_sum(uint32_t d) {
+	flash.sum += d;
+	flash.head[8] = flash.sum >> 24;
+	flash.head[9] = flash.sum >> 16;
+	flash.head[10] = flash.sum >> 8;
+	flash.head[11] = flash.sum;
+	flash_dirty_block(0);
+}
+
+void flash_reset(uint8_t *ram1, uint8_t *ram2) {
+	memset(&flash, 0, sizeof(FLASH_CART));
+	flash.ram1 = ram1;
+	flash.ram2 = ram2;
+	flash.writing = -1;
+	flash.eraseWait = (SystemCoreClock / 1000000) * FLASH_ERASE_WAIT_US;
+	flash.settle = (SystemCoreClock / 1000) * FLASH_SETTLE_MS;
+}
+
+int flash_map(FIL *fil, uint32_t offset, const uint8_t *head) {
+	FATFS *fs = fil->fs;
+	DWORD clst = fil->sclust;
+	int blocks = (offset + FLASH_SIZE + 511) / 512;
+
+	// copying the header 16 bytes at a time has to stay in one place
+	if (offset > sizeof(flash.head) || (offset & (FLASH_COPY_STEP - 1))
+			|| fil->fsize != offset + FLASH_SIZE)
+		return 0;
+	for (int b = 0; b < blocks; b++) {
+		if (b && b % fs->csize == 0) {
+			clst = get_fat(fs, clst);
+			if (clst < 2 || clst >= fs->n_fatent) return 0;
+		}
+		flash.sector[b] = clust2sect(fs, clst) + b % fs->csize;
+	}
+	memcpy(flash.head, head, offset);
+	flash.sum = offset < 12 ? 0 :
+		(uint32_t)head[8] << 24 | (uint32_t)head[9] << 16 | (uint32_t)head[10] << 8 | head[11];
+	flash.offset = offset;
+	flash.blocks = blocks;
+	return 1;
+}
+
+static void flash_program(uint32_t addr, uint8_t data) {
+	uint8_t *p = flash_byte(addr), old = *p;
+	// programming can only clear bits
+	*p = old & data;
+	flash.programs++;
+	if (*p != old) {
+		flash_dirty(addr);
+		if (flash.offset >= 12)
+			flash_sum(*p - old);
+	}
+}
+
+static void flash_erase(uint8_t mask) {
+	if (!mask) return;
+	flash.eraseMask |= mask;
+	if (flash.mode != FLASH_ERASING) {
+		flash.mode = FLASH_ERASING;
+		flash.erasePos = 0;
+	}
+	// more sectors can be added until the erase starts
+	flash.cycle = CYCLE_ERASE_MORE;
+}
+
+static void flash_erase_done(void) {
+	flash.mode = FLASH_READ;
+	flash.cycle = CYCLE_NONE;
+	flash.eraseMask = 0;
+	flash.erasePos = 0;
+	flash.erases++;
+	flash.lastWrite = DWT->CYCCNT;
+}
+
+int flash_write(uint32_t addr, uint8_t data) {
+	uint32_t cmdAddr = addr & 0x7FFF;
+	flash.lastWrite = DWT->CYCCNT;
+	if (flash.mode == FLASH_ERASING) {
+		// more sectors, within FLASH_ERASE_WAIT_US of the last; suspend isn't supported
+		if (flash.cycle == CYCLE_ERASE_MORE && data == 0x30)
+			flash_erase(1 << (addr / FLASH_SECTOR_SIZE));
+		else
+			flash.cycle = CYCLE_NONE;
+		return flash.mode;
+	}
+	switch (flash.cycle) {
+	case CYCLE_NONE:
+		if (cmdAddr == 0x5555 && data == 0xAA) flash.cycle = CYCLE_AA;
+		else if (data == 0xF0) flash.mode = FLASH_READ;
+		break;
+	case CYCLE_AA:
+		flash.cycle = (cmdAddr == 0x2AAA && data == 0x55) ? CYCLE_55 : CYCLE_NONE;
+		break;
+	case CYCLE_55:
+		flash.cycle = CYCLE_NONE;
+		if (cmdAddr != 0x5555) break;
+		if (data == 0xA0) flash.cycle = CYCLE_PROGRAM;
+		else if (data == 0x80) flash.cycle = CYCLE_ERASE;
+		else if (data == 0x90) flash.mode = FLASH_AUTOSELECT;
+		else if (data == 0xF0) flash.mode = FLASH_READ;
+		break;
+	case CYCLE_PROGRAM:
+		flash.cycle = CYCLE_NONE;
+		flash_program(addr, data);
+		break;
+	case CYCLE_ERASE:
+		flash.cycle = (cmdAddr == 0x5555 && data == 0xAA) ? CYCLE_ERASE_AA : CYCLE_NONE;
+		break;
+	case CYCLE_ERASE_AA:
+		flash.cycle = (cmdAddr == 0x2AAA && data == 0x55) ? CYCLE_ERASE_55 : CYCLE_NONE;
+		break;
+	case CYCLE_ERASE_55:
+		flash.cycle = CYCLE_NONE;
+		if (data == 0x30) flash_erase(1 << (addr / FLASH_SECTOR_SIZE));
+		else if (data == 0x10 && cmdAddr == 0x5555) flash_erase(0xFF);
+		break;
+	default:
+		flash.cycle = CYCLE_NONE;
+	}
+	return flash.mode;
+}
+
+uint8_t flash_read(uint32_t addr) {
+	if (flash.mode == FLASH_AUTOSELECT) {
+		if (addr & 2) return 0;		// sector not protected
+		return (addr & 1) ? FLASH_DEVICE : FLASH_MANUFACTURER;
+	}
+	if (flash.mode == FLASH_ERASING) {
+		// DQ7 low, DQ6 toggling, DQ3 erase started, and DQ2 toggling in a sector being erased
+		flash.toggle ^= 0x44;
+		return (flash.cycle == CYCLE_ERASE_MORE ? 0 : 0x08) | (flash.toggle & ((flash.eraseMask & (1 << (addr / FLASH_SECTOR_SIZE))) ? 0x44 : 0x40));
+	}
+	return *flash_byte(addr);
+}
+
+static void flash_erase_step(void) {
+	if (flash.cycle == CYCLE_ERASE_MORE) {
+		// the chip waits for more sectors before it starts, and then takes no more
+		if (DWT->CYCCNT - flash.lastWrite < flash.eraseWait)
+			return;
+		flash.cycle = CYCLE_NONE;
+	}
+	if (!flash.eraseMask) {
+		flash_erase_done();
+		return;
+	}
+	int s = __builtin_ctz(flash.eraseMask);
+	uint32_t addr = s * FLASH_SECTOR_SIZE + flash.erasePos;
+	uint32_t *w = (uint32_t *)flash_byte(addr), x = ~*w;
+	if (x) {
+		*w = 0xFFFFFFFF;
+		flash_dirty(addr);
+		// the checksum goes up by what each byte was short of $FF
+		if (flash.offset >= 12)
+			flash_sum((x & 0xFF) + ((x >> 8) & 0xFF) + ((x >> 16) & 0xFF) + (x >> 24));
+	}
+	flash.erasePos += FLASH_ERASE_STEP;
+	if (flash.erasePos == FLASH_SECTOR_SIZE) {
+		flash.erasePos = 0;
+		flash.eraseMask &= ~(1 << s);
+		if (!flash.eraseMask)
+			flash_erase_done();
+	}
+}
+
+// a dirty block from the next word of them, -1 if that word has none
+static int flash_pick(void) {
+	int i = flash.pick;
+	uint32_t d = flash.dirty[i];
+	if (++flash.pick == FLASH_DIRTY_WORDS)
+		flash.pick = 0;
+	if (!d)
+		return -1;
+	flash.dirty[i] = d & (d - 1);
+	flash.numDirty--;
+	return i * 32 + __builtin_ctz(d);
+}
+
+// FLASH_COPY_STEP bytes, a word at a time
+static void flash_copy(uint32_t *dst, const uint32_t *src) {
+	dst[0] = src[0];
+	dst[1] = src[1];
+	dst[2] = src[2];
+	dst[3] = src[3];
+}
+
+int flash_step(void) {
+	if (flash.mode == FLASH_ERASING) {
+		flash_erase_step();
+		return flash.mode;
+	}
+	if (flash.writing >= 0) {
+		if (flash.copied < 512) {
+			// gather the block; a program from here on marks it dirty again
+			uint32_t pos = flash.writing * 512 + flash.copied;
+			uint32_t *dst = (uint32_t *)&flash.buf[flash.copied];
+			if (pos < flash.offset)
+				flash_copy(dst, (uint32_t *)&flash.head[pos]);
+			else if (pos - flash.offset < FLASH_SIZE)
+				flash_copy(dst, (uint32_t *)flash_byte(pos - flash.offset));
+			else
+				dst[0] = dst[1] = dst[2] = dst[3] = 0;	// past the end of the file
+			if ((flash.copied += FLASH_COPY_STEP) == 512)
+				TM_FATFS_SD_BgWriteStart(flash.sector[flash.writing], flash.buf);
+		}
+		else if (!TM_FATFS_SD_BgWriteStep()) {
+			if (TM_FATFS_SD_BgWriteOk()) {
+				flash.blocksWritten++;
+				flash.writing = -1;
+			}
+			else if (++flash.tries >= FLASH_TRIES) {
+				flash.blocksFailed++;
+				flash.writing = -1;
+			}
+			else
+				TM_FATFS_SD_BgWriteStart(flash.sector[flash.writing], flash.buf);
+		}
+		return flash.mode;
+	}
+	if (flash.numDirty && flash.blocks && DWT->CYCCNT - flash.lastWrite >= flash.settle
+			&& (flash.writing = flash_pick()) >= 0) {
+		flash.copied = 0;
+		flash.tries = 0;
+	}
+	return flash.mode;
+}
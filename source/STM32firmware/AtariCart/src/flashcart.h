@@ -0,0 +1,106 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Flash carts. The AtariMax 1Mbit and SIC! 128k carts keep their 128k in an
+ * Am29F010 flash chip (8 sectors of 16k), and games save by sending it JEDEC
+ * command sequences through the cart window. The chip is emulated on the
+ * image in cart_ram1/cart_ram2: programming a byte clears its bits in SRAM
+ * there and then, erasing fills a sector with $FF a word per idle bus cycle
+ * (reads give the chip's busy status meanwhile, as a real one does), and
+ * autoselect gives AMD's IDs.
+ *
+ * Each 512 byte block of the .CAR that changes is marked dirty. Once the
+ * Atari has left the flash alone for FLASH_SETTLE_MS, the dirty blocks are
+ * written back to the file in the loop's idle cycles, a byte at a time with
+ * TM_FATFS_SD_BgWriteStep, straight to the file's sectors (looked up in the
+ * FAT at load time, as FatFs isn't used once the cart is running). The cart
+ * never goes back to the menu, so the file is up to date a moment after the
+ * game stops saving, which is when it's safe to turn the Atari off.
+ *
+ * All of that runs after phi2 falls, in the half cycle before the next poll,
+ * so each call does a fixed amount of it with no loops (HostTools/unowcet
+ * checks this).
+ */
+
+#ifndef FLASHCART_H
+#define FLASHCART_H
+
+#include <stdint.h>
+#include "ff.h"
+
+#define FLASH_SIZE			(128*1024)
+#define FLASH_SECTOR_SIZE	16384
+#define FLASH_MANUFACTURER	0x01		// AMD
+#define FLASH_DEVICE		0x20		// Am29F010
+#define FLASH_FILE_BLOCKS	((16 + FLASH_SIZE + 511) / 512)		// of a .CAR
+#define FLASH_DIRTY_WORDS	((FLASH_FILE_BLOCKS + 31) / 32)
+#define FLASH_ERASE_STEP	4			// bytes erased per idle cycle, a word
+#define FLASH_ERASE_WAIT_US	50			// for more sectors, after a sector erase command
+#define FLASH_COPY_STEP		16			// bytes copied per idle cycle for a block to write, 4 words
+#define FLASH_SETTLE_MS		250			// after the last write to the flash, before saving
+#define FLASH_TRIES			3			// writes of a block before giving up on it
+
+// how the chip answers reads
+#define FLASH_READ			0			// the array
+#define FLASH_AUTOSELECT	1			// IDs
+#define FLASH_ERASING		2			// status, with DQ6 toggling
+
+typedef struct {
+	int mode;				// FLASH_xxx
+	int cycle;				// of the command being written
+	uint8_t eraseMask;		// sectors left to erase
+	uint8_t toggle;
+	uint32_t erasePos;		// in the first of them
+	uint8_t *ram1, *ram2;
+	// saving
+	int blocks;				// of the file, 0 if it isn't saved
+	uint32_t offset;		// of the chip's first byte in the file
+	uint8_t head[16] __attribute__((aligned(4)));	// .CAR header, with the checksum kept up to date
+	uint32_t sum;
+	uint32_t sector[FLASH_FILE_BLOCKS];
+	uint32_t dirty[FLASH_DIRTY_WORDS];
+	int numDirty;
+	int pick;				// word of dirty to look in next
+	int writing;			// block being written, -1 for none
+	int copied;				// bytes of it in buf
+	int tries;
+	uint32_t lastWrite;		// DWT->CYCCNT
+	uint32_t eraseWait, settle;	// FLASH_ERASE_WAIT_US and FLASH_SETTLE_MS in cycles
+	uint8_t buf[512] __attribute__((aligned(4)));
+	// for HostTools/bussim
+	uint32_t programs, erases, blocksWritten, blocksFailed;
+} FLASH_CART;
+
+extern FLASH_CART flash;
+
+// is cartType one of the carts above?
+int flash_cart_type(int cartType);
+// a chip holding the image in ram1 and ram2, not saved anywhere yet
+void flash_reset(uint8_t *ram1, uint8_t *ram2);
+/* Save it back to fil, where the chip starts at offset after the .CAR
+   header head. Returns 0 if the file's sectors can't be found */
+int flash_map(FIL *fil, uint32_t offset, const uint8_t *head);
+/* For the emulation loop, with addr in the chip. flash_write and flash_step
+   return the mode, and reads only need flash_read when it isn't FLASH_READ */
+int flash_write(uint32_t addr, uint8_t data);
+uint8_t flash_read(uint32_t addr);
+// from an idle cycle: erasing and saving
+int flash_step(void);
+
+#endif
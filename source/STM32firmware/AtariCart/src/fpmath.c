@@ -0,0 +1,356 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The routines follow source/Atari/UnoCartOS/mathpack.s instruction by
+ * instruction (same labels in the comments), on a copy of page zero and
+ * with the 6502 carry, decimal flag and A/X/Y at exit kept explicitly,
+ * so even the scratch bytes they leave behind match. That is slower
+ * than a native BCD implementation would be, but it is still a couple of
+ * hundred times faster than the 6502, and it means programs which depend
+ * on exactly how the OS rounds see no difference. HostTools/unofp checks
+ * that against the OS's own routines.
+ */
+
+#include <string.h>
+#include "fpmath.h"
+
+#define FR0		0xD4
+#define FR3		0xDA
+#define FR1		0xE0
+#define FR2		0xE6
+#define FLPTR	0xFC
+
+/* fdiv */
+#define DIGIT	(FR3+1)
+#define INDEX	(FR3+2)
+/* fp_fmul_innerloop */
+#define OFFSET	(FR3+5)
+#define OFFSET2	FR2
+
+static uint8_t zp[256];
+static int decimal;
+static uint8_t regA, regX, regY;
+
+static uint8_t adc(uint8_t a, uint8_t v, int *c)
+{
+	if (decimal) {
+		int lo = (a & 0xf) + (v & 0xf) + *c;
+		int hi = (a >> 4) + (v >> 4);
+		if (lo > 9) lo += 6;
+		if (lo > 0xf) hi++;
+		if (hi > 9) hi += 6;
+		*c = hi > 0xf;
+		return (hi << 4) | (lo & 0xf);
+	}
+	int r = a + v + *c;
+	*c = r > 0xff;
+	return r;
+}
+
+static uint8_t sbc(uint8_t a, uint8_t v, int *c)
+{
+	int borrow = !*c;
+	int r = a - v - borrow;
+	*c = r >= 0;
+	if (decimal) {
+		int lo = (a & 0xf) - (v & 0xf) - borrow;
+		int hi = (a >> 4) - (v >> 4);
+		if (lo < 0) { lo -= 6; hi--; }
+		if (hi < 0) hi -= 6;
+		return (hi << 4) | (lo & 0xf);
+	}
+	return r;
+}
+
+/* zfl */
+static void zfl(uint8_t x, int y)
+{
+	while (y--) zp[x++] = 0;
+	regA = 0;
+	regX = x;
+	regY = 0;
+}
+
+static void zfr0(void)
+{
+	zfl(FR0, 6);
+}
+
+/* fp_normalize_cld, returns carry (1 = overflow) */
+static int fp_normalize(void)
+{
+	decimal = 0;
+	for (int y = 5; y; y--) {
+		uint8_t a = zp[FR0] & 0x7f;
+		if (!a) break;
+		if (zp[FR0+1]) {
+			if (a < 64-49) break;
+			regA = a;
+			regX = zp[FR0+1];
+			regY = y;
+			return a >= 64+49;
+		}
+		// need_norm
+		zp[FR0]--;
+		for (int x = 1; x < 6; x++)
+			zp[FR0+x] = zp[FR0+x+1];
+		regA = zp[FR0+6];
+		zp[FR0+6] = 0;
+		if (y == 1) {
+			zp[FR0] = zp[FR0+1] = 0;
+			regX = regY = 0;
+			return 0;
+		}
+	}
+	// underflow
+	zfr0();
+	return 0;
+}
+
+/* fp_fastadd6_fr1, returns carry */
+static int fp_fastadd6_fr1(uint8_t x)
+{
+	int c = 0;
+	for (int i = 5; i >= 0; i--)
+		zp[(uint8_t)(x+i)] = adc(zp[(uint8_t)(x+i)], zp[FR1+i], &c);
+	return c;
+}
+
+/* fp_fastsub5, returns carry */
+static int fp_fastsub5(void)
+{
+	int c = 1;
+	for (int i = 5; i; i--)
+		zp[FR0+i] = sbc(zp[FR0+i], zp[FR1+i], &c);
+	return c;
+}
+
+/* fp_fastdbl_fr1 */
+static void fp_fastdbl_fr1(int *c)
+{
+	for (int i = 5; i >= 0; i--)
+		zp[FR1+i] = adc(zp[FR1+i], zp[FR1+i], c);
+}
+
+/* fp_carryup.round_loop */
+static void fp_carryup(uint8_t x, uint8_t a, int c)
+{
+	do {
+		zp[x] = adc(a, zp[x], &c);
+		x--;
+		a = 0;
+	} while (c);
+}
+
+/* fp_adjust_exponent.fmul_entry, A = exp1. Returns -1 and the new
+   exponent, or zeroes FR0 and returns the carry on over/underflow. */
+static int fp_adjust_exponent(uint8_t a, int c, uint8_t *exp)
+{
+	uint8_t x = a;
+	zp[FR1] = (a ^ zp[FR0]) & 0x80;
+	x = adc(x, zp[FR0], &c);
+	a = x ^ zp[FR1];
+	if (a < 128-49 || a >= 128+49) {
+		zfr0();
+		return a >= 128+49;
+	}
+	c = 1;
+	*exp = sbc(x, 0x40, &c);
+	return -1;
+}
+
+/* fmul */
+static int fp_mul(void)
+{
+	int c;
+	uint8_t exp;
+
+	// FR0 zero is dealt with on the 6502
+	if (!zp[FR1]) {
+		zfr0();
+		return 0;
+	}
+	// fp_fmul_fr0_to_binfr2 (fp_dectobin_tab runs into zeroes after 9)
+	for (int x = 4; x >= 0; x--) {
+		uint8_t a = zp[FR0+1+x];
+		zp[FR2+1+x] = a >> 4 < 10 ? a - 6 * (a >> 4) : a;
+	}
+	if ((c = fp_adjust_exponent(zp[FR1], 0, &exp)) >= 0)
+		return c;
+	zp[FR0] = exp;
+
+	// fp_fmul_innerloop
+	zp[FR0]++;
+	zfl(FR0+1, 12);
+	zp[OFFSET] = 7;
+	decimal = 1;
+	zp[FR0+7] = 0x50;
+	c = 0;
+	do {
+		for (uint8_t x = FR0+5; x != FR0; x--) {
+			uint8_t m = zp[(uint8_t)(x + FR2-FR0)];
+			zp[(uint8_t)(x + FR2-FR0)] = m >> 1;
+			if (m & 1) {
+				if (fp_fastadd6_fr1(x)) {
+					zp[OFFSET2] = x;
+					fp_carryup(x-1, 0, 1);
+					x = zp[OFFSET2];
+				}
+			}
+		}
+		c = 0;
+		fp_fastdbl_fr1(&c);
+	} while (--zp[OFFSET]);
+	if (zp[FR0+1])
+		fp_carryup(FR0+6, 0x50, c);
+	return fp_normalize();
+}
+
+/* fp_fdiv_init, returns 0 if fp_adjust_exponent bailed out */
+static int fp_fdiv_init(void)
+{
+	uint8_t exp, x = 0;
+
+	zfl(FR2, 6);
+	zp[FR2+6] = 0x50;
+	if (fp_adjust_exponent(zp[FR1] ^ 0x7f, 1, &exp) >= 0)
+		return 0;
+	zp[FR3] = exp;
+	zp[FR0] = zp[FR1] = 0;
+	if (zp[FR1+1] < 0x10) {
+		for (int i = 1; i < 5; i++)
+			zp[FR1+i] = (zp[FR1+i] << 4) | (zp[FR1+i+1] >> 4);
+		zp[FR1+5] <<= 4;
+		x = 0x09;
+	}
+	zp[DIGIT] = x;
+	decimal = 1;
+	zp[INDEX] = 0-7;
+	return 1;
+}
+
+/* fdiv */
+static int fp_div(void)
+{
+	int c;
+	uint8_t a, x;
+
+	// FR0 or FR1 zero is dealt with on the 6502, which has X and Y
+
+	// On over/underflow the 6502 code returns from fp_fdiv_init into the
+	// digit loop with FR0 zeroed, and the result is built from whatever
+	// _fr3 held; this falls through the same way.
+	fp_fdiv_init();
+	c = 1;
+	do {
+		// digitloop
+		if (zp[FR0] | zp[FR0+1]) {
+			if (c) {
+				do {
+					// decloop
+					a = zp[DIGIT];
+					x = zp[INDEX];
+					do {
+						zp[(uint8_t)(FR2+7+x)] = adc(a, zp[(uint8_t)(FR2+7+x)], &c);
+						a = 0;
+						x--;
+					} while (c);
+					c = fp_fastsub5();
+					zp[FR0] = sbc(zp[FR0], 0, &c);
+				} while (c);
+			} else {
+				do {
+					// incloop
+					a = sbc(0, zp[DIGIT], &c);
+					x = zp[INDEX];
+					do {
+						zp[(uint8_t)(FR2+7+x)] = adc(a, zp[(uint8_t)(FR2+7+x)], &c);
+						a = 0x99;
+						x--;
+					} while (!c);
+					c = fp_fastadd6_fr1(FR0);
+				} while (!c);
+			}
+		}
+		// nextdigit
+		for (int i = 0; i < 5; i++)
+			zp[FR0+i] = (zp[FR0+i] << 4) | (zp[FR0+i+1] >> 4);
+		zp[FR0+5] <<= 4;
+		zp[DIGIT] ^= 0x09;
+	} while (!zp[DIGIT] || ++zp[INDEX]);
+
+	x = FR2-1;
+	a = zp[FR3];
+	if (!zp[FR2]) {
+		x++;
+		a--;
+	}
+	zp[x] = a;
+	// fld0r_zp
+	zp[FLPTR] = x;
+	zp[FLPTR+1] = 0;
+	memmove(&zp[FR0], &zp[x], 6);
+	regA = zp[FR0];
+	regX = x;
+	regY = 0xFF;
+	decimal = 0;
+	return 0;
+}
+
+/* a digit over 9 in the mantissa */
+static int fp_bad_digits(const uint8_t *m)
+{
+	for (int i = 1; i < 6; i++)
+		if ((m[i] & 0xf) > 9 || (m[i] >> 4) > 9)
+			return 1;
+	return 0;
+}
+
+int fp_op(int op, FP_STATE *state)
+{
+	int c = 1;
+
+	// zero operands are left to the 6502, since the result leaves X and Y
+	// as they were, and so are unnormalised divisors, which can keep it
+	// busy for minutes when the cart has to get back to the bus
+	if (!state->zp[0] || (op == FP_OP_DIV && (!state->zp[FR1-FR0] || !state->zp[FR1+1-FR0])))
+		return -1;
+	// and anything that isn't BCD, as fp_carryup can then carry on below
+	// FR0 into page zero the cart doesn't have
+	if (fp_bad_digits(&state->zp[0]) || fp_bad_digits(&state->zp[FR1-FR0]))
+		return -1;
+
+	memcpy(&zp[FR0], state->zp, FP_ZP_SIZE);
+	memcpy(&zp[FLPTR], state->flptr, 2);
+	decimal = 0;
+	switch (op) {
+		case FP_OP_MUL:
+			c = fp_mul();
+			break;
+		case FP_OP_DIV:
+			c = fp_div();
+			break;
+	}
+	memcpy(state->zp, &zp[FR0], FP_ZP_SIZE);
+	memcpy(state->flptr, &zp[FLPTR], 2);
+	state->a = regA;
+	state->x = regX;
+	state->y = regY;
+	return c;
+}
@@ -0,0 +1,53 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Atari 6-byte BCD floating point, for the soft OS math pack offload.
+ *
+ * A port of FMUL and FDIV from the soft OS mathpack.s, working on the
+ * same zero page layout, so results (rounding, underflow, overflow and the
+ * odd corner case) are identical to the 6502 code. FADD/FSUB stay on the
+ * 6502: at ~190 cycles they are quicker than a trip through $D5xx.
+ */
+
+#ifndef FPMATH_H
+#define FPMATH_H
+
+#include <stdint.h>
+
+#define FP_OP_MUL	0
+#define FP_OP_DIV	1
+
+/* Page zero from FR0 ($D4) to the end of FR2 ($EC) */
+#define FP_ZP_SIZE	25
+
+/* What the 6502 routines read and leave behind: besides FR0, FMUL leaves
+   its low product digits in _fr3, which a following FADD can shift back
+   into FR0, and EXP carries on with the A register FMUL returns. */
+typedef struct {
+	uint8_t zp[FP_ZP_SIZE];
+	uint8_t flptr[2];		// $FC
+	uint8_t a, x, y;
+} FP_STATE;
+
+/* Runs FMUL or FDIV on the state. Returns the carry flag the 6502 routine
+   would return (1 = error), or -1 if the 6502 should do the operation
+   itself: zero operands, unnormalised divisors and digits over 9. */
+int fp_op(int op, FP_STATE *state);
+
+#endif
@@ -0,0 +1,284 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "hdevice.h"
+#include "ff.h"
+#include <string.h>
+
+#define EOL			0x9B
+#define DIR_LINE	20		// "  NAME     EXT 012" + EOL
+
+typedef struct {
+	uint8_t aux1;			// 0 = closed
+	uint8_t dirDone;
+	uint8_t linePos, lineLen;
+	char line[DIR_LINE];
+	char pattern[H_SPEC_LEN+1];	// f_findnext keeps a pointer to it
+	FIL fil;
+	DIR dir;
+} H_FILE;
+
+static H_FILE hFiles[H_NUM_FILES];
+static FILINFO hFno;		// no long names, the 8.3 ones are what the Atari can type
+// full paths for the command being handled, kept off the stack
+static char hPath[256], hNewPath[256], hOldDir[256];
+
+static int h_status(FRESULT res) {
+	switch (res) {
+		case FR_OK: return H_OK;
+		case FR_NO_FILE:
+		case FR_NO_PATH: return H_NOT_FOUND;
+		case FR_INVALID_NAME: return H_NAME_ERR;
+		case FR_DENIED:
+		case FR_EXIST:
+		case FR_WRITE_PROTECTED: return H_LOCKED;
+		default: return H_FATAL;
+	}
+}
+
+// build dir/name in path from "Hn:name", stopping at the EOL or a comma.
+// Returns the end of the name in spec, or NULL if it can't be a FAT path
+static const uint8_t *h_path(char *path, const char *dir, const uint8_t *spec, const uint8_t *end) {
+	const uint8_t *p = spec;
+	int len;
+
+	// skip the device
+	for (int i = 0; i < 3 && p[i] != EOL; i++)
+		if (p[i] == ':') {
+			p += i + 1;
+			break;
+		}
+	if (*p == '>' || *p == '\\' || *p == '/') {
+		path[0] = 0;	// from the root
+		p++;
+	}
+	else
+		strcpy(path, dir);
+	len = strlen(path);
+	path[len++] = '/';
+	for (; p < end && *p != EOL && *p && *p != ','; p++) {
+		uint8_t c = *p;
+		if (c == '>' || c == '\\') c = '/';
+		if (c <= ' ' || c >= 0x7F || len >= 255)
+			return NULL;
+		path[len++] = c;
+	}
+	path[len] = 0;
+	return p;
+}
+
+static int h_no_name(const char *path) {
+	return path[strlen(path)-1] == '/';
+}
+
+// DOS 2 layout, with MyDOS's ':' for directories
+static void h_dir_line(H_FILE *h) {
+	char *name = hFno.fname, *dot = strchr(name, '.');
+	char *ext = dot ? dot + 1 : "";
+	int nameLen = dot ? dot - name : strlen(name), extLen = strlen(ext);
+	char *l = h->line;
+	int i;
+
+	*l++ = (hFno.fattrib & AM_DIR) ? ':' : (hFno.fattrib & AM_RDO) ? '*' : ' ';
+	*l++ = ' ';
+	for (i = 0; i < 8; i++)
+		*l++ = i < nameLen ? name[i] : ' ';
+	*l++ = ' ';
+	for (i = 0; i < 3; i++)
+		*l++ = i < extLen ? ext[i] : ' ';
+	*l++ = ' ';
+	if (hFno.fattrib & AM_DIR) {
+		memcpy(l, "DIR", 3);
+		l += 3;
+	}
+	else {
+		uint32_t sectors = (hFno.fsize + 124) / 125;
+		if (sectors > 999) sectors = 999;
+		*l++ = '0' + sectors / 100;
+		*l++ = '0' + sectors / 10 % 10;
+		*l++ = '0' + sectors % 10;
+	}
+	*l++ = EOL;
+	h->lineLen = l - h->line;
+	h->linePos = 0;
+}
+
+static int h_dir_open(H_FILE *h, char *path) {
+	// the last part of the path is the pattern
+	char *slash = strrchr(path, '/');
+	strcpy(h->pattern, slash + 1);
+	if (!h->pattern[0] || !strcmp(h->pattern, "*.*"))
+		strcpy(h->pattern, "*");
+	*slash = 0;
+	h->dirDone = 0;
+	h->lineLen = h->linePos = 0;
+	int ret = h_status(f_findfirst(&h->dir, &hFno, path, h->pattern));
+	if (ret == H_OK) {
+		if (hFno.fname[0])
+			h_dir_line(h);
+		else
+			h->dirDone = 1;
+	}
+	return ret;
+}
+
+static int h_dir_read(H_FILE *h, uint8_t *buf, int len) {
+	int got = 0;
+	while (got < len) {
+		if (h->linePos == h->lineLen) {
+			if (h->dirDone == 2)
+				break;
+			if (h->dirDone) {
+				// the SD card is never going to be short of space for a 16 bit
+				// sector count, so there is no need to count the free clusters
+				strcpy(h->line, "999 FREE SECTORS\x9b");
+				h->lineLen = strlen(h->line);
+				h->linePos = 0;
+				h->dirDone = 2;
+			}
+			else {
+				if (f_findnext(&h->dir, &hFno) != FR_OK || !hFno.fname[0])
+					h->dirDone = 1;
+				else
+					h_dir_line(h);
+				continue;
+			}
+		}
+		buf[got++] = h->line[h->linePos++];
+	}
+	return got;
+}
+
+int hdev_open(int iocb, uint8_t aux1, const char *dir, const uint8_t *spec) {
+	H_FILE *h = &hFiles[iocb & (H_NUM_FILES-1)];
+	BYTE mode;
+	int ret;
+
+	hdev_close(iocb);	// left open over a reset
+	if (!h_path(hPath, dir, spec, spec + H_SPEC_LEN))
+		return H_NAME_ERR;
+	if ((aux1 & 0x06) == 0x06)
+		ret = h_dir_open(h, hPath);
+	else {
+		if (h_no_name(hPath) || strchr(hPath, '*') || strchr(hPath, '?'))
+			return H_NAME_ERR;
+		if ((aux1 & 0x0C) == 0x0C)
+			mode = FA_READ|FA_WRITE|FA_OPEN_EXISTING;
+		else if (aux1 & 0x08)
+			mode = FA_WRITE|((aux1 & 0x01) ? FA_OPEN_ALWAYS : FA_CREATE_ALWAYS);
+		else if (aux1 & 0x04)
+			mode = FA_READ|FA_OPEN_EXISTING;
+		else
+			return H_NOT_SUPPORTED;
+		if ((ret = h_status(f_open(&h->fil, hPath, mode))) == H_OK && (aux1 & 0x0D) == 0x09)
+			if ((ret = h_status(f_lseek(&h->fil, f_size(&h->fil)))) != H_OK)
+				f_close(&h->fil);
+	}
+	if (ret == H_OK)
+		h->aux1 = aux1;
+	return ret;
+}
+
+int hdev_close(int iocb) {
+	H_FILE *h = &hFiles[iocb & (H_NUM_FILES-1)];
+	int ret = H_OK;
+	if (!h->aux1)
+		return H_OK;
+	if ((h->aux1 & 0x06) == 0x06)
+		f_closedir(&h->dir);
+	else
+		ret = h_status(f_close(&h->fil));
+	h->aux1 = 0;
+	return ret;
+}
+
+void hdev_close_all(void) {
+	for (int i = 0; i < H_NUM_FILES; i++)
+		hdev_close(i);
+}
+
+int hdev_read(int iocb, uint8_t *buf, int len, int *got) {
+	H_FILE *h = &hFiles[iocb & (H_NUM_FILES-1)];
+	UINT br = 0;
+
+	*got = 0;
+	if (!h->aux1)
+		return H_NOT_OPEN;
+	if ((h->aux1 & 0x06) == 0x06)
+		br = h_dir_read(h, buf, len);
+	else if (f_read(&h->fil, buf, len, &br) != FR_OK)
+		return H_FATAL;
+	*got = br;
+	return br ? H_OK : H_EOF;
+}
+
+int hdev_write(int iocb, const uint8_t *buf, int len, int *put) {
+	H_FILE *h = &hFiles[iocb & (H_NUM_FILES-1)];
+	UINT bw = 0;
+
+	*put = 0;
+	if (!h->aux1)
+		return H_NOT_OPEN;
+	if ((h->aux1 & 0x06) == 0x06)
+		return H_NOT_SUPPORTED;
+	if (f_write(&h->fil, buf, len, &bw) != FR_OK)
+		return H_FATAL;
+	*put = bw;
+	return bw == (UINT)len ? H_OK : H_DISK_FULL;
+}
+
+int hdev_special(int iocb, uint8_t xio, uint32_t *pos, const char *dir, const uint8_t *spec) {
+	H_FILE *h = &hFiles[iocb & (H_NUM_FILES-1)];
+	const uint8_t *p, *end = spec + H_SPEC_LEN;
+
+	if (xio == H_XIO_POINT || xio == H_XIO_NOTE) {
+		if (!h->aux1)
+			return H_NOT_OPEN;
+		if ((h->aux1 & 0x06) == 0x06)
+			return H_NOT_SUPPORTED;
+		if (xio == H_XIO_NOTE) {
+			*pos = f_tell(&h->fil);
+			return H_OK;
+		}
+		// only files open for writing can be made longer
+		if (*pos > f_size(&h->fil) && !(h->aux1 & 0x08))
+			return H_POINT_ERR;
+		return h_status(f_lseek(&h->fil, *pos));
+	}
+
+	if (!(p = h_path(hPath, dir, spec, end)) || h_no_name(hPath))
+		return H_NAME_ERR;
+	switch (xio) {
+		case H_XIO_RENAME:
+			// "H:OLD,NEW" - the new name is in the same directory
+			if (*p != ',')
+				return H_NAME_ERR;
+			strcpy(hOldDir, hPath);
+			*strrchr(hOldDir, '/') = 0;
+			if (!h_path(hNewPath, hOldDir, p + 1, end) || h_no_name(hNewPath))
+				return H_NAME_ERR;
+			return h_status(f_rename(hPath, hNewPath));
+		case H_XIO_DELETE:
+			return h_status(f_unlink(hPath));
+		case H_XIO_LOCK:
+			return h_status(f_chmod(hPath, AM_RDO, AM_RDO));
+		case H_XIO_UNLOCK:
+			return h_status(f_chmod(hPath, 0, AM_RDO));
+	}
+	return H_NOT_SUPPORTED;
+}
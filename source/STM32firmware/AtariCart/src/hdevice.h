@@ -0,0 +1,65 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * H: device for the soft OS - files on the SD card, opened by name from
+ * the directory the ATR was booted from ("H:GAME.BAS"), or from the root
+ * ("H:>DIR>GAME.BAS", '\' and '/' also work). One file per IOCB.
+ * All calls return a CIO status, 0 for success.
+ */
+
+#ifndef HDEVICE_H
+#define HDEVICE_H
+
+#include <stdint.h>
+
+#define H_NUM_FILES		8		// one per IOCB
+#define H_SPEC_LEN		64		// filespec as sent by the 6502, EOL terminated
+#define H_BLOCK			128		// most bytes moved by one read/write
+
+/* CIO status codes */
+#define H_OK			0x00
+#define H_NOT_OPEN		0x85
+#define H_EOF			0x88
+#define H_NOT_SUPPORTED	0x92
+#define H_DISK_FULL		0xA2
+#define H_FATAL			0xA3
+#define H_NAME_ERR		0xA5
+#define H_POINT_ERR		0xA6
+#define H_LOCKED		0xA7
+#define H_NOT_FOUND		0xAA
+
+/* XIO commands */
+#define H_XIO_RENAME	0x20
+#define H_XIO_DELETE	0x21
+#define H_XIO_LOCK		0x23
+#define H_XIO_UNLOCK	0x24
+#define H_XIO_POINT		0x25
+#define H_XIO_NOTE		0x26
+
+/* aux1 4 = read, 6 = directory, 8 = write, 9 = append, 12 = update */
+int hdev_open(int iocb, uint8_t aux1, const char *dir, const uint8_t *spec);
+int hdev_close(int iocb);
+void hdev_close_all(void);
+// up to len bytes, stopping early at the end of the file. H_EOF once there
+int hdev_read(int iocb, uint8_t *buf, int len, int *got);
+int hdev_write(int iocb, const uint8_t *buf, int len, int *put);
+// pos is the 24 bit file position for POINT and NOTE
+int hdev_special(int iocb, uint8_t xio, uint32_t *pos, const char *dir, const uint8_t *spec);
+
+#endif
@@ -0,0 +1,414 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "inflate.h"
+#include "cartinfo.h"
+#include "cmdstats.h"
+#include <string.h>
+
+/* Huffman codes are kept as canonical tables, the number of codes of each
+   length and the symbols in code order, and decoded a bit at a time */
+typedef struct {
+	uint16_t counts[16];
+	uint16_t symbols[288];
+} INF_TREE;
+
+typedef struct {
+	FIL *fil;
+	uint8_t *buf;
+	UINT bufSize, pos, len;
+	uint32_t inLeft;		// compressed bytes not read yet
+	uint32_t bits;
+	int bitCount;
+	uint32_t filPos;		// where the next read comes from
+	int mode;				// INF_xxx
+	int last;				// on the last block
+	uint32_t storedLeft;	// in a stored block
+	INFLATE_OUT *o;
+	uint8_t *dst;			// where the next byte goes
+	uint32_t dstRoom;		// and how many run on from there
+	int status;
+	INF_TREE lit, dist;
+} INF_STATE;
+
+#define INF_HEADER	0		// next is a block header
+#define INF_CODES	1		// in a Huffman block
+#define INF_STORED	2
+#define INF_DONE	3
+
+static INF_STATE inf;
+
+static const uint16_t lenBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lenExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// the order the code length code lengths come in
+static const uint8_t clenOrder[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// CRC-32 a nibble at a time, to keep the table small
+static const uint32_t crcNibble[16] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C };
+
+static void inf_crc(const uint8_t *p, uint32_t n) {
+	uint32_t crc = inf.o->crc;
+	while (n--) {
+		crc ^= *p++;
+		crc = (crc >> 4) ^ crcNibble[crc & 15];
+		crc = (crc >> 4) ^ crcNibble[crc & 15];
+	}
+	inf.o->crc = crc;
+}
+
+static int inf_fill(void) {
+	UINT want = inf.inLeft < inf.bufSize ? inf.inLeft : inf.bufSize;
+	if (!want) {
+		inf.status = INFLATE_CORRUPT;	// runs on past the data
+		return 0;
+	}
+	uint32_t t = stat_now();
+	// the file may have been used for something else since a run stopped
+	if ((f_tell(inf.fil) != inf.filPos && f_lseek(inf.fil, inf.filPos) != FR_OK)
+			|| f_read(inf.fil, inf.buf, want, &inf.len) != FR_OK || inf.len != want) {
+		inf.len = 0;
+		inf.status = INFLATE_READ_ERROR;
+	}
+	stat_phase(STAT_PHASE_READ, t);
+	inf.inLeft -= inf.len;
+	inf.filPos += inf.len;
+	inf.pos = 0;
+	return inf.len;
+}
+
+static uint32_t inf_bits(int n) {
+	while (inf.bitCount < n) {
+		if (inf.pos == inf.len && !inf_fill())
+			return 0;
+		inf.bits |= (uint32_t)inf.buf[inf.pos++] << inf.bitCount;
+		inf.bitCount += 8;
+	}
+	uint32_t v = inf.bits & ((1u << n) - 1);
+	inf.bits >>= n;
+	inf.bitCount -= n;
+	return v;
+}
+
+// where unpacked byte n is, and how many bytes run on from it
+static uint8_t *inf_at(uint32_t n, uint32_t *room) {
+	INFLATE_OUT *o = inf.o;
+	if (n < o->headLen) {
+		*room = o->headLen - n;
+		return o->head + n;
+	}
+	uint32_t p = n - o->headLen + o->base;
+	if (o->ring)
+		p %= CART_MAX_IMAGE_SIZE;
+	if (p < CART_RAM_SPLIT) {
+		*room = CART_RAM_SPLIT - p;
+		return o->ram1 + p;
+	}
+	*room = CART_MAX_IMAGE_SIZE - p;
+	return o->ram2 + p - CART_RAM_SPLIT;
+}
+
+// room at the output, 0 if the image is full
+static int inf_dst(void) {
+	INFLATE_OUT *o = inf.o;
+	if (!o->ring && o->out >= o->headLen && o->out - o->headLen + o->base >= CART_MAX_IMAGE_SIZE) {
+		inf.status = INFLATE_TOO_BIG;
+		return 0;
+	}
+	inf.dst = inf_at(o->out, &inf.dstRoom);
+	return 1;
+}
+
+static int inf_put(uint8_t b) {
+	if (!inf.dstRoom && !inf_dst())
+		return 0;
+	*inf.dst = b;
+	inf_crc(inf.dst, 1);
+	inf.dst++;
+	inf.dstRoom--;
+	inf.o->out++;
+	return 1;
+}
+
+static int inf_copy(uint32_t dist, uint32_t len) {
+	INFLATE_OUT *o = inf.o;
+	if (dist > o->out) {
+		inf.status = INFLATE_CORRUPT;
+		return 0;
+	}
+	while (len) {
+		uint32_t srcRoom, k;
+		if (!inf.dstRoom && !inf_dst())
+			return 0;
+		uint8_t *src = inf_at(o->out - dist, &srcRoom);
+		k = inf.dstRoom < srcRoom ? inf.dstRoom : srcRoom;
+		if (k > len) k = len;
+		// forwards a byte at a time, the source can overlap what's being written
+		for (uint32_t i = 0; i < k; i++)
+			inf.dst[i] = src[i];
+		inf_crc(inf.dst, k);
+		inf.dst += k;
+		inf.dstRoom -= k;
+		o->out += k;
+		len -= k;
+	}
+	return 1;
+}
+
+// bytes straight from the input, for a stored block or member
+static int inf_literal(uint32_t n) {
+	while (n) {
+		uint32_t k;
+		if (inf.pos == inf.len && !inf_fill())
+			return 0;
+		if (!inf.dstRoom && !inf_dst())
+			return 0;
+		k = inf.len - inf.pos;
+		if (k > inf.dstRoom) k = inf.dstRoom;
+		if (k > n) k = n;
+		memcpy(inf.dst, &inf.buf[inf.pos], k);
+		inf_crc(inf.dst, k);
+		inf.pos += k;
+		inf.dst += k;
+		inf.dstRoom -= k;
+		inf.o->out += k;
+		n -= k;
+	}
+	return 1;
+}
+
+static void inf_build(INF_TREE *t, const uint8_t *lengths, int n) {
+	uint16_t offs[16];
+	int i, sum = 0;
+	memset(t->counts, 0, sizeof(t->counts));
+	for (i = 0; i < n; i++)
+		t->counts[lengths[i]]++;
+	t->counts[0] = 0;
+	for (i = 0; i < 16; i++) {
+		offs[i] = sum;
+		sum += t->counts[i];
+	}
+	for (i = 0; i < n; i++)
+		if (lengths[i])
+			t->symbols[offs[lengths[i]]++] = i;
+}
+
+static int inf_decode(const INF_TREE *t) {
+	int code = 0, first = 0, index = 0;
+	for (int len = 1; len < 16; len++) {
+		code |= inf_bits(1);
+		int count = t->counts[len];
+		if (code - first < count)
+			return t->symbols[index + code - first];
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	inf.status = INFLATE_CORRUPT;
+	return -1;
+}
+
+static void inf_fixed(void) {
+	uint8_t lengths[288];
+	memset(lengths, 8, 144);
+	memset(lengths + 144, 9, 112);
+	memset(lengths + 256, 7, 24);
+	memset(lengths + 280, 8, 8);
+	inf_build(&inf.lit, lengths, 288);
+	memset(lengths, 5, 30);
+	inf_build(&inf.dist, lengths, 30);
+}
+
+static int inf_dynamic(void) {
+	uint8_t lengths[286 + 30];
+	int nlit = inf_bits(5) + 257, ndist = inf_bits(5) + 1, nclen = inf_bits(4) + 4;
+	int i, n = 0;
+
+	if (nlit > 286 || ndist > 30) {
+		inf.status = INFLATE_CORRUPT;
+		return 0;
+	}
+	memset(lengths, 0, 19);
+	for (i = 0; i < nclen; i++)
+		lengths[clenOrder[i]] = inf_bits(3);
+	inf_build(&inf.dist, lengths, 19);		// the code length code, for now
+	while (n < nlit + ndist && !inf.status) {
+		int sym = inf_decode(&inf.dist), rep, val = 0;
+		if (sym < 0)
+			return 0;
+		if (sym < 16) {
+			lengths[n++] = sym;
+			continue;
+		}
+		if (sym == 16) {
+			if (!n) {
+				inf.status = INFLATE_CORRUPT;
+				return 0;
+			}
+			val = lengths[n - 1];
+			rep = 3 + inf_bits(2);
+		}
+		else if (sym == 17)
+			rep = 3 + inf_bits(3);
+		else
+			rep = 11 + inf_bits(7);
+		if (n + rep > nlit + ndist) {
+			inf.status = INFLATE_CORRUPT;
+			return 0;
+		}
+		while (rep--)
+			lengths[n++] = val;
+	}
+	if (inf.status)
+		return 0;
+	inf_build(&inf.lit, lengths, nlit);
+	inf_build(&inf.dist, lengths + nlit, ndist);
+	return 1;
+}
+
+// the symbols of a Huffman block, until its end or stopAt
+static void inf_codes(void) {
+	INFLATE_OUT *o = inf.o;
+	while (!inf.status) {
+		if (o->stopAt && o->out >= o->stopAt) {
+			inf.status = INFLATE_STOPPED;
+			return;
+		}
+		int sym = inf_decode(&inf.lit);
+		if (sym < 0 || inf.status)
+			return;
+		if (sym < 256)
+			inf_put(sym);
+		else if (sym == 256) {
+			inf.mode = INF_HEADER;
+			return;
+		}
+		else {
+			sym -= 257;
+			if (sym >= 29) {
+				inf.status = INFLATE_CORRUPT;
+				return;
+			}
+			uint32_t len = lenBase[sym] + inf_bits(lenExtra[sym]);
+			int dsym = inf_decode(&inf.dist);
+			if (dsym < 0 || dsym >= 30) {
+				inf.status = INFLATE_CORRUPT;
+				return;
+			}
+			uint32_t dist = distBase[dsym] + inf_bits(distExtra[dsym]);
+			if (!inf.status)
+				inf_copy(dist, len);
+		}
+	}
+}
+
+// the rest of a stored block, or as much as stopAt allows
+static void inf_stored(void) {
+	INFLATE_OUT *o = inf.o;
+	uint32_t n = inf.storedLeft;
+	if (o->stopAt && n > o->stopAt - o->out)
+		n = o->stopAt > o->out ? o->stopAt - o->out : 0;
+	if (!inf_literal(n))
+		return;
+	inf.storedLeft -= n;
+	if (!inf.storedLeft)
+		inf.mode = INF_HEADER;
+	else
+		inf.status = INFLATE_STOPPED;
+}
+
+static void inf_header(void) {
+	if (inf.last) {
+		inf.mode = INF_DONE;
+		return;
+	}
+	inf.last = inf_bits(1);
+	int type = inf_bits(2);
+	if (inf.status)
+		return;
+	if (type == 0) {
+		inf.bits = 0;		// on to the next byte
+		inf.bitCount = 0;
+		uint32_t len = inf_bits(16), nlen = inf_bits(16);
+		if (!inf.status && len != (~nlen & 0xFFFF))
+			inf.status = INFLATE_CORRUPT;
+		inf.storedLeft = len;
+		inf.mode = INF_STORED;
+	}
+	else if (type == 1) {
+		inf_fixed();
+		inf.mode = INF_CODES;
+	}
+	else if (type == 2) {
+		if (inf_dynamic())
+			inf.mode = INF_CODES;
+	}
+	else
+		inf.status = INFLATE_CORRUPT;
+}
+
+static int inf_go(void) {
+	inf.status = INFLATE_OK;
+	while (!inf.status && inf.mode != INF_DONE) {
+		if (inf.mode == INF_HEADER)
+			inf_header();
+		else if (inf.mode == INF_CODES)
+			inf_codes();
+		else
+			inf_stored();
+	}
+	if (inf.mode == INF_DONE)
+		inf.o->crc ^= 0xFFFFFFFF;
+	return inf.status;
+}
+
+int inflate_run(FIL *fil, uint32_t inBytes, int stored, uint8_t *buf, uint32_t bufSize, INFLATE_OUT *o) {
+	memset(&inf, 0, sizeof(inf));
+	inf.fil = fil;
+	inf.filPos = f_tell(fil);
+	inf.buf = buf;
+	inf.bufSize = bufSize;
+	inf.inLeft = inBytes;
+	inf.o = o;
+	o->out = 0;
+	o->crc = 0xFFFFFFFF;
+	if (stored) {
+		inf.mode = INF_STORED;
+		inf.storedLeft = inBytes;
+		inf.last = 1;
+	}
+	return inf_go();
+}
+
+int inflate_resume(INFLATE_OUT *o) {
+	if (inf.o != o || inf.status != INFLATE_STOPPED)
+		return INFLATE_CORRUPT;
+	return inf_go();
+}
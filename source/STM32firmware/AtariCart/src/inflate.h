@@ -0,0 +1,62 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Deflate (RFC 1951), as in a ZIP, unpacked as it's read from the card
+ * straight into cart_ram1 and cart_ram2. Like lz4load.c the output is the
+ * SRAM image, so matches copy from what's already there and no separate
+ * window is kept. For an ATR the 128k is a ring instead, holding the last
+ * 128k unpacked, and a run can stop part way through the stream and carry
+ * on from there later.
+ */
+
+#ifndef INFLATE_H
+#define INFLATE_H
+
+#include <stdint.h>
+#include "ff.h"
+
+// status codes
+#define INFLATE_OK			0
+#define INFLATE_READ_ERROR	1
+#define INFLATE_CORRUPT		2
+#define INFLATE_TOO_BIG		3	// more than the SRAM image holds
+#define INFLATE_STOPPED		4	// got to stopAt
+
+typedef struct {
+	uint8_t *head;			// the first headLen bytes go here, a .CAR's header
+	uint32_t headLen;
+	uint8_t *ram1, *ram2;	// then the SRAM image
+	uint32_t base;			// where in it
+	int ring;				// wrap at the end of the image rather than stop
+	uint32_t stopAt;		// stop once this much is unpacked (give or take a
+							// match of up to 258 bytes), 0 for the end
+	// results
+	uint32_t out;			// bytes unpacked
+	uint32_t crc;			// their CRC-32, as a ZIP has it, once all are out
+} INFLATE_OUT;
+
+/* Unpack inBytes of fil, from where it's positioned, into o. stored = the
+   bytes are just copied. buf is for reading fil. Returns an INFLATE_xxx
+   status */
+int inflate_run(FIL *fil, uint32_t inBytes, int stored, uint8_t *buf, uint32_t bufSize, INFLATE_OUT *o);
+/* After INFLATE_STOPPED, carry on to o->stopAt. fil may have been used in
+   between but buf must be as it was */
+int inflate_resume(INFLATE_OUT *o);
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "lz4load.h"
+#include "cartinfo.h"
+#include "cmdstats.h"
+#include <string.h>
+
+/* The unpacked file is addressed by its offset. The first 16 bytes go to
+   r->head, until they show what the file is; after that offset o is at
+   o - 16 + base in the SRAM image, cart_ram1 then cart_ram2. */
+typedef struct {
+	FIL *fil;
+	uint8_t *ram1, *ram2;
+	LZ4_RESULT *r;
+	UINT pos, len;			// in buf
+	uint32_t blockLeft;		// compressed bytes left in the block
+	uint32_t out;			// unpacked so far
+	int base;				// -1 until the kind is known
+	uint32_t limit;			// first offset that doesn't fit
+	int status;
+	uint8_t buf[LZ4_IN_BUF];
+} LZ4_STATE;
+
+static LZ4_STATE lz;
+
+static int lz_fill(void) {
+	uint32_t t = stat_now();
+	if (f_read(lz.fil, lz.buf, LZ4_IN_BUF, &lz.len) != FR_OK) {
+		lz.len = 0;
+		lz.status = LZ4_READ_ERROR;
+	}
+	else if (!lz.len)
+		lz.status = LZ4_CORRUPT;	// cut short
+	stat_phase(STAT_PHASE_READ, t);
+	lz.pos = 0;
+	lz.r->inBytes += lz.len;
+	return lz.len;
+}
+
+// next byte of the frame, -1 at the end or on an error
+static int lz_byte(void) {
+	if (lz.pos == lz.len && !lz_fill())
+		return -1;
+	return lz.buf[lz.pos++];
+}
+
+static int lz_block_byte(void) {
+	if (!lz.blockLeft) {
+		lz.status = LZ4_CORRUPT;
+		return -1;
+	}
+	lz.blockLeft--;
+	return lz_byte();
+}
+
+static uint32_t lz_word(int bytes) {
+	uint32_t w = 0;
+	for (int i = 0; i < bytes; i++)
+		w |= (uint32_t)(lz_byte() & 0xFF) << (8 * i);
+	return w;
+}
+
+static void lz_skip(int bytes) {
+	while (bytes-- && lz_byte() >= 0)
+		;
+}
+
+// where unpacked byte o is, and how many bytes run on from it
+static uint8_t *lz_at(uint32_t o, uint32_t *room) {
+	if (o < 16) {
+		*room = 16 - o;
+		return &lz.r->head[o];
+	}
+	uint32_t p = o - 16 + lz.base;
+	if (p < CART_RAM_SPLIT) {
+		*room = CART_RAM_SPLIT - p;
+		return lz.ram1 + p;
+	}
+	*room = lz.limit - o;
+	return lz.ram2 + p - CART_RAM_SPLIT;
+}
+
+// the header is all there, so the rest of the file can be placed
+static void lz_place(void) {
+	uint8_t *h = lz.r->head;
+	uint32_t n = lz.out < 16 ? lz.out : 16;
+	if (n >= 4 && memcmp(h, "CART", 4) == 0) {
+		lz.r->kind = FILE_KIND_CAR;
+		lz.base = 0;
+	}
+	else {
+		if (n >= 2 && h[0] == 0xFF && h[1] == 0xFF) {
+			lz.r->kind = FILE_KIND_XEX;
+			lz.base = 4 + 16;	// the loader wants the length first
+		}
+		else {
+			lz.r->kind = FILE_KIND_ROM;
+			lz.base = 16;
+		}
+		memcpy(lz.ram1 + lz.base - 16, h, n);
+	}
+	lz.limit = CART_MAX_IMAGE_SIZE + 16 - lz.base;
+}
+
+// room at the output, NULL if the image is full
+static uint8_t *lz_dst(uint32_t *room) {
+	if (lz.out == 16 && lz.base < 0)
+		lz_place();
+	if (lz.base >= 0 && lz.out >= lz.limit) {
+		lz.status = LZ4_TOO_BIG;
+		return NULL;
+	}
+	return lz_at(lz.out, room);
+}
+
+static int lz_literals(uint32_t n) {
+	if (n > lz.blockLeft) {
+		lz.status = LZ4_CORRUPT;
+		return 0;
+	}
+	lz.blockLeft -= n;
+	lz.r->literalBytes += n;
+	while (n) {
+		uint32_t room, k;
+		uint8_t *dst;
+		if (lz.pos == lz.len && !lz_fill())
+			return 0;
+		if (!(dst = lz_dst(&room)))
+			return 0;
+		k = lz.len - lz.pos;
+		if (k > room) k = room;
+		if (k > n) k = n;
+		memcpy(dst, &lz.buf[lz.pos], k);
+		lz.pos += k;
+		lz.out += k;
+		n -= k;
+	}
+	return 1;
+}
+
+static int lz_match(uint32_t offset, uint32_t n) {
+	if (!offset || offset > lz.out) {
+		lz.status = LZ4_CORRUPT;
+		return 0;
+	}
+	lz.r->matchBytes += n;
+	while (n) {
+		uint32_t room, srcRoom, k;
+		uint8_t *dst, *src;
+		if (!(dst = lz_dst(&room)))
+			return 0;
+		src = lz_at(lz.out - offset, &srcRoom);
+		k = room < srcRoom ? room : srcRoom;
+		if (k > n) k = n;
+		// forwards a byte at a time, the source can overlap what's being written
+		for (uint32_t i = 0; i < k; i++)
+			dst[i] = src[i];
+		lz.out += k;
+		n -= k;
+	}
+	return 1;
+}
+
+// a run length that carries on in bytes of 255
+static uint32_t lz_length(uint32_t len) {
+	int b;
+	if (len == 15) {
+		do {
+			if ((b = lz_block_byte()) < 0)
+				return 0;
+			len += b;
+		} while (b == 255);
+	}
+	return len;
+}
+
+static int lz_block(void) {
+	while (lz.blockLeft) {
+		int token = lz_block_byte();
+		if (token < 0)
+			return 0;
+		lz.r->sequences++;
+		if (!lz_literals(lz_length(token >> 4)) || lz.status)
+			return 0;
+		if (!lz.blockLeft)
+			break;		// the last sequence is just literals
+		int lo = lz_block_byte(), hi = lz_block_byte();
+		if (hi < 0)
+			return 0;
+		uint32_t len = lz_length(token & 15);
+		if (lz.status || !lz_match(lo | hi << 8, len + 4))
+			return 0;
+	}
+	return 1;
+}
+
+int lz4_load(FIL *fil, uint8_t *ram1, uint8_t *ram2, LZ4_RESULT *result) {
+	memset(result, 0, sizeof(LZ4_RESULT));
+	lz.fil = fil;
+	lz.ram1 = ram1;
+	lz.ram2 = ram2;
+	lz.r = result;
+	lz.pos = lz.len = 0;
+	lz.out = 0;
+	lz.base = -1;
+	lz.status = LZ4_OK;
+
+	// frame descriptor
+	if (lz_word(4) != LZ4_FRAME_MAGIC)
+		return lz.status ? lz.status : LZ4_BAD_FRAME;
+	int flags = lz_byte();
+	lz_byte();		// block size, matches can go back further than a block anyway
+	if ((flags & 0xC0) != 0x40 || (flags & 0x01))
+		return LZ4_BAD_FRAME;	// another version, or a dictionary
+	if (flags & 0x08) {
+		uint32_t size = lz_word(4);
+		if (lz_word(4) || size > CART_MAX_IMAGE_SIZE + 16)
+			return LZ4_TOO_BIG;
+	}
+	lz_byte();		// header checksum
+
+	for (;;) {
+		uint32_t size = lz_word(4);
+		if (lz.status)
+			return lz.status;
+		if (!size)
+			break;		// end mark, a content checksum may follow
+		lz.r->blocks++;
+		lz.blockLeft = size & 0x7FFFFFFF;
+		if (size & 0x80000000) {
+			if (!lz_literals(lz.blockLeft))
+				return lz.status;
+		}
+		else if (!lz_block())
+			return lz.status ? lz.status : LZ4_CORRUPT;
+		if (flags & 0x10)
+			lz_skip(4);	// block checksum
+	}
+	if (lz.base < 0)
+		lz_place();		// less than 16 bytes
+	if (lz.out + lz.base >= 16)
+		result->size = lz.out + lz.base - 16 - (result->kind == FILE_KIND_XEX ? 4 : 0);
+	return LZ4_OK;
+}
@@ -0,0 +1,62 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compressed carts: a .CAR, .ROM or .XEX packed into an LZ4 frame (.LZ4,
+ * from HostTools/unolz4 or "lz4 -9"). The frame is unpacked as it is read,
+ * straight into cart_ram1 and cart_ram2, so a slow card only has to deliver
+ * the compressed bytes. LZ4 matches copy from earlier output, and all of it
+ * is still in SRAM, so there's no window to keep. Which kind of file it was
+ * is told from the first bytes: "CART" for a .CAR, $FFFF for a .XEX,
+ * anything else is a raw .ROM.
+ */
+
+#ifndef LZ4LOAD_H
+#define LZ4LOAD_H
+
+#include <stdint.h>
+#include "ff.h"
+
+#define LZ4_FRAME_MAGIC		0x184D2204
+#define LZ4_IN_BUF			4096		// compressed bytes read at a time
+
+// status codes
+#define LZ4_OK				0
+#define LZ4_READ_ERROR		1
+#define LZ4_BAD_FRAME		2	// not an LZ4 frame, or needs a dictionary
+#define LZ4_CORRUPT			3
+#define LZ4_TOO_BIG			4	// unpacks to more than the SRAM holds
+
+typedef struct {
+	int kind;				// FILE_KIND_CAR, _XEX or _ROM
+	uint8_t head[16];		// the first 16 bytes, the header of a .CAR
+	uint32_t size;			// bytes in SRAM, not counting a .CAR header
+	// what the unpacking did, for HostTools/sdbench's cost model
+	uint32_t inBytes;
+	uint32_t blocks;
+	uint32_t sequences;
+	uint32_t literalBytes;
+	uint32_t matchBytes;
+} LZ4_RESULT;
+
+/* Unpack the frame in fil, from where it's positioned. A .CAR's header is
+   left out of SRAM and an .XEX starts 4 bytes in, where load_file would
+   put them. Returns an LZ4_xxx status */
+int lz4_load(FIL *fil, uint8_t *ram1, uint8_t *ram2, LZ4_RESULT *result);
+
+#endif
@@ -22,8 +22,25 @@
 #include "stm32f4xx.h"
 #include "tm_stm32f4_fatfs.h"
 #include "tm_stm32f4_delay.h"
+#include "fatfs_sd.h"
+#include "cartinfo.h"
+#include "filemeta.h"
+#include "fpmath.h"
+#include "hdevice.h"
+#include "castape.h"
+#include "atrdelta.h"
+#include "bustrace.h"
+#include "cmdstats.h"
+#include "sdtest.h"
+#include "profiler.h"
+#include "stackmark.h"
+#include "lz4load.h"
+#include "flashcart.h"
+#include "dircache.h"
+#include "zipfile.h"
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 
 #include "rom.h" /* unsigned char cart_rom[64*1024] */
 #include "osrom.h"
@@ -39,53 +56,60 @@ char errorBuf[40];
 #define CART_CMD_UP_DIR				0x03
 #define CART_CMD_ROOT_DIR			0x04
 #define CART_CMD_SEARCH				0x05
+#define CART_CMD_BOOT_TIMES			0x06
+#define CART_CMD_META_SCAN			0x07
+#define CART_CMD_SEARCH_KEY			0x08
+#define CART_CMD_CURSOR_HINT		0x09
 #define CART_CMD_LOAD_SOFT_OS		0x10
 #define CART_CMD_SOFT_OS_CHUNK		0x11
 #define CART_CMD_MOUNT_ATR			0x20	// unused, done automatically by firmware
 #define CART_CMD_READ_ATR_SECTOR	0x21
 #define CART_CMD_WRITE_ATR_SECTOR	0x22
 #define CART_CMD_ATR_HEADER			0x23
+#define CART_CMD_ATR_SET_PERCOM		0x24
+#define CART_CMD_ATR_DELTA			0x25
+#define CART_CMD_OVERLAY_MODE		0x26
+#define CART_CMD_CAS_STATUS			0x28
+#define CART_CMD_CAS_READ_RECORD	0x29
+#define CART_CMD_FP_MODE			0x30
+#define CART_CMD_FP_MUL				0x31
+#define CART_CMD_FP_DIV				0x32
+#define CART_CMD_H_OPEN				0x40
+#define CART_CMD_H_CLOSE			0x41
+#define CART_CMD_H_READ				0x42
+#define CART_CMD_H_WRITE			0x43
+#define CART_CMD_H_SPECIAL			0x44
+#define CART_CMD_TRACE				0x50
+#define CART_CMD_STATS				0x51
+#define CART_CMD_SD_TEST			0x52
+#define CART_CMD_PROFILE			0x53
 #define CART_CMD_NO_CART			0xFE
 #define CART_CMD_ACTIVATE_CART  	0xFF
 
-#define CART_TYPE_NONE				0
-#define CART_TYPE_8K				1	// 8k
-#define CART_TYPE_16K				2	// 16k
-#define CART_TYPE_XEGS_32K			3	// 32k
-#define CART_TYPE_XEGS_64K			4	// 64k
-#define CART_TYPE_XEGS_128K			5	// 128k
-#define CART_TYPE_SW_XEGS_32K		6	// 32k
-#define CART_TYPE_SW_XEGS_64K		7	// 64k
-#define CART_TYPE_SW_XEGS_128K		8	// 128k
-#define CART_TYPE_MEGACART_16K		9	// 16k
-#define CART_TYPE_MEGACART_32K		10	// 32k
-#define CART_TYPE_MEGACART_64K		11	// 64k
-#define CART_TYPE_MEGACART_128K		12	// 128k
-#define CART_TYPE_BOUNTY_BOB		13	// 40k
-#define CART_TYPE_ATARIMAX_1MBIT	14	// 128k
-#define CART_TYPE_WILLIAMS_64K		15	// 32k/64k
-#define CART_TYPE_OSS_16K_TYPE_B	16	// 16k
-#define CART_TYPE_OSS_8K			17	// 8k
-#define CART_TYPE_OSS_16K_034M		18	// 16k
-#define CART_TYPE_OSS_16K_043M		19	// 16k
-#define CART_TYPE_SIC_128K			20	// 128k
-#define CART_TYPE_SDX_64K			21	// 64k
-#define CART_TYPE_SDX_128K			22	// 128k
-#define CART_TYPE_DIAMOND_64K		23	// 64k
-#define CART_TYPE_EXPRESS_64K		24	// 64k
-#define CART_TYPE_BLIZZARD_16K		25	// 16k
-#define CART_TYPE_ATR				254
-#define CART_TYPE_XEX				255
-
 typedef struct {
 	char isDir;
 	char filename[13];
 	char long_filename[32];
-	char full_path[210];
+	char full_path[194];
+	uint8_t cartType;		// from the metadata cache
+	uint8_t metaStatus;		// META_xxx, META_UNKNOWN until scanned
+	uint16_t fdate, ftime;
+	uint32_t size;
+	uint32_t nameHash;
 } DIR_ENTRY;	// 256 bytes = 256 entries in 64k
 
 int num_dir_entries = 0; // how many entries in the current directory
 
+void swap_items(void *p1, void *p2, int size)
+{
+	uint16_t *a = (uint16_t *)p1, *b = (uint16_t *)p2, t;
+	for (size /= 2; size; size--) {
+		t = *a;
+		*a++ = *b;
+		*b++ = t;
+	}
+}
+
 int entry_compare(const void* p1, const void* p2)
 {
 	DIR_ENTRY* e1 = (DIR_ENTRY*)p1;
@@ -95,28 +119,98 @@ int entry_compare(const void* p1, const void* p2)
 	else return stricmp(e1->long_filename, e2->long_filename);
 }
 
-char *get_filename_ext(char *filename) {
-    char *dot = strrchr(filename, '.');
-    if(!dot || dot == filename) return "";
-    return dot + 1;
-}
+// in place of qsort: no recursion, so the stack it needs doesn't depend on
+// the data, and the time is n log n at worst. size must be a multiple of 2
+void sort_items(void *base, int n, int size, int (*compare)(const void *, const void *))
+{
+	uint8_t *items = (uint8_t *)base;
+	int start = n / 2, end = n;
 
-int is_valid_file(char *filename) {
-	char *ext = get_filename_ext(filename);
-	if (stricmp(ext, "CAR") == 0 || stricmp(ext, "ROM") == 0
-			|| stricmp(ext, "XEX") == 0 || stricmp(ext, "ATR") == 0)
-		return 1;
-	return 0;
+	while (end > 1) {
+		int root, child;
+		if (start > 0)
+			root = --start;		// building the heap
+		else {
+			// the largest goes to the end, the last leaf becomes the root
+			end--;
+			swap_items(items, items + end * size, size);
+			root = 0;
+		}
+		while ((child = 2 * root + 1) < end) {
+			if (child + 1 < end && compare(items + child * size, items + (child + 1) * size) < 0)
+				child++;
+			if (compare(items + root * size, items + child * size) >= 0)
+				break;
+			swap_items(items + root * size, items + child * size, size);
+			root = child;
+		}
+	}
 }
 
 // single FILINFO structure
 FILINFO fno;
 char lfn[_MAX_LFN + 1];   /* Buffer to store the LFN */
 
+// off the stack, a FIL holds a sector buffer
+FIL loadFil;
+
+// a path for the command being run to build in, off the stack. Commands
+// don't nest, so one will do
+char pathBuf[256];
+
+// the SD card stays mounted between commands
+FATFS FatFs;
+int doneFatFsInit = 0;
+
+/* Boot timing, in DWT cycles since MCU reset */
+typedef struct {
+	uint32_t card_ready;	// background SD init finished
+	uint32_t mounted;		// volume mounted
+	uint32_t first_dir;		// first directory listing sent to the menu
+} BOOT_TIMES;
+
+BOOT_TIMES boot_times = {0};
+
+// soft OS hands FMUL/FDIV to the cart (set from the menu)
+int fpOffload = 0;
+
+// ATR writes go to a delta file rather than the image (set from the menu)
+int atrOverlay = 0;
+
 void init() {
+	stack_paint();
 	// this seems to be required for this version of FAT FS
 	fno.lfname = lfn;
 	fno.lfsize = sizeof lfn;
+	TM_DELAY_Init();
+	// start bringing up the SD card, continued while the boot rom is running
+	TM_FATFS_SD_BgInitStart();
+	// CRC unit, for the metadata cache
+	RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_CRC, ENABLE);
+}
+
+int mount_sd() {
+	if (!doneFatFsInit) {
+		uint32_t t = stat_now();
+		FRESULT res = f_mount(&FatFs, "", 1);
+		stat_phase(STAT_PHASE_MOUNT, t);
+		if (res != FR_OK)
+			return 0;
+		doneFatFsInit = 1;
+		meta_forget();
+		if (!boot_times.mounted) boot_times.mounted = DWT->CYCCNT;
+	}
+	return 1;
+}
+
+// details needed to find the file in the metadata cache, dir is its folder
+void set_entry_meta(DIR_ENTRY *dst, char *dir) {
+	dst->size = fno.fsize;
+	dst->fdate = fno.fdate;
+	dst->ftime = fno.ftime;
+	dst->nameHash = meta_path_hash(dir, fno.lfname[0] ? fno.lfname : fno.fname);
+	dst->cartType = CART_TYPE_NONE;
+	dst->metaStatus = META_UNKNOWN;
 }
 
 int scan_files(char *path, char *search)
@@ -125,18 +219,22 @@ int scan_files(char *path, char *search)
     DIR dir;
     UINT i;
 
+	uint32_t t = stat_now();
 	res = f_opendir(&dir, path);
+	stat_phase(STAT_PHASE_OPENDIR, t);
 	if (res == FR_OK) {
 		for (;;) {
 			if (num_dir_entries == 255) break;
+			t = stat_now();
 			res = f_readdir(&dir, &fno);
+			stat_phase(STAT_PHASE_READDIR, t);
 			if (res != FR_OK || fno.fname[0] == 0) break;
 			if (fno.fattrib & (AM_HID | AM_SYS)) continue;
 			if (fno.fattrib & AM_DIR) {
 				i = strlen(path);
 				strcat(path, "/");
 				strcat(path, fno.fname);
-				if (strlen(path) >= 210) continue;	// no more room for path in DIR_ENTRY
+				if (strlen(path) >= 194) continue;	// no more room for path in DIR_ENTRY
 				res = scan_files(path, search);
 				if (res != FR_OK) break;
 				path[i] = 0;
@@ -156,6 +254,7 @@ int scan_files(char *path, char *search)
 					dst->long_filename[31] = 0;
 					// full path for search results
 					strcpy(dst->full_path, path);
+					set_entry_meta(dst, path);
 
 					num_dir_entries++;
 				}
@@ -167,16 +266,16 @@ int scan_files(char *path, char *search)
 }
 
 int search_directory(char *path, char *search) {
-	char pathBuf[256];
 	strcpy(pathBuf, path);
 	num_dir_entries = 0;
 	int i;
-	FATFS FatFs;
 	TM_DELAY_Init();
-	if (f_mount(&FatFs, "", 1) == FR_OK) {
+	if (mount_sd()) {
 		if (scan_files(pathBuf, search) == FR_OK) {
 			// sort by score, name
-			qsort((DIR_ENTRY *)&cart_ram1[0], num_dir_entries, sizeof(DIR_ENTRY), entry_compare);
+			uint32_t t = stat_now();
+			sort_items((DIR_ENTRY *)&cart_ram1[0], num_dir_entries, sizeof(DIR_ENTRY), entry_compare);
+			stat_phase(STAT_PHASE_SORT, t);
 			DIR_ENTRY *dst = (DIR_ENTRY *)&cart_ram1[0];
 			// reset the "scores" back to 0
 			for (i=0; i<num_dir_entries; i++)
@@ -185,52 +284,468 @@ int search_directory(char *path, char *search) {
 
 		}
 	}
+	doneFatFsInit = 0;
 	strcpy(errorBuf, "Problem searching SD card");
 	return 0;
 }
 
+/* Incremental search - the menu sends one key at a time. The files matching
+   the first key are collected from the card into cart_ram2 once, and later
+   keys narrow (or, on delete, widen) that set without touching the card. */
+
+#define SEARCH_KEY_START	0x00	// new search, empty query
+#define SEARCH_KEY_DELETE	0x7E
+#define SEARCH_KEY_REFRESH	0x9B	// same query, just return more results
+#define SEARCH_MAX_LEN		31
+
+typedef struct {
+	uint32_t size;
+	uint32_t nameHash;
+	uint16_t fdate, ftime;
+	uint16_t pathOff;		// directory, stored from the top of cart_ram2 down
+	uint8_t depth;			// how much of the query still matches
+	uint8_t score;
+	char filename[13];
+	char long_filename[32];
+	uint8_t reserved[3];
+} SEARCH_CAND;	// 64 bytes
+
+typedef struct {
+	char query[SEARCH_MAX_LEN + 1];
+	int len;
+	int baseLen;		// query length when the candidates were collected
+	int complete;		// every match on the card fitted in cart_ram2
+	int numCands;
+	uint32_t pathTop;
+	int total;			// candidates matching the whole query
+} INC_SEARCH;
+
+INC_SEARCH incSearch = {0};
+uint16_t searchOrder[64*1024 / sizeof(SEARCH_CAND)];
+
+// 3 = start of the name, 2 = start of a word, 1 = anywhere, 0 = no match
+int search_score(char *name, char *query) {
+	int best = 0;
+	char *p = name;
+	while ((p = strcasestr(p, query))) {
+		if (p == name) return 3;
+		unsigned char prev = p[-1];
+		if (!isalnum(prev) || (islower(prev) && isupper((unsigned char)p[0])))
+			best = 2;
+		else if (!best)
+			best = 1;
+		p++;
+	}
+	return best;
+}
+
+int search_collect(char *path, int *pathOff) {
+	SEARCH_CAND *cands = (SEARCH_CAND *)&cart_ram2[0];
+	FRESULT res;
+	DIR dir;
+	UINT i;
+
+	uint32_t t = stat_now();
+	res = f_opendir(&dir, path);
+	stat_phase(STAT_PHASE_OPENDIR, t);
+	if (res == FR_OK) {
+		while (incSearch.complete) {
+			t = stat_now();
+			res = f_readdir(&dir, &fno);
+			stat_phase(STAT_PHASE_READDIR, t);
+			if (res != FR_OK || fno.fname[0] == 0) break;
+			if (fno.fattrib & (AM_HID | AM_SYS)) continue;
+			if (fno.fattrib & AM_DIR) {
+				i = strlen(path);
+				strcat(path, "/");
+				strcat(path, fno.fname);
+				if (strlen(path) >= 194) {	// no more room for path in DIR_ENTRY
+					path[i] = 0;
+					continue;
+				}
+				int subOff = -1;
+				res = search_collect(path, &subOff);
+				path[i] = 0;
+				if (res != FR_OK) break;
+			}
+			else if (is_valid_file(fno.fname))
+			{
+				char *name = fno.lfname[0] ? fno.lfname : fno.fname;
+				int score = search_score(name, incSearch.query);
+				if (!score) continue;
+				// the path is stored once, with the first match in the directory
+				uint32_t need = (*pathOff < 0) ? strlen(path) + 1 : 0;
+				if ((incSearch.numCands + 1) * sizeof(SEARCH_CAND) + need > incSearch.pathTop) {
+					incSearch.complete = 0;
+					break;
+				}
+				if (*pathOff < 0) {
+					incSearch.pathTop -= need;
+					strcpy((char *)&cart_ram2[incSearch.pathTop], path);
+					*pathOff = incSearch.pathTop;
+				}
+				SEARCH_CAND *c = &cands[incSearch.numCands++];
+				c->size = fno.fsize;
+				c->nameHash = meta_path_hash(path, name);
+				c->fdate = fno.fdate;
+				c->ftime = fno.ftime;
+				c->pathOff = *pathOff;
+				c->depth = incSearch.len;
+				c->score = score;
+				strcpy(c->filename, fno.fname);
+				strncpy(c->long_filename, name, 31);
+				c->long_filename[31] = 0;
+			}
+		}
+		f_closedir(&dir);
+	}
+	return res;
+}
+
+// gather every file under path matching the whole query
+int search_gather(char *path) {
+	int rootOff = -1;
+	strcpy(pathBuf, path);
+	zip_forget();	// the candidates go over its index
+	incSearch.numCands = 0;
+	incSearch.pathTop = 64*1024;
+	incSearch.complete = 1;
+	incSearch.baseLen = incSearch.len;
+	if (!mount_sd() || search_collect(pathBuf, &rootOff) != FR_OK) {
+		incSearch.numCands = 0;
+		incSearch.len = 0;
+		doneFatFsInit = 0;
+		strcpy(errorBuf, "Problem searching SD card");
+		return 0;
+	}
+	return 1;
+}
+
+int search_order_compare(const void *p1, const void *p2)
+{
+	SEARCH_CAND *cands = (SEARCH_CAND *)&cart_ram2[0];
+	SEARCH_CAND *c1 = &cands[*(uint16_t *)p1];
+	SEARCH_CAND *c2 = &cands[*(uint16_t *)p2];
+	if (c1->score != c2->score) return c2->score - c1->score;
+	return stricmp(c1->long_filename, c2->long_filename);
+}
+
+// the best maxResults matches, as DIR_ENTRYs in cart_ram1
+void search_results(int maxResults) {
+	SEARCH_CAND *cands = (SEARCH_CAND *)&cart_ram2[0];
+	DIR_ENTRY *dst = (DIR_ENTRY *)&cart_ram1[0];
+	int i, n = 0;
+	for (i=0; i<incSearch.numCands && incSearch.len; i++) {
+		SEARCH_CAND *c = &cands[i];
+		if (c->depth < incSearch.len) continue;
+		c->score = search_score(c->long_filename, incSearch.query);
+		searchOrder[n++] = i;
+	}
+	incSearch.total = n;
+	uint32_t t = stat_now();
+	sort_items(searchOrder, n, sizeof(uint16_t), search_order_compare);
+	stat_phase(STAT_PHASE_SORT, t);
+	if (maxResults > 255) maxResults = 255;
+	num_dir_entries = n < maxResults ? n : maxResults;
+	for (i=0; i<num_dir_entries; i++, dst++) {
+		SEARCH_CAND *c = &cands[searchOrder[i]];
+		dst->isDir = 0;
+		strcpy(dst->filename, c->filename);
+		strcpy(dst->long_filename, c->long_filename);
+		strcpy(dst->full_path, (char *)&cart_ram2[c->pathOff]);
+		dst->size = c->size;
+		dst->fdate = c->fdate;
+		dst->ftime = c->ftime;
+		dst->nameHash = c->nameHash;
+		dst->cartType = CART_TYPE_NONE;
+		dst->metaStatus = META_UNKNOWN;
+	}
+}
+
+int search_key(char *path, uint8_t key, int maxResults) {
+	SEARCH_CAND *cands = (SEARCH_CAND *)&cart_ram2[0];
+	int i;
+	if (key == SEARCH_KEY_START) {
+		incSearch.len = 0;
+		incSearch.numCands = 0;
+	}
+	else if (key == SEARCH_KEY_DELETE) {
+		if (incSearch.len) incSearch.query[--incSearch.len] = 0;
+		// only files that matched the shorter query when they were collected are held
+		if (incSearch.len && incSearch.len < incSearch.baseLen && !search_gather(path))
+			return 0;
+	}
+	else if (key >= 0x20 && key < 0x7D && incSearch.len < SEARCH_MAX_LEN) {
+		incSearch.query[incSearch.len++] = key;
+		incSearch.query[incSearch.len] = 0;
+		if (incSearch.len == 1 || !incSearch.complete) {
+			if (!search_gather(path))
+				return 0;
+		}
+		else {
+			for (i=0; i<incSearch.numCands; i++) {
+				SEARCH_CAND *c = &cands[i];
+				if (c->depth < incSearch.len - 1) continue;
+				c->depth = search_score(c->long_filename, incSearch.query) ? incSearch.len : incSearch.len - 1;
+			}
+		}
+	}
+	search_results(maxResults);
+	return 1;
+}
+
+// DIR_ENTRY to and from the directory cache, which has no full_path
+void entry_pack(DIRC_ENTRY *dst, const DIR_ENTRY *src) {
+	dst->isDir = src->isDir;
+	memcpy(dst->filename, src->filename, sizeof(dst->filename));
+	memcpy(dst->long_filename, src->long_filename, sizeof(dst->long_filename));
+	dst->cartType = src->cartType;
+	dst->metaStatus = src->metaStatus;
+	dst->fdate = src->fdate;
+	dst->ftime = src->ftime;
+	dst->size = src->size;
+	dst->nameHash = src->nameHash;
+}
+
+void entry_unpack(DIR_ENTRY *dst, const DIRC_ENTRY *src) {
+	dst->isDir = src->isDir;
+	memcpy(dst->filename, src->filename, sizeof(dst->filename));
+	memcpy(dst->long_filename, src->long_filename, sizeof(dst->long_filename));
+	dst->full_path[0] = 0;
+	dst->cartType = src->cartType;
+	dst->metaStatus = src->metaStatus;
+	dst->fdate = src->fdate;
+	dst->ftime = src->ftime;
+	dst->size = src->size;
+	dst->nameHash = src->nameHash;
+}
+
+int dirc_entry_compare(const void* p1, const void* p2)
+{
+	DIRC_ENTRY* e1 = (DIRC_ENTRY*)p1;
+	DIRC_ENTRY* e2 = (DIRC_ENTRY*)p2;
+	if (e1->isDir && !e2->isDir) return -1;
+	else if (!e1->isDir && e2->isDir) return 1;
+	else return stricmp(e1->long_filename, e2->long_filename);
+}
+
+// the directory entry in fno, from folder dir. 0 if the menu doesn't show it
+int entry_from_fno(DIR_ENTRY *dst, char *dir) {
+	if (fno.fattrib & (AM_HID | AM_SYS))
+		return 0;
+	dst->isDir = fno.fattrib & AM_DIR ? 1 : 0;
+	if (!dst->isDir) {
+		if (file_kind(fno.fname) == FILE_KIND_ZIP)
+			dst->isDir = 1;		// opened as a folder
+		else if (!is_valid_file(fno.fname)) return 0;
+	}
+	strcpy(dst->filename, fno.fname);
+	if (fno.lfname[0]) {
+		strncpy(dst->long_filename, fno.lfname, 31);
+		dst->long_filename[31] = 0;
+	}
+	else strcpy(dst->long_filename, fno.fname);
+	dst->full_path[0] = 0; // path only for search results
+	set_entry_meta(dst, dir);
+	return 1;
+}
+
+// copy of the listing in cart_ram1 to the directory cache, if there's room
+void cache_directory(char *path) {
+	DIR_ENTRY *src = (DIR_ENTRY *)&cart_ram1[0];
+	if (!dirc_begin(path))
+		return;
+	for (int i=0; i<num_dir_entries; i++) {
+		DIRC_ENTRY *e = dirc_add();
+		if (!e) return;		// too big, dropped
+		entry_pack(e, &src[i]);
+	}
+	dirc_end();
+}
+
+// a folder in a .ZIP, the first zipLen bytes of path, into cart_ram1. The
+// archive's index goes in cart_ram2
+FRESULT read_zip_directory(char *path, int zipLen) {
+	DIR_ENTRY *dst = (DIR_ENTRY *)&cart_ram1[0];
+	ZIP_ITEM item;
+	int ret, more;
+
+	memcpy(pathBuf, path, zipLen);
+	pathBuf[zipLen] = 0;
+	FRESULT res = f_open(&loadFil, pathBuf, FA_READ);
+	if (res != FR_OK) {
+		strcpy(errorBuf, "Can't read ZIP file");
+		return res;
+	}
+	incSearch.len = incSearch.numCands = 0;	// its candidates are in cart_ram2
+	ret = zip_list_begin(&loadFil, path, zipLen, &cart_ram2[0], sizeof(cart_ram2),
+			&cart_ram1[0], sizeof(cart_ram1));	// before the entries go there
+	while (ret == ZIP_OK && num_dir_entries < 255 && (more = zip_list_next(&item)) != 0) {
+		if (more < 0) {
+			ret = ZIP_READ_ERROR;
+			break;
+		}
+		dst->isDir = item.isDir;
+		strcpy(dst->filename, item.token);
+		strcpy(dst->long_filename, item.name);
+		dst->full_path[0] = 0;
+		dst->size = item.size;
+		dst->fdate = item.fdate;
+		dst->ftime = item.ftime;
+		dst->nameHash = meta_path_hash(path, item.name);
+		dst->cartType = CART_TYPE_NONE;
+		dst->metaStatus = META_UNKNOWN;
+		dst++;
+		num_dir_entries++;
+	}
+	f_close(&loadFil);
+	if (ret == ZIP_OK)
+		return FR_OK;
+	strcpy(errorBuf, ret == ZIP_READ_ERROR ? "Can't read ZIP file" : "Bad or unsupported ZIP file");
+	return ret == ZIP_READ_ERROR ? FR_DISK_ERR : FR_INT_ERR;
+}
+
 int read_directory(char *path) {
 	int ret = 0;
 	num_dir_entries = 0;
 	DIR_ENTRY *dst = (DIR_ENTRY *)&cart_ram1[0];
+	FRESULT res = FR_NOT_READY;
 
-	FATFS FatFs;
 	TM_DELAY_Init();
-	if (f_mount(&FatFs, "", 1) == FR_OK) {
+	if (mount_sd()) {
 		DIR dir;
-		if (f_opendir(&dir, path) == FR_OK) {
+		int zipLen = zip_split(path);
+		uint32_t t = stat_now();
+		res = zipLen ? FR_OK : f_opendir(&dir, path);
+		stat_phase(STAT_PHASE_OPENDIR, t);
+		if (zipLen) {
+			if ((res = read_zip_directory(path, zipLen)) == FR_DISK_ERR)
+				doneFatFsInit = 0;
+		}
+		else if (res == FR_OK) {
 			while (num_dir_entries < 255) {
-				if (f_readdir(&dir, &fno) != FR_OK || fno.fname[0] == 0)
+				t = stat_now();
+				res = f_readdir(&dir, &fno);
+				stat_phase(STAT_PHASE_READDIR, t);
+				if (res != FR_OK || fno.fname[0] == 0)
 					break;
-				if (fno.fattrib & (AM_HID | AM_SYS))
-					continue;
-				dst->isDir = fno.fattrib & AM_DIR ? 1 : 0;
-				if (!dst->isDir)
-					if (!is_valid_file(fno.fname)) continue;
 				// copy file record to first ram block
-	            strcpy(dst->filename, fno.fname);
-				if (fno.lfname[0]) {
-					strncpy(dst->long_filename, fno.lfname, 31);
-					dst->long_filename[31] = 0;
-				}
-				else strcpy(dst->long_filename, fno.fname);
-				dst->full_path[0] = 0; // path only for search results
+				if (!entry_from_fno(dst, path))
+					continue;
 	            dst++;
 				num_dir_entries++;
 			}
 			f_closedir(&dir);
 		}
-		else
+		else {
 			strcpy(errorBuf, "Can't read directory");
-		f_mount(0, "", 1);
-		qsort((DIR_ENTRY *)&cart_ram1[0], num_dir_entries, sizeof(DIR_ENTRY), entry_compare);
-		ret = 1;
+			doneFatFsInit = 0;	// remount next time in case the card was changed
+		}
+		t = stat_now();
+		sort_items((DIR_ENTRY *)&cart_ram1[0], num_dir_entries, sizeof(DIR_ENTRY), entry_compare);
+		stat_phase(STAT_PHASE_SORT, t);
+		ret = !zipLen || res == FR_OK;	// a ZIP that can't be read says why
 	}
 	else
 		strcpy(errorBuf, "Can't read SD card");
+	if (res == FR_OK)
+		cache_directory(path);
+	else
+		dirc_flush();	// the card may have changed
 	return ret;
 }
 
+// the listing of path into cart_ram1, from the directory cache if it's there.
+// *cursor = the item the menu was on when it last left the directory
+int list_directory(char *path, int *cursor) {
+	DIR_ENTRY *dst = (DIR_ENTRY *)&cart_ram1[0];
+	const DIRC_ENTRY *cached = dirc_find(path, &num_dir_entries, cursor);
+	int ret = 1;
+
+	if (cached) {
+		for (int i=0; i<num_dir_entries; i++)
+			entry_unpack(&dst[i], &cached[i]);
+	}
+	else {
+		*cursor = 0;
+		ret = read_directory(path);
+	}
+	dirc_show(path);
+	return ret;
+}
+
+/* Reading the folder the menu's cursor rests on into the directory cache
+   a slice at a time, while the Atari waits for a key, so opening it is
+   instant */
+typedef struct {
+	int open;
+	int item;		// in cart_ram1
+	DIR dir;
+} DIR_HINT;
+
+DIR_HINT dirHint = {0};
+
+void dir_hint_cancel() {
+	if (dirHint.open) {
+		f_closedir(&dirHint.dir);
+		dirc_cancel();
+	}
+	dirHint.open = 0;
+}
+
+// returns 1 once there's nothing more to do for item
+int dir_hint_step(char *curPath, int item, uint32_t budget) {
+	DIR_ENTRY *entry = (DIR_ENTRY *)&cart_ram1[0];
+	uint32_t t0 = DWT->CYCCNT;
+	DIR_ENTRY e;
+
+	if (dirHint.open && dirHint.item != item)
+		dir_hint_cancel();
+	if (item >= num_dir_entries || !entry[item].isDir || entry[item].full_path[0])
+		return 1;
+	if (strlen(curPath) + strlen(entry[item].filename) + 2 > sizeof(pathBuf))
+		return 1;
+	strcpy(pathBuf, curPath);
+	strcat(pathBuf, "/");
+	strcat(pathBuf, entry[item].filename);
+	if (!dirHint.open) {
+		if (dirc_has(pathBuf) || !mount_sd())
+			return 1;
+		if (f_opendir(&dirHint.dir, pathBuf) != FR_OK)
+			return 1;
+		if (!dirc_begin(pathBuf)) {
+			f_closedir(&dirHint.dir);
+			return 1;
+		}
+		dirHint.open = 1;
+		dirHint.item = item;
+	}
+	while (DWT->CYCCNT - t0 < budget) {
+		if (f_readdir(&dirHint.dir, &fno) != FR_OK) {
+			dir_hint_cancel();
+			return 1;
+		}
+		if (fno.fname[0] == 0) {
+			int n;
+			DIRC_ENTRY *entries = dirc_building(&n);
+			sort_items(entries, n, sizeof(DIRC_ENTRY), dirc_entry_compare);
+			dirc_end();
+			f_closedir(&dirHint.dir);
+			dirHint.open = 0;
+			return 1;
+		}
+		if (!entry_from_fno(&e, pathBuf))
+			continue;
+		DIRC_ENTRY *c = dirc_add();
+		if (!c) {	// too big to cache
+			dir_hint_cancel();
+			return 1;
+		}
+		entry_pack(c, &e);
+	}
+	return 0;
+}
+
 /* ATR Handling */
 
 // ATR format
@@ -246,41 +761,164 @@ typedef struct {
   uint8_t unused[5];
 } ATRHeader;
 
+// drive status byte, for the SIO status command
+#define ATR_STATUS_MOTOR	0x10
+#define ATR_STATUS_DD		0x20	// sectors bigger than 128 bytes
+#define ATR_STATUS_ED		0x80	// 1050 enhanced density
+
+#define PERCOM_SIZE			12
+
 typedef struct {
 	char path[256];
 	ATRHeader atrHeader;
 	int	filesize;
-	FIL fil;
+	uint16_t numSectors;
+	uint8_t status;
+	uint8_t percom[PERCOM_SIZE];
+	FIL fil;				// or the .ZIP it's in
+	int inZip;				// read only
+	ZIP_MEMBER zip;
 } MountedATR;
 
 MountedATR mountedATRs[1] = {0};
 
-FATFS FatFs;
-int doneFatFsInit = 0;
+// the geometry a drive would report for the image. Floppy sizes look like
+// the real drives, anything else like a hard disk with one huge track
+void atr_geometry(MountedATR *mountedATR) {
+	ATRHeader *hdr = &mountedATR->atrHeader;
+	uint32_t bytes = ((uint32_t)hdr->parsHigh << 20) | ((uint32_t)hdr->pars << 4);
+	uint32_t sectors;
+	uint8_t *p = mountedATR->percom;
+
+	// 256 byte images have three short boot sectors
+	if (hdr->secSize == 256)
+		sectors = bytes < 3 * 128 ? bytes / 128 : 3 + (bytes - 3 * 128) / 256;
+	else
+		sectors = bytes / hdr->secSize;
+	if (sectors > 65535) sectors = 65535;
+	mountedATR->numSectors = sectors;
+
+	mountedATR->status = ATR_STATUS_MOTOR;
+	if (hdr->secSize != 128)
+		mountedATR->status |= ATR_STATUS_DD;
+	else if (sectors == 1040)
+		mountedATR->status |= ATR_STATUS_ED;
+
+	memset(p, 0, PERCOM_SIZE);
+	if (sectors == 720 || sectors == 1040 || sectors == 1440 || sectors == 2880) {
+		int sides = sectors >= 1440 ? 2 : 1;
+		p[0] = sectors == 2880 ? 80 : 40;	// tracks
+		p[4] = sides - 1;
+		sectors /= p[0] * sides;
+	}
+	else
+		p[0] = 1;
+	p[1] = 1;								// step rate
+	p[2] = sectors >> 8;					// sectors per track
+	p[3] = sectors & 0xFF;
+	p[5] = mountedATR->status & (ATR_STATUS_DD|ATR_STATUS_ED) ? 4 : 0;	// MFM or FM
+	p[6] = hdr->secSize >> 8;
+	p[7] = hdr->secSize & 0xFF;
+	p[8] = 0xFF;							// drive present
+}
+
+// where sector/page is in the file. Only 256 byte images have short boot sectors
+int atr_sector_offset(MountedATR *mountedATR, uint16_t sector, uint8_t page) {
+	int secSize = mountedATR->atrHeader.secSize;
+	if (secSize == 256) {
+		if (sector <= 3)
+			return ATR_HEADER_SIZE + (sector - 1) * 128;
+		return ATR_HEADER_SIZE + (3 * 128) + ((sector - 4) * secSize) + (page * 128);
+	}
+	return ATR_HEADER_SIZE + ((sector - 1) * secSize) + (page * 128);
+}
+
+// len bytes of the image at offset, 1 if they were read
+int atr_read(MountedATR *mountedATR, uint32_t offset, void *buf, UINT len) {
+	UINT br;
+	if (mountedATR->inZip)
+		return zip_read(&mountedATR->fil, &mountedATR->zip, offset, buf, len, &cart_ram1[0], &cart_ram2[0]) == ZIP_OK;
+	return f_lseek(&mountedATR->fil, offset) == FR_OK && f_read(&mountedATR->fil, buf, len, &br) == FR_OK && br == len;
+}
+
+void unmount_atr() {
+	MountedATR *mountedATR = &mountedATRs[0];
+	if (mountedATR->path[0])
+		f_close(&mountedATR->fil);
+	mountedATR->path[0] = 0;
+	atrd_unmount();
+}
 
 int mount_atr(char *filename) {
 	// returns 0 for success or error code
 	// 1 = no media, 2 = no file, 3 = bad atr
-	if (!doneFatFsInit) {
-		if (f_mount(&FatFs, "", 1) != FR_OK)
-			return 1;
-		doneFatFsInit = 1;
-	}
+	unmount_atr();
+	if (!mount_sd())
+		return 1;
 	MountedATR *mountedATR = &mountedATRs[0];
-	if (f_open(&mountedATR->fil, filename, FA_READ|FA_WRITE) != FR_OK)
+	// one in a .ZIP is read from the .ZIP, and unpacked into cart_ram1 and
+	// cart_ram2 if it's deflated
+	int zipLen = zip_split(filename);
+	mountedATR->inZip = zipLen != 0;
+	if (zipLen) {
+		memcpy(pathBuf, filename, zipLen);
+		pathBuf[zipLen] = 0;
+		if (f_open(&mountedATR->fil, pathBuf, FA_READ) != FR_OK)
+			return 2;
+		if (zip_member(&mountedATR->fil, filename, zipLen, &mountedATR->zip) != ZIP_OK
+				|| mountedATR->zip.kind != FILE_KIND_ATR) {
+			f_close(&mountedATR->fil);
+			return 3;
+		}
+	}
+	// with the overlay, a read only image is fine
+	else if (f_open(&mountedATR->fil, filename, FA_READ|FA_WRITE) != FR_OK &&
+			(!atrOverlay || f_open(&mountedATR->fil, filename, FA_READ) != FR_OK))
 		return 2;
-	UINT br;
-	if (f_read(&mountedATR->fil, &mountedATR->atrHeader, ATR_HEADER_SIZE, &br) != FR_OK || br != ATR_HEADER_SIZE ||
-			mountedATR->atrHeader.signature != ATR_SIGNATURE) {
+	uint32_t size = zipLen ? mountedATR->zip.size : f_size(&mountedATR->fil);
+	ATRHeader *hdr = &mountedATR->atrHeader;
+	int ok = size >= ATR_HEADER_SIZE && atr_read(mountedATR, 0, hdr, ATR_HEADER_SIZE);
+	if (ok) {
+		// some tools leave the size fields blank
+		if (!hdr->secSize)
+			hdr->secSize = 128;
+		if (!hdr->pars && !hdr->parsHigh) {
+			uint32_t bytes = size - ATR_HEADER_SIZE;
+			hdr->pars = bytes >> 4;
+			hdr->parsHigh = bytes >> 20;
+		}
+	}
+	if (!ok || hdr->signature != ATR_SIGNATURE ||
+			(hdr->secSize != 128 && hdr->secSize != 256 && hdr->secSize != 512)) {
 		f_close(&mountedATR->fil);
 		return 3;
 	}
+	atr_geometry(mountedATR);
+	// an existing delta is always used, or its changes would be hidden. The
+	// index goes in cart_ram1, the soft OS is already in the Atari
+	int ret = zipLen ? ATRD_NONE : atrd_mount(filename, (ATRD_ENTRY *)&cart_ram1[0], sizeof(cart_ram1) / sizeof(ATRD_ENTRY));
+	if (ret == ATRD_BAD_FILE) {
+		f_close(&mountedATR->fil);
+		return 3;
+	}
+	if (ret == ATRD_NONE && !atrOverlay)
+		atrd_unmount();
 	// success
 	strcpy(mountedATR->path, filename);
-	mountedATR->filesize = f_size(&mountedATR->fil);
+	mountedATR->filesize = size;
 	return 0;
 }
 
+// H: files are named from the directory the ATR is in
+void atr_dir(char *dir) {
+	strcpy(dir, mountedATRs[0].path);
+	int zipLen = zip_split(dir);
+	if (zipLen)
+		dir[zipLen] = 0;	// the one the .ZIP is in
+	char *slash = strrchr(dir, '/');
+	if (slash) *slash = 0;
+}
+
 int read_atr_sector(uint16_t sector, uint8_t page, uint8_t *buf) {
 	// returns 0 for success or error code
 	// 1 = no ATR mounted, 2 = invalid sector
@@ -288,50 +926,292 @@ int read_atr_sector(uint16_t sector, uint8_t page, uint8_t *buf) {
 	if (!mountedATR->path[0]) return 1;
 	if (sector == 0) return 2;
 
-	int offset = ATR_HEADER_SIZE;
-	// first 3 sectors are always 128 bytes
-	if (sector <=3)
-		offset += (sector - 1) * 128;
-	else
-		offset += (3 * 128) + ((sector - 4) * mountedATR->atrHeader.secSize) + (page * 128);
+	int offset = atr_sector_offset(mountedATR, sector, page);
 	// check we're not reading beyond the end of the file..
 	if (offset > (mountedATR->filesize - 128)) {
 		memset(buf, 0 , 128);	// return blank sector?
 		return 0;
 	}
-	UINT br;
-	if (f_lseek(&mountedATR->fil, offset) != FR_OK || f_read(&mountedATR->fil, buf, 128, &br) != FR_OK || br != 128)
-		return 2;
-	return 0;
+	uint32_t t = stat_now();
+	int ret = atrd_read((offset - ATR_HEADER_SIZE) / 128, buf);
+	if (ret == ATRD_NONE)
+		ret = atr_read(mountedATR, offset, buf, 128) ? 0 : 2;
+	stat_phase(STAT_PHASE_READ, t);
+	return ret;
 }
 
 int write_atr_sector(uint16_t sector, uint8_t page, uint8_t *buf) {
 	// returns 0 for success or error code
-	// 1 = no ATR mounted, 2 = write error
+	// 1 = no ATR mounted, 2 = write error, 4 = the overlay is full (ATRD_FULL)
 	MountedATR *mountedATR = &mountedATRs[0];
 	if (!mountedATR->path[0]) return 1;
-	if (sector == 0) return 2;
+	if (sector == 0 || mountedATR->inZip) return 2;
 
-	int offset = ATR_HEADER_SIZE;
-	// first 3 sectors are always 128 bytes
-	if (sector <=3)
-		offset += (sector - 1) * 128;
-	else
-		offset += (3 * 128) + ((sector - 4) * mountedATR->atrHeader.secSize) + (page * 128);
+	int offset = atr_sector_offset(mountedATR, sector, page);
 	// check we're not writing beyond the end of the file..
 	if (offset > (mountedATR->filesize - 128))
 		return 2;
-	UINT bw;
-	if (f_lseek(&mountedATR->fil, offset) != FR_OK || f_write(&mountedATR->fil, buf, 128, &bw) != FR_OK || f_sync(&mountedATR->fil) != FR_OK  || bw != 128)
-		return 2;
-	return 0;
+	uint32_t t = stat_now();
+	int ret = 0;
+	if (atrd_active())
+		ret = atrd_write((offset - ATR_HEADER_SIZE) / 128, buf);
+	else {
+		UINT bw;
+		if (f_lseek(&mountedATR->fil, offset) != FR_OK || f_write(&mountedATR->fil, buf, 128, &bw) != FR_OK || f_sync(&mountedATR->fil) != FR_OK  || bw != 128)
+			ret = 2;
+	}
+	stat_phase(STAT_PHASE_WRITE, t);
+	return ret;
 }
 
 /* CARTRIDGE/XEX HANDLING */
 
-int load_file(char *filename) {
+// cartinfo.h CRC, using the hardware unit
+void cart_crc_reset(void) {
+	CRC_ResetDR();
+}
+
+void cart_crc_words(const uint32_t *words, uint32_t count) {
+	CRC_CalcBlockCRC((uint32_t *)words, count);
+}
+
+uint32_t cart_crc_value(void) {
+	return CRC_GetCRC();
+}
+
+// is the top part of this image still in cart_ram2 from an earlier load?
+int cart_ram2_holds(FILE_META *meta, uint32_t len) {
+	if (!meta || meta->status != META_OK || !len || len > 64*1024)
+		return 0;
+	cart_crc_reset();
+	cart_crc_words((uint32_t *)&cart_ram2[0], len / 4);
+	if (len & 3) {
+		uint32_t w = 0;
+		memcpy(&w, &cart_ram2[len & ~3], len & 3);
+		cart_crc_words(&w, 1);
+	}
+	return cart_crc_value() == meta->crc[1];
+}
+
+LZ4_RESULT lz4Result;
+
+// a CAR, ROM or XEX packed with LZ4, unpacked into SRAM as it's read
+int load_lz4_file(void) {
+	int cart_type = CART_TYPE_NONE, expectedSize;
+	LZ4_RESULT *r = &lz4Result;
+
+	switch (lz4_load(&loadFil, &cart_ram1[0], &cart_ram2[0], r)) {
+	case LZ4_OK: break;
+	case LZ4_BAD_FRAME: strcpy(errorBuf, "Not an LZ4 file"); return 0;
+	case LZ4_CORRUPT: strcpy(errorBuf, "Bad LZ4 file"); return 0;
+	case LZ4_TOO_BIG: strcpy(errorBuf, "Cart file/XEX too big (>128k)"); return 0;
+	default: strcpy(errorBuf, "Can't read file"); return 0;
+	}
+	if (r->kind == FILE_KIND_CAR) {
+		cart_type = car_header_type(r->head[7], &expectedSize);
+		if (cart_type == CART_TYPE_NONE)
+			strcpy(errorBuf, "Unsupported CAR type");
+		else if (r->size != expectedSize) {
+			strcpy(errorBuf, "CAR file is wrong size");
+			cart_type = CART_TYPE_NONE;
+		}
+	}
+	else if (r->kind == FILE_KIND_XEX) {
+		cart_type = CART_TYPE_XEX;
+		// the size of the file first, as for a plain .XEX
+		cart_ram1[0] = r->size & 0xFF;
+		cart_ram1[1] = (r->size >> 8) & 0xFF;
+		cart_ram1[2] = (r->size >> 16) & 0xFF;
+		cart_ram1[3] = 0;
+	}
+	else if ((cart_type = rom_size_type(r->size)) == CART_TYPE_NONE)
+		strcpy(errorBuf, "Unsupported ROM size ");
+	return cart_type;
+}
+
+ZIP_MEMBER zipMember;
+
+// a CAR, ROM or XEX in a .ZIP (open in loadFil), unpacked into SRAM as it's read
+int load_zip_file(char *filename, int zipLen) {
+	int cart_type = CART_TYPE_NONE, expectedSize, ret;
+	ZIP_MEMBER *m = &zipMember;
+	INFLATE_OUT o = {0};
+	uint8_t head[16];
+
+	if ((ret = zip_member(&loadFil, filename, zipLen, m)) == ZIP_OK) {
+		o.ram1 = &cart_ram1[0];
+		o.ram2 = &cart_ram2[0];
+		if (m->kind == FILE_KIND_CAR) {
+			o.head = head;
+			o.headLen = 16;
+		}
+		else if (m->kind == FILE_KIND_XEX)
+			o.base = 4;		// the length goes first
+		if (m->size - o.headLen + o.base > CART_MAX_IMAGE_SIZE)
+			ret = ZIP_TOO_BIG;
+		else
+			ret = zip_load(&loadFil, m, &o);
+	}
+	switch (ret) {
+	case ZIP_OK: break;
+	case ZIP_READ_ERROR: strcpy(errorBuf, "Can't read file"); return 0;
+	case ZIP_TOO_BIG: strcpy(errorBuf, "Cart file/XEX too big (>128k)"); return 0;
+	case ZIP_UNSUPPORTED: strcpy(errorBuf, "Unsupported ZIP compression"); return 0;
+	case ZIP_BAD_CRC: strcpy(errorBuf, "ZIP file CRC error"); return 0;
+	default: strcpy(errorBuf, "Bad ZIP file"); return 0;
+	}
+	if (m->kind == FILE_KIND_CAR) {
+		if (m->size < 16)
+			strcpy(errorBuf, "Bad CAR file");
+		else if ((cart_type = car_header_type(head[7], &expectedSize)) == CART_TYPE_NONE)
+			strcpy(errorBuf, "Unsupported CAR type");
+		else if (m->size - 16 != expectedSize) {
+			strcpy(errorBuf, "CAR file is wrong size");
+			cart_type = CART_TYPE_NONE;
+		}
+	}
+	else if (m->kind == FILE_KIND_XEX) {
+		cart_type = CART_TYPE_XEX;
+		cart_ram1[0] = m->size & 0xFF;
+		cart_ram1[1] = (m->size >> 8) & 0xFF;
+		cart_ram1[2] = (m->size >> 16) & 0xFF;
+		cart_ram1[3] = 0;
+	}
+	else if ((cart_type = rom_size_type(m->size)) == CART_TYPE_NONE)
+		strcpy(errorBuf, "Unsupported ROM size ");
+	return cart_type;
+}
+
+/* Speculative load: while the menu's cursor rests on a ROM, CAR or XEX, what
+   load_file would put in cart_ram2 is read there a slice at a time. An image
+   of 64k or less is read whole and copied to cart_ram1 when it's opened,
+   since the listing is there until then; a bigger one has only its first 64k
+   left to read. The data is forgotten by any command that may use cart_ram2
+   (preload_forget) */
+#define PRELOAD_CHUNK		4096
+
+#define PRELOAD_NONE		0
+#define PRELOAD_READING		1	// from loadFil
+#define PRELOAD_READY		2
+
+typedef struct {
+	int state;
+	int item;			// in cart_ram1
+	uint32_t pathHash;
+	uint32_t fileSize;
+	uint32_t offset;	// of cart_ram2[0] in the file
+	uint32_t len;
+	uint32_t done;
+} PRELOAD;
+
+PRELOAD preload = {0};
+
+// stop a preload that's under way
+void preload_cancel() {
+	if (preload.state == PRELOAD_READING) {
+		f_close(&loadFil);
+		preload.state = PRELOAD_NONE;
+	}
+}
+
+void preload_forget() {
+	preload_cancel();
+	preload.state = PRELOAD_NONE;
+}
+
+// is offset..the end of the open loadFil in cart_ram2 already?
+int preload_holds(char *filename, uint32_t offset) {
+	return preload.state == PRELOAD_READY && preload.fileSize == f_size(&loadFil)
+		&& preload.offset == offset && preload.pathHash == meta_name_hash(filename);
+}
+
+// open the file and check its header, 0 if there's nothing to read ahead
+int preload_begin(char *curPath, DIR_ENTRY *entry) {
+	int kind = file_kind(entry->filename), expectedSize;
+	uint32_t base = 0, room = 64*1024, size, hash;
+	unsigned char header[16];
+	UINT br;
+
+	if (kind != FILE_KIND_ROM && kind != FILE_KIND_CAR && kind != FILE_KIND_XEX)
+		return 0;
+	if (entry->metaStatus != META_UNKNOWN && entry->metaStatus != META_OK)
+		return 0;
+	if (strlen(entry->full_path[0] ? entry->full_path : curPath) + strlen(entry->filename) + 2 > sizeof(pathBuf))
+		return 0;
+	strcpy(pathBuf, entry->full_path[0] ? entry->full_path : curPath);
+	strcat(pathBuf, "/");
+	strcat(pathBuf, entry->filename);
+	hash = meta_name_hash(pathBuf);
+	if (preload.state == PRELOAD_READY && preload.pathHash == hash && preload.fileSize == entry->size)
+		return 0;	// read already
+	preload_forget();
+	if (!mount_sd() || f_open(&loadFil, pathBuf, FA_READ) != FR_OK)
+		return 0;
+	size = f_size(&loadFil);
+	if (kind == FILE_KIND_CAR) {
+		base = 16;
+		if (f_read(&loadFil, header, 16, &br) != FR_OK || br != 16
+				|| car_header_type(header[7], &expectedSize) == CART_TYPE_NONE
+				|| size != expectedSize + 16)
+			goto fail;
+	}
+	else if (kind == FILE_KIND_XEX) {
+		room -= 4;		// the length goes before it
+		if (size > 128*1024 - 4)
+			goto fail;
+	}
+	else if (rom_size_type(size) == CART_TYPE_NONE)
+		goto fail;
+	// all of it if it fits in cart_ram1, or what's after that
+	preload.offset = (size - base <= room) ? base : base + room;
+	preload.len = size - preload.offset;
+	if (preload.len > 64*1024 || f_lseek(&loadFil, preload.offset) != FR_OK)
+		goto fail;
+	incSearch.len = incSearch.numCands = 0;	// its candidates are in cart_ram2
+	zip_forget();	// and so is its index
+	preload.state = PRELOAD_READING;
+	preload.pathHash = hash;
+	preload.fileSize = size;
+	preload.done = 0;
+	return 1;
+fail:
+	f_close(&loadFil);
+	return 0;
+}
+
+// returns 1 once there's nothing more to do for item
+int preload_step(char *curPath, int item, uint32_t budget) {
+	DIR_ENTRY *entry = (DIR_ENTRY *)&cart_ram1[0];
+	uint32_t t0 = DWT->CYCCNT;
+	UINT br;
+
+	if (preload.state == PRELOAD_READING && preload.item != item)
+		preload_cancel();
+	if (item >= num_dir_entries || entry[item].isDir)
+		return 1;
+	if (preload.state != PRELOAD_READING) {
+		if (!preload_begin(curPath, &entry[item]))
+			return 1;
+		preload.item = item;
+	}
+	while (preload.done < preload.len && DWT->CYCCNT - t0 < budget) {
+		uint32_t n = preload.len - preload.done;
+		if (n > PRELOAD_CHUNK) n = PRELOAD_CHUNK;
+		if (f_read(&loadFil, &cart_ram2[preload.done], n, &br) != FR_OK || br != n) {
+			preload_cancel();
+			return 1;
+		}
+		preload.done += n;
+	}
+	if (preload.done < preload.len)
+		return 0;
+	f_close(&loadFil);
+	preload.state = PRELOAD_READY;
+	return 1;
+}
+
+int load_file(char *filename, FILE_META *meta) {
 	TM_DELAY_Init();
-	FATFS FatFs;
 	int cart_type = CART_TYPE_NONE;
 	int car_file = 0, xex_file = 0, expectedSize = 0;
 	unsigned char carFileHeader[16];
@@ -342,53 +1222,45 @@ int load_file(char *filename) {
 	if (strncasecmp(filename+strlen(filename)-4, ".XEX", 4) == 0)
 		xex_file = 1;
 
-	if (f_mount(&FatFs, "", 1) != FR_OK) {
+	flash_reset(&cart_ram1[0], &cart_ram2[0]);
+	zip_forget();
+	if (!mount_sd()) {
 		strcpy(errorBuf, "Can't read SD card");
 		return 0;
 	}
-	FIL fil;
-	if (f_open(&fil, filename, FA_READ) != FR_OK) {
+	// a member of a .ZIP is read from the .ZIP
+	int zipLen = zip_split(filename);
+	if (zipLen) {
+		memcpy(pathBuf, filename, zipLen);
+		pathBuf[zipLen] = 0;
+	}
+	if (f_open(&loadFil, zipLen ? pathBuf : filename, FA_READ) != FR_OK) {
 		strcpy(errorBuf, "Can't open file");
-		goto cleanup;
+		return 0;
+	}
+	if (zipLen) {
+		cart_type = load_zip_file(filename, zipLen);
+		goto closefile;
+	}
+	if (file_kind(filename) == FILE_KIND_LZ4) {
+		cart_type = load_lz4_file();
+		goto closefile;
 	}
 
 	// read the .CAR file header?
 	if (car_file) {
-		if (f_read(&fil, carFileHeader, 16, &br) != FR_OK || br != 16) {
+		if (f_read(&loadFil, carFileHeader, 16, &br) != FR_OK || br != 16) {
 			strcpy(errorBuf, "Bad CAR file");
 			goto closefile;
 		}
-		int car_type = carFileHeader[7];
-		if (car_type == 1)			{ cart_type = CART_TYPE_8K; expectedSize = 8192; }
-		else if (car_type == 2)		{ cart_type = CART_TYPE_16K; expectedSize = 16384; }
-		else if (car_type == 3) 	{ cart_type = CART_TYPE_OSS_16K_034M; expectedSize = 16384; }
-		else if (car_type == 8)		{ cart_type = CART_TYPE_WILLIAMS_64K; expectedSize = 65536; }
-		else if (car_type == 9)		{ cart_type = CART_TYPE_EXPRESS_64K; expectedSize = 65536; }
-		else if (car_type == 10)	{ cart_type = CART_TYPE_DIAMOND_64K; expectedSize = 65536; }
-		else if (car_type == 11)	{ cart_type = CART_TYPE_SDX_64K; expectedSize = 65536; }
-		else if (car_type == 12) 	{ cart_type = CART_TYPE_XEGS_32K; expectedSize = 32768; }
-		else if (car_type == 13) 	{ cart_type = CART_TYPE_XEGS_64K; expectedSize = 65536; }
-		else if (car_type == 14) 	{ cart_type = CART_TYPE_XEGS_128K; expectedSize = 131072; }
-		else if (car_type == 15) 	{ cart_type = CART_TYPE_OSS_16K_TYPE_B; expectedSize = 16384; }
-		else if (car_type == 18) 	{ cart_type = CART_TYPE_BOUNTY_BOB; expectedSize = 40960; }
-		else if (car_type == 22)	{ cart_type = CART_TYPE_WILLIAMS_64K; expectedSize = 32768; }
-		else if (car_type == 26)	{ cart_type = CART_TYPE_MEGACART_16K; expectedSize = 16384; }
-		else if (car_type == 27)	{ cart_type = CART_TYPE_MEGACART_32K; expectedSize = 32768; }
-		else if (car_type == 28)	{ cart_type = CART_TYPE_MEGACART_64K; expectedSize = 65536; }
-		else if (car_type == 29)	{ cart_type = CART_TYPE_MEGACART_128K; expectedSize = 131072; }
-		else if (car_type == 33)	{ cart_type = CART_TYPE_SW_XEGS_32K; expectedSize = 32768; }
-		else if (car_type == 34)	{ cart_type = CART_TYPE_SW_XEGS_64K; expectedSize = 65536; }
-		else if (car_type == 35)	{ cart_type = CART_TYPE_SW_XEGS_128K; expectedSize = 131072; }
-		else if (car_type == 40)	{ cart_type = CART_TYPE_BLIZZARD_16K; expectedSize = 16384; }
-		else if (car_type == 41)	{ cart_type = CART_TYPE_ATARIMAX_1MBIT; expectedSize = 131072; }
-		else if (car_type == 43)	{ cart_type = CART_TYPE_SDX_128K; expectedSize = 131072; }
-		else if (car_type == 44)	{ cart_type = CART_TYPE_OSS_8K; expectedSize = 8192; }
-		else if (car_type == 45) 	{ cart_type = CART_TYPE_OSS_16K_043M; expectedSize = 16384; }
-		else if (car_type == 54)	{ cart_type = CART_TYPE_SIC_128K; expectedSize = 131072; }
-		else {
+		cart_type = car_header_type(carFileHeader[7], &expectedSize);
+		if (cart_type == CART_TYPE_NONE) {
 			strcpy(errorBuf, "Unsupported CAR type");
 			goto closefile;
 		}
+		// saving changes the file but not its date, so the cached CRC can't be trusted
+		if (flash_cart_type(cart_type))
+			meta = NULL;
 	}
 
 	// set a default error
@@ -401,21 +1273,46 @@ int load_file(char *filename) {
 		bytes_to_read -= 4;
 	}
 	// read the file in two 64k chunks to each area of SRAM
-	if (f_read(&fil, dst, bytes_to_read, &br) != FR_OK) {
+	uint32_t t = stat_now();
+	FRESULT res;
+	if (f_size(&loadFil) - f_tell(&loadFil) <= bytes_to_read && preload_holds(filename, f_tell(&loadFil))) {
+		// read ahead whole while the cursor was on it
+		br = preload.len;
+		memcpy(dst, &cart_ram2[0], br);
+		res = f_lseek(&loadFil, f_size(&loadFil));
+	}
+	else
+		res = f_read(&loadFil, dst, bytes_to_read, &br);
+	stat_phase(STAT_PHASE_READ, t);
+	if (res != FR_OK) {
 		cart_type = CART_TYPE_NONE;
 		goto closefile;
 	}
 	size += br;
 	if (br == bytes_to_read) {
 		// first 64k was complete, so try to load 64k more
-		if (f_read(&fil, &cart_ram2[0], 64*1024, &br) != FR_OK) {
-			cart_type = CART_TYPE_NONE;
-			goto closefile;
+		uint32_t remaining = f_size(&loadFil) - f_tell(&loadFil);
+		if (preload_holds(filename, f_tell(&loadFil)) || cart_ram2_holds(meta, remaining)) {
+			// read ahead, or the same file loaded last time, no need to read the rest
+			if (f_lseek(&loadFil, f_size(&loadFil)) != FR_OK) {
+				cart_type = CART_TYPE_NONE;
+				goto closefile;
+			}
+			br = remaining;
+		}
+		else {
+			t = stat_now();
+			res = f_read(&loadFil, &cart_ram2[0], 64*1024, &br);
+			stat_phase(STAT_PHASE_READ, t);
+			if (res != FR_OK) {
+				cart_type = CART_TYPE_NONE;
+				goto closefile;
+			}
 		}
 		size += br;
 		if (br == 64*1024) {
 			// that's 128k read, is there any more?
-			if (f_read(&fil, carFileHeader, 1, &br) != FR_OK) {
+			if (f_read(&loadFil, carFileHeader, 1, &br) != FR_OK) {
 				cart_type = CART_TYPE_NONE;
 				goto closefile;
 			}
@@ -434,6 +1331,9 @@ int load_file(char *filename) {
 			cart_type = CART_TYPE_NONE;
 			goto closefile;
 		}
+		// writes to the flash chip go back to the file (otherwise they're kept until power off)
+		if (flash_cart_type(cart_type))
+			flash_map(&loadFil, 16, carFileHeader);
 	}
 	else if (xex_file) {
 		cart_type = CART_TYPE_XEX;
@@ -444,25 +1344,132 @@ int load_file(char *filename) {
 		cart_ram1[3] = 0;	// has to be zero!
 	}
 	else {	// not a car/xex file - guess the type based on size
-		if (size == 8*1024) cart_type = CART_TYPE_8K;
-		else if (size == 16*1024) cart_type = CART_TYPE_16K;
-		else if (size == 32*1024) cart_type = CART_TYPE_XEGS_32K;
-		else if (size == 64*1024) cart_type = CART_TYPE_XEGS_64K;
-		else if (size == 128*1024) cart_type = CART_TYPE_XEGS_128K;
-		else {
+		cart_type = rom_size_type(size);
+		if (cart_type == CART_TYPE_NONE) {
 			strcpy(errorBuf, "Unsupported ROM size ");
-			cart_type = CART_TYPE_NONE;
 			goto closefile;
 		}
 	}
 
 closefile:
-	f_close(&fil);
-cleanup:
-	f_mount(0, "", 1);
+	f_close(&loadFil);
+	preload.state = PRELOAD_NONE;	// cart_ram2 is the cart's now
 	return cart_type;
 }
 
+/* Background metadata scan, run a slice at a time while the menu is idle */
+
+#define META_SCAN_CHUNK		2048
+
+typedef struct {
+	int started;
+	int start;			// entry at the top of the menu when the scan began
+	int pos;			// entries done, counting on from start
+	int fileOpen;		// scanning entry (start+pos) from fil
+	FIL fil;
+	CART_SCAN scan;
+	FILE_META meta;
+} META_SCAN;
+
+META_SCAN metaScan = {0};
+uint32_t metaScanBuf[META_SCAN_CHUNK / 4];
+
+void meta_scan_reset() {
+	if (metaScan.fileOpen)
+		f_close(&metaScan.fil);
+	metaScan.fileOpen = 0;
+	metaScan.started = 0;
+}
+
+// give up on the file being read (the CRC unit is needed), it is rescanned later
+void meta_scan_abort() {
+	if (metaScan.fileOpen)
+		f_close(&metaScan.fil);
+	metaScan.fileOpen = 0;
+}
+
+void meta_scan_finish(DIR_ENTRY *entry, int store) {
+	entry->cartType = metaScan.meta.cartType;
+	entry->metaStatus = metaScan.meta.status;
+	dirc_shown_meta(entry - (DIR_ENTRY *)&cart_ram1[0], entry->cartType, entry->metaStatus);
+	if (store)
+		meta_store(&metaScan.meta);
+}
+
+// returns 1 once every entry has been looked at, *updated = entries changed
+int meta_scan_step(char *curPath, int top, uint32_t budget, int *updated) {
+	DIR_ENTRY *entries = (DIR_ENTRY *)&cart_ram1[0];
+	uint32_t t0 = DWT->CYCCNT;
+	UINT br;
+
+	*updated = 0;
+	if (!metaScan.started) {
+		metaScan.started = 1;
+		metaScan.start = top < num_dir_entries ? top : 0;
+		metaScan.pos = 0;
+	}
+	if (!mount_sd() || !meta_open())
+		return 1;
+	while (metaScan.pos < num_dir_entries && DWT->CYCCNT - t0 < budget) {
+		DIR_ENTRY *entry = &entries[(metaScan.start + metaScan.pos) % num_dir_entries];
+		if (!metaScan.fileOpen) {
+			if (entry->isDir || entry->metaStatus != META_UNKNOWN) {
+				metaScan.pos++;
+				continue;
+			}
+			memset(&metaScan.meta, 0, sizeof(FILE_META));
+			metaScan.meta.nameHash = entry->nameHash;
+			metaScan.meta.size = entry->size;
+			metaScan.meta.fdate = entry->fdate;
+			metaScan.meta.ftime = entry->ftime;
+			if (meta_lookup(&metaScan.meta)) {
+				meta_scan_finish(entry, 0);
+				(*updated)++;
+				metaScan.pos++;
+				continue;
+			}
+			if (entry->filename[0] == '?') {
+				metaScan.pos++;		// in a .ZIP, it's only checked when it's loaded
+				continue;
+			}
+			strcpy(pathBuf, entry->full_path[0] ? entry->full_path : curPath);
+			strcat(pathBuf, "/");
+			strcat(pathBuf, entry->filename);
+			cart_scan_begin(&metaScan.scan, entry->filename, entry->size, &metaScan.meta);
+			if (metaScan.scan.failed) {
+				// known from the size alone
+				cart_scan_end(&metaScan.scan);
+				meta_scan_finish(entry, 1);
+				(*updated)++;
+				metaScan.pos++;
+				continue;
+			}
+			if (f_open(&metaScan.fil, pathBuf, FA_READ) != FR_OK) {
+				// not cached, may be a card problem
+				metaScan.meta.status = META_READ_ERROR;
+				meta_scan_finish(entry, 0);
+				(*updated)++;
+				metaScan.pos++;
+				continue;
+			}
+			metaScan.fileOpen = 1;
+		}
+		int more = 0;
+		if (f_read(&metaScan.fil, metaScanBuf, META_SCAN_CHUNK, &br) == FR_OK && br)
+			more = cart_scan_feed(&metaScan.scan, (uint8_t *)metaScanBuf, br);
+		if (!more) {
+			f_close(&metaScan.fil);
+			metaScan.fileOpen = 0;
+			cart_scan_end(&metaScan.scan);
+			meta_scan_finish(entry, metaScan.meta.status != META_READ_ERROR);
+			(*updated)++;
+			metaScan.pos++;
+		}
+	}
+	return metaScan.pos >= num_dir_entries;
+}
+
+#ifndef UNOCART_HOST
 #define RD5_LOW GPIOB->BSRRH = GPIO_Pin_2;
 #define RD4_LOW GPIOB->BSRRH = GPIO_Pin_4;
 #define RD5_HIGH GPIOB->BSRRL = GPIO_Pin_2;
@@ -472,11 +1479,23 @@ cleanup:
 #define ADDR_IN GPIOD->IDR
 #define DATA_IN GPIOE->IDR
 #define DATA_OUT GPIOE->ODR
-
-#define PHI2_RD (GPIOC->IDR & 0x0001)
-#define S5_RD (GPIOC->IDR & 0x0002)
-#define S4_RD (GPIOC->IDR & 0x0004)
-#define S4_AND_S5_HIGH (GPIOC->IDR & 0x0006) == 0x6
+#else
+// HostTools/bussim and cosim play the Atari's side (see host/stm32f4xx.h)
+#define RD5_LOW host_bus_rd(GPIO_Pin_2, 0);
+#define RD4_LOW host_bus_rd(GPIO_Pin_4, 0);
+#define RD5_HIGH host_bus_rd(GPIO_Pin_2, 1);
+#define RD4_HIGH host_bus_rd(GPIO_Pin_4, 1);
+
+#define CONTROL_IN host_bus_control()
+#define ADDR_IN host_bus_addr()
+#define DATA_IN host_bus_data()
+#define DATA_OUT host_bus_out
+#endif
+
+#define PHI2_RD (CONTROL_IN & 0x0001)
+#define S5_RD (CONTROL_IN & 0x0002)
+#define S4_RD (CONTROL_IN & 0x0004)
+#define S4_AND_S5_HIGH (CONTROL_IN & 0x0006) == 0x6
 
 #define PHI2	0x0001
 #define S5		0x0002
@@ -484,6 +1503,13 @@ cleanup:
 #define CCTL	0x0010
 #define RW		0x0020
 
+// the address, for trace entries where the emulation doesn't need it
+#ifdef UNOCART_TRACE
+#define TRACE_ADDR(a) a = ADDR_IN;
+#else
+#define TRACE_ADDR(a)
+#endif
+
 #define SET_DATA_MODE_IN GPIOE->MODER = 0x00000000;
 #define SET_DATA_MODE_OUT GPIOE->MODER = 0x55550000;
 
@@ -569,6 +1595,7 @@ void config_gpio_addr(void) {
 */
 
 int emulate_boot_rom(int atrMode) {
+	static int sdBgInit = 1;
 	__disable_irq();	// Disable interrupts
 	if (atrMode) RD5_LOW else RD5_HIGH
 	RD4_LOW
@@ -586,6 +1613,7 @@ int emulate_boot_rom(int atrMode) {
 				SET_DATA_MODE_OUT
 				addr = ADDR_IN;
 				DATA_OUT = ((uint16_t)cart_d5xx[addr&0xFF])<<8;
+				TRACE_BUS(addr, DATA_OUT >> 8, c);
 				// wait for phi2 low
 				while (CONTROL_IN & PHI2) ;
 				SET_DATA_MODE_IN
@@ -597,6 +1625,7 @@ int emulate_boot_rom(int atrMode) {
 				// read data bus on falling edge of phi2
 				while (CONTROL_IN & PHI2)
 					data = DATA_IN;
+				TRACE_BUS(addr, data >> 8, c);
 				cart_d5xx[addr&0xFF] = data>>8;
 				if ((addr&0xFF) == 0xDF)	// write to $D5DF
 					break;
@@ -607,10 +1636,17 @@ int emulate_boot_rom(int atrMode) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)(UnoCart_rom[addr]))<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 			// wait for phi2 low
 			while (CONTROL_IN & PHI2) ;
 			SET_DATA_MODE_IN
 		}
+		else if (sdBgInit && (c & CCTL)) {
+			// idle cycle - use the phi2 low phase to clock the SD card init along
+			while (CONTROL_IN & PHI2) ;
+			if (!(sdBgInit = TM_FATFS_SD_BgInitStep()) && TM_FATFS_SD_BgInitReady())
+				boot_times.card_ready = DWT->CYCCNT;
+		}
 	}
 	__enable_irq();
 	return data>>8;
@@ -619,7 +1655,7 @@ int emulate_boot_rom(int atrMode) {
 void emulate_standard_8k() {
 	// 8k
 	RD5_HIGH
-	uint16_t addr;
+	uint16_t addr = 0;
 	while (1)
 	{
 		// wait for s5 low
@@ -631,6 +1667,8 @@ void emulate_standard_8k() {
 			DATA_OUT = ((uint16_t)cart_ram1[addr])<<8;
 		}
 		SET_DATA_MODE_IN
+		// RW isn't looked at here, so everything goes down as a read
+		TRACE_BUS(addr, DATA_OUT >> 8, CCTL|RW|S4);
 	}
 }
 
@@ -638,7 +1676,7 @@ void emulate_standard_16k() {
 	// 16k
 	RD4_HIGH
 	RD5_HIGH
-	uint16_t addr;
+	uint16_t addr = 0;
 	while (1)
 	{
 		// wait for either s4 or s5 low
@@ -650,6 +1688,7 @@ void emulate_standard_16k() {
 				addr = ADDR_IN;
 				DATA_OUT = ((uint16_t)cart_ram1[addr])<<8;
 			}
+			TRACE_BUS(addr, DATA_OUT >> 8, CCTL|RW|S5);
 		}
 		else {
 			// while s5 low
@@ -657,6 +1696,7 @@ void emulate_standard_16k() {
 				addr = ADDR_IN;
 				DATA_OUT = ((uint16_t)cart_ram1[0x2000|addr])<<8;
 			}
+			TRACE_BUS(addr, DATA_OUT >> 8, CCTL|RW|S4);
 		}
 		SET_DATA_MODE_IN
 	}
@@ -677,6 +1717,7 @@ void emulate_XEGS_32k(char switchable) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)(*(bankPtr+addr)))<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 			// wait for phi2 low
 			while (CONTROL_IN & PHI2) ;
 			SET_DATA_MODE_IN
@@ -685,16 +1726,19 @@ void emulate_XEGS_32k(char switchable) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)cart_ram1[0x6000|addr])<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 			// wait for phi2 low
 			while (CONTROL_IN & PHI2) ;
 			SET_DATA_MODE_IN
 		}
 		else if (!(c & CCTL) && !(c & RW)) {
 			// CCTL low + write
+			TRACE_ADDR(addr);
 			data = DATA_IN;
 			// read the data bus on falling edge of phi2
 			while (CONTROL_IN & PHI2)
 				data = DATA_IN;
+			TRACE_BUS(addr, data >> 8, c);
 			// new bank is the low 2 bits written to $D5xx
 			bankPtr = &cart_ram1[0] + (8192*((data>>8) & 3));
 			if (switchable) {
@@ -727,6 +1771,7 @@ void emulate_XEGS_64k(char switchable) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)(*(bankPtr+addr)))<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 			// wait for phi2 low
 			while (CONTROL_IN & PHI2) ;
 			SET_DATA_MODE_IN
@@ -735,16 +1780,19 @@ void emulate_XEGS_64k(char switchable) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)cart_ram1[0xE000|addr])<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 			// wait for phi2 low
 			while (CONTROL_IN & PHI2) ;
 			SET_DATA_MODE_IN
 		}
 		else if (!(c & CCTL) && !(c & RW)) {
 			// CCTL low + write
+			TRACE_ADDR(addr);
 			data = DATA_IN;
 			// read the data bus on falling edge of phi2
 			while (CONTROL_IN & PHI2)
 				data = DATA_IN;
+			TRACE_BUS(addr, data >> 8, c);
 			// new bank is the low 3 bits written to $D5xx
 			bankPtr = &cart_ram1[0] + (8192*((data>>8) & 7));
 			if (switchable) {
@@ -777,6 +1825,7 @@ void emulate_XEGS_128k(char switchable) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)(*(ramPtr+addr)))<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 			// wait for phi2 low
 			while (CONTROL_IN & PHI2) ;
 			SET_DATA_MODE_IN
@@ -785,16 +1834,19 @@ void emulate_XEGS_128k(char switchable) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)cart_ram2[0xE000|addr])<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 			// wait for phi2 low
 			while (CONTROL_IN & PHI2) ;
 			SET_DATA_MODE_IN
 		}
 		else if (!(c & CCTL) && !(c & RW)) {
 			// CCTL low + write
+			TRACE_ADDR(addr);
 			data = DATA_IN;
 			// read the data bus on falling edge of phi2
 			while (CONTROL_IN & PHI2)
 				data = DATA_IN;
+			TRACE_BUS(addr, data >> 8, c);
 			// new bank is the low 4 bits written to $D5xx
 			int bank = (data>>8) & 0xF;
 			if (bank & 0x8) ramPtr = &cart_ram2[0]; else ramPtr = &cart_ram1[0];
@@ -829,6 +1881,7 @@ void emulate_bounty_bob() {
 			addr = ADDR_IN;
 			if (addr & 0x1000) {
 				DATA_OUT = ((uint16_t)(*(bankPtr2+(addr&0xFFF))))<<8;
+				TRACE_BUS(addr, DATA_OUT >> 8, c);
 				if (addr == 0x1FF6) bankPtr2 = &cart_ram1[0x4000];
 				else if (addr == 0x1FF7) bankPtr2 = &cart_ram1[0x5000];
 				else if (addr == 0x1FF8) bankPtr2 = &cart_ram1[0x6000];
@@ -836,6 +1889,7 @@ void emulate_bounty_bob() {
 			}
 			else {
 				DATA_OUT = ((uint16_t)(*(bankPtr1+(addr&0xFFF))))<<8;
+				TRACE_BUS(addr, DATA_OUT >> 8, c);
 				if (addr == 0x0FF6) bankPtr1 = &cart_ram1[0];
 				else if (addr == 0x0FF7) bankPtr1 = &cart_ram1[0x1000];
 				else if (addr == 0x0FF8) bankPtr1 = &cart_ram1[0x2000];
@@ -846,6 +1900,7 @@ void emulate_bounty_bob() {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)cart_ram1[0x8000|addr])<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 		}
 		// wait for phi2 low
 		while (CONTROL_IN & PHI2) ;
@@ -857,8 +1912,9 @@ void emulate_atarimax_128k() {
 	// atarimax 128k
 	RD5_HIGH
 	RD4_LOW
-	uint16_t addr, c;
+	uint16_t addr, data, c;
 	uint32_t bank = 0;
+	int flashMode = FLASH_READ;
 	unsigned char *ramPtr;
 	while (1)
 	{
@@ -868,13 +1924,33 @@ void emulate_atarimax_128k() {
 		// wait for phi2 high
 		while (!((c = CONTROL_IN) & PHI2)) ;
 		if (!(c & S5)) {
-			SET_DATA_MODE_OUT
-			addr = ADDR_IN;
-			DATA_OUT = ((uint16_t)(*(ramPtr+addr)))<<8;
+			if (c & RW) {
+				SET_DATA_MODE_OUT
+				addr = ADDR_IN;
+				if (flashMode == FLASH_READ)
+					DATA_OUT = ((uint16_t)(*(ramPtr+addr)))<<8;
+				else
+					DATA_OUT = ((uint16_t)flash_read(8192 * bank + addr))<<8;
+				TRACE_BUS(addr, DATA_OUT >> 8, c);
+				// wait for phi2 low
+				while (CONTROL_IN & PHI2) ;
+				SET_DATA_MODE_IN
+			}
+			else {
+				// write to the flash chip
+				addr = ADDR_IN;
+				data = DATA_IN;
+				// read the data bus on falling edge of phi2
+				while (CONTROL_IN & PHI2)
+					data = DATA_IN;
+				TRACE_BUS(addr, data >> 8, c);
+				flashMode = flash_write(8192 * bank + addr, data >> 8);
+			}
 		}
 		else if (!(c & CCTL)) {
 			// CCTL low
 			addr = ADDR_IN;
+			TRACE_BUS(addr, 0, c);
 			if ((addr & 0xE0) == 0) {
 				bank = addr & 0xF;
 				if (addr & 0x10) {
@@ -886,10 +1962,14 @@ void emulate_atarimax_128k() {
 					GREEN_LED_ON
 				}
 			}
+			// wait for phi2 low
+			while (CONTROL_IN & PHI2) ;
+		}
+		else {
+			// idle cycle - erasing and saving in the phi2 low phase
+			while (CONTROL_IN & PHI2) ;
+			flashMode = flash_step();
 		}
-		// wait for phi2 low
-		while (CONTROL_IN & PHI2) ;
-		SET_DATA_MODE_IN
 	}
 }
 
@@ -910,10 +1990,12 @@ void emulate_williams() {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)(*(bankPtr+addr)))<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 		}
 		else if (!(c & CCTL)) {
 			// CCTL low
 			addr = ADDR_IN;
+			TRACE_BUS(addr, 0, c);
 			if ((addr & 0xF0) == 0) {
 				bank = addr & 0x07;
 				if (addr & 0x08) {
@@ -952,10 +2034,12 @@ void emulate_OSS_B() {
 				DATA_OUT = ((uint16_t)cart_ram1[addr&0xFFF])<<8;
 			else
 				DATA_OUT = ((uint16_t)(*(bankPtr+addr)))<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 		}
 		else if (!(c & CCTL)) {
 			// CCTL low
 			addr = ADDR_IN;
+			TRACE_BUS(addr, 0, c);
 			int a0 = addr & 1, a3 = addr & 8;
 			if (a3 && !a0) {
 				RD5_LOW
@@ -995,10 +2079,12 @@ void emulate_OSS_A(char is034M) {
 				DATA_OUT = ((uint16_t)cart_ram1[addr|0x2000])<<8;	// 4k bank #3 always mapped to $Bxxx
 			else
 				DATA_OUT = ((uint16_t)(*(bankPtr+addr)))<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 		}
 		else if (!(c & CCTL)) {
 			// CCTL low
 			addr = ADDR_IN & 0xF;
+			TRACE_BUS(addr, 0, c);
 			if (addr & 0x8) {
 				RD5_LOW
 				GREEN_LED_OFF
@@ -1037,6 +2123,7 @@ void emulate_megacart(int size) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)(*(ramPtr+addr)))<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 			// wait for phi2 low
 			while (CONTROL_IN & PHI2) ;
 			SET_DATA_MODE_IN
@@ -1045,16 +2132,19 @@ void emulate_megacart(int size) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)(*(ramPtr+(addr|0x2000))))<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 			// wait for phi2 low
 			while (CONTROL_IN & PHI2) ;
 			SET_DATA_MODE_IN
 		}
 		else if (!(c & CCTL) && !(c & RW)) {
 			// CCTL low + write
+			TRACE_ADDR(addr);
 			data = DATA_IN;
 			// read the data bus on falling edge of phi2
 			while (CONTROL_IN & PHI2)
 				data = DATA_IN;
+			TRACE_BUS(addr, data >> 8, c);
 			// new bank is the low n bits written to $D5xx
 			int bank = (data>>8) & bank_mask;
 			if (bank & 0x4) ramPtr = &cart_ram2[0]; else ramPtr = &cart_ram1[0];
@@ -1078,6 +2168,7 @@ void emulate_SIC() {
 	RD4_LOW
 	uint16_t addr, data, c;
 	uint8_t SIC_byte = 0;
+	int flashMode = FLASH_READ;
 	unsigned char *ramPtr = &cart_ram1[0];
 	while (1)
 	{
@@ -1085,20 +2176,51 @@ void emulate_SIC() {
 		while (!((c = CONTROL_IN) & PHI2)) ;
 
 		if (!(c & S4)) {
-			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
-			DATA_OUT = ((uint16_t)(*(ramPtr+addr)))<<8;
-			// wait for phi2 low
-			while (CONTROL_IN & PHI2) ;
-			SET_DATA_MODE_IN
+			if (c & RW) {
+				SET_DATA_MODE_OUT
+				if (flashMode == FLASH_READ)
+					DATA_OUT = ((uint16_t)(*(ramPtr+addr)))<<8;
+				else
+					DATA_OUT = ((uint16_t)flash_read(16384 * (SIC_byte & 0x7) + addr))<<8;
+				TRACE_BUS(addr, DATA_OUT >> 8, c);
+				// wait for phi2 low
+				while (CONTROL_IN & PHI2) ;
+				SET_DATA_MODE_IN
+			}
+			else {
+				data = DATA_IN;
+				// read the data bus on falling edge of phi2
+				while (CONTROL_IN & PHI2)
+					data = DATA_IN;
+				TRACE_BUS(addr, data >> 8, c);
+				// the flash chip only sees it with bit 7 of $D5xx set
+				if (SIC_byte & 0x80)
+					flashMode = flash_write(16384 * (SIC_byte & 0x7) + addr, data >> 8);
+			}
 		}
 		else if (!(c & S5)) {
-			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
-			DATA_OUT = ((uint16_t)(*(ramPtr+(addr|0x2000))))<<8;
-			// wait for phi2 low
-			while (CONTROL_IN & PHI2) ;
-			SET_DATA_MODE_IN
+			if (c & RW) {
+				SET_DATA_MODE_OUT
+				if (flashMode == FLASH_READ)
+					DATA_OUT = ((uint16_t)(*(ramPtr+(addr|0x2000))))<<8;
+				else
+					DATA_OUT = ((uint16_t)flash_read(16384 * (SIC_byte & 0x7) + (addr|0x2000)))<<8;
+				TRACE_BUS(addr, DATA_OUT >> 8, c);
+				// wait for phi2 low
+				while (CONTROL_IN & PHI2) ;
+				SET_DATA_MODE_IN
+			}
+			else {
+				data = DATA_IN;
+				// read the data bus on falling edge of phi2
+				while (CONTROL_IN & PHI2)
+					data = DATA_IN;
+				TRACE_BUS(addr, data >> 8, c);
+				if (SIC_byte & 0x80)
+					flashMode = flash_write(16384 * (SIC_byte & 0x7) + (addr|0x2000), data >> 8);
+			}
 		}
 		else if (!(c & CCTL)) {
 			// CCTL low
@@ -1108,6 +2230,7 @@ void emulate_SIC() {
 					// read from $D5xx
 					SET_DATA_MODE_OUT
 					DATA_OUT = ((uint16_t)SIC_byte)<<8;
+					TRACE_BUS(addr, DATA_OUT >> 8, c);
 					// wait for phi2 low
 					while (CONTROL_IN & PHI2) ;
 					SET_DATA_MODE_IN
@@ -1118,6 +2241,7 @@ void emulate_SIC() {
 					// read the data bus on falling edge of phi2
 					while (CONTROL_IN & PHI2)
 						data = DATA_IN;
+					TRACE_BUS(addr, data >> 8, c);
 					SIC_byte = (uint8_t)(data>>8);
 					// switch bank
 					if (SIC_byte & 0x4) ramPtr = &cart_ram2[0]; else ramPtr = &cart_ram1[0];
@@ -1128,6 +2252,11 @@ void emulate_SIC() {
 				}
 			}
 		}
+		else {
+			// idle cycle - erasing and saving in the phi2 low phase
+			while (CONTROL_IN & PHI2) ;
+			flashMode = flash_step();
+		}
 	}
 }
 
@@ -1144,10 +2273,12 @@ void emulate_SDX(int size) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)(*(ramPtr+addr)))<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 		}
 		else if (!(c & CCTL)) {
 			// CCTL low
 			addr = ADDR_IN;
+			TRACE_BUS(addr, 0, c);
 			if ((addr & 0xF0) == 0xE0) {
 				// 64k & 128k versions
 				if (size == 64) ramPtr = &cart_ram1[0]; else ramPtr = &cart_ram2[0];
@@ -1193,10 +2324,12 @@ void emulate_diamond_express(uint8_t cctlAddr) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)(*(ramPtr+addr)))<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 		}
 		else if (!(c & CCTL)) {
 			// CCTL low
 			addr = ADDR_IN;
+			TRACE_BUS(addr, 0, c);
 			if ((addr & 0xF0) == cctlAddr) {
 				ramPtr = &cart_ram1[0] + ((~addr) & 0x7) * 8192;
 				if (addr & 0x8) {
@@ -1229,14 +2362,18 @@ void emulate_blizzard() {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)cart_ram1[addr])<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 		}
 		else if (!(c & S5)) {
 			SET_DATA_MODE_OUT
 			addr = ADDR_IN;
 			DATA_OUT = ((uint16_t)cart_ram1[0x2000|addr])<<8;
+			TRACE_BUS(addr, DATA_OUT >> 8, c);
 		}
 		else if (!(c & CCTL)) {
 			// CCTL
+			TRACE_ADDR(addr);
+			TRACE_BUS(addr, 0, c);
 			RD4_LOW
 			RD5_LOW
 			GREEN_LED_OFF
@@ -1265,6 +2402,7 @@ void feed_XEX_loader(void) {
 				SET_DATA_MODE_OUT
 				addr = ADDR_IN & 0xFF;
 				DATA_OUT = ((uint16_t)ramPtr[addr&0xFF])<<8;
+				TRACE_BUS(addr, DATA_OUT >> 8, c);
 				GREEN_LED_ON
 			}
 			else {
@@ -1273,6 +2411,7 @@ void feed_XEX_loader(void) {
 				data = DATA_IN;
 				while (CONTROL_IN & PHI2)
 					data = DATA_IN;
+				TRACE_BUS(addr, data >> 8, c);
 				if (addr == 0)
 					bank = (bank&0xFF00) | (data>>8);
 				else if (addr == 1)
@@ -1329,6 +2468,11 @@ void emulate_cartridge(int cartType) {
 }
 
 int main(void) {
+	/* Cycle counter for boot timing */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
 	/* Ouptut: LEDS - PB{0..1}, RD5 - PB2, RD4 - PB4 */
 	config_gpio_leds_RD45();
 	/* InOut: Data - PE{8..15} */
@@ -1350,12 +2494,27 @@ int main(void) {
 		int cmd = emulate_boot_rom(atrMode);
 
 		GREEN_LED_ON
+		// reading the stats shouldn't change them
+		if (cmd != CART_CMD_STATS)
+			stat_cmd_begin(cmd);
+		// a folder or file being read ahead is only kept while the menu is idle,
+		// and a file that has been until something else may use cart_ram2, as
+		// listing a .ZIP does for its index
+		if (cmd != CART_CMD_CURSOR_HINT && cmd != CART_CMD_GET_DIR_ENTRY
+				&& cmd != CART_CMD_META_SCAN && cmd != CART_CMD_STATS) {
+			dir_hint_cancel();
+			preload_cancel();
+			if (cmd != CART_CMD_OPEN_ITEM && cmd != CART_CMD_UP_DIR && cmd != CART_CMD_BOOT_TIMES
+					&& (cmd != CART_CMD_READ_CUR_DIR || zip_split(curPath)))
+				preload_forget();
+		}
 
 		// OPEN ITEM n
 		if (cmd == CART_CMD_OPEN_ITEM)
 		{
 			int n = cart_d5xx[0x00];
 			DIR_ENTRY *entry = (DIR_ENTRY *)&cart_ram1[0];
+			dirc_shown_cursor(n);	// for coming back to this directory
 			if (entry[n].isDir)
 			{	// directory
 				strcat(curPath, "/");
@@ -1364,20 +2523,40 @@ int main(void) {
 			}
 			else
 			{	// file/search result
+				dirc_show(NULL);	// cart_ram1 may be loaded over
 				if (entry[n].full_path[0])
 					strcpy(path, entry[n].full_path);	// search result
 				else
 					strcpy(path, curPath); // file in current directory
 				strcat(path, "/");
 				strcat(path, entry[n].filename);
-				if (stricmp(get_filename_ext(entry[n].filename), "ATR")==0)
+				if (entry[n].metaStatus != META_UNKNOWN && entry[n].metaStatus != META_OK
+						&& entry[n].metaStatus != META_READ_ERROR)
+				{	// already known not to load
+					cart_d5xx[0x01] = 4;	// error
+					strcpy((char*)&cart_d5xx[0x02], meta_status_text(entry[n].metaStatus));
+				}
+				else if (file_kind(entry[n].filename) == FILE_KIND_ATR)
 				{	// ATR
 					cart_d5xx[0x01] = 3;	// ATR
 					cartType = CART_TYPE_ATR;
 				}
+				else if (file_kind(entry[n].filename) == FILE_KIND_CAS)
+				{	// CAS, also needs the soft OS
+					cart_d5xx[0x01] = 3;
+					cartType = CART_TYPE_CAS;
+				}
 				else
 				{	// ROM,CAR or XEX
-					cartType = load_file(path);
+					FILE_META meta = {0};
+					meta.nameHash = entry[n].nameHash;
+					meta.size = entry[n].size;
+					meta.fdate = entry[n].fdate;
+					meta.ftime = entry[n].ftime;
+					meta_scan_abort();	// we need the CRC unit
+					if (entry[n].metaStatus != META_OK || !meta_open() || !meta_lookup(&meta))
+						meta.status = META_UNKNOWN;
+					cartType = load_file(path, &meta);
 					if (cartType)
 						cart_d5xx[0x01] = (cartType != CART_TYPE_XEX ? 1 : 2);	// file was loaded
 					else
@@ -1388,18 +2567,29 @@ int main(void) {
 				}
 			}
 		}
-		// READ DIR
+		// READ DIR - returns $D502 = entries, $D503 = the item to put the cursor on
 		else if (cmd == CART_CMD_READ_CUR_DIR)
 		{
-			int ret = read_directory(curPath);
+			int cursor;
+			meta_scan_reset();
+			int ret = list_directory(curPath, &cursor);
 			if (ret) {
 				cart_d5xx[0x01] = 0;	// ok
 				cart_d5xx[0x02] = num_dir_entries;
+				cart_d5xx[0x03] = cursor;
+				if (!boot_times.first_dir) boot_times.first_dir = DWT->CYCCNT;
 			}
 			else
 			{
 				cart_d5xx[0x01] = 1;	// error
 				strcpy((char*)&cart_d5xx[0x02], errorBuf);
+				// the menu reads the directory again after the message, so
+				// leave a ZIP that can't be read for the folder it's in
+				int len = zip_split(curPath);
+				if (len) {
+					while (len && curPath[--len] != '/');
+					curPath[len] = 0;
+				}
 			}
 		}
 		// GET DIR ENTRY n
@@ -1409,6 +2599,9 @@ int main(void) {
 			DIR_ENTRY *entry = (DIR_ENTRY *)&cart_ram1[0];
 			cart_d5xx[0x01] = entry[n].isDir;
 			strcpy((char*)&cart_d5xx[0x02], entry[n].long_filename);
+			// type tag, once the metadata scan has got to it
+			strcpy((char*)&cart_d5xx[0x22], entry[n].isDir ? "    " :
+					cart_type_tag(entry[n].cartType, entry[n].metaStatus));
 		}
 		// UP A DIRECTORY LEVEL
 		else if (cmd == CART_CMD_UP_DIR)
@@ -1419,12 +2612,24 @@ int main(void) {
 		}
 		// ROOT DIR (when atari reset pressed)
 		else if (cmd == CART_CMD_ROOT_DIR)
+		{
 			curPath[0] = 0;
+			meta_scan_reset();
+			dirc_flush();
+			zip_forget();
+			incSearch.len = incSearch.numCands = 0;
+			hdev_close_all();
+			cas_unmount();	// the indexes are in cart_ram1
+			unmount_atr();
+			doneFatFsInit = 0;	// card may have been swapped, so mount it again
+		}
 		// SEARCH str
 		else if (cmd == CART_CMD_SEARCH)
 		{
 			char searchStr[32];
 			strcpy(searchStr, (char*)&cart_d5xx[0x00]);
+			meta_scan_reset();
+			dirc_show(NULL);
 			int ret = search_directory(curPath, searchStr);
 			if (ret) {
 				cart_d5xx[0x01] = 0;	// ok
@@ -1436,9 +2641,61 @@ int main(void) {
 				strcpy((char*)&cart_d5xx[0x02], errorBuf);
 			}
 		}
+		// SEARCH KEY - incremental search, $D500 = key, $D501 = max results
+		else if (cmd == CART_CMD_SEARCH_KEY)
+		{
+			uint8_t key = cart_d5xx[0x00];
+			int maxResults = cart_d5xx[0x01];
+			meta_scan_reset();
+			dirc_show(NULL);
+			if (search_key(curPath, key, maxResults)) {
+				cart_d5xx[0x01] = 0;	// ok
+				cart_d5xx[0x02] = num_dir_entries;
+				cart_d5xx[0x03] = incSearch.total & 0xFF;	// matches in all
+				cart_d5xx[0x04] = incSearch.total >> 8;
+			}
+			else
+			{
+				cart_d5xx[0x01] = 1;	// error
+				strcpy((char*)&cart_d5xx[0x02], errorBuf);
+			}
+		}
+		// BOOT TIMES - microseconds from reset to card ready, mounted & first directory
+		else if (cmd == CART_CMD_BOOT_TIMES)
+		{
+			uint32_t t[3] = { boot_times.card_ready, boot_times.mounted, boot_times.first_dir };
+			for (int i=0; i<3; i++)
+				t[i] /= (SystemCoreClock / 1000000);
+			memcpy(&cart_d5xx[0x02], t, sizeof(t));
+			cart_d5xx[0x01] = 0;
+		}
+		// META SCAN - work through the directory for ~20ms, starting at item n
+		else if (cmd == CART_CMD_META_SCAN)
+		{
+			int updated;
+			int done = meta_scan_step(curPath, cart_d5xx[0x00], SystemCoreClock / 50, &updated);
+			cart_d5xx[0x01] = updated > 255 ? 255 : updated;
+			cart_d5xx[0x02] = done;
+		}
+		// CURSOR HINT - the menu's cursor has rested on item n. A folder there is
+		// read into the directory cache, a file into cart_ram2 for OPEN ITEM,
+		// ~20ms at a time. $D501 = 1 when done
+		else if (cmd == CART_CMD_CURSOR_HINT)
+		{
+			int n = cart_d5xx[0x00];
+			DIR_ENTRY *entry = (DIR_ENTRY *)&cart_ram1[0];
+			if (n < num_dir_entries && !entry[n].isDir) {
+				dir_hint_cancel();
+				cart_d5xx[0x01] = preload_step(curPath, n, SystemCoreClock / 50);
+			}
+			else {
+				preload_cancel();
+				cart_d5xx[0x01] = dir_hint_step(curPath, n, SystemCoreClock / 50);
+			}
+		}
 		else if (cmd == CART_CMD_LOAD_SOFT_OS)
 		{
-			int ret = load_file("UNO_OS.ROM");
+			int ret = load_file("UNO_OS.ROM", NULL);
 			if (!ret) {
 				for (int i=0; i<16384; i++)
 					cart_ram1[i] = os_rom[i];
@@ -1473,31 +2730,238 @@ int main(void) {
 		else if (cmd == CART_CMD_ATR_HEADER)
 		{
 			//uint8_t device = cart_d5xx[0x00];
-			if (!&mountedATRs[0].path[0])
+			if (!mountedATRs[0].path[0])
 				cart_d5xx[0x01] = 1;
 			else
 			{
 				memcpy(&cart_d5xx[0x02], &mountedATRs[0].atrHeader, 16);
+				cart_d5xx[0x12] = mountedATRs[0].status;
+				memcpy(&cart_d5xx[0x13], mountedATRs[0].percom, PERCOM_SIZE);
 				cart_d5xx[0x01] = 0;
 			}
 		}
+		// ATR SET PERCOM - the PERCOM block at $D504. The image can't change
+		// shape, so this only works if the sector size is the same
+		else if (cmd == CART_CMD_ATR_SET_PERCOM)
+		{
+			MountedATR *mountedATR = &mountedATRs[0];
+			if (!mountedATR->path[0])
+				cart_d5xx[0x01] = 1;
+			else if (((cart_d5xx[0x04 + 6] << 8) | cart_d5xx[0x04 + 7]) != mountedATR->atrHeader.secSize)
+				cart_d5xx[0x01] = 2;
+			else
+				cart_d5xx[0x01] = 0;
+		}
+		// ATR DELTA - $D500 = 0 query, 1 merge the changes into the ATR, 2 discard
+		// them. Returns $D502-3 = pages changed, $D504 = overlay in use
+		else if (cmd == CART_CMD_ATR_DELTA)
+		{
+			MountedATR *mountedATR = &mountedATRs[0];
+			int ret = 0;
+			if (!mountedATR->path[0])
+				ret = 1;
+			else if (cart_d5xx[0x00] == 1 && atrd_active())
+				ret = atrd_merge(&mountedATR->fil);
+			else if (cart_d5xx[0x00] == 2 && atrd_active())
+				ret = atrd_discard();
+			cart_d5xx[0x01] = ret;
+			cart_d5xx[0x02] = atrd_num_pages() & 0xFF;
+			cart_d5xx[0x03] = atrd_num_pages() >> 8;
+			cart_d5xx[0x04] = atrd_active();
+		}
+		// OVERLAY MODE - $D500 = 0 off, 1 on, $FF query. Used at the next mount
+		else if (cmd == CART_CMD_OVERLAY_MODE)
+		{
+			if (cart_d5xx[0x00] != 0xFF)
+				atrOverlay = cart_d5xx[0x00] ? 1 : 0;
+			cart_d5xx[0x01] = 0;
+			cart_d5xx[0x02] = atrOverlay;
+		}
+		// CAS STATUS - $D500 = 1 to rewind. Returns 1 if no tape, $D502 = boot tape,
+		// $D503-4 = number of records, $D505-6 = next record
+		else if (cmd == CART_CMD_CAS_STATUS)
+		{
+			if (cart_d5xx[0x00])
+				cas_rewind();
+			cart_d5xx[0x01] = cas_mounted() ? CAS_OK : CAS_NO_TAPE;
+			cart_d5xx[0x02] = cas_is_boot_tape();
+			cart_d5xx[0x03] = cas_num_records() & 0xFF;
+			cart_d5xx[0x04] = cas_num_records() >> 8;
+			cart_d5xx[0x05] = cas_position() & 0xFF;
+			cart_d5xx[0x06] = cas_position() >> 8;
+		}
+		// CAS READ RECORD - the next record, length in $D502 and the data from $D503
+		else if (cmd == CART_CMD_CAS_READ_RECORD)
+		{
+			int len;
+			cart_d5xx[0x01] = cas_read_record(&cart_d5xx[0x03], 0xDF - 0x03, &len);
+			cart_d5xx[0x02] = len;
+		}
+		// TRACE - $D500 = mode (TRACE_xxx) for the next cart or ATR started, with
+		// the trigger address in $D501 (the seconds, for hot spots), or $FF to
+		// query. Returns $D502 = mode, status 1 if the firmware was built without tracing
+		else if (cmd == CART_CMD_TRACE)
+		{
+			int ret = 0;
+			if (cart_d5xx[0x00] == TRACE_DUMP)
+				ret = trace_dump();
+			else if (cart_d5xx[0x00] != 0xFF)
+				ret = trace_arm(cart_d5xx[0x00], cart_d5xx[0x01]);
+			cart_d5xx[0x01] = ret;
+			cart_d5xx[0x02] = trace_armed();
+		}
+		// STATS - command latencies, $D500 = what:
+		//   0 line $D501 of the menu's stats screen, at $D502. Status 1 if there isn't one
+		//   1/2 command/phase $D501, $D502 count, $D506 min, $D50A avg, $D50E max in us
+		//   3 reset, 4 CSV log $D501 = 0 off, 1 on, $FF query. Returns $D502 = log on
+		else if (cmd == CART_CMD_STATS)
+		{
+			uint8_t what = cart_d5xx[0x00], n = cart_d5xx[0x01];
+			cart_d5xx[0x01] = 0;
+			if (what == 0) {
+				if (!stat_line(n, (char*)&cart_d5xx[0x02]))
+					cart_d5xx[0x01] = 1;
+			}
+			else if (what == 1 || what == 2) {
+				const STAT_ENTRY *e = what == 1 ? stat_cmd_entry(n) : stat_phase_entry(n);
+				uint32_t v[4] = {0};
+				if (e) {
+					uint32_t div = SystemCoreClock / 1000000;
+					v[0] = e->count;
+					v[1] = e->min / div;
+					v[2] = (uint32_t)(e->total / e->count) / div;
+					v[3] = e->max / div;
+				}
+				else
+					cart_d5xx[0x01] = 1;
+				memcpy(&cart_d5xx[0x02], v, sizeof(v));
+			}
+			else if (what == 3) {
+				stat_reset();
+				stack_paint();
+			}
+			else if (what == 4) {
+				if (n != 0xFF)
+					stat_log(n);
+				cart_d5xx[0x02] = stat_logging();
+			}
+		}
+		// SD TEST - $D500 = 1 to run the card self-test (a few seconds), status
+		// SDTEST_xxx. $D500 = 0 for line $D501 of the results at $D502, status
+		// 1 if there isn't one
+		else if (cmd == CART_CMD_SD_TEST)
+		{
+			if (cart_d5xx[0x00] == 1) {
+				cart_d5xx[0x01] = mount_sd() ? sdtest_run(&cart_ram2[0]) : SDTEST_NO_CARD;
+				incSearch.len = incSearch.numCands = 0;	// its candidates were in cart_ram2
+				zip_forget();
+			}
+			else
+				cart_d5xx[0x01] = !sdtest_line(cart_d5xx[0x01], (char*)&cart_d5xx[0x02]);
+		}
+		// PROFILE - $D500 = 1 start sampling, 0 stop and write UNOPROF.BIN, $FF
+		// query. Returns $D502 = running, $D503 = samples (4 bytes), status 1 if
+		// the firmware was built without the profiler or the file can't be written
+		else if (cmd == CART_CMD_PROFILE)
+		{
+			int ret = 0;
+			if (cart_d5xx[0x00] == 1)
+				ret = prof_start();
+			else if (cart_d5xx[0x00] == 0)
+				ret = prof_dump();
+			uint32_t samples = prof_samples();
+			cart_d5xx[0x01] = ret;
+			cart_d5xx[0x02] = prof_running();
+			memcpy(&cart_d5xx[0x03], &samples, 4);
+		}
+		// FP MODE - $D500 = 0 off, 1 on, $FF query
+		else if (cmd == CART_CMD_FP_MODE)
+		{
+			if (cart_d5xx[0x00] != 0xFF)
+				fpOffload = cart_d5xx[0x00] ? 1 : 0;
+			cart_d5xx[0x01] = 0;
+			cart_d5xx[0x02] = fpOffload;
+		}
+		// FP MUL/DIV - page zero $D4-$EC at $D500, FLPTR at $D519
+		else if (cmd == CART_CMD_FP_MUL || cmd == CART_CMD_FP_DIV)
+		{
+			FP_STATE state;
+			memcpy(&state, &cart_d5xx[0x00], FP_ZP_SIZE + 2);
+			int ret = fp_op(cmd == CART_CMD_FP_MUL ? FP_OP_MUL : FP_OP_DIV, &state);
+			if (ret < 0)
+				cart_d5xx[0x01] = 2;	// over to the 6502
+			else {
+				memcpy(&cart_d5xx[0x02], &state, sizeof(state));
+				cart_d5xx[0x01] = ret;	// 1 = error (carry)
+			}
+		}
+		// H: OPEN - $D500 = IOCB, $D501 = AUX1, filespec from $D508
+		else if (cmd == CART_CMD_H_OPEN)
+		{
+			atr_dir(pathBuf);
+			cart_d5xx[0x01] = mount_sd() ? hdev_open(cart_d5xx[0x00], cart_d5xx[0x01], pathBuf, &cart_d5xx[0x08]) : H_FATAL;
+		}
+		// H: CLOSE - $D500 = IOCB
+		else if (cmd == CART_CMD_H_CLOSE)
+			cart_d5xx[0x01] = hdev_close(cart_d5xx[0x00]);
+		// H: READ - $D500 = IOCB, $D501 = bytes wanted, returns the count in $D502 and the data from $D503
+		else if (cmd == CART_CMD_H_READ)
+		{
+			int len = cart_d5xx[0x01], got;
+			cart_d5xx[0x01] = hdev_read(cart_d5xx[0x00], &cart_d5xx[0x03], len > H_BLOCK ? H_BLOCK : len, &got);
+			cart_d5xx[0x02] = got;
+		}
+		// H: WRITE - $D500 = IOCB, $D501 = byte count, data from $D503, returns the count written in $D502
+		else if (cmd == CART_CMD_H_WRITE)
+		{
+			int len = cart_d5xx[0x01], put;
+			GREEN_LED_OFF
+			RED_LED_ON
+			cart_d5xx[0x01] = hdev_write(cart_d5xx[0x00], &cart_d5xx[0x03], len > H_BLOCK ? H_BLOCK : len, &put);
+			cart_d5xx[0x02] = put;
+			RED_LED_OFF
+		}
+		// H: XIO - $D500 = IOCB, $D501 = command, $D502-$D504 = position, filespec from $D508
+		else if (cmd == CART_CMD_H_SPECIAL)
+		{
+			uint32_t pos = cart_d5xx[0x02] | (cart_d5xx[0x03] << 8) | (cart_d5xx[0x04] << 16);
+			atr_dir(pathBuf);
+			cart_d5xx[0x01] = hdev_special(cart_d5xx[0x00], cart_d5xx[0x01], &pos, pathBuf, &cart_d5xx[0x08]);
+			cart_d5xx[0x02] = pos & 0xFF;
+			cart_d5xx[0x03] = (pos >> 8) & 0xFF;
+			cart_d5xx[0x04] = (pos >> 16) & 0xFF;
+		}
 		// NO CART
 		else if (cmd == CART_CMD_NO_CART)
 			cartType = 0;
 		// REBOOT TO CART
 		else if (cmd == CART_CMD_ACTIVATE_CART)
 		{
+			trace_start(cartType);
 			if (cartType == CART_TYPE_ATR) {
 				atrMode = 1;
 				RED_LED_OFF
+				cas_unmount();
 				int ret = mount_atr(path);
 				if (ret == 0)
 					memcpy(&cart_d5xx[0x02], &mountedATRs[0].atrHeader, 16);
 				cart_d5xx[0x01] = ret;
 			}
-			else
+			else if (cartType == CART_TYPE_CAS) {
+				// D1: goes to the SIO bus, the soft OS is already in the Atari so
+				// cart_ram1 can hold the index
+				atrMode = 1;
+				RED_LED_OFF
+				unmount_atr();
+				cart_d5xx[0x01] = mount_sd() ? cas_mount(path, (CAS_RECORD *)&cart_ram1[0],
+						sizeof(cart_ram1) / sizeof(CAS_RECORD)) : CAS_NO_TAPE;
+			}
+			else {
+				stat_log_flush();
 				emulate_cartridge(cartType);
+			}
 		}
+		stat_cmd_end();
 	}
 
 }
@@ -50,7 +50,7 @@ unsigned const char os_rom[] = {
   0x98, 0xac, 0x2d, 0x02, 0xee, 0x0a, 0xd4, 0x99, 0x16, 0x02, 0x8a, 0x99,
   0x17, 0x02, 0x28, 0x60, 0xa9, 0x40, 0x8d, 0x0e, 0xd4, 0xad, 0x13, 0xd0,
   0x8d, 0xfa, 0x03, 0x60, 0x2c, 0x0f, 0xd4, 0x10, 0x03, 0x6c, 0x00, 0x02,
-  0x48, 0xd8, 0x8a, 0x48, 0x98, 0x48, 0x8d, 0x0f, 0xd4, 0x20, 0x8f, 0xf3,
+  0x48, 0xd8, 0x8a, 0x48, 0x98, 0x48, 0x8d, 0x0f, 0xd4, 0x20, 0xd7, 0xc9,
   0x6c, 0x22, 0x02, 0xd8, 0x6c, 0x16, 0x02, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xff, 0xff, 0x4c, 0x3c, 0xc1, 0xa9, 0xbd, 0x8d, 0x38, 0x02, 0xa9, 0xc2,
@@ -140,81 +140,81 @@ unsigned const char os_rom[] = {
   0x01, 0x60, 0xca, 0xf0, 0xf7, 0x18, 0xad, 0xc9, 0x02, 0x6d, 0xd1, 0x02,
   0x8d, 0xc9, 0x02, 0xad, 0xca, 0x02, 0x6d, 0xd2, 0x02, 0x8d, 0xca, 0x02,
   0x4c, 0x74, 0xc6, 0x20, 0x9b, 0xc6, 0x90, 0x02, 0x68, 0x68, 0x60, 0x6c,
-  0xcf, 0x02, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xcf, 0x02, 0xa9, 0xff, 0x8d, 0x00, 0xd5, 0xa0, 0x30, 0x20, 0xbc, 0xc9,
+  0x30, 0x21, 0xad, 0x02, 0xd5, 0xf0, 0x1c, 0xa9, 0x4c, 0x8d, 0xdb, 0xda,
+  0x8d, 0x28, 0xdb, 0xa9, 0xcc, 0x8d, 0xdc, 0xda, 0xa9, 0xc6, 0x8d, 0xdd,
+  0xda, 0xa9, 0xe1, 0x8d, 0x29, 0xdb, 0xa9, 0xc6, 0x8d, 0x2a, 0xdb, 0x60,
+  0xa5, 0xd4, 0xf0, 0x0f, 0xa0, 0x31, 0x20, 0xfc, 0xc6, 0x4a, 0xd0, 0x04,
+  0xad, 0x1d, 0xd5, 0x60, 0x4c, 0xdf, 0xda, 0x18, 0x60, 0xa5, 0xd4, 0xf0,
+  0x13, 0xa5, 0xe0, 0xf0, 0x11, 0xa0, 0x32, 0x20, 0xfc, 0xc6, 0x4a, 0xd0,
+  0x04, 0xad, 0x1d, 0xd5, 0x60, 0x4c, 0x2c, 0xdb, 0x18, 0x60, 0x38, 0x60,
+  0xa2, 0x18, 0xb5, 0xd4, 0x9d, 0x00, 0xd5, 0xca, 0x10, 0xf8, 0xa5, 0xfc,
+  0x8d, 0x19, 0xd5, 0xa5, 0xfd, 0x8d, 0x1a, 0xd5, 0x8c, 0xdf, 0xd5, 0x20,
+  0xa9, 0xc9, 0xa9, 0x02, 0xb0, 0x24, 0xad, 0x01, 0xd5, 0xc9, 0x02, 0xb0,
+  0x1d, 0xa2, 0x18, 0xbd, 0x02, 0xd5, 0x95, 0xd4, 0xca, 0x10, 0xf8, 0xad,
+  0x1b, 0xd5, 0x85, 0xfc, 0xad, 0x1c, 0xd5, 0x85, 0xfd, 0xae, 0x1e, 0xd5,
+  0xac, 0x1f, 0xd5, 0xad, 0x01, 0xd5, 0x60, 0x57, 0xc7, 0x64, 0xc7, 0x6c,
+  0xc7, 0xa3, 0xc7, 0x69, 0xc7, 0xdb, 0xc7, 0x4c, 0x6a, 0xc7, 0x00, 0xa2,
+  0x48, 0xa9, 0xc7, 0xa0, 0x3f, 0x4c, 0x61, 0xc3, 0xa5, 0x2a, 0x8d, 0x01,
+  0xd5, 0x20, 0x84, 0xc8, 0xa0, 0x40, 0x4c, 0x43, 0xc8, 0xa0, 0x41, 0x4c,
+  0x43, 0xc8, 0xa0, 0x01, 0x60, 0xa5, 0x22, 0x29, 0xfe, 0xc9, 0x06, 0xd0,
+  0x04, 0x20, 0x5c, 0xc8, 0x2c, 0xa9, 0x01, 0x8d, 0x01, 0xd5, 0xa0, 0x42,
+  0x20, 0x43, 0xc8, 0x30, 0x1e, 0xac, 0x02, 0xd5, 0x88, 0xf0, 0x10, 0x88,
+  0xb9, 0x03, 0xd5, 0x91, 0x24, 0x98, 0xd0, 0xf7, 0xae, 0x02, 0xd5, 0xca,
+  0x20, 0x6c, 0xc8, 0xac, 0x02, 0xd5, 0xb9, 0x02, 0xd5, 0xa0, 0x01, 0x60,
+  0x8d, 0x03, 0xd5, 0xa5, 0x22, 0x29, 0xfe, 0xc9, 0x0a, 0xd0, 0x04, 0x20,
+  0x5c, 0xc8, 0x2c, 0xa9, 0x01, 0x8d, 0x01, 0xd5, 0xa8, 0x88, 0xf0, 0x08,
+  0xb1, 0x24, 0x99, 0x03, 0xd5, 0x88, 0xd0, 0xf8, 0xa0, 0x43, 0x20, 0x43,
+  0xc8, 0x30, 0x10, 0xae, 0x02, 0xd5, 0xca, 0xf0, 0x0a, 0x20, 0x6c, 0xc8,
+  0xa0, 0x00, 0xb1, 0x24, 0x85, 0x2f, 0xc8, 0x60, 0xa5, 0x22, 0xc9, 0x30,
+  0xf0, 0x3e, 0xbd, 0x4c, 0x03, 0x8d, 0x02, 0xd5, 0xbd, 0x4d, 0x03, 0x8d,
+  0x03, 0xd5, 0xbd, 0x4e, 0x03, 0x8d, 0x04, 0xd5, 0xa4, 0x22, 0x8c, 0x01,
+  0xd5, 0xc0, 0x25, 0x90, 0x04, 0xc0, 0x27, 0x90, 0x03, 0x20, 0x84, 0xc8,
+  0xa0, 0x44, 0x20, 0x43, 0xc8, 0x30, 0x14, 0xa6, 0x2e, 0xad, 0x02, 0xd5,
+  0x9d, 0x4c, 0x03, 0xad, 0x03, 0xd5, 0x9d, 0x4d, 0x03, 0xad, 0x04, 0xd5,
+  0x9d, 0x4e, 0x03, 0x60, 0xa5, 0x2a, 0x8d, 0x00, 0xd5, 0xa0, 0x25, 0x20,
+  0xbc, 0xc9, 0x30, 0x16, 0xa6, 0x2e, 0xad, 0x02, 0xd5, 0x9d, 0x4c, 0x03,
+  0xad, 0x03, 0xd5, 0x9d, 0x4d, 0x03, 0xad, 0x04, 0xd5, 0x9d, 0x4e, 0x03,
+  0xa0, 0x01, 0x60, 0x8a, 0x4a, 0x4a, 0x4a, 0x4a, 0x8d, 0x00, 0xd5, 0x8c,
+  0xdf, 0xd5, 0x20, 0xa9, 0xc9, 0xa0, 0x8a, 0xb0, 0x06, 0xac, 0x01, 0xd5,
+  0xd0, 0x01, 0xc8, 0x60, 0xa5, 0x29, 0xd0, 0x06, 0xa5, 0x28, 0xf0, 0x05,
+  0x10, 0x05, 0xa9, 0x80, 0x60, 0xa9, 0x01, 0x60, 0x86, 0x2f, 0x8a, 0x18,
+  0x65, 0x24, 0x85, 0x24, 0x90, 0x02, 0xe6, 0x25, 0xa5, 0x28, 0x38, 0xe5,
+  0x2f, 0x85, 0x28, 0xb0, 0x02, 0xc6, 0x29, 0x60, 0xa0, 0x00, 0xb1, 0x24,
+  0x99, 0x08, 0xd5, 0xc9, 0x9b, 0xf0, 0x05, 0xc8, 0xc0, 0x40, 0xd0, 0xf2,
+  0x60, 0xad, 0x04, 0x03, 0x85, 0x32, 0xad, 0x05, 0x03, 0x85, 0x33, 0xad,
+  0x00, 0x03, 0x29, 0x70, 0xc9, 0x30, 0xf0, 0x0d, 0xc9, 0x60, 0xd0, 0x32,
+  0xad, 0x02, 0x03, 0xc9, 0x52, 0xf0, 0x72, 0xd0, 0x29, 0xad, 0x01, 0x03,
+  0xc9, 0x01, 0xd0, 0x22, 0x20, 0xba, 0xc9, 0x30, 0x1d, 0xad, 0x02, 0x03,
+  0xc9, 0x52, 0xf0, 0x21, 0xc9, 0x57, 0xf0, 0x14, 0xc9, 0x50, 0xf0, 0x10,
+  0xc9, 0x53, 0xf0, 0x31, 0xc9, 0x4e, 0xf0, 0x3f, 0xc9, 0x4f, 0xf0, 0x04,
+  0xd0, 0x45, 0x18, 0x60, 0x2c, 0x03, 0x03, 0x70, 0x3e, 0x10, 0x3c, 0x30,
+  0x07, 0x2c, 0x03, 0x03, 0x50, 0x35, 0x30, 0x33, 0xad, 0x08, 0x03, 0x0a,
+  0xad, 0x09, 0x03, 0x2a, 0x85, 0x34, 0xa2, 0x00, 0x2c, 0x03, 0x03, 0x30,
+  0x4b, 0xa0, 0x21, 0xd0, 0x5c, 0xa0, 0x03, 0xb9, 0xa5, 0xc9, 0x91, 0x32,
+  0x88, 0xd0, 0xf8, 0xad, 0x12, 0xd5, 0x91, 0x32, 0xc8, 0x38, 0x60, 0xa0,
+  0x0b, 0xb9, 0x13, 0xd5, 0x91, 0x32, 0x88, 0x10, 0xf8, 0x30, 0x74, 0x38,
+  0x60, 0xa0, 0x29, 0x8c, 0xdf, 0xd5, 0x20, 0xa9, 0xc9, 0xa0, 0x8a, 0xb0,
+  0xf2, 0xad, 0x01, 0xd5, 0xf0, 0x06, 0xc9, 0x01, 0xf0, 0xa4, 0xd0, 0xe7,
+  0xac, 0x08, 0x03, 0xf0, 0x56, 0x88, 0xb9, 0x03, 0xd5, 0x91, 0x32, 0x98,
+  0xd0, 0xf7, 0xf0, 0x4b, 0xa0, 0x00, 0xb1, 0x32, 0x99, 0x04, 0xd5, 0xc8,
+  0x10, 0xf8, 0xa0, 0x22, 0xad, 0x02, 0x03, 0xc9, 0x4f, 0xd0, 0x02, 0xa0,
+  0x24, 0xad, 0x0a, 0x03, 0x8d, 0x01, 0xd5, 0xad, 0x0b, 0x03, 0x8d, 0x02,
+  0xd5, 0x8e, 0x03, 0xd5, 0x20, 0xbc, 0xc9, 0x30, 0xae, 0x2c, 0x03, 0x03,
+  0x30, 0x0a, 0xa0, 0x00, 0xb9, 0x02, 0xd5, 0x91, 0x32, 0xc8, 0x10, 0xf8,
+  0xe8, 0xe4, 0x34, 0xb0, 0x0e, 0xa5, 0x32, 0x18, 0x69, 0x80, 0x85, 0x32,
+  0x90, 0x02, 0xe6, 0x33, 0x4c, 0xfc, 0xc8, 0xad, 0x04, 0x03, 0x85, 0x32,
+  0xad, 0x05, 0x03, 0x85, 0x33, 0xa0, 0x01, 0x38, 0x60, 0x30, 0xff, 0xe0,
+  0x00, 0xa4, 0x14, 0x88, 0xad, 0x00, 0xd5, 0xc9, 0x11, 0xf0, 0x05, 0xc4,
+  0x14, 0xd0, 0xf5, 0x60, 0x18, 0x60, 0xa0, 0x23, 0x8c, 0xdf, 0xd5, 0x20,
+  0xa9, 0xc9, 0xb0, 0x06, 0xac, 0x01, 0xd5, 0xd0, 0x04, 0x60, 0xa0, 0x8a,
+  0x60, 0xc0, 0x04, 0xd0, 0x03, 0xa0, 0xa2, 0x60, 0xa0, 0x8b, 0x60, 0xa5,
+  0x0c, 0xa6, 0x0d, 0xc9, 0x60, 0xd0, 0x04, 0xe0, 0x01, 0xf0, 0x0e, 0x8d,
+  0x61, 0x01, 0x8e, 0x62, 0x01, 0xa9, 0x60, 0x85, 0x0c, 0xa9, 0x01, 0x85,
+  0x0d, 0x60, 0xe0, 0x01, 0xd0, 0x0d, 0xa0, 0x28, 0xa9, 0x00, 0x8d, 0x00,
+  0xd5, 0x20, 0xbc, 0xc9, 0xd0, 0x01, 0x60, 0x4c, 0x4c, 0xee, 0xa5, 0x08,
+  0xd0, 0x14, 0xa0, 0x28, 0xa9, 0x01, 0x8d, 0x00, 0xd5, 0x20, 0xbc, 0xc9,
+  0xd0, 0x08, 0xad, 0x02, 0xd5, 0xf0, 0x03, 0x8c, 0xe9, 0x03, 0x60, 0xff,
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
@@ -852,7 +852,7 @@ unsigned const char os_rom[] = {
   0x20, 0xd5, 0xe6, 0x4c, 0xe0, 0xe7, 0xa0, 0x82, 0x08, 0xa5, 0x2f, 0xa6,
   0x2e, 0x28, 0x60, 0xa9, 0x03, 0x8d, 0x0f, 0xd2, 0x8d, 0x32, 0x02, 0x85,
   0x41, 0x60, 0xa9, 0x01, 0x8d, 0xbd, 0x02, 0x85, 0x42, 0x20, 0xe1, 0xc2,
-  0x90, 0x03, 0x4c, 0xe2, 0xe8, 0x20, 0xa9, 0xf2, 0x90, 0x03, 0x4c, 0xe2,
+  0x90, 0x03, 0x4c, 0xe2, 0xe8, 0x20, 0x95, 0xc8, 0x90, 0x03, 0x4c, 0xe2,
   0xe8, 0xba, 0x8e, 0x18, 0x03, 0x20, 0x08, 0xe9, 0xa2, 0x00, 0xad, 0x00,
   0x03, 0xc9, 0x60, 0xd0, 0x01, 0xca, 0x8e, 0x0f, 0x03, 0x20, 0x5b, 0xe9,
   0x2c, 0x0f, 0x03, 0x10, 0x03, 0x4c, 0xd3, 0xea, 0xa9, 0x0d, 0x8d, 0x9c,
@@ -966,7 +966,7 @@ unsigned const char os_rom[] = {
   0x10, 0x05, 0x06, 0x3d, 0x20, 0x72, 0xee, 0x20, 0x72, 0xee, 0x20, 0x86,
   0xfe, 0x30, 0x20, 0x2c, 0x89, 0x02, 0x10, 0x08, 0xa9, 0xff, 0x8d, 0x0f,
   0x03, 0x20, 0x47, 0xe9, 0xa9, 0x34, 0x8d, 0x02, 0xd3, 0xa2, 0x00, 0x2c,
-  0x89, 0x02, 0x30, 0x02, 0xa2, 0x01, 0x20, 0x4c, 0xee, 0xa0, 0x01, 0x60,
+  0x89, 0x02, 0x30, 0x02, 0xa2, 0x01, 0x20, 0xf2, 0xc9, 0xa0, 0x01, 0x60,
   0xad, 0x89, 0x02, 0x10, 0x0a, 0xa5, 0x3d, 0xf0, 0x03, 0x20, 0xd1, 0xed,
   0x20, 0xd1, 0xed, 0xa9, 0x3c, 0x8d, 0x02, 0xd3, 0xa0, 0x00, 0x8c, 0x01,
   0xd2, 0x8c, 0x03, 0xd2, 0x8c, 0x07, 0xd2, 0xc8, 0x60, 0xa5, 0x3f, 0xd0,
@@ -1004,7 +1004,7 @@ unsigned const char os_rom[] = {
   0xfc, 0xad, 0x12, 0xd0, 0x0a, 0x4d, 0x1f, 0xd0, 0x29, 0x02, 0xf0, 0x02,
   0xa2, 0xbe, 0x8e, 0x01, 0xd3, 0x20, 0x95, 0xef, 0xa2, 0x50, 0xa0, 0x08,
   0xa9, 0x00, 0x85, 0x66, 0x85, 0x67, 0x91, 0x66, 0xc8, 0xd0, 0xfb, 0xe6,
-  0x67, 0xca, 0xd0, 0xf6, 0xa0, 0x11, 0xb9, 0x1b, 0xf1, 0x99, 0x60, 0x01,
+  0x67, 0xca, 0xd0, 0xf6, 0xa0, 0x11, 0xb9, 0x24, 0xf1, 0x99, 0x60, 0x01,
   0x88, 0x10, 0xf7, 0xae, 0x01, 0xd3, 0x8a, 0x29, 0x7f, 0x8d, 0x01, 0xd3,
   0x8e, 0x01, 0xd3, 0xa9, 0x9b, 0x85, 0x0a, 0xa9, 0xe4, 0x85, 0x0b, 0xce,
   0x44, 0x02, 0xad, 0x01, 0xd3, 0x29, 0x02, 0x8d, 0xf8, 0x03, 0x4c, 0xd1,
@@ -1029,79 +1029,79 @@ unsigned const char os_rom[] = {
   0x02, 0xa2, 0x07, 0x8e, 0xe8, 0x02, 0xca, 0x8e, 0xda, 0x02, 0x20, 0x0a,
   0xec, 0x20, 0xb7, 0xf5, 0x20, 0x5c, 0xfe, 0x20, 0x7a, 0xec, 0xa2, 0x0e,
   0xbd, 0x92, 0xee, 0x9d, 0x1a, 0x03, 0xca, 0x10, 0xf7, 0x20, 0x6e, 0xe4,
-  0x20, 0xe7, 0xe7, 0x20, 0x50, 0xc2, 0xad, 0x1f, 0xd0, 0x29, 0x01, 0x8d,
-  0xe9, 0x03, 0x20, 0x8d, 0xc2, 0x58, 0xa9, 0x00, 0x85, 0x07, 0xa9, 0x00,
-  0x85, 0x06, 0xad, 0xfc, 0xbf, 0xd0, 0x18, 0xad, 0xfb, 0xbf, 0xaa, 0x49,
-  0xff, 0x8d, 0xfb, 0xbf, 0xcd, 0xfb, 0xbf, 0x8e, 0xfb, 0xbf, 0xf0, 0x07,
-  0x20, 0x14, 0xf1, 0xa9, 0x01, 0x85, 0x06, 0xa9, 0x03, 0x8d, 0x42, 0x03,
-  0xa9, 0x1a, 0x8d, 0x44, 0x03, 0xa9, 0xf1, 0x8d, 0x45, 0x03, 0xa9, 0x0c,
-  0x8d, 0x4a, 0x03, 0xa2, 0x00, 0x8e, 0x4b, 0x03, 0x20, 0x56, 0xe4, 0xa5,
-  0x14, 0xc5, 0x14, 0xf0, 0xfc, 0xa5, 0x08, 0xd0, 0x0b, 0xad, 0xe9, 0x03,
-  0xd0, 0x0f, 0x20, 0x8d, 0xf1, 0x4c, 0xb9, 0xf0, 0xa9, 0x02, 0x24, 0x09,
-  0xf0, 0x03, 0x20, 0x30, 0xf1, 0xa5, 0x08, 0xd0, 0x20, 0xa5, 0x07, 0xf0,
-  0x0b, 0xa9, 0x01, 0x2c, 0xfd, 0x9f, 0xd0, 0x0f, 0xa5, 0x06, 0xf0, 0x19,
-  0xa5, 0x06, 0xf0, 0x07, 0xa9, 0x01, 0x2c, 0xfd, 0xbf, 0xf0, 0x0e, 0x20,
-  0x34, 0xf1, 0x4c, 0xe5, 0xf0, 0xa5, 0x09, 0x4a, 0x90, 0x03, 0x20, 0x2d,
-  0xf1, 0xa5, 0x08, 0xd0, 0x06, 0x20, 0xa9, 0xc4, 0x4c, 0xf2, 0xf0, 0x20,
-  0x6d, 0xc4, 0xa2, 0x00, 0x8e, 0x44, 0x02, 0xa5, 0x06, 0xf0, 0x0a, 0xa9,
-  0x04, 0x2c, 0xfd, 0xbf, 0xf0, 0x03, 0x6c, 0xfa, 0xbf, 0xa5, 0x07, 0xf0,
-  0x08, 0x2c, 0xfd, 0x9f, 0xf0, 0x03, 0x6c, 0xfa, 0x9f, 0x6c, 0x0a, 0x00,
-  0x6c, 0xfe, 0xbf, 0x6c, 0xfe, 0x9f, 0x45, 0x20, 0x2c, 0xf1, 0xad, 0x01,
-  0xd3, 0x4a, 0x90, 0x08, 0x18, 0x0a, 0x8d, 0x01, 0xd3, 0x4c, 0x74, 0xe4,
-  0x60, 0x6c, 0x0c, 0x00, 0x6c, 0x02, 0x00, 0xea, 0xa9, 0x53, 0x8d, 0x02,
-  0x03, 0xa2, 0x01, 0x8e, 0x01, 0x03, 0x20, 0x53, 0xe4, 0x30, 0x39, 0xa2,
-  0x01, 0x8e, 0x01, 0x03, 0x8e, 0x0a, 0x03, 0xca, 0x8e, 0x04, 0x03, 0xa9,
-  0x52, 0x8d, 0x02, 0x03, 0xa9, 0x04, 0x8d, 0x05, 0x03, 0x20, 0x53, 0xe4,
-  0x30, 0x1a, 0xa2, 0x0c, 0x20, 0xbe, 0xf1, 0x20, 0xeb, 0xf1, 0xce, 0x41,
-  0x02, 0xf0, 0x15, 0xee, 0x0a, 0x03, 0xd0, 0x03, 0xee, 0x0b, 0x03, 0x20,
-  0x53, 0xe4, 0x10, 0xeb, 0xc0, 0x8a, 0xd0, 0x01, 0x60, 0x4c, 0x9b, 0xe4,
-  0x20, 0xdb, 0xf1, 0xb0, 0xf8, 0x20, 0x2d, 0xf1, 0xa9, 0x01, 0x85, 0x09,
-  0x60, 0xa9, 0x80, 0x85, 0x3e, 0x20, 0x7d, 0xe4, 0x20, 0x7a, 0xe4, 0x30,
-  0x1f, 0xa2, 0x02, 0x20, 0xbe, 0xf1, 0x20, 0xeb, 0xf1, 0x20, 0x7a, 0xe4,
-  0x30, 0x12, 0xce, 0x41, 0x02, 0xd0, 0xf3, 0x20, 0xdb, 0xf1, 0x20, 0x30,
-  0xf1, 0xa9, 0x02, 0x85, 0x09, 0x6c, 0x0a, 0x00, 0x20, 0x60, 0xed, 0x4c,
-  0x00, 0xf2, 0xa0, 0xfc, 0xb9, 0x04, 0x03, 0x99, 0x44, 0x01, 0xc8, 0xd0,
-  0xf7, 0x85, 0x16, 0xad, 0x42, 0x02, 0x85, 0x15, 0xad, 0x04, 0x04, 0x95,
-  0x00, 0xad, 0x05, 0x04, 0x95, 0x01, 0x60, 0xad, 0x42, 0x02, 0x18, 0x69,
-  0x05, 0xaa, 0xad, 0x43, 0x02, 0x69, 0x00, 0x48, 0x8a, 0x48, 0x60, 0xa0,
-  0x7f, 0xb9, 0x00, 0x04, 0x91, 0x15, 0x88, 0x10, 0xf8, 0xa5, 0x15, 0x49,
-  0x80, 0x85, 0x15, 0x30, 0x02, 0xe6, 0x16, 0x60, 0xa2, 0xf5, 0x8a, 0x48,
-  0xbd, 0x1b, 0xf1, 0x20, 0xc8, 0xfa, 0x68, 0xaa, 0xe8, 0xd0, 0xf3, 0x60,
-  0x42, 0x4f, 0x4f, 0x54, 0x20, 0x45, 0x52, 0x52, 0x4f, 0x52, 0x9b, 0x00,
-  0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc,
-  0xdd, 0xee, 0xff, 0x00, 0x55, 0xaa, 0xff, 0x00, 0xff, 0x40, 0x80, 0x70,
-  0x70, 0x80, 0xa0, 0xe0, 0x60, 0x50, 0x50, 0x50, 0x50, 0xa0, 0x80, 0x60,
-  0x50, 0xfc, 0xfd, 0xfe, 0xfe, 0xfd, 0xfb, 0xf7, 0xf0, 0xe1, 0xe1, 0xe1,
-  0xe1, 0xfb, 0xfd, 0xf0, 0xe1, 0x02, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
-  0x1d, 0x3f, 0x7f, 0xbf, 0xff, 0x04, 0x05, 0x1c, 0x3e, 0x01, 0x01, 0x00,
-  0x01, 0x02, 0x02, 0x03, 0x03, 0x04, 0x04, 0x04, 0x04, 0x01, 0x00, 0x04,
-  0x04, 0x0c, 0x18, 0x30, 0x60, 0xc0, 0x01, 0x00, 0x00, 0x01, 0x02, 0x02,
-  0x03, 0x03, 0x04, 0x02, 0x02, 0x02, 0x01, 0x01, 0x03, 0x03, 0x0a, 0x14,
-  0x28, 0x50, 0xa0, 0x40, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00,
-  0x02, 0x03, 0x02, 0x03, 0x02, 0x03, 0x01, 0x01, 0x01, 0x00, 0x00, 0x03,
-  0x02, 0xff, 0x0f, 0x03, 0x01, 0xff, 0xf0, 0xc0, 0x80, 0xad, 0x04, 0x03,
-  0x85, 0x32, 0xad, 0x05, 0x03, 0x85, 0x33, 0xad, 0x00, 0x03, 0x29, 0x70,
-  0xc9, 0x30, 0xd0, 0x1c, 0xad, 0x01, 0x03, 0xc9, 0x01, 0xd0, 0x15, 0xad,
-  0x02, 0x03, 0xc9, 0x52, 0xf0, 0x19, 0xc9, 0x57, 0xf0, 0x0c, 0xc9, 0x50,
-  0xf0, 0x08, 0xc9, 0x53, 0xf0, 0x1f, 0xd0, 0x3a, 0x18, 0x60, 0x2c, 0x03,
-  0x03, 0x70, 0x33, 0x10, 0x31, 0x30, 0x07, 0x2c, 0x03, 0x03, 0x50, 0x2a,
-  0x30, 0x28, 0xa2, 0x00, 0x2c, 0x03, 0x03, 0x30, 0x23, 0xa0, 0x21, 0xd0,
-  0x2b, 0x20, 0x79, 0xf3, 0x30, 0x18, 0xa0, 0x03, 0xb9, 0x64, 0xf3, 0x91,
-  0x32, 0x88, 0xd0, 0xf8, 0xa9, 0x10, 0xae, 0x07, 0xd5, 0xf0, 0x02, 0xa9,
-  0x30, 0x91, 0x32, 0xc8, 0x38, 0x60, 0x38, 0x60, 0xa0, 0x00, 0xb1, 0x32,
-  0x99, 0x04, 0xd5, 0xc8, 0x10, 0xf8, 0xa0, 0x22, 0xad, 0x0a, 0x03, 0x8d,
-  0x01, 0xd5, 0xad, 0x0b, 0x03, 0x8d, 0x02, 0xd5, 0x8e, 0x03, 0xd5, 0x20,
-  0x7b, 0xf3, 0x30, 0xde, 0x2c, 0x03, 0x03, 0x30, 0x0a, 0xa0, 0x00, 0xb9,
-  0x02, 0xd5, 0x91, 0x32, 0xc8, 0x10, 0xf8, 0xec, 0x09, 0x03, 0xb0, 0x0e,
-  0xa5, 0x32, 0x18, 0x69, 0x80, 0x85, 0x32, 0x90, 0x02, 0xe6, 0x33, 0xe8,
-  0xd0, 0x96, 0xad, 0x04, 0x03, 0x85, 0x32, 0xad, 0x05, 0x03, 0x85, 0x33,
-  0xa0, 0x01, 0x38, 0x60, 0x30, 0xff, 0xe0, 0x00, 0xa4, 0x14, 0x88, 0xad,
-  0x00, 0xd5, 0xc9, 0x11, 0xf0, 0x05, 0xc4, 0x14, 0xd0, 0xf5, 0x60, 0x18,
-  0x60, 0xa0, 0x23, 0x8c, 0xdf, 0xd5, 0x20, 0x68, 0xf3, 0xb0, 0x06, 0xac,
-  0x01, 0xd5, 0xd0, 0x04, 0x60, 0xa0, 0x8a, 0x60, 0xa0, 0x8b, 0x60, 0xa5,
-  0x0c, 0xa6, 0x0d, 0xc9, 0x60, 0xd0, 0x04, 0xe0, 0x01, 0xf0, 0x0e, 0x8d,
-  0x61, 0x01, 0x8e, 0x62, 0x01, 0xa9, 0x60, 0x85, 0x0c, 0xa9, 0x01, 0x85,
-  0x0d, 0x60, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0x20, 0xe7, 0xe7, 0x20, 0x50, 0xc2, 0x20, 0x9e, 0xc6, 0x20, 0x4f, 0xc7,
+  0xad, 0x1f, 0xd0, 0x29, 0x01, 0x8d, 0xe9, 0x03, 0x20, 0x06, 0xca, 0x20,
+  0x8d, 0xc2, 0x58, 0xa9, 0x00, 0x85, 0x07, 0xa9, 0x00, 0x85, 0x06, 0xad,
+  0xfc, 0xbf, 0xd0, 0x18, 0xad, 0xfb, 0xbf, 0xaa, 0x49, 0xff, 0x8d, 0xfb,
+  0xbf, 0xcd, 0xfb, 0xbf, 0x8e, 0xfb, 0xbf, 0xf0, 0x07, 0x20, 0x1d, 0xf1,
+  0xa9, 0x01, 0x85, 0x06, 0xa9, 0x03, 0x8d, 0x42, 0x03, 0xa9, 0x23, 0x8d,
+  0x44, 0x03, 0xa9, 0xf1, 0x8d, 0x45, 0x03, 0xa9, 0x0c, 0x8d, 0x4a, 0x03,
+  0xa2, 0x00, 0x8e, 0x4b, 0x03, 0x20, 0x56, 0xe4, 0xa5, 0x14, 0xc5, 0x14,
+  0xf0, 0xfc, 0xa5, 0x08, 0xd0, 0x0b, 0xad, 0xe9, 0x03, 0xd0, 0x0f, 0x20,
+  0x96, 0xf1, 0x4c, 0xc2, 0xf0, 0xa9, 0x02, 0x24, 0x09, 0xf0, 0x03, 0x20,
+  0x39, 0xf1, 0xa5, 0x08, 0xd0, 0x20, 0xa5, 0x07, 0xf0, 0x0b, 0xa9, 0x01,
+  0x2c, 0xfd, 0x9f, 0xd0, 0x0f, 0xa5, 0x06, 0xf0, 0x19, 0xa5, 0x06, 0xf0,
+  0x07, 0xa9, 0x01, 0x2c, 0xfd, 0xbf, 0xf0, 0x0e, 0x20, 0x3d, 0xf1, 0x4c,
+  0xee, 0xf0, 0xa5, 0x09, 0x4a, 0x90, 0x03, 0x20, 0x36, 0xf1, 0xa5, 0x08,
+  0xd0, 0x06, 0x20, 0xa9, 0xc4, 0x4c, 0xfb, 0xf0, 0x20, 0x6d, 0xc4, 0xa2,
+  0x00, 0x8e, 0x44, 0x02, 0xa5, 0x06, 0xf0, 0x0a, 0xa9, 0x04, 0x2c, 0xfd,
+  0xbf, 0xf0, 0x03, 0x6c, 0xfa, 0xbf, 0xa5, 0x07, 0xf0, 0x08, 0x2c, 0xfd,
+  0x9f, 0xf0, 0x03, 0x6c, 0xfa, 0x9f, 0x6c, 0x0a, 0x00, 0x6c, 0xfe, 0xbf,
+  0x6c, 0xfe, 0x9f, 0x45, 0x20, 0x35, 0xf1, 0xad, 0x01, 0xd3, 0x4a, 0x90,
+  0x08, 0x18, 0x0a, 0x8d, 0x01, 0xd3, 0x4c, 0x74, 0xe4, 0x60, 0x6c, 0x0c,
+  0x00, 0x6c, 0x02, 0x00, 0xea, 0xa9, 0x53, 0x8d, 0x02, 0x03, 0xa2, 0x01,
+  0x8e, 0x01, 0x03, 0x20, 0x53, 0xe4, 0x30, 0x39, 0xa2, 0x01, 0x8e, 0x01,
+  0x03, 0x8e, 0x0a, 0x03, 0xca, 0x8e, 0x04, 0x03, 0xa9, 0x52, 0x8d, 0x02,
+  0x03, 0xa9, 0x04, 0x8d, 0x05, 0x03, 0x20, 0x53, 0xe4, 0x30, 0x1a, 0xa2,
+  0x0c, 0x20, 0xc7, 0xf1, 0x20, 0xf4, 0xf1, 0xce, 0x41, 0x02, 0xf0, 0x15,
+  0xee, 0x0a, 0x03, 0xd0, 0x03, 0xee, 0x0b, 0x03, 0x20, 0x53, 0xe4, 0x10,
+  0xeb, 0xc0, 0x8a, 0xd0, 0x01, 0x60, 0x4c, 0x9b, 0xe4, 0x20, 0xe4, 0xf1,
+  0xb0, 0xf8, 0x20, 0x36, 0xf1, 0xa9, 0x01, 0x85, 0x09, 0x60, 0xa9, 0x80,
+  0x85, 0x3e, 0x20, 0x7d, 0xe4, 0x20, 0x7a, 0xe4, 0x30, 0x1f, 0xa2, 0x02,
+  0x20, 0xc7, 0xf1, 0x20, 0xf4, 0xf1, 0x20, 0x7a, 0xe4, 0x30, 0x12, 0xce,
+  0x41, 0x02, 0xd0, 0xf3, 0x20, 0xe4, 0xf1, 0x20, 0x39, 0xf1, 0xa9, 0x02,
+  0x85, 0x09, 0x6c, 0x0a, 0x00, 0x20, 0x60, 0xed, 0x4c, 0x09, 0xf2, 0xa0,
+  0xfc, 0xb9, 0x04, 0x03, 0x99, 0x44, 0x01, 0xc8, 0xd0, 0xf7, 0x85, 0x16,
+  0xad, 0x42, 0x02, 0x85, 0x15, 0xad, 0x04, 0x04, 0x95, 0x00, 0xad, 0x05,
+  0x04, 0x95, 0x01, 0x60, 0xad, 0x42, 0x02, 0x18, 0x69, 0x05, 0xaa, 0xad,
+  0x43, 0x02, 0x69, 0x00, 0x48, 0x8a, 0x48, 0x60, 0xa0, 0x7f, 0xb9, 0x00,
+  0x04, 0x91, 0x15, 0x88, 0x10, 0xf8, 0xa5, 0x15, 0x49, 0x80, 0x85, 0x15,
+  0x30, 0x02, 0xe6, 0x16, 0x60, 0xa2, 0xf5, 0x8a, 0x48, 0xbd, 0x24, 0xf1,
+  0x20, 0xc8, 0xfa, 0x68, 0xaa, 0xe8, 0xd0, 0xf3, 0x60, 0x42, 0x4f, 0x4f,
+  0x54, 0x20, 0x45, 0x52, 0x52, 0x4f, 0x52, 0x9b, 0x00, 0x11, 0x22, 0x33,
+  0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+  0x00, 0x55, 0xaa, 0xff, 0x00, 0xff, 0x40, 0x80, 0x70, 0x70, 0x80, 0xa0,
+  0xe0, 0x60, 0x50, 0x50, 0x50, 0x50, 0xa0, 0x80, 0x60, 0x50, 0xfc, 0xfd,
+  0xfe, 0xfe, 0xfd, 0xfb, 0xf7, 0xf0, 0xe1, 0xe1, 0xe1, 0xe1, 0xfb, 0xfd,
+  0xf0, 0xe1, 0x02, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x1d, 0x3f, 0x7f,
+  0xbf, 0xff, 0x04, 0x05, 0x1c, 0x3e, 0x01, 0x01, 0x00, 0x01, 0x02, 0x02,
+  0x03, 0x03, 0x04, 0x04, 0x04, 0x04, 0x01, 0x00, 0x04, 0x04, 0x0c, 0x18,
+  0x30, 0x60, 0xc0, 0x01, 0x00, 0x00, 0x01, 0x02, 0x02, 0x03, 0x03, 0x04,
+  0x02, 0x02, 0x02, 0x01, 0x01, 0x03, 0x03, 0x0a, 0x14, 0x28, 0x50, 0xa0,
+  0x40, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x03, 0x02,
+  0x03, 0x02, 0x03, 0x01, 0x01, 0x01, 0x00, 0x00, 0x03, 0x02, 0xff, 0x0f,
+  0x03, 0x01, 0xff, 0xf0, 0xc0, 0x80, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
   0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
@@ -1110,13 +1110,13 @@ unsigned const char os_rom[] = {
   0x85, 0x2a, 0xa9, 0x00, 0x85, 0x2b, 0xad, 0x2f, 0x02, 0x29, 0xdc, 0x8d,
   0x2f, 0x02, 0x8d, 0x00, 0xd4, 0xa2, 0x0b, 0xa9, 0x00, 0x95, 0x54, 0x9d,
   0x90, 0x02, 0xca, 0xd0, 0xf8, 0x86, 0x7b, 0xa5, 0x2b, 0x29, 0x0f, 0x85,
-  0x57, 0xaa, 0xbd, 0x51, 0xf2, 0x4d, 0x6f, 0x02, 0x29, 0xc0, 0x4d, 0x6f,
+  0x57, 0xaa, 0xbd, 0x5a, 0xf2, 0x4d, 0x6f, 0x02, 0x29, 0xc0, 0x4d, 0x6f,
   0x02, 0x8d, 0x6f, 0x02, 0xc9, 0x40, 0xa5, 0x2a, 0xb0, 0x04, 0xe0, 0x00,
-  0xd0, 0x02, 0x29, 0xef, 0x0a, 0x0a, 0x85, 0x68, 0xbc, 0x61, 0xf2, 0xbe,
-  0x71, 0xf2, 0x0a, 0x10, 0x03, 0xbe, 0x86, 0xf2, 0x86, 0x69, 0xa5, 0x6a,
-  0xa6, 0x57, 0x18, 0x7d, 0x41, 0xf2, 0xb0, 0x09, 0x8a, 0xf0, 0x03, 0x20,
-  0xee, 0xf3, 0xa0, 0x93, 0x60, 0x85, 0x59, 0xbc, 0x31, 0xf2, 0x84, 0x58,
-  0xbd, 0x51, 0xf2, 0xa6, 0x59, 0x29, 0x30, 0xf0, 0x03, 0xa0, 0x00, 0xca,
+  0xd0, 0x02, 0x29, 0xef, 0x0a, 0x0a, 0x85, 0x68, 0xbc, 0x6a, 0xf2, 0xbe,
+  0x7a, 0xf2, 0x0a, 0x10, 0x03, 0xbe, 0x8f, 0xf2, 0x86, 0x69, 0xa5, 0x6a,
+  0xa6, 0x57, 0x18, 0x7d, 0x4a, 0xf2, 0xb0, 0x09, 0x8a, 0xf0, 0x03, 0x20,
+  0xee, 0xf3, 0xa0, 0x93, 0x60, 0x85, 0x59, 0xbc, 0x3a, 0xf2, 0x84, 0x58,
+  0xbd, 0x5a, 0xf2, 0xa6, 0x59, 0x29, 0x30, 0xf0, 0x03, 0xa0, 0x00, 0xca,
   0x84, 0x70, 0x8e, 0xe6, 0x02, 0x86, 0x71, 0x8e, 0x31, 0x02, 0xc9, 0x20,
   0xa9, 0xf8, 0x90, 0x02, 0xa9, 0xf5, 0xe5, 0x69, 0x24, 0x68, 0x50, 0x02,
   0xe9, 0x06, 0xa0, 0x01, 0xcc, 0x6e, 0x02, 0x65, 0x70, 0x8d, 0xe5, 0x02,
@@ -1133,7 +1133,7 @@ unsigned const char os_rom[] = {
   0x02, 0xa2, 0x40, 0x8e, 0x0e, 0xd4, 0xa4, 0x7e, 0xa2, 0x70, 0xa9, 0x41,
   0x20, 0x98, 0xf5, 0xad, 0x2f, 0x02, 0x09, 0x22, 0x8d, 0x2f, 0x02, 0xa5,
   0x14, 0xc5, 0x14, 0xf0, 0xfc, 0xa5, 0x2b, 0x29, 0x0f, 0xd0, 0x03, 0x20,
-  0xab, 0xf6, 0x20, 0xb0, 0xfd, 0xa2, 0x00, 0x60, 0xa6, 0x57, 0xbd, 0x51,
+  0xab, 0xf6, 0x20, 0xb0, 0xfd, 0xa2, 0x00, 0x60, 0xa6, 0x57, 0xbd, 0x5a,
   0xf2, 0x29, 0x0f, 0xa6, 0x57, 0xd0, 0x07, 0xae, 0x6e, 0x02, 0xf0, 0x02,
   0x09, 0x20, 0x48, 0x09, 0x40, 0xa2, 0x58, 0x20, 0x98, 0xf5, 0xa6, 0x69,
   0xa5, 0x57, 0xd0, 0x03, 0xae, 0xbf, 0x02, 0xca, 0x68, 0xc9, 0x22, 0xf0,
@@ -1147,9 +1147,9 @@ unsigned const char os_rom[] = {
   0x68, 0x30, 0xfb, 0x4c, 0x3f, 0xf8, 0x28, 0xca, 0x94, 0x46, 0x00, 0xad,
   0xe6, 0x02, 0x85, 0x6a, 0xa9, 0x00, 0x85, 0x4f, 0xa9, 0xfe, 0x85, 0x4e,
   0x60, 0x20, 0xf6, 0xf8, 0x30, 0x36, 0xa4, 0x54, 0x20, 0x7b, 0xf9, 0xa5,
-  0x55, 0xa6, 0x57, 0xbc, 0x91, 0xf2, 0x59, 0x04, 0xf6, 0xaa, 0xa5, 0x56,
+  0x55, 0xa6, 0x57, 0xbc, 0x9a, 0xf2, 0x59, 0x04, 0xf6, 0xaa, 0xa5, 0x56,
   0x20, 0xce, 0xf9, 0xa4, 0x6f, 0xb1, 0x66, 0x20, 0xbb, 0xf9, 0x20, 0xac,
-  0xf9, 0x5d, 0x01, 0xf6, 0xa6, 0x57, 0xbc, 0x91, 0xf2, 0x39, 0xa1, 0xf2,
+  0xf9, 0x5d, 0x01, 0xf6, 0xa6, 0x57, 0xbc, 0x9a, 0xf2, 0x39, 0xaa, 0xf2,
   0xa6, 0x57, 0xf0, 0x03, 0x4c, 0xe6, 0xf9, 0x20, 0x1c, 0xfe, 0xa0, 0x01,
   0x60, 0x20, 0x60, 0x40, 0x00, 0x01, 0x03, 0x07, 0x8d, 0xfb, 0x02, 0x20,
   0xf6, 0xf8, 0x30, 0x0c, 0xad, 0xfb, 0x02, 0xc9, 0x7d, 0xd0, 0x0e, 0x20,
@@ -1167,9 +1167,9 @@ unsigned const char os_rom[] = {
   0xab, 0xf6, 0x20, 0xb1, 0xf6, 0xa5, 0x54, 0x20, 0x92, 0xfd, 0xf0, 0x03,
   0x20, 0x83, 0xf8, 0x20, 0xd4, 0xfc, 0x4c, 0x32, 0xfe, 0xa6, 0x54, 0xca,
   0x8a, 0x20, 0x9b, 0xfd, 0x18, 0x69, 0x02, 0xc5, 0x54, 0x90, 0x01, 0x60,
-  0x68, 0x68, 0x90, 0xe7, 0xa6, 0x57, 0xbc, 0x91, 0xf2, 0xbe, 0xa5, 0xf2,
-  0x86, 0x77, 0xbe, 0xa1, 0xf2, 0x8e, 0xa0, 0x02, 0x30, 0x0b, 0x2d, 0xa0,
-  0x02, 0x19, 0xee, 0xfd, 0xaa, 0xbd, 0x1b, 0xf2, 0x60, 0x4c, 0x2b, 0xfe,
+  0x68, 0x68, 0x90, 0xe7, 0xa6, 0x57, 0xbc, 0x9a, 0xf2, 0xbe, 0xae, 0xf2,
+  0x86, 0x77, 0xbe, 0xaa, 0xf2, 0x8e, 0xa0, 0x02, 0x30, 0x0b, 0x2d, 0xa0,
+  0x02, 0x19, 0xee, 0xfd, 0xaa, 0xbd, 0x24, 0xf2, 0x60, 0x4c, 0x2b, 0xfe,
   0xa5, 0x22, 0xc9, 0x11, 0xf0, 0x05, 0xc9, 0x12, 0xf0, 0x01, 0x60, 0xa6,
   0x57, 0xd0, 0x03, 0x20, 0xe7, 0xf8, 0xad, 0xfd, 0x02, 0x20, 0xc4, 0xf6,
   0x8d, 0xbc, 0x02, 0xad, 0xfb, 0x02, 0x20, 0xc4, 0xf6, 0x85, 0x51, 0x20,
@@ -1179,7 +1179,7 @@ unsigned const char os_rom[] = {
   0x71, 0xa2, 0x00, 0xa5, 0x55, 0x38, 0xe5, 0x5b, 0x85, 0x72, 0xa5, 0x56,
   0xe5, 0x5c, 0xb0, 0x10, 0x49, 0xff, 0xa8, 0xa5, 0x72, 0x49, 0xff, 0x69,
   0x01, 0x85, 0x72, 0x98, 0x69, 0x00, 0xa2, 0xcc, 0x85, 0x73, 0x8a, 0xa6,
-  0x57, 0xbc, 0x91, 0xf2, 0x18, 0x79, 0xa2, 0xf7, 0x85, 0x64, 0xa9, 0xf7,
+  0x57, 0xbc, 0x9a, 0xf2, 0x18, 0x79, 0xa2, 0xf7, 0x85, 0x64, 0xa9, 0xf7,
   0x85, 0x65, 0x85, 0x75, 0xb9, 0xa2, 0xf7, 0x18, 0x69, 0xd9, 0x85, 0x74,
   0xa6, 0x72, 0x8a, 0x38, 0xe5, 0x76, 0x85, 0x68, 0xa4, 0x73, 0x98, 0xe9,
   0x00, 0x85, 0x69, 0xb0, 0x04, 0xa0, 0x00, 0xa6, 0x76, 0x86, 0x7e, 0x84,
@@ -1199,7 +1199,7 @@ unsigned const char os_rom[] = {
   0xb5, 0x71, 0x75, 0x67, 0x95, 0x67, 0xca, 0xca, 0x10, 0xef, 0x98, 0x18,
   0x65, 0x76, 0x68, 0x69, 0x00, 0x30, 0xb7, 0xa5, 0x68, 0x38, 0xe5, 0x76,
   0x85, 0x68, 0xb0, 0x02, 0xc6, 0x69, 0xa5, 0x6e, 0x6c, 0x64, 0x00, 0xa0,
-  0x00, 0xa6, 0x7b, 0xd0, 0x08, 0xa4, 0x57, 0xbe, 0x61, 0xf2, 0xbc, 0x71,
+  0x00, 0xa6, 0x7b, 0xd0, 0x08, 0xa4, 0x57, 0xbe, 0x6a, 0xf2, 0xbc, 0x7a,
   0xf2, 0x20, 0x85, 0xf9, 0x18, 0xa6, 0x57, 0xf0, 0x02, 0x69, 0xa0, 0xa8,
   0xa5, 0x65, 0x69, 0x00, 0xaa, 0x18, 0x65, 0x59, 0x85, 0x67, 0xa5, 0x58,
   0x85, 0x66, 0xa9, 0x00, 0x88, 0x91, 0x66, 0xd0, 0xfb, 0xc6, 0x67, 0xca,
@@ -1214,11 +1214,11 @@ unsigned const char os_rom[] = {
   0x18, 0x79, 0xb2, 0x02, 0x6a, 0x05, 0x51, 0x99, 0xb2, 0x02, 0x88, 0x10,
   0x03, 0x6e, 0xb3, 0x02, 0x88, 0x10, 0x03, 0x6e, 0xb4, 0x02, 0x60, 0xa4,
   0x5f, 0xf0, 0x0a, 0x48, 0xa0, 0x00, 0xa5, 0x5d, 0x91, 0x5e, 0x84, 0x5f,
-  0x68, 0x60, 0xad, 0xbf, 0x02, 0xa6, 0x57, 0xf0, 0x06, 0xbc, 0x61, 0xf2,
-  0xb9, 0x71, 0xf2, 0xa0, 0x27, 0xc4, 0x53, 0xb0, 0x02, 0x84, 0x53, 0x18,
+  0x68, 0x60, 0xad, 0xbf, 0x02, 0xa6, 0x57, 0xf0, 0x06, 0xbc, 0x6a, 0xf2,
+  0xb9, 0x7a, 0xf2, 0xa0, 0x27, 0xc4, 0x53, 0xb0, 0x02, 0x84, 0x53, 0x18,
   0xe5, 0x54, 0xb0, 0x0e, 0xa0, 0x00, 0x84, 0x56, 0x8a, 0xd0, 0x02, 0xa4,
-  0x52, 0x84, 0x55, 0xa0, 0x8d, 0x60, 0xbc, 0x76, 0xf2, 0xa5, 0x55, 0xd9,
-  0x87, 0xf2, 0xa5, 0x56, 0xf9, 0x8c, 0xf2, 0xb0, 0xe3, 0xa0, 0xff, 0xa5,
+  0x52, 0x84, 0x55, 0xa0, 0x8d, 0x60, 0xbc, 0x7f, 0xf2, 0xa5, 0x55, 0xd9,
+  0x90, 0xf2, 0xa5, 0x56, 0xf9, 0x95, 0xf2, 0xb0, 0xe3, 0xa0, 0xff, 0xa5,
   0x11, 0xd0, 0x04, 0x84, 0x11, 0xa0, 0x7f, 0xc8, 0x60, 0xa0, 0x17, 0xcc,
   0xbf, 0x02, 0x48, 0xa9, 0x00, 0x65, 0x7b, 0xf0, 0x14, 0xa2, 0x0b, 0xb5,
   0x54, 0xbc, 0x90, 0x02, 0x94, 0x54, 0x9d, 0x90, 0x02, 0xca, 0x10, 0xf3,
@@ -1226,16 +1226,16 @@ unsigned const char os_rom[] = {
   0x8a, 0x18, 0x65, 0x64, 0x90, 0x02, 0xe6, 0x65, 0x18, 0x65, 0x58, 0xaa,
   0xa5, 0x65, 0x65, 0x59, 0x60, 0xa2, 0x00, 0x20, 0x5b, 0xf9, 0x86, 0x68,
   0x85, 0x69, 0x60, 0xa2, 0x00, 0x20, 0x5b, 0xf9, 0x86, 0x66, 0x85, 0x67,
-  0x60, 0xa9, 0x00, 0x85, 0x65, 0x84, 0x64, 0xa4, 0x57, 0xb9, 0x76, 0xf2,
-  0x38, 0xf9, 0x91, 0xf2, 0xa8, 0xc8, 0xa5, 0x64, 0x0a, 0x26, 0x65, 0x0a,
+  0x60, 0xa9, 0x00, 0x85, 0x65, 0x84, 0x64, 0xa4, 0x57, 0xb9, 0x7f, 0xf2,
+  0x38, 0xf9, 0x9a, 0xf2, 0xa8, 0xc8, 0xa5, 0x64, 0x0a, 0x26, 0x65, 0x0a,
   0x26, 0x65, 0x18, 0x65, 0x64, 0x90, 0x02, 0xe6, 0x65, 0x0a, 0x26, 0x65,
   0x88, 0x10, 0xfa, 0x60, 0x48, 0x2a, 0x2a, 0x2a, 0x2a, 0x29, 0x03, 0xaa,
   0x68, 0x60, 0x20, 0xc5, 0xf9, 0xa5, 0x77, 0xca, 0x30, 0x04, 0x4a, 0xca,
   0x10, 0xfc, 0x85, 0x6e, 0x60, 0xa4, 0x5a, 0x20, 0x7b, 0xf9, 0xa5, 0x5c,
-  0xa6, 0x5b, 0x6a, 0x86, 0x6f, 0xa9, 0x00, 0xa6, 0x57, 0xbc, 0x91, 0xf2,
+  0xa6, 0x5b, 0x6a, 0x86, 0x6f, 0xa9, 0x00, 0xa6, 0x57, 0xbc, 0x9a, 0xf2,
   0xf0, 0x06, 0x66, 0x6f, 0x6a, 0x88, 0xd0, 0xfa, 0x2a, 0x2a, 0x2a, 0x2a,
-  0xaa, 0x60, 0xe6, 0x55, 0xd0, 0x02, 0xe6, 0x56, 0xa6, 0x57, 0xbc, 0x76,
-  0xf2, 0xbe, 0x8c, 0xf2, 0xe4, 0x56, 0xd0, 0x0f, 0xbe, 0x87, 0xf2, 0xe4,
+  0xaa, 0x60, 0xe6, 0x55, 0xd0, 0x02, 0xe6, 0x56, 0xa6, 0x57, 0xbc, 0x7f,
+  0xf2, 0xbe, 0x95, 0xf2, 0xe4, 0x56, 0xd0, 0x0f, 0xbe, 0x90, 0xf2, 0xe4,
   0x55, 0xd0, 0x08, 0xa0, 0x00, 0x84, 0x55, 0x84, 0x56, 0xe6, 0x54, 0xa0,
   0x01, 0x60, 0x20, 0xff, 0xfd, 0x8e, 0xfe, 0x02, 0x8e, 0xa2, 0x02, 0x4c,
   0xf2, 0xf3, 0xa5, 0x6b, 0xd0, 0x06, 0x20, 0x36, 0xfa, 0x10, 0x01, 0x60,
@@ -0,0 +1,148 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "profiler.h"
+#include "stm32f4xx.h"
+#include "ff.h"
+#include <string.h>
+
+#ifdef UNOCART_PROFILE
+static PROF_ENTRY profTable[PROF_ENTRIES];
+#endif
+static volatile uint32_t profSamples, profDropped;
+static int profOn = 0;
+
+#ifdef UNOCART_PROFILE
+// frame is what the exception pushed: r0-r3, r12, lr, pc, xpsr
+void prof_sample(uint32_t *frame) {
+	uint32_t pc = frame[6];
+	uint32_t i = (pc >> 1) * 2654435761u >> 22;
+
+	TIM7->SR = ~TIM_IT_Update;
+	profSamples++;
+	for (int n = 0; n < 8; n++, i = (i + 1) & (PROF_ENTRIES-1)) {
+		if (profTable[i].pc == pc) {
+			profTable[i].count++;
+			return;
+		}
+		if (!profTable[i].pc) {
+			profTable[i].pc = pc;
+			profTable[i].count = 1;
+			return;
+		}
+	}
+	profDropped++;
+}
+
+// find the stack the interrupted code was using, the frame is on it
+void TIM7_IRQHandler(void) __attribute__((naked));
+void TIM7_IRQHandler(void) {
+	__asm volatile (
+		"tst lr, #4\n"
+		"ite eq\n"
+		"mrseq r0, msp\n"
+		"mrsne r0, psp\n"
+		"b prof_sample\n"
+	);
+}
+#endif
+
+int prof_start(void) {
+#ifdef UNOCART_PROFILE
+	TIM_TimeBaseInitTypeDef timInit;
+	NVIC_InitTypeDef nvicInit;
+
+	prof_stop();
+	memset(profTable, 0, sizeof(profTable));
+	profSamples = profDropped = 0;
+
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM7, ENABLE);
+	TIM_TimeBaseStructInit(&timInit);
+	// APB1 timers run at SystemCoreClock / 2
+	timInit.TIM_Prescaler = SystemCoreClock / 2 / 1000000 - 1;
+	timInit.TIM_Period = 1000000 / PROF_HZ - 1;
+	TIM_TimeBaseInit(TIM7, &timInit);
+	TIM7->SR = ~TIM_IT_Update;
+	TIM7->DIER |= TIM_IT_Update;
+
+	// below SysTick, so the delay timing isn't disturbed
+	nvicInit.NVIC_IRQChannel = TIM7_IRQn;
+	nvicInit.NVIC_IRQChannelPreemptionPriority = 15;
+	nvicInit.NVIC_IRQChannelSubPriority = 0;
+	nvicInit.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_Init(&nvicInit);
+
+	TIM7->CR1 |= TIM_CR1_CEN;
+	profOn = 1;
+	return 0;
+#else
+	return 1;
+#endif
+}
+
+void prof_stop(void) {
+#ifdef UNOCART_PROFILE
+	TIM7->CR1 &= ~TIM_CR1_CEN;
+	TIM7->DIER &= ~TIM_IT_Update;
+	NVIC_DisableIRQ(TIM7_IRQn);
+#endif
+	profOn = 0;
+}
+
+int prof_running(void) {
+	return profOn;
+}
+
+uint32_t prof_samples(void) {
+	return profSamples;
+}
+
+int prof_dump(void) {
+#ifdef UNOCART_PROFILE
+	PROF_HEADER hdr;
+	static FIL fil;	// off the stack, it holds a sector buffer
+	UINT bw;
+	uint32_t count = 0;
+	int ok;
+
+	prof_stop();
+	// used entries to the front, the order doesn't matter
+	for (int i = 0; i < PROF_ENTRIES; i++)
+		if (profTable[i].pc)
+			profTable[count++] = profTable[i];
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, "UNOPROF", 8);
+	hdr.version = PROF_VERSION;
+	hdr.hz = 1000000 / (1000000 / PROF_HZ);
+	hdr.samples = profSamples;
+	hdr.dropped = profDropped;
+	hdr.count = count;
+	if (f_open(&fil, PROF_FILENAME, FA_WRITE|FA_CREATE_ALWAYS) != FR_OK)
+		return 1;
+	ok = f_write(&fil, &hdr, sizeof(hdr), &bw) == FR_OK && bw == sizeof(hdr) &&
+		f_write(&fil, profTable, count * sizeof(PROF_ENTRY), &bw) == FR_OK && bw == count * sizeof(PROF_ENTRY);
+	if (f_close(&fil) != FR_OK)
+		ok = 0;
+	// the table has been packed, start again if sampling is restarted
+	memset(profTable, 0, sizeof(profTable));
+	profSamples = profDropped = 0;
+	return !ok;
+#else
+	return 1;
+#endif
+}
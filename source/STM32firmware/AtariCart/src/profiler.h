@@ -0,0 +1,67 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Sampling profiler for the code that runs between bus cycles (FatFs, the
+ * directory and search code, loading files). TIM7 interrupts a few thousand
+ * times a second and counts the PC it interrupted in a hash table. The bus
+ * loops run with interrupts off, so they never show up. The table is
+ * written to UNOPROF.BIN for HostTools/unoprof to match against the ELF.
+ *
+ * Only built in with UNOCART_PROFILE defined (uncomment below, or add it to
+ * the project's defines).
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+// #define UNOCART_PROFILE
+
+#define PROF_ENTRIES		1024	// power of two
+#define PROF_HZ				7874	// 1MHz / 127, not a multiple of SysTick's 1kHz
+#define PROF_FILENAME		"UNOPROF.BIN"
+
+typedef struct {
+	uint32_t pc;			// 0 if unused
+	uint32_t count;
+} PROF_ENTRY;
+
+/* UNOPROF.BIN: this header, then count PROF_ENTRYs */
+typedef struct {
+	char magic[8];			// "UNOPROF"
+	uint32_t version;
+	uint32_t hz;
+	uint32_t samples;		// in all, including dropped
+	uint32_t dropped;		// PCs the table had no room for
+	uint32_t count;
+	uint32_t reserved;
+} PROF_HEADER;
+
+#define PROF_VERSION		1
+
+// clear the table and start sampling. Returns 1 if profiling isn't built in
+int prof_start(void);
+void prof_stop(void);
+int prof_running(void);
+uint32_t prof_samples(void);
+// stops, then writes the table out. 0 if it worked
+int prof_dump(void);
+
+#endif
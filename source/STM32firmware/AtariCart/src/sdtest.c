@@ -0,0 +1,196 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sdtest.h"
+#include "stm32f4xx.h"
+#include "ff.h"
+#include "diskio.h"
+#include <stdio.h>
+#include <string.h>
+
+static SDTEST_RESULT sdtResult = { SDTEST_NONE };
+
+static uint32_t sdt_us(uint32_t cycles) {
+	return cycles / (SystemCoreClock / 1000000);
+}
+
+// KB/s for bytes moved in cycles
+static uint32_t sdt_rate(uint32_t bytes, uint32_t cycles) {
+	uint32_t us = sdt_us(cycles);
+	return us ? (uint32_t)((uint64_t)bytes * 1000000 / 1024 / us) : 0;
+}
+
+// the whole file, in pieces of size bytes. Returns the cycles taken, or 0
+static uint32_t sdt_pass(FIL *fil, uint8_t *buf, UINT size, int write) {
+	UINT n;
+	uint32_t t = DWT->CYCCNT;
+	if (f_lseek(fil, 0) != FR_OK)
+		return 0;
+	for (uint32_t pos = 0; pos < SDTEST_FILE_SIZE; pos += size) {
+		FRESULT res = write ? f_write(fil, buf, size, &n) : f_read(fil, buf, size, &n);
+		if (res != FR_OK || n != size)
+			return 0;
+	}
+	if (write && f_sync(fil) != FR_OK)
+		return 0;
+	return (DWT->CYCCNT - t) | 1;
+}
+
+int sdtest_run(uint8_t *buf) {
+	SDTEST_RESULT *r = &sdtResult;
+	static FIL fil;	// off the stack, it holds a sector buffer
+	uint32_t cycles;
+	DWORD sectors = 0;
+
+	memset(r, 0, sizeof(*r));
+	if (disk_status(0) & STA_NOINIT)
+		return r->status = SDTEST_NO_CARD;
+	r->haveIds = disk_ioctl(0, MMC_GET_TYPE, &r->cardType) == RES_OK &&
+			disk_ioctl(0, MMC_GET_CID, r->cid) == RES_OK &&
+			disk_ioctl(0, MMC_GET_CSD, r->csd) == RES_OK;
+	// the driver writes a DWORD, which isn't 32 bits on every host
+	if (disk_ioctl(0, GET_SECTOR_COUNT, &sectors) == RES_OK)
+		r->sectors = sectors;
+
+	if (f_open(&fil, SDTEST_FILENAME, FA_READ|FA_WRITE|FA_CREATE_ALWAYS) != FR_OK)
+		return r->status = SDTEST_CREATE;
+	// allocate it first, so the timed writes don't include FAT updates
+	if (f_lseek(&fil, SDTEST_FILE_SIZE) != FR_OK || f_tell(&fil) != SDTEST_FILE_SIZE || f_sync(&fil) != FR_OK) {
+		r->status = SDTEST_CREATE;
+		goto done;
+	}
+	for (int i = 0; i < SDTEST_CHUNK; i++)
+		buf[i] = i * 7;
+
+	r->status = SDTEST_WRITE;
+	if (!(cycles = sdt_pass(&fil, buf, SDTEST_CHUNK, 1)))
+		goto done;
+	r->multiWriteKBs = sdt_rate(SDTEST_FILE_SIZE, cycles);
+	if (!(cycles = sdt_pass(&fil, buf, 512, 1)))
+		goto done;
+	r->singleWriteKBs = sdt_rate(SDTEST_FILE_SIZE, cycles);
+
+	r->status = SDTEST_READ;
+	if (!(cycles = sdt_pass(&fil, buf, SDTEST_CHUNK, 0)))
+		goto done;
+	r->multiReadKBs = sdt_rate(SDTEST_FILE_SIZE, cycles);
+	if (!(cycles = sdt_pass(&fil, buf, 512, 0)))
+		goto done;
+	r->singleReadKBs = sdt_rate(SDTEST_FILE_SIZE, cycles);
+
+	// random sectors, the way the SIO handler reads an ATR
+	uint32_t seed = DWT->CYCCNT, total = 0;
+	r->randMinUs = 0xFFFFFFFF;
+	for (int i = 0; i < SDTEST_RANDOM_READS; i++) {
+		UINT n;
+		seed = seed * 1103515245 + 12345;
+		uint32_t t = DWT->CYCCNT;
+		if (f_lseek(&fil, (seed >> 8) % (SDTEST_FILE_SIZE / 512) * 512) != FR_OK ||
+				f_read(&fil, buf, 512, &n) != FR_OK || n != 512)
+			goto done;
+		uint32_t us = sdt_us(DWT->CYCCNT - t);
+		if (us < r->randMinUs) r->randMinUs = us;
+		if (us > r->randMaxUs) r->randMaxUs = us;
+		total += us;
+	}
+	r->randAvgUs = total / SDTEST_RANDOM_READS;
+	r->status = SDTEST_OK;
+done:
+	f_close(&fil);
+	f_unlink(SDTEST_FILENAME);
+	return r->status;
+}
+
+const SDTEST_RESULT *sdtest_result(void) {
+	return &sdtResult;
+}
+
+static const char *sdtErrors[] = {
+	"", "No SD card", "Can't create " SDTEST_FILENAME, "Write failed", "Read failed", "Not run"
+};
+
+static void sdt_card_line(const SDTEST_RESULT *r, char *buf) {
+	const char *type = "SD";
+	if (!r->haveIds) {
+		sprintf(buf, "Card: %u MB", (unsigned)(r->sectors / 2048));
+		return;
+	}
+	if (r->cardType & CT_MMC) type = "MMC";
+	else if (r->cardType & CT_SD1) type = "SD 1.x";
+	else if (r->cardType & CT_BLOCK) type = "SDHC/XC";
+	// TRAN_SPEED is 25MHz ($32) or 50MHz ($5A) for SD cards
+	sprintf(buf, "Card: %s %u MB, %s", type, (unsigned)(r->sectors / 2048),
+			r->csd[3] == 0x5A ? "50MHz" : r->csd[3] == 0x32 ? "25MHz" : "slow");
+}
+
+static void sdt_cid_line(const SDTEST_RESULT *r, char *buf) {
+	const uint8_t *c = r->cid;
+	char oem[3] = { c[1], c[2], 0 }, name[6];
+	memcpy(name, &c[3], 5);
+	name[5] = 0;
+	for (int i = 0; i < 5; i++)
+		if (name[i] < ' ' || name[i] > 'z') name[i] = '?';
+	if (oem[0] < ' ' || oem[0] > 'z') oem[0] = '?';
+	if (oem[1] < ' ' || oem[1] > 'z') oem[1] = '?';
+	sprintf(buf, "Maker $%x %s %s rev %u.%u %u/%u", c[0], oem, name, c[8] >> 4, c[8] & 15,
+			((c[13] & 15) << 4 | c[14] >> 4) + 2000, c[14] & 15);
+}
+
+// the figures right aligned after the name
+static void sdt_rate_line(char *buf, const char *name, uint32_t value, const char *unit) {
+	char num[12];
+	int len = sprintf(buf, "%s ", name);
+	int nlen = sprintf(num, "%u", (unsigned)value);
+	while (len < 32 - nlen) buf[len++] = ' ';
+	sprintf(buf + len, "%s %s", num, unit);
+}
+
+int sdtest_line(int n, char *buf) {
+	const SDTEST_RESULT *r = &sdtResult;
+	buf[0] = 0;
+	if (r->status == SDTEST_NONE || r->status == SDTEST_NO_CARD) {
+		if (n) return 0;
+		strcpy(buf, sdtErrors[r->status]);
+		return 1;
+	}
+	if (!r->haveIds && n < 3)
+		n = n == 0 ? 0 : 3;		// no CID/CSD, just the size
+	switch (n) {
+	case 0: sdt_card_line(r, buf); break;
+	case 1: sdt_cid_line(r, buf); break;
+	case 2: sprintf(buf, "Serial $%x", (unsigned)(r->cid[9] << 24 | r->cid[10] << 16 | r->cid[11] << 8 | r->cid[12])); break;
+	case 3: break;
+	case 4:
+		if (r->status != SDTEST_OK) strcpy(buf, sdtErrors[r->status]);
+		else sdt_rate_line(buf, "Multi block read", r->multiReadKBs, "KB/s");
+		break;
+	default:
+		if (r->status != SDTEST_OK) return 0;
+		switch (n) {
+		case 5: sdt_rate_line(buf, "Single block read", r->singleReadKBs, "KB/s"); break;
+		case 6: sdt_rate_line(buf, "Multi block write", r->multiWriteKBs, "KB/s"); break;
+		case 7: sdt_rate_line(buf, "Single block write", r->singleWriteKBs, "KB/s"); break;
+		case 8: break;
+		case 9: sdt_rate_line(buf, "Random 512 byte read min", r->randMinUs, "us"); break;
+		case 10: sdt_rate_line(buf, "                    avg", r->randAvgUs, "us"); break;
+		case 11: sdt_rate_line(buf, "                    max", r->randMaxUs, "us"); break;
+		default: return 0;
+		}
+	}
+	return 1;
+}
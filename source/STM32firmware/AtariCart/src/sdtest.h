@@ -0,0 +1,61 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * SD card self-test, to tell a slow card from a slow cart. A scratch file
+ * is written and read back through FatFs and the SPI driver, a sector at a
+ * time (single block commands) and in 32k chunks (multiple block commands),
+ * then read at random sectors for the latency. The results and the card's
+ * CID/CSD are kept for the menu to show a line at a time.
+ */
+
+#ifndef SDTEST_H
+#define SDTEST_H
+
+#include <stdint.h>
+
+#define SDTEST_FILENAME		"UNOSDTST.TMP"
+#define SDTEST_FILE_SIZE	(256*1024)
+#define SDTEST_CHUNK		(32*1024)
+#define SDTEST_RANDOM_READS	64
+
+typedef struct {
+	int status;					// SDTEST_xxx
+	uint8_t cardType;			// diskio.h CT_xxx
+	uint8_t cid[16], csd[16];
+	int haveIds;				// the driver gave us the CID and CSD
+	uint32_t sectors;
+	uint32_t singleReadKBs, multiReadKBs;
+	uint32_t singleWriteKBs, multiWriteKBs;
+	uint32_t randMinUs, randAvgUs, randMaxUs;
+} SDTEST_RESULT;
+
+#define SDTEST_OK			0
+#define SDTEST_NO_CARD		1
+#define SDTEST_CREATE		2	// can't make the scratch file (card full or locked?)
+#define SDTEST_WRITE		3
+#define SDTEST_READ			4
+#define SDTEST_NONE			5	// not run yet
+
+// buf must hold SDTEST_CHUNK bytes. The volume must be mounted
+int sdtest_run(uint8_t *buf);
+const SDTEST_RESULT *sdtest_result(void);
+// a line of results for the menu (38 chars at most), 0 if there's no line n
+int sdtest_line(int n, char *buf);
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stackmark.h"
+#include "stm32f4xx.h"
+
+// from stm32f4_flash.ld: the stack runs down from _estack towards _end
+extern uint32_t _end[], _estack[], _Min_Stack_Size[];
+
+void stack_paint(void) {
+	uint32_t *p = _end;
+	// leave room for this function's own frame
+	uint32_t *top = (uint32_t *)__get_MSP() - 16;
+
+	// an interrupt's frame mustn't be painted over while it's in use
+	__disable_irq();
+	while (p < top)
+		*p++ = STACK_PAINT;
+	__enable_irq();
+}
+
+uint32_t stack_high_water(void) {
+	uint32_t *p = _end;
+	while (p < _estack && *p == STACK_PAINT)
+		p++;
+	return (uint32_t)_estack - (uint32_t)p;
+}
+
+uint32_t stack_budget(void) {
+	return (uint32_t)_Min_Stack_Size;
+}
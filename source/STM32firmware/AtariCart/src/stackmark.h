@@ -0,0 +1,42 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Stack high water mark. The free RAM between the end of .bss and the stack
+ * is filled with a pattern at boot, and the deepest the stack has been is
+ * where the pattern stops. The firmware has no heap, so everything else in
+ * RAM is placed by the linker and shown in its memory usage report; the
+ * stack is the one figure that has to be measured, and the linker script's
+ * _Min_Stack_Size is the budget it's held to.
+ */
+
+#ifndef STACKMARK_H
+#define STACKMARK_H
+
+#include <stdint.h>
+
+#define STACK_PAINT		0xC5C5C5C5
+
+// fill the unused stack, from _end up to just below the caller
+void stack_paint(void);
+// deepest use since stack_paint, in bytes
+uint32_t stack_high_water(void);
+// _Min_Stack_Size from the linker script
+uint32_t stack_budget(void);
+
+#endif
@@ -0,0 +1,528 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "zipfile.h"
+#include "cartinfo.h"
+#include "cmdstats.h"
+#include <string.h>
+#include <strings.h>
+
+#define SIG_LOCAL		0x04034B50
+#define SIG_CENTRAL		0x02014B50
+#define SIG_END			0x06054B50
+
+#define CENTRAL_SIZE	46		// a central directory entry, before its name
+#define LOCAL_SIZE		30
+#define END_SIZE		22
+#define END_SEARCH		(END_SIZE + 0xFFFF)	// it may have a comment
+
+#define FNV_BASIS		2166136261u		// the hash of the archive's top folder
+#define MAX_CD_OFFSET	0x0FFFFFFF		// fits a member token
+#define READ_AHEAD		(32*1024)		// unpacked past what zip_read wants
+#define LINK_FRAGMENTS	32				// of the archive, for fast seek
+
+/* The index: a record for each member that is listed, from the bottom up,
+   and one for each folder from the top down */
+typedef struct {
+	uint32_t cdOffset;		// of its central directory entry
+	uint32_t dirHash;		// the folder it's in
+} ZIP_FILE_REC;
+
+typedef struct {
+	uint32_t hash;			// of its path in the archive
+	uint32_t parent;
+	char name[32];
+} ZIP_DIR_REC;
+
+typedef struct {
+	int valid;
+	uint32_t pathHash;		// of the archive
+	uint32_t zipSize;
+	ZIP_FILE_REC *files;
+	uint32_t numFiles;
+	ZIP_DIR_REC *dirsEnd;	// the first dir is dirsEnd[-1]
+	uint32_t numDirs;
+	// listing
+	FIL *fil;
+	uint32_t target;
+	uint32_t next;
+	int inFiles;
+} ZIP_INDEX;
+
+static ZIP_INDEX zx;
+
+// the archive bytes in rdBuf, zipBuf or a bigger one while the index is
+// built. zipBuf is inflate's input while rdLen is 0
+static uint8_t zipBuf[ZIP_IN_BUF];
+static uint8_t *rdBuf = zipBuf;
+static uint32_t rdSize = ZIP_IN_BUF;
+static FIL *rdFil;
+static uint32_t rdPos, rdLen;
+
+/* FatFs's map of the archive's clusters, so a seek doesn't follow them from
+   the start. It's built once for each archive, by one walk of the chain */
+static DWORD linkMap[2 + 2 * LINK_FRAGMENTS];
+static uint32_t linkHash, linkSize, linkClust;
+
+// whose unpacked data is in the ring, and the run that put it there
+static ZIP_MEMBER *ringMember;
+static INFLATE_OUT ringOut;
+
+static const char *kindExt[] = { "", "CAR", "ROM", "XEX", "ATR" };
+
+static uint16_t get16(const uint8_t *p) {
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t fnv(uint32_t h, uint8_t c) {
+	return (h ^ c) * 16777619u;
+}
+
+static void put_hex(char *dst, uint32_t v, int digits) {
+	for (int i = digits - 1; i >= 0; i--, v >>= 4)
+		dst[i] = "0123456789ABCDEF"[v & 15];
+	dst[digits] = 0;
+}
+
+// FILE_KIND_xxx from the extension of a name in the archive
+static int name_kind(const uint8_t *name, int len) {
+	char ext[6] = "x";
+	int e = len;
+	while (e && name[e - 1] != '.' && name[e - 1] != '/') e--;
+	if (!e || name[e - 1] != '.' || len - e > 3)
+		return FILE_KIND_NONE;
+	memcpy(ext + 1, name + e - 1, len - e + 1);
+	ext[len - e + 2] = 0;
+	return file_kind(ext);
+}
+
+static int get_hex(const char *s, int digits, uint32_t *v) {
+	*v = 0;
+	for (int i = 0; i < digits; i++) {
+		char c = s[i];
+		if (c >= '0' && c <= '9') *v = (*v << 4) | (c - '0');
+		else if (c >= 'A' && c <= 'F') *v = (*v << 4) | (c - 'A' + 10);
+		else return 0;
+	}
+	return 1;
+}
+
+// n bytes of the archive at off, NULL if they can't be read
+static const uint8_t *rd_get(FIL *fil, uint32_t off, uint32_t n) {
+	UINT br;
+	if (fil == rdFil && rdLen && off >= rdPos && off + n <= rdPos + rdLen)
+		return rdBuf + off - rdPos;
+	ringMember = 0;		// inflate's input is gone
+	rdFil = fil;
+	rdLen = 0;
+	uint32_t t = stat_now();
+	FRESULT res = f_lseek(fil, off);
+	if (res == FR_OK)
+		res = f_read(fil, rdBuf, rdSize, &br);
+	stat_phase(STAT_PHASE_READ, t);
+	if (res != FR_OK || br < n)
+		return 0;
+	rdPos = off;
+	rdLen = br;
+	return rdBuf;
+}
+
+static uint32_t zip_hash(const char *path, int zipLen) {
+	uint32_t h = FNV_BASIS;
+	for (int i = 0; i < zipLen; i++)
+		h = fnv(h, path[i]);
+	return h;
+}
+
+// seeks in fil use the link map, if the archive isn't too fragmented for it
+static void fast_seek(FIL *fil, uint32_t pathHash) {
+	if (pathHash != linkHash || f_size(fil) != linkSize || fil->sclust != linkClust) {
+		linkHash = 0;
+		linkMap[0] = sizeof(linkMap) / sizeof(DWORD);
+		fil->cltbl = linkMap;
+		uint32_t t = stat_now();
+		FRESULT res = f_lseek(fil, CREATE_LINKMAP);
+		stat_phase(STAT_PHASE_READ, t);
+		if (res != FR_OK) {
+			fil->cltbl = 0;
+			return;
+		}
+		linkHash = pathHash;
+		linkSize = f_size(fil);
+		linkClust = fil->sclust;
+	}
+	fil->cltbl = linkMap;
+}
+
+int zip_split(const char *path) {
+	for (const char *p = path; ; p++) {
+		if (*p && *p != '/')
+			continue;
+		int len = p - path;
+		if (len >= 4 && !strncasecmp(p - 4, ".ZIP", 4)) {
+			if (*p == '/' && (p[1] == '*' || p[1] == '?'))
+				return len;
+			if (!*p) {
+				// the end of the path, it may be a folder called .ZIP
+				FILINFO info;
+				char name[256];
+				if (len >= (int)sizeof(name))
+					return 0;
+				memcpy(name, path, len + 1);
+				info.lfname = 0;
+				return f_stat(name, &info) == FR_OK && !(info.fattrib & AM_DIR) ? len : 0;
+			}
+		}
+		if (!*p)
+			return 0;
+	}
+}
+
+void zip_forget(void) {
+	zx.valid = 0;
+}
+
+// the folder of the archive called name, in parent, has this hash
+static int add_dir(uint32_t hash, uint32_t parent, const uint8_t *name, int len) {
+	ZIP_DIR_REC *d = zx.dirsEnd - zx.numDirs;
+	for (uint32_t i = 0; i < zx.numDirs; i++)
+		if (d[i].hash == hash)
+			return 1;
+	if ((uint8_t *)(d - 1) < (uint8_t *)(zx.files + zx.numFiles))
+		return 0;	// full
+	d--;
+	d->hash = hash;
+	d->parent = parent;
+	if (len > 31) len = 31;
+	memcpy(d->name, name, len);
+	d->name[len] = 0;
+	zx.numDirs++;
+	return 1;
+}
+
+// the central directory's offset, size and entries, from its end record
+static int find_end(FIL *fil, uint32_t *cdOffset, uint32_t *cdSize, uint32_t *entries) {
+	uint32_t size = f_size(fil), lowest = size > END_SEARCH ? size - END_SEARCH : 0;
+	uint32_t pos = size;
+
+	while (pos > lowest && size >= END_SIZE) {
+		// back a buffer at a time, overlapping by a record
+		uint32_t start = pos >= rdSize ? pos - rdSize : 0;
+		if (start < lowest) start = lowest;
+		const uint8_t *p = rd_get(fil, start, pos - start);
+		if (!p)
+			return ZIP_READ_ERROR;
+		for (int i = (int)(pos - start) - 4; i >= 0; i--) {
+			if (get32(p + i) != SIG_END || start + i + END_SIZE > size)
+				continue;
+			const uint8_t *e = p + i;
+			if (start + i + END_SIZE > pos) {
+				// the record runs on past what's in the buffer
+				if (!(e = rd_get(fil, start + i, END_SIZE)))
+					return ZIP_READ_ERROR;
+			}
+			if (get16(e + 4) || get16(e + 6) || get16(e + 8) != get16(e + 10))
+				return ZIP_UNSUPPORTED;		// split over several files
+			*entries = get16(e + 10);
+			*cdSize = get32(e + 12);
+			*cdOffset = get32(e + 16);
+			if (*entries == 0xFFFF || *cdOffset == 0xFFFFFFFF)
+				return ZIP_UNSUPPORTED;		// ZIP64
+			if (*cdOffset + *cdSize > start + i)
+				return ZIP_CORRUPT;
+			return ZIP_OK;
+		}
+		if (start == lowest)
+			break;
+		pos = start + END_SIZE;
+	}
+	return ZIP_NOT_ZIP;
+}
+
+// read the central directory into the index
+static int build_index(FIL *fil, uint8_t *index, uint32_t indexSize) {
+	uint32_t cdOffset, cdSize, entries, lastDir = 0;
+	int ret = find_end(fil, &cdOffset, &cdSize, &entries);
+	if (ret != ZIP_OK)
+		return ret;
+
+	zx.files = (ZIP_FILE_REC *)index;
+	zx.numFiles = 0;
+	zx.dirsEnd = (ZIP_DIR_REC *)(index + indexSize / sizeof(ZIP_DIR_REC) * sizeof(ZIP_DIR_REC));
+	zx.numDirs = 0;
+	uint32_t off = cdOffset;
+	for (uint32_t n = 0; n < entries; n++) {
+		const uint8_t *h = rd_get(fil, off, CENTRAL_SIZE);
+		if (!h)
+			return ZIP_READ_ERROR;
+		if (get32(h) != SIG_CENTRAL)
+			return ZIP_CORRUPT;
+		int nameLen = get16(h + 28), encrypted = get16(h + 8) & 1;
+		uint32_t entryOff = off;
+		off += CENTRAL_SIZE + nameLen + get16(h + 30) + get16(h + 32);
+		const uint8_t *name = rd_get(fil, entryOff + CENTRAL_SIZE, nameLen);
+		if (!name)
+			return ZIP_READ_ERROR;
+
+		// the hash of the folder it's in, and where its own name starts
+		uint32_t hash = FNV_BASIS, dirHash = FNV_BASIS;
+		int i, last = 0;
+		for (i = 0; i < nameLen; i++) {
+			uint8_t c = name[i] == '\\' ? '/' : name[i];
+			if (c == '/') {
+				dirHash = hash;
+				last = i + 1;
+			}
+			hash = fnv(hash, c);
+		}
+		// the folders on the way to it, unless they're the last member's
+		if (dirHash != lastDir) {
+			uint32_t parent = FNV_BASIS, start = 0;
+			hash = FNV_BASIS;
+			for (i = 0; i < last; i++) {
+				uint8_t c = name[i] == '\\' ? '/' : name[i];
+				if (c == '/') {
+					if (i > (int)start) {
+						if (!add_dir(hash, parent, name + start, i - start))
+							break;
+						parent = hash;
+					}
+					start = i + 1;
+				}
+				hash = fnv(hash, c);
+			}
+			if (i < last)
+				break;		// the index is full
+			lastDir = dirHash;
+		}
+		if (last == nameLen || encrypted || entryOff > MAX_CD_OFFSET || nameLen > 255)
+			continue;
+		// a member the menu can load?
+		int kind = name_kind(name, nameLen);
+		if (kind < FILE_KIND_CAR || kind > FILE_KIND_ATR)
+			continue;
+		if ((uint8_t *)(zx.files + zx.numFiles + 1) > (uint8_t *)(zx.dirsEnd - zx.numDirs))
+			break;		// full
+		zx.files[zx.numFiles].cdOffset = entryOff;
+		zx.files[zx.numFiles].dirHash = dirHash;
+		zx.numFiles++;
+	}
+	return ZIP_OK;
+}
+
+int zip_list_begin(FIL *fil, const char *path, int zipLen, uint8_t *index, uint32_t indexSize,
+		uint8_t *buf, uint32_t bufSize) {
+	uint32_t pathHash = zip_hash(path, zipLen);
+	fast_seek(fil, pathHash);
+	if (!zx.valid || zx.pathHash != pathHash || zx.zipSize != f_size(fil) || (uint8_t *)zx.files != index) {
+		zx.valid = 0;
+		ringMember = 0;		// the index goes over the ring
+		rdBuf = buf;
+		rdSize = bufSize;
+		rdLen = 0;
+		int ret = build_index(fil, index, indexSize);
+		rdBuf = zipBuf;
+		rdSize = ZIP_IN_BUF;
+		rdLen = 0;
+		if (ret != ZIP_OK)
+			return ret;
+		zx.valid = 1;
+		zx.pathHash = pathHash;
+		zx.zipSize = f_size(fil);
+	}
+	// the folder is the last in the path, or the top
+	const char *dir = strstr(path + zipLen, "/*"), *next;
+	while (dir && (next = strstr(dir + 2, "/*")) != 0)
+		dir = next;
+	zx.fil = fil;
+	zx.target = FNV_BASIS;
+	if (dir && !get_hex(dir + 2, 8, &zx.target))
+		return ZIP_CORRUPT;
+	zx.next = 0;
+	zx.inFiles = 0;
+	return ZIP_OK;
+}
+
+int zip_list_next(ZIP_ITEM *item) {
+	FIL *fil = zx.fil;
+	if (!zx.inFiles) {
+		ZIP_DIR_REC *d = zx.dirsEnd - 1;
+		while (zx.next < zx.numDirs) {
+			ZIP_DIR_REC *r = d - zx.next++;
+			if (r->parent != zx.target)
+				continue;
+			memset(item, 0, sizeof(ZIP_ITEM));
+			item->isDir = 1;
+			item->token[0] = '*';
+			put_hex(item->token + 1, r->hash, 8);
+			strcpy(item->name, r->name);
+			return 1;
+		}
+		zx.inFiles = 1;
+		zx.next = 0;
+	}
+	while (zx.next < zx.numFiles) {
+		ZIP_FILE_REC *f = &zx.files[zx.next++];
+		if (f->dirHash != zx.target)
+			continue;
+		const uint8_t *h = rd_get(fil, f->cdOffset, CENTRAL_SIZE);
+		if (!h)
+			return -1;
+		int nameLen = get16(h + 28);
+		item->isDir = 0;
+		item->ftime = get16(h + 12);
+		item->fdate = get16(h + 14);
+		item->size = get32(h + 24);
+		const uint8_t *name = rd_get(fil, f->cdOffset + CENTRAL_SIZE, nameLen);
+		if (!name)
+			return -1;
+		int start = nameLen;
+		while (start && name[start - 1] != '/' && name[start - 1] != '\\')
+			start--;
+		int len = nameLen - start > 31 ? 31 : nameLen - start;
+		memcpy(item->name, name + start, len);
+		item->name[len] = 0;
+		item->token[0] = '?';
+		put_hex(item->token + 1, f->cdOffset, 7);
+		strcpy(item->token + 8, ".");
+		strcat(item->token + 8, kindExt[name_kind(name, nameLen)]);
+		return 1;
+	}
+	return 0;
+}
+
+int zip_member(FIL *fil, const char *path, int zipLen, ZIP_MEMBER *m) {
+	const char *token = strrchr(path + zipLen, '/');
+	uint32_t cdOffset;
+
+	memset(m, 0, sizeof(ZIP_MEMBER));
+	if (!token || token[1] != '?' || !get_hex(token + 2, 7, &cdOffset))
+		return ZIP_CORRUPT;
+	fast_seek(fil, zip_hash(path, zipLen));
+	m->kind = file_kind((char *)token);
+	const uint8_t *h = rd_get(fil, cdOffset, CENTRAL_SIZE);
+	if (!h)
+		return ZIP_READ_ERROR;
+	if (get32(h) != SIG_CENTRAL)
+		return ZIP_CORRUPT;
+	int method = get16(h + 10);
+	if ((get16(h + 8) & 1) || (method != 0 && method != 8))
+		return ZIP_UNSUPPORTED;
+	m->stored = method == 0;
+	m->crc = get32(h + 16);
+	m->packed = get32(h + 20);
+	m->size = get32(h + 24);
+	uint32_t localOff = get32(h + 42);
+	if (m->packed == 0xFFFFFFFF || m->size == 0xFFFFFFFF || localOff == 0xFFFFFFFF)
+		return ZIP_UNSUPPORTED;
+	const uint8_t *l = rd_get(fil, localOff, LOCAL_SIZE);
+	if (!l)
+		return ZIP_READ_ERROR;
+	if (get32(l) != SIG_LOCAL)
+		return ZIP_CORRUPT;
+	m->dataOffset = localOff + LOCAL_SIZE + get16(l + 26) + get16(l + 28);
+	if (m->dataOffset + m->packed > f_size(fil) || (m->stored && m->packed != m->size))
+		return ZIP_CORRUPT;
+	return ZIP_OK;
+}
+
+static int zip_status(int inflateStatus) {
+	switch (inflateStatus) {
+	case INFLATE_OK: return ZIP_OK;
+	case INFLATE_READ_ERROR: return ZIP_READ_ERROR;
+	case INFLATE_TOO_BIG: return ZIP_TOO_BIG;
+	default: return ZIP_CORRUPT;
+	}
+}
+
+// inflate's input goes through zipBuf
+static int zip_start(FIL *fil, ZIP_MEMBER *m, INFLATE_OUT *o) {
+	zx.valid = 0;		// the output goes over the index
+	rdLen = 0;
+	ringMember = 0;
+	if (f_lseek(fil, m->dataOffset) != FR_OK)
+		return INFLATE_READ_ERROR;
+	return inflate_run(fil, m->packed, m->stored, zipBuf, ZIP_IN_BUF, o);
+}
+
+// all of it is out, is it right?
+static int zip_check(ZIP_MEMBER *m, INFLATE_OUT *o) {
+	if (o->out != m->size)
+		return ZIP_CORRUPT;
+	if (o->crc != m->crc)
+		return ZIP_BAD_CRC;
+	return ZIP_OK;
+}
+
+int zip_load(FIL *fil, ZIP_MEMBER *m, INFLATE_OUT *o) {
+	int ret = zip_status(zip_start(fil, m, o));
+	return ret == ZIP_OK ? zip_check(m, o) : ret;
+}
+
+int zip_read(FIL *fil, ZIP_MEMBER *m, uint32_t offset, uint8_t *buf, uint32_t len, uint8_t *ram1, uint8_t *ram2) {
+	UINT br;
+	if (offset + len > m->size)
+		return ZIP_CORRUPT;
+	if (m->stored) {
+		uint32_t t = stat_now();
+		FRESULT res = f_lseek(fil, m->dataOffset + offset);
+		if (res == FR_OK)
+			res = f_read(fil, buf, len, &br);
+		stat_phase(STAT_PHASE_READ, t);
+		rdLen = 0;		// fil has moved
+		return res == FR_OK && br == len ? ZIP_OK : ZIP_READ_ERROR;
+	}
+	if (ringMember != m || offset < m->ringStart || offset + len > m->ringEnd) {
+		// on from where it stopped if that's not past offset, or from the start
+		uint32_t stopAt = offset + len + READ_AHEAD < m->size ? offset + len + READ_AHEAD : 0;
+		int st;
+		if (ringMember == m && offset >= m->ringStart) {
+			ringOut.stopAt = stopAt;
+			st = inflate_resume(&ringOut);
+		}
+		else {
+			memset(&ringOut, 0, sizeof(ringOut));
+			ringOut.ram1 = ram1;
+			ringOut.ram2 = ram2;
+			ringOut.ring = 1;
+			ringOut.stopAt = stopAt;
+			st = zip_start(fil, m, &ringOut);
+		}
+		int ret = st == INFLATE_STOPPED ? ZIP_OK : zip_status(st);
+		if (ret == ZIP_OK && st == INFLATE_OK)
+			ret = zip_check(m, &ringOut);
+		if (ret != ZIP_OK) {
+			ringMember = 0;
+			return ret;
+		}
+		ringMember = m;
+		m->ringEnd = ringOut.out;
+		m->ringStart = ringOut.out > CART_MAX_IMAGE_SIZE ? ringOut.out - CART_MAX_IMAGE_SIZE : 0;
+		if (offset < m->ringStart || offset + len > m->ringEnd)
+			return ZIP_CORRUPT;
+	}
+	for (uint32_t i = 0; i < len; i++) {
+		uint32_t p = (offset + i) % CART_MAX_IMAGE_SIZE;
+		buf[i] = p < CART_RAM_SPLIT ? ram1[p] : ram2[p - CART_RAM_SPLIT];
+	}
+	return ZIP_OK;
+}
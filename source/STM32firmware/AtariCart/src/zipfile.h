@@ -0,0 +1,90 @@
+/*
+ * --------------------------------------
+ * UNOCart Firmware (c)2016 Robin Edwards
+ * --------------------------------------
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * .ZIP files as folders. The central directory is read once into an index
+ * (in cart_ram2, it is rebuilt if anything else has used that) of the .CAR,
+ * .ROM, .XEX and .ATR members and the folders they're in, so listing any
+ * folder of the archive needs only the names of what's in it.
+ *
+ * The menu's paths go on into an archive with tokens, since its names may
+ * be longer than a DIR_ENTRY's filename: "*1A2B3C4D" is the folder of the
+ * archive whose path hashes to $1A2B3C4D, "?0012F40.CAR" the member whose
+ * central directory entry is at $12F40. Neither '*' nor '?' can be in a FAT
+ * name, so the tokens can't be mistaken for files on the card.
+ */
+
+#ifndef ZIPFILE_H
+#define ZIPFILE_H
+
+#include <stdint.h>
+#include "ff.h"
+#include "inflate.h"
+
+#define ZIP_IN_BUF			2048		// archive bytes read at a time
+
+// status codes
+#define ZIP_OK				0
+#define ZIP_READ_ERROR		1
+#define ZIP_NOT_ZIP			2
+#define ZIP_CORRUPT			3
+#define ZIP_UNSUPPORTED		4	// ZIP64, split, encrypted, or not stored/deflated
+#define ZIP_TOO_BIG			5
+#define ZIP_BAD_CRC			6
+
+typedef struct {
+	int isDir;
+	char token[13];			// for DIR_ENTRY.filename
+	char name[32];			// the last part of its name in the archive
+	uint16_t fdate, ftime;
+	uint32_t size;			// unpacked
+} ZIP_ITEM;
+
+typedef struct {
+	int kind;				// FILE_KIND_xxx, from the name
+	int stored;				// or deflated
+	uint32_t crc;
+	uint32_t packed, size;
+	uint32_t dataOffset;	// in the archive
+	uint32_t ringStart, ringEnd;	// unpacked bytes in the ring, for zip_read
+} ZIP_MEMBER;
+
+/* the length of the part of path that is a .ZIP file, 0 if path isn't in
+   one. A path ending in .ZIP is checked on the card */
+int zip_split(const char *path);
+// the index is gone, cart_ram2 has been used
+void zip_forget(void);
+
+/* list the folder path is at in the archive (path's first zipLen bytes),
+   open in fil. index is where the index goes, buf is for reading the
+   central directory when the index is built */
+int zip_list_begin(FIL *fil, const char *path, int zipLen, uint8_t *index, uint32_t indexSize,
+		uint8_t *buf, uint32_t bufSize);
+// the next item: 1, 0 when there are no more, -1 if it can't be read
+int zip_list_next(ZIP_ITEM *item);
+
+// the member path is at, in the archive open in fil
+int zip_member(FIL *fil, const char *path, int zipLen, ZIP_MEMBER *m);
+// unpack all of it into o. Checks the CRC
+int zip_load(FIL *fil, ZIP_MEMBER *m, INFLATE_OUT *o);
+/* len bytes at offset in the unpacked member. A deflated one is unpacked
+   into the 128k ring ram1/ram2, from the start again if offset is behind
+   what's there */
+int zip_read(FIL *fil, ZIP_MEMBER *m, uint32_t offset, uint8_t *buf, uint32_t len, uint8_t *ram1, uint8_t *ram2);
+
+#endif